@@ -0,0 +1,174 @@
+#include "AvailabilityStream.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QUrlQuery>
+#include <QStringList>
+#include <QList>
+#include <algorithm>
+#include <QDebug>
+
+namespace {
+
+const int RECONNECT_INTERVAL_MS = 3000;
+
+} // namespace
+
+AvailabilityStream::AvailabilityStream(QNetworkAccessManager *manager, const QString &apiBase,
+                                       QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_apiBase(apiBase)
+{
+    m_reconnectTimer.setSingleShot(true);
+    m_reconnectTimer.setInterval(RECONNECT_INTERVAL_MS);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &AvailabilityStream::connectStream);
+}
+
+AvailabilityStream::~AvailabilityStream()
+{
+    stop();
+}
+
+void AvailabilityStream::subscribe(const QSet<int> &scheduleIds,
+                                   const QString &fromStation, const QString &toStation)
+{
+    if (scheduleIds.isEmpty()) {
+        stop();
+        return;
+    }
+
+    QList<int> ids(scheduleIds.begin(), scheduleIds.end());
+    std::sort(ids.begin(), ids.end());
+    QStringList idList;
+    for (int id : ids) {
+        idList << QString::number(id);
+    }
+
+    QUrlQuery query;
+    query.addQueryItem("schedules", idList.join(','));
+    query.addQueryItem("fromStation", fromStation);
+    query.addQueryItem("toStation", toStation);
+    QUrl url(m_apiBase + "/events/availability");
+    url.setQuery(query);
+
+    // 订阅没变且连接还在，不必重连
+    if (url == m_url && (m_reply || m_reconnectTimer.isActive())) {
+        return;
+    }
+
+    stop();
+    m_url = url;
+    m_fromStation = fromStation;
+    m_toStation = toStation;
+    connectStream();
+}
+
+void AvailabilityStream::stop()
+{
+    m_reconnectTimer.stop();
+    m_url.clear();
+    if (m_reply) {
+        QNetworkReply *reply = m_reply;
+        m_reply = nullptr;          // 先置空，abort 触发的 finished 不再重连
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+void AvailabilityStream::connectStream()
+{
+    if (m_url.isEmpty()) {
+        return;
+    }
+
+    m_buffer.clear();
+    m_eventName.clear();
+    m_eventData.clear();
+
+    QNetworkRequest request(m_url);
+    request.setRawHeader("Accept", "text/event-stream");
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                         QNetworkRequest::AlwaysNetwork);
+    // 长连接，不记入网络诊断
+    m_reply = m_manager->get(request);
+
+    connect(m_reply, &QNetworkReply::readyRead, this, &AvailabilityStream::onReadyRead);
+    connect(m_reply, &QNetworkReply::finished, this, &AvailabilityStream::onFinished);
+}
+
+void AvailabilityStream::onReadyRead()
+{
+    m_buffer += m_reply->readAll();
+
+    int newline;
+    while ((newline = m_buffer.indexOf('\n')) >= 0) {
+        QByteArray line = m_buffer.left(newline);
+        m_buffer.remove(0, newline + 1);
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+
+        if (line.isEmpty()) {
+            dispatchEvent();
+        } else if (line.startsWith(':')) {
+            // 注释行（keepalive）
+        } else if (line.startsWith("event:")) {
+            m_eventName = line.mid(6).trimmed();
+        } else if (line.startsWith("data:")) {
+            if (!m_eventData.isEmpty()) {
+                m_eventData += '\n';
+            }
+            m_eventData += line.mid(5).trimmed();
+        }
+    }
+}
+
+void AvailabilityStream::onFinished()
+{
+    QNetworkReply *reply = m_reply;
+    m_reply = nullptr;
+    if (reply) {
+        qDebug() << "余票推送连接断开:" << reply->errorString();
+        reply->deleteLater();
+    }
+    // 服务端重启或网络中断，稍后重连；期间漏掉的变化由下次搜索补齐
+    if (!m_url.isEmpty()) {
+        m_reconnectTimer.start();
+    }
+}
+
+void AvailabilityStream::dispatchEvent()
+{
+    QByteArray name = m_eventName;
+    QByteArray data = m_eventData;
+    m_eventName.clear();
+    m_eventData.clear();
+
+    if (name != "availability" || data.isEmpty()) {
+        return;
+    }
+
+    QJsonObject event = QJsonDocument::fromJson(data).object();
+    QString fromStation = event["fromStation"].toString();
+    QString toStation = event["toStation"].toString();
+    if (fromStation != m_fromStation || toStation != m_toStation) {
+        return;
+    }
+
+    for (const QJsonValue &seatValue : event["seatTypes"].toArray()) {
+        QJsonObject seat = seatValue.toObject();
+
+        AvailabilityUpdate update;
+        update.scheduleId = event["scheduleId"].toInt();
+        update.seatType = seat["type"].toString();
+        update.fromStation = fromStation;
+        update.toStation = toStation;
+        update.availableSeats = seat["availableSeats"].toInt();
+        emit availabilityChanged(update);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef AVAILABILITYSTREAM_H
+#define AVAILABILITYSTREAM_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+#include <QNetworkReply>
+#include "ResponseParser.h"
+
+class QNetworkAccessManager;
+
+// 订阅 /events/availability 的余票推送（Server-Sent Events）。
+// 一次只订阅一组时刻表，连接断开后按固定间隔重连
+class AvailabilityStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    AvailabilityStream(QNetworkAccessManager *manager, const QString &apiBase,
+                       QObject *parent = nullptr);
+    ~AvailabilityStream();
+
+    // 替换当前订阅；scheduleIds 为空时等同于 stop()
+    void subscribe(const QSet<int> &scheduleIds,
+                   const QString &fromStation, const QString &toStation);
+    void stop();
+
+signals:
+    void availabilityChanged(const AvailabilityUpdate &update);
+
+private:
+    void connectStream();
+    void onReadyRead();
+    void onFinished();
+    void dispatchEvent();
+
+    QNetworkAccessManager *m_manager;
+    QString m_apiBase;
+    QPointer<QNetworkReply> m_reply;    // 随 QNetworkAccessManager 析构时自动置空
+    QTimer m_reconnectTimer;
+
+    QUrl m_url;
+    QString m_fromStation;
+    QString m_toStation;
+
+    // 当前事件的解析状态，空行时分发
+    QByteArray m_buffer;
+    QByteArray m_eventName;
+    QByteArray m_eventData;
+};
+
+#endif // AVAILABILITYSTREAM_H
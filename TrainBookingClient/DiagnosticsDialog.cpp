@@ -0,0 +1,179 @@
+#include "DiagnosticsDialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QStandardPaths>
+#include <QDir>
+#include <algorithm>
+
+namespace {
+
+// 耗时列在 RequestTiming 中对应的字段，顺序与表头一致
+const int FIRST_STAGE_COLUMN = 4;
+double RequestTiming::*const STAGE_FIELDS[] = {
+    &RequestTiming::dnsMs, &RequestTiming::connectMs, &RequestTiming::ttfbMs,
+    &RequestTiming::downloadMs, &RequestTiming::parseMs, &RequestTiming::renderMs,
+    &RequestTiming::totalMs
+};
+const char *const STAGE_NAMES[] = {
+    "排队/DNS", "连接", "首字节", "下载", "解析", "渲染", "总计"
+};
+const int STAGE_COUNT = sizeof(STAGE_FIELDS) / sizeof(STAGE_FIELDS[0]);
+
+QString formatMs(double ms)
+{
+    return ms < 0 ? QString("-") : QString::number(ms, 'f', 1);
+}
+
+double percentile(QList<double> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    int index = qBound(0, int(p * (values.size() - 1) + 0.5), int(values.size()) - 1);
+    return values[index];
+}
+
+} // namespace
+
+DiagnosticsDialog::DiagnosticsDialog(NetworkTimings *timings, QWidget *parent)
+    : QDialog(parent)
+    , m_timings(timings)
+{
+    setWindowTitle("📊 网络诊断");
+    resize(1000, 500);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    m_summaryLabel = new QLabel(this);
+    m_summaryLabel->setTextFormat(Qt::RichText);
+    layout->addWidget(m_summaryLabel);
+
+    m_table = new QTableWidget(this);
+    QStringList headers = {"时间", "请求", "状态", "字节"};
+    for (const char *name : STAGE_NAMES) {
+        headers << QString("%1(ms)").arg(name);
+    }
+    headers << "错误";
+    m_table->setColumnCount(headers.size());
+    m_table->setHorizontalHeaderLabels(headers);
+    m_table->setAlternatingRowColors(true);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+    m_table->verticalHeader()->setVisible(false);
+    layout->addWidget(m_table);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addStretch();
+    m_exportButton = new QPushButton("导出CSV", this);
+    m_clearButton = new QPushButton("清空", this);
+    m_closeButton = new QPushButton("关闭", this);
+    buttonLayout->addWidget(m_exportButton);
+    buttonLayout->addWidget(m_clearButton);
+    buttonLayout->addWidget(m_closeButton);
+    layout->addLayout(buttonLayout);
+
+    connect(m_exportButton, &QPushButton::clicked, this, &DiagnosticsDialog::exportCsv);
+    connect(m_clearButton, &QPushButton::clicked, m_timings, &NetworkTimings::clear);
+    connect(m_closeButton, &QPushButton::clicked, this, &QDialog::close);
+    connect(m_timings, &NetworkTimings::timingRecorded, this, &DiagnosticsDialog::appendTiming);
+    connect(m_timings, &NetworkTimings::cleared, this, &DiagnosticsDialog::reload);
+
+    reload();
+}
+
+void DiagnosticsDialog::appendTiming(const RequestTiming &timing)
+{
+    // 最新的请求显示在最上面
+    m_table->insertRow(0);
+    m_table->setItem(0, 0, new QTableWidgetItem(timing.startedAt.toString("hh:mm:ss.zzz")));
+
+    QTableWidgetItem *nameItem = new QTableWidgetItem(timing.name);
+    nameItem->setToolTip(timing.url);
+    m_table->setItem(0, 1, nameItem);
+    m_table->setItem(0, 2, new QTableWidgetItem(QString::number(timing.httpStatus)));
+    m_table->setItem(0, 3, new QTableWidgetItem(QString::number(timing.bytes)));
+
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        QTableWidgetItem *item = new QTableWidgetItem(formatMs(timing.*STAGE_FIELDS[i]));
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        m_table->setItem(0, FIRST_STAGE_COLUMN + i, item);
+    }
+    if (timing.connectionReused) {
+        m_table->item(0, FIRST_STAGE_COLUMN)->setToolTip("复用已有连接");
+        m_table->item(0, FIRST_STAGE_COLUMN + 1)->setToolTip("复用已有连接");
+    }
+    m_table->setItem(0, FIRST_STAGE_COLUMN + STAGE_COUNT, new QTableWidgetItem(timing.error));
+
+    if (!timing.error.isEmpty()) {
+        for (int col = 0; col < m_table->columnCount(); ++col) {
+            m_table->item(0, col)->setForeground(QColor(220, 53, 69));
+        }
+    }
+
+    while (m_table->rowCount() > m_timings->capacity()) {
+        m_table->removeRow(m_table->rowCount() - 1);
+    }
+    updateSummary();
+}
+
+void DiagnosticsDialog::reload()
+{
+    m_table->setRowCount(0);
+    for (const RequestTiming &timing : m_timings->timings()) {
+        appendTiming(timing);
+    }
+    updateSummary();
+}
+
+void DiagnosticsDialog::updateSummary()
+{
+    const QList<RequestTiming> &timings = m_timings->timings();
+    if (timings.isEmpty()) {
+        m_summaryLabel->setText("暂无请求记录");
+        return;
+    }
+
+    QStringList parts;
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        QList<double> values;
+        for (const RequestTiming &timing : timings) {
+            double ms = timing.*STAGE_FIELDS[i];
+            if (ms >= 0) {
+                values << ms;
+            }
+        }
+        if (!values.isEmpty()) {
+            parts << QString("<b>%1</b> p50 %2 / p95 %3")
+                     .arg(STAGE_NAMES[i])
+                     .arg(formatMs(percentile(values, 0.5)))
+                     .arg(formatMs(percentile(values, 0.95)));
+        }
+    }
+    m_summaryLabel->setText(QString("最近 %1 个请求（ms）：%2")
+                            .arg(timings.size())
+                            .arg(parts.join("，")));
+}
+
+void DiagnosticsDialog::exportCsv()
+{
+    QString defaultPath = QDir(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation))
+                          .filePath(QString("network-timings-%1.csv")
+                                    .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+    QString filePath = QFileDialog::getSaveFileName(this, "导出网络计时", defaultPath,
+                                                    "CSV文件 (*.csv)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    if (m_timings->exportCsv(filePath, &error)) {
+        QMessageBox::information(this, "导出成功",
+                                 QString("已导出 %1 条记录到\n%2")
+                                 .arg(m_timings->timings().size())
+                                 .arg(filePath));
+    } else {
+        QMessageBox::warning(this, "导出失败", QString("无法写入文件: %1").arg(error));
+    }
+}
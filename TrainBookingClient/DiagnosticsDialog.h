@@ -0,0 +1,34 @@
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include "NetworkTimings.h"
+
+// 网络诊断面板：最近请求的分阶段耗时，以及各阶段的 p50/p95
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(NetworkTimings *timings, QWidget *parent = nullptr);
+
+private slots:
+    void appendTiming(const RequestTiming &timing);
+    void reload();
+    void exportCsv();
+
+private:
+    void updateSummary();
+
+    NetworkTimings *m_timings;
+    QTableWidget *m_table;
+    QLabel *m_summaryLabel;
+    QPushButton *m_exportButton;
+    QPushButton *m_clearButton;
+    QPushButton *m_closeButton;
+};
+
+#endif // DIAGNOSTICSDIALOG_H
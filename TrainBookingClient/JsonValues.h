@@ -0,0 +1,16 @@
+#ifndef JSONVALUES_H
+#define JSONVALUES_H
+
+#include <QJsonValue>
+#include <QString>
+
+// 价格可能是字符串也可能是数字
+inline double priceOf(const QJsonValue &priceValue)
+{
+    if (priceValue.isString()) {
+        return priceValue.toString().toDouble();
+    }
+    return priceValue.toDouble();
+}
+
+#endif // JSONVALUES_H
@@ -1,8 +1,14 @@
 #include "MainWindow.h"
+#include "DiagnosticsDialog.h"
+#include "TrainTableDelegate.h"
 #include <QApplication>
 #include <QDir>
 #include <QStandardPaths>
 #include <QDebug>
+#include <QMenuBar>
+#include <QMenu>
+#include <QAction>
+#include <QScrollBar>
 
 // 静态常量定义
 const QString MainWindow::API_BASE = "http://localhost:3000";
@@ -18,6 +24,10 @@ MainWindow::MainWindow(QWidget *parent)
     , m_mainSplitter(nullptr)
     , m_selectedTrainRow(-1)
     , m_networkManager(new QNetworkAccessManager(this))
+    , m_timings(new NetworkTimings(200, this))
+    , m_diagnosticsDialog(nullptr)
+    , m_availabilityStream(new AvailabilityStream(m_networkManager, API_BASE, this))
+    , m_searchFromButton(false)
 {
     setWindowTitle("🚄 火车票预订系统 - Qt客户端");
     setWindowIcon(QIcon(":/icons/train.png")); // 如果有图标资源
@@ -26,6 +36,31 @@ MainWindow::MainWindow(QWidget *parent)
     setupUI();
     populateStationComboBoxes();
     
+    connect(m_availabilityStream, &AvailabilityStream::availabilityChanged,
+            this, &MainWindow::onAvailabilityPushed);
+    
+    // 相邻日期预取；换了出发站或到达站，已排队的日期就没用了
+    m_prefetcher = new SearchPrefetcher(m_networkManager, API_BASE, &m_searchCache, m_timings, this);
+    m_prefetcher->setDays(PREFETCH_DAYS);
+    m_prefetcher->setMaxConcurrent(PREFETCH_CONCURRENCY);
+    connect(m_fromStationCombo, &QComboBox::currentIndexChanged,
+            m_prefetcher, &SearchPrefetcher::cancel);
+    connect(m_toStationCombo, &QComboBox::currentIndexChanged,
+            m_prefetcher, &SearchPrefetcher::cancel);
+    
+    // 同一时刻只保留最新的搜索
+    m_searchRequests = new SearchRequestManager(m_networkManager, API_BASE, m_timings, this);
+    connect(m_searchRequests, &SearchRequestManager::started, this, &MainWindow::onSearchStarted);
+    connect(m_searchRequests, &SearchRequestManager::finished, this, &MainWindow::onSearchFinished);
+    connect(m_searchRequests, &SearchRequestManager::failed, this, &MainWindow::onSearchFailed);
+    
+    // 已经搜索过之后，修改日期或车站自动重新搜索（去抖）
+    connect(m_travelDateEdit, &QDateEdit::dateChanged, this, &MainWindow::onSearchInputChanged);
+    connect(m_fromStationCombo, &QComboBox::currentIndexChanged,
+            this, &MainWindow::onSearchInputChanged);
+    connect(m_toStationCombo, &QComboBox::currentIndexChanged,
+            this, &MainWindow::onSearchInputChanged);
+    
     // 设置默认日期
     m_travelDateEdit->setDate(QDate(2025, 7, 17));
     m_travelDateEdit->setMinimumDate(QDate(2025, 7, 17));
@@ -49,6 +84,7 @@ void MainWindow::setupUI()
     setupTrainListSection();
     setupOrderSection();
     setupStatusBar();
+    setupMenuBar();
 }
 
 void MainWindow::setupSearchSection()
@@ -98,25 +134,23 @@ void MainWindow::setupTrainListSection()
     
     QVBoxLayout *trainLayout = new QVBoxLayout(m_trainListGroup);
     
-    m_trainTable = new QTableWidget(this);
-    m_trainTable->setColumnCount(9);
-    QStringList headers = {"车次", "出发站", "到达站", "日期", "座位类型", "价格", "余票", "总票数", "时刻表"};
-    m_trainTable->setHorizontalHeaderLabels(headers);
+    m_trainModel = new TrainTableModel(this);
+    m_trainTable = new QTableView(this);
+    m_trainTable->setModel(m_trainModel);
+    m_trainDelegate = new TrainTableDelegate(40, m_trainTable);
+    m_trainTable->setItemDelegate(m_trainDelegate);
     
     // 设置表格属性
     m_trainTable->setAlternatingRowColors(true);
     m_trainTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_trainTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_trainTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
     m_trainTable->horizontalHeader()->setStretchLastSection(true);
     m_trainTable->verticalHeader()->setVisible(false);
     
-    // 优化时刻表列显示
-    m_trainTable->setWordWrap(true); // 启用自动换行
-    m_trainTable->setTextElideMode(Qt::ElideNone); // 禁用省略号
-    
-    // 设置最小行高以支持多行内容
-    m_trainTable->verticalHeader()->setMinimumSectionSize(80);
-    m_trainTable->verticalHeader()->setDefaultSectionSize(80);
+    // 行高不按内容测量，由 displayTrains 按时刻表站数设置
+    m_trainTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_trainTable->verticalHeader()->setDefaultSectionSize(40);
     
     // 设置列宽
     m_trainTable->setColumnWidth(0, 80);   // 车次
@@ -136,7 +170,10 @@ void MainWindow::setupTrainListSection()
     m_bookButton->setMinimumHeight(40);
     trainLayout->addWidget(m_bookButton);
     
-    connect(m_trainTable, &QTableWidget::itemSelectionChanged, 
+    connect(m_trainTable->selectionModel(), &QItemSelectionModel::selectionChanged,
+            this, &MainWindow::onTrainSelectionChanged);
+    // 重置模型会清空选中但不发出 selectionChanged
+    connect(m_trainModel, &QAbstractItemModel::modelReset,
             this, &MainWindow::onTrainSelectionChanged);
     connect(m_bookButton, &QPushButton::clicked, this, &MainWindow::bookTicket);
     
@@ -171,22 +208,24 @@ void MainWindow::setupOrderSection()
     
     orderLayout->addWidget(queryWidget);
     
-    // 订单表格
-    m_orderTable = new QTableWidget(this);
-    m_orderTable->setColumnCount(9);
-    QStringList orderHeaders = {"订单号", "车次", "日期", "行程", "座位", "乘客", "价格", "状态", "创建时间"};
-    m_orderTable->setHorizontalHeaderLabels(orderHeaders);
+    // 订单表格：数据按页从服务器加载，只保留有限的行数
+    m_orderModel = new OrderTableModel(m_networkManager, API_BASE, m_timings, this);
+    m_orderModel->setPageSize(ORDER_PAGE_SIZE);
+    m_orderModel->setMaxPages(ORDER_MAX_PAGES);
+    m_orderTable = new QTableView(this);
+    m_orderTable->setModel(m_orderModel);
     
     m_orderTable->setAlternatingRowColors(true);
     m_orderTable->horizontalHeader()->setStretchLastSection(true);
     m_orderTable->verticalHeader()->setVisible(false);
+    m_orderTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
     
     // 优化订单表格显示
     m_orderTable->setWordWrap(true); // 启用自动换行
     m_orderTable->setTextElideMode(Qt::ElideNone); // 禁用省略号
     
-    // 设置最小行高以支持多行内容
-    m_orderTable->verticalHeader()->setMinimumSectionSize(60);
+    // 固定行高，容纳两行内容；加载新页时不按内容测量
+    m_orderTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
     m_orderTable->verticalHeader()->setDefaultSectionSize(60);
     
     // 设置订单表格的列宽
@@ -204,6 +243,24 @@ void MainWindow::setupOrderSection()
     
     connect(m_queryOrdersButton, &QPushButton::clicked, this, &MainWindow::queryOrders);
     connect(m_queryAllOrdersButton, &QPushButton::clicked, this, &MainWindow::queryAllOrders);
+    connect(m_orderModel, &OrderTableModel::loaded, this, &MainWindow::onOrdersLoaded);
+    connect(m_orderModel, &OrderTableModel::loadFailed, this, &MainWindow::onOrdersLoadFailed);
+    
+    // 向下滚动由视图调用 fetchMore；窗口前端丢弃过的页在滚回顶部时重新加载
+    QScrollBar *orderScrollBar = m_orderTable->verticalScrollBar();
+    connect(orderScrollBar, &QScrollBar::valueChanged, this, [this, orderScrollBar](int value) {
+        if (value == orderScrollBar->minimum() && m_orderModel->canFetchNewer()) {
+            m_orderModel->fetchNewer();
+        }
+    });
+    // 前端增删行后按行高补偿滚动位置，保持用户正在看的行不动；
+    // 等视图按新行数更新滚动范围后再调整
+    connect(m_orderModel, &OrderTableModel::windowShifted, this, [this, orderScrollBar](int rows) {
+        int offset = rows * m_orderTable->verticalHeader()->defaultSectionSize();
+        QTimer::singleShot(0, this, [orderScrollBar, offset]() {
+            orderScrollBar->setValue(orderScrollBar->value() + offset);
+        });
+    });
     
     m_mainSplitter->addWidget(m_orderGroup);
     
@@ -223,6 +280,38 @@ void MainWindow::setupStatusBar()
     
     statusBar()->addWidget(m_statusLabel, 1);
     statusBar()->addPermanentWidget(m_progressBar);
+
+    // 上一个请求的耗时，详情见网络诊断面板
+    m_timingLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_timingLabel);
+    connect(m_timings, &NetworkTimings::timingRecorded, this, &MainWindow::onTimingRecorded);
+}
+
+void MainWindow::setupMenuBar()
+{
+    QMenu *toolsMenu = menuBar()->addMenu("工具");
+    QAction *diagnosticsAction = toolsMenu->addAction("📊 网络诊断...");
+    diagnosticsAction->setShortcut(QKeySequence("Ctrl+Shift+D"));
+    connect(diagnosticsAction, &QAction::triggered, this, &MainWindow::showDiagnostics);
+}
+
+void MainWindow::showDiagnostics()
+{
+    if (!m_diagnosticsDialog) {
+        m_diagnosticsDialog = new DiagnosticsDialog(m_timings, this);
+    }
+    m_diagnosticsDialog->show();
+    m_diagnosticsDialog->raise();
+    m_diagnosticsDialog->activateWindow();
+}
+
+void MainWindow::onTimingRecorded(const RequestTiming &timing)
+{
+    QString text = QString("%1 %2 ms").arg(timing.name).arg(timing.totalMs, 0, 'f', 0);
+    if (timing.ttfbMs >= 0) {
+        text += QString("（服务器 %1 ms）").arg(timing.ttfbMs, 0, 'f', 0);
+    }
+    m_timingLabel->setText(text);
 }
 
 void MainWindow::populateStationComboBoxes()
@@ -242,24 +331,58 @@ void MainWindow::searchTrains()
         return;
     }
     
-    setLoading(true);
-    m_statusLabel->setText("正在搜索车次...");
-    
-    QJsonObject requestData;
-    requestData["fromStation"] = m_fromStationCombo->currentData().toString();
-    requestData["toStation"] = m_toStationCombo->currentData().toString();
-    requestData["date"] = m_travelDateEdit->date().toString("yyyy-MM-dd");
-    
-    QNetworkRequest request(QUrl(API_BASE + "/search-bookable-trains"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    m_searchFromButton = true;
+    startSearch(currentSearchQuery(), false);
+}
+
+void MainWindow::onSearchInputChanged()
+{
+    // 还没搜索过时不自动搜索；条件不完整时静默忽略，不弹出提示
+    if (m_displayedQuery.date.isEmpty()) {
+        return;
+    }
+    SearchQuery query = currentSearchQuery();
+    if (query.fromStation.isEmpty() || query.toStation.isEmpty()
+        || query.fromStation == query.toStation) {
+        if (m_searchRequests->isActive()) {
+            m_searchRequests->cancel();
+            setLoading(false);
+        }
+        return;
+    }
     
-    QJsonDocument doc(requestData);
-    QNetworkReply *reply = m_networkManager->post(request, doc.toJson());
+    m_searchFromButton = false;
+    startSearch(query, true);
+}
+
+SearchQuery MainWindow::currentSearchQuery() const
+{
+    SearchQuery query;
+    query.fromStation = m_fromStationCombo->currentData().toString();
+    query.toStation = m_toStationCombo->currentData().toString();
+    query.date = m_travelDateEdit->date().toString("yyyy-MM-dd");
+    return query;
+}
+
+void MainWindow::startSearch(const SearchQuery &query, bool debounced)
+{
+    // 缓存命中时直接显示，不再请求服务器；进行中的旧搜索一并放弃，免得晚到的结果覆盖
+    SearchResponse cached;
+    if (m_searchCache.lookup(query, &cached)) {
+        if (m_searchRequests->isActive()) {
+            m_searchRequests->cancel();
+            setLoading(false);
+        }
+        displayTrains(query, cached.rows);
+        m_statusLabel->setText(QString("找到 %1 个可预订车次（缓存）").arg(cached.trainCount));
+        return;
+    }
     
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onSearchFinished(reply);
-        reply->deleteLater();
-    });
+    if (debounced) {
+        m_searchRequests->searchDebounced(query);
+    } else {
+        m_searchRequests->search(query);
+    }
 }
 
 void MainWindow::bookTicket()
@@ -268,23 +391,22 @@ void MainWindow::bookTicket()
         return;
     }
     
-    int currentRow = m_trainTable->currentRow();
+    int currentRow = selectedTrainRow();
     if (currentRow < 0) {
         showMessage("请选择要预订的车次", false);
         return;
     }
     
     // 获取选中行的数据
-    QString trainName = m_trainTable->item(currentRow, 0)->text();
-    QString seatType = m_trainTable->item(currentRow, 4)->text();
-    QString priceStr = m_trainTable->item(currentRow, 5)->text();
-    double price = priceStr.replace("¥", "").toDouble();
+    const TrainSeatRow &train = m_trainModel->row(currentRow);
+    QString trainName = train.trainName;
+    QString seatType = train.seatType;
+    double price = train.price;
     
     // 调试输出
     qDebug() << "预订请求 - 车次:" << trainName 
              << "座位类型:" << seatType 
-             << "价格字符串:" << priceStr 
-             << "解析的价格:" << price;
+             << "价格:" << price;
     
     // 确认对话框
     QString confirmText = QString("确认预订以下车票？\n\n"
@@ -312,11 +434,11 @@ void MainWindow::bookTicket()
     setLoading(true);
     m_statusLabel->setText("正在预订车票...");
     
-    // 从当前车次数据中获取trainId
-    QJsonObject trainData = m_currentTrains[currentRow].toObject();
+    // 记下预订的行，结果返回时用来显示开车时间
+    m_selectedTrainRow = currentRow;
     
     QJsonObject requestData;
-    requestData["trainId"] = trainData["id"].toInt();
+    requestData["trainId"] = train.trainId;
     requestData["seatType"] = seatType;
     requestData["passengerName"] = m_passengerNameEdit->text();
     requestData["passengerId"] = m_passengerIdEdit->text();
@@ -329,9 +451,19 @@ void MainWindow::bookTicket()
     
     QJsonDocument doc(requestData);
     QNetworkReply *reply = m_networkManager->post(request, doc.toJson());
-    
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    m_timings->track(reply, "预订");
+    
+    connect(reply, &QNetworkReply::finished, this, [this, reply, requestData]() {
+        // 无论成功还是售完，这个区间的缓存余票都已不可信
+        m_searchCache.invalidateBooking(requestData["trainId"].toInt(),
+                                        requestData["date"].toString(),
+                                        requestData["fromStation"].toString(),
+                                        requestData["toStation"].toString());
         onBookingFinished(reply);
+        // 服务器处理了这次预订（成功或售完），只刷新该车次各座位类型的余票
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid()) {
+            refreshAvailability(requestData["trainId"].toInt());
+        }
         reply->deleteLater();
     });
 }
@@ -348,77 +480,69 @@ void MainWindow::queryOrders()
     
     setLoading(true);
     m_statusLabel->setText("正在查询订单...");
-    
-    QString url = QString("%1/orders?passengerName=%2&passengerId=%3")
-                  .arg(API_BASE)
-                  .arg(QUrl::toPercentEncoding(passengerName))
-                  .arg(QUrl::toPercentEncoding(passengerId));
-    
-    QNetworkRequest request{QUrl(url)};
-    QNetworkReply *reply = m_networkManager->get(request);
-    
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onOrderQueryFinished(reply);
-        reply->deleteLater();
-    });
+    m_orderModel->load(passengerName, passengerId);
 }
 
 void MainWindow::queryAllOrders()
 {
     setLoading(true);
     m_statusLabel->setText("正在查询所有订单...");
-    
-    QNetworkRequest request(QUrl(API_BASE + "/orders"));
-    QNetworkReply *reply = m_networkManager->get(request);
-    
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onOrderQueryFinished(reply);
-        reply->deleteLater();
-    });
+    // 只取第一页，其余随滚动加载
+    m_orderModel->load(QString(), QString());
 }
 
 void MainWindow::onTrainSelectionChanged()
 {
-    bool hasSelection = m_trainTable->currentRow() >= 0;
+    bool hasSelection = selectedTrainRow() >= 0;
     m_bookButton->setEnabled(hasSelection);
 }
 
-void MainWindow::onSearchFinished(QNetworkReply *reply)
+int MainWindow::selectedTrainRow() const
+{
+    QModelIndexList rows = m_trainTable->selectionModel()->selectedRows();
+    return rows.isEmpty() ? -1 : rows.first().row();
+}
+
+void MainWindow::onSearchStarted()
+{
+    setLoading(true);
+    m_statusLabel->setText("正在搜索车次...");
+}
+
+void MainWindow::onSearchFinished(QNetworkReply *reply, const SearchQuery &query,
+                                  const SearchResponse &response)
 {
     setLoading(false);
+    m_timings->markParsed(reply);
     
-    if (reply->error() != QNetworkReply::NoError) {
-        m_statusLabel->setText("搜索失败");
-        showMessage(QString("网络错误: %1").arg(reply->errorString()), false);
-        return;
-    }
-    
-    QByteArray responseData = reply->readAll();
-    qDebug() << "API响应数据:" << responseData;
-    
-    QJsonDocument doc = QJsonDocument::fromJson(responseData);
-    QJsonObject response = doc.object();
-    
-    qDebug() << "解析的JSON响应:" << doc.toJson(QJsonDocument::Compact);
-    
-    if (response["success"].toBool()) {
-        QJsonArray trains = response["data"].toArray();
-        qDebug() << "找到车次数量:" << trains.size();
-        m_currentTrains = trains;
-        displayTrains(trains);
+    if (response.success) {
+        m_searchCache.store(query, response);
+        displayTrains(query, response.rows);
+        m_timings->markRendered(reply);
         
-        m_statusLabel->setText(QString("找到 %1 个可预订车次").arg(trains.size()));
-        if (trains.isEmpty()) {
+        m_statusLabel->setText(QString("找到 %1 个可预订车次").arg(response.trainCount));
+        if (!m_searchFromButton) {
+            return; // 修改条件触发的搜索只更新状态栏
+        }
+        if (response.trainCount == 0) {
             showMessage("未找到符合条件的车次，请检查搜索条件", false);
         } else {
-            showMessage(QString("搜索成功，找到 %1 个车次").arg(trains.size()));
+            showMessage(QString("搜索成功，找到 %1 个车次").arg(response.trainCount));
         }
     } else {
         m_statusLabel->setText("搜索失败");
-        showMessage(QString("搜索失败: %1").arg(response["message"].toString()), false);
+        showMessage(QString("搜索失败: %1").arg(response.message), false);
     }
 }
 
+void MainWindow::onSearchFailed(const SearchQuery &query, const QString &message)
+{
+    Q_UNUSED(query);
+    setLoading(false);
+    m_statusLabel->setText("搜索失败");
+    showMessage(QString("网络错误: %1").arg(message), false);
+}
+
 void MainWindow::onBookingFinished(QNetworkReply *reply)
 {
     setLoading(false);
@@ -431,22 +555,21 @@ void MainWindow::onBookingFinished(QNetworkReply *reply)
     
     QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
     QJsonObject response = doc.object();
+    m_timings->markParsed(reply);
     
     if (response["success"].toBool()) {
         QJsonObject bookingData = response["data"].toObject();
         
         // 获取当前选中的车次信息来显示开车时间
         QString departureTimeInfo = "";
-        if (m_selectedTrainRow >= 0 && m_selectedTrainRow < m_currentTrains.size()) {
-            QJsonObject selectedTrain = m_currentTrains[m_selectedTrainRow].toObject();
-            QJsonArray schedule = selectedTrain["schedule"].toArray();
+        if (m_selectedTrainRow >= 0 && m_selectedTrainRow < m_trainModel->rowCount()) {
+            const TrainSeatRow &selectedTrain = m_trainModel->row(m_selectedTrainRow);
             
             // 查找出发站的发车时间
             QString fromStation = bookingData["fromStation"].toString();
-            for (const QJsonValue &stationValue : schedule) {
-                QJsonObject station = stationValue.toObject();
-                if (station["station"].toString() == fromStation) {
-                    QString departureTime = station["departure"].toString();
+            for (const ScheduleStop &stop : selectedTrain.schedule) {
+                if (stop.station == fromStation) {
+                    QString departureTime = stop.departure;
                     if (!departureTime.isEmpty()) {
                         departureTimeInfo = QString("\n开车时间: %1").arg(departureTime);
                     }
@@ -477,192 +600,136 @@ void MainWindow::onBookingFinished(QNetworkReply *reply)
         
         QMessageBox::information(this, "预订成功", successMessage);
         m_statusLabel->setText("预订成功");
-        
-        // 重新搜索以更新余票信息
-        searchTrains();
-        
     } else {
         m_statusLabel->setText("预订失败");
         showMessage(QString("预订失败: %1").arg(response["message"].toString()), false);
     }
 }
 
-void MainWindow::onOrderQueryFinished(QNetworkReply *reply)
+void MainWindow::onOrdersLoaded(int rowCount, bool hasMore)
 {
     setLoading(false);
     
-    if (reply->error() != QNetworkReply::NoError) {
-        m_statusLabel->setText("查询失败");
-        showMessage(QString("网络错误: %1").arg(reply->errorString()), false);
-        return;
-    }
-    
-    QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-    QJsonObject response = doc.object();
-    
-    if (response["success"].toBool()) {
-        QJsonArray orders = response["data"].toArray();
-        displayOrders(orders);
-        
-        m_statusLabel->setText(QString("查询到 %1 个订单").arg(orders.size()));
-        if (orders.isEmpty()) {
-            showMessage("未找到相关订单", false);
-        } else {
-            showMessage(QString("查询成功，找到 %1 个订单").arg(orders.size()));
-        }
+    if (rowCount == 0) {
+        m_statusLabel->setText("查询到 0 个订单");
+        showMessage("未找到相关订单", false);
+    } else if (hasMore) {
+        // 总数未知，滚动到底部时继续加载
+        m_statusLabel->setText(QString("已加载 %1 个订单，滚动查看更多").arg(rowCount));
     } else {
-        m_statusLabel->setText("查询失败");
-        showMessage(QString("查询失败: %1").arg(response["message"].toString()), false);
+        m_statusLabel->setText(QString("查询到 %1 个订单").arg(rowCount));
+        showMessage(QString("查询成功，找到 %1 个订单").arg(rowCount));
     }
 }
 
-void MainWindow::displayTrains(const QJsonArray &trains)
+void MainWindow::onOrdersLoadFailed(const QString &message)
 {
-    m_trainTable->setRowCount(0);
+    setLoading(false);
+    m_statusLabel->setText("查询失败");
+    showMessage(QString("查询失败: %1").arg(message), false);
+}
+
+void MainWindow::displayTrains(const SearchQuery &query, const QVector<TrainSeatRow> &rows)
+{
+    m_displayedQuery = query;
+    // 整体替换模型数据，列宽在 setupTrainListSection 中固定，不再按内容重新测量
+    m_trainModel->setRows(rows);
+    
+    // 行高只取决于站数，不做文字排版
+    QHeaderView *header = m_trainTable->verticalHeader();
+    QFontMetrics fontMetrics = m_trainTable->fontMetrics();
+    for (int i = 0; i < rows.size(); ++i) {
+        int stopCount = int(rows[i].schedule.size());
+        header->resizeSection(i, m_trainDelegate->rowHeight(stopCount, fontMetrics));
+    }
     
-    for (int i = 0; i < trains.size(); ++i) {
-        QJsonObject train = trains[i].toObject();
-        QJsonArray seatTypes = train["seatTypes"].toArray();
-        
-        for (int j = 0; j < seatTypes.size(); ++j) {
-            QJsonObject seatType = seatTypes[j].toObject();
-            
-            int row = m_trainTable->rowCount();
-            m_trainTable->insertRow(row);
-            
-            m_trainTable->setItem(row, 0, new QTableWidgetItem(train["name"].toString()));
-            m_trainTable->setItem(row, 1, new QTableWidgetItem(train["from"].toString()));
-            m_trainTable->setItem(row, 2, new QTableWidgetItem(train["to"].toString()));
-            m_trainTable->setItem(row, 3, new QTableWidgetItem(train["date"].toString()));
-            m_trainTable->setItem(row, 4, new QTableWidgetItem(seatType["type"].toString()));
-            // 安全地获取价格，处理字符串和数字两种情况
-            double price = 0.0;
-            QJsonValue priceValue = seatType["price"];
-            if (priceValue.isString()) {
-                price = priceValue.toString().toDouble();
-            } else if (priceValue.isDouble()) {
-                price = priceValue.toDouble();
-            }
-            
-            m_trainTable->setItem(row, 5, new QTableWidgetItem(QString("¥%1").arg(price, 0, 'f', 2)));
-            m_trainTable->setItem(row, 6, new QTableWidgetItem(QString::number(seatType["availableSeats"].toInt())));
-            m_trainTable->setItem(row, 7, new QTableWidgetItem(QString::number(seatType["totalSeats"].toInt())));
-            
-            // 显示时刻表信息
-            QString scheduleInfo = "";
-            QJsonArray schedule = train["schedule"].toArray();
-            if (schedule.size() > 0) {
-                QStringList scheduleItems;
-                for (int k = 0; k < schedule.size(); ++k) {
-                    QJsonObject station = schedule[k].toObject();
-                    QString stationName = station["station"].toString();
-                    QString arrival = station["arrival"].toString();
-                    QString departure = station["departure"].toString();
-                    
-                    if (k == 0) {
-                        // 起始站，只显示发车时间
-                        scheduleItems << QString("%1 %2").arg(stationName).arg(departure);
-                    } else if (k == schedule.size() - 1) {
-                        // 终点站，只显示到达时间
-                        scheduleItems << QString("%1 %2").arg(stationName).arg(arrival);
-                    } else {
-                        // 中间站，显示到达/发车时间
-                        scheduleItems << QString("%1 %2/%3").arg(stationName).arg(arrival).arg(departure);
-                    }
-                }
-                scheduleInfo = scheduleItems.join("\n");
-            }
-            
-            QTableWidgetItem *scheduleItem = new QTableWidgetItem(scheduleInfo);
-            scheduleItem->setToolTip(scheduleInfo); // 设置工具提示以显示完整信息
-            scheduleItem->setTextAlignment(Qt::AlignTop | Qt::AlignLeft); // 顶部左对齐
-            m_trainTable->setItem(row, 8, scheduleItem);
-            
-            // 调试输出
-            qDebug() << "显示车次:" << train["name"].toString() 
-                     << "座位类型:" << seatType["type"].toString()
-                     << "价格:" << price
-                     << "余票:" << seatType["availableSeats"].toInt();
-            
-            // 如果没有余票，将整行设置为灰色
-            if (seatType["availableSeats"].toInt() == 0) {
-                for (int col = 0; col < m_trainTable->columnCount(); ++col) {
-                    m_trainTable->item(row, col)->setBackground(QColor(220, 220, 220));
-                    m_trainTable->item(row, col)->setForeground(QColor(128, 128, 128));
-                }
-            }
+    // 订阅当前显示车次的余票变化，替换之前的订阅
+    QSet<int> scheduleIds;
+    for (const TrainSeatRow &row : rows) {
+        scheduleIds.insert(row.scheduleId);
+    }
+    m_availabilityStream->subscribe(scheduleIds, query.fromStation, query.toStation);
+    
+    // 当前日期已显示，再在后台准备前后几天
+    m_prefetcher->prefetchAround(query, m_travelDateEdit->minimumDate(),
+                                 m_travelDateEdit->maximumDate());
+}
+
+void MainWindow::refreshAvailability(int trainId)
+{
+    QJsonArray items;
+    for (int i = 0; i < m_trainModel->rowCount(); ++i) {
+        const TrainSeatRow &row = m_trainModel->row(i);
+        if (row.trainId != trainId) {
+            continue;
         }
+        QJsonObject item;
+        item["scheduleId"] = row.scheduleId;
+        item["seatType"] = row.seatType;
+        item["fromStation"] = m_displayedQuery.fromStation;
+        item["toStation"] = m_displayedQuery.toStation;
+        items.append(item);
+    }
+    if (items.isEmpty()) {
+        return;
     }
     
-    // 调整列宽和行高
-    m_trainTable->resizeColumnsToContents();
-    m_trainTable->resizeRowsToContents(); // 自动调整行高以适应内容
+    m_statusLabel->setText("正在刷新余票...");
+    
+    QJsonObject requestData;
+    requestData["items"] = items;
+    
+    QNetworkRequest request(QUrl(API_BASE + "/availability"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    
+    QNetworkReply *reply = m_networkManager->post(request, QJsonDocument(requestData).toJson());
+    m_timings->track(reply, "刷新余票");
+    
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onAvailabilityFinished(reply);
+        reply->deleteLater();
+    });
 }
 
-void MainWindow::displayOrders(const QJsonArray &orders)
+void MainWindow::onAvailabilityFinished(QNetworkReply *reply)
 {
-    m_orderTable->setRowCount(orders.size());
+    // 刷新失败不打扰用户，下次搜索会拿到最新余票
+    if (reply->error() != QNetworkReply::NoError) {
+        m_statusLabel->setText("余票刷新失败");
+        return;
+    }
     
-    for (int i = 0; i < orders.size(); ++i) {
-        QJsonObject order = orders[i].toObject();
-        
-        QString seatInfo = QString("%1车厢 %2号")
-                          .arg(order["carriageNumber"].toString())
-                          .arg(order["seatNumber"].toString());
-        if (order["carriageNumber"].toString().isEmpty()) {
-            seatInfo = "未分配";
-        }
-        seatInfo += QString(" (%1)").arg(order["seatType"].toString());
-        
-        QString passengerInfo = QString("%1\n%2")
-                               .arg(order["passengerName"].toString())
-                               .arg(order["passengerId"].toString());
-        
-        QString routeInfo = QString("%1 → %2")
-                           .arg(order["fromStation"].toString())
-                           .arg(order["toStation"].toString());
-        
-        // 格式化日期和时间信息
-        QString dateTimeInfo = order["date"].toString();
-        if (!order["departureTime"].toString().isEmpty()) {
-            dateTimeInfo += QString("\n开车时间: %1").arg(order["departureTime"].toString());
-        }
-        
-        m_orderTable->setItem(i, 0, new QTableWidgetItem(QString::number(order["id"].toInt())));
-        m_orderTable->setItem(i, 1, new QTableWidgetItem(order["trainName"].toString()));
-        m_orderTable->setItem(i, 2, new QTableWidgetItem(dateTimeInfo));
-        m_orderTable->setItem(i, 3, new QTableWidgetItem(routeInfo));
-        m_orderTable->setItem(i, 4, new QTableWidgetItem(seatInfo));
-        m_orderTable->setItem(i, 5, new QTableWidgetItem(passengerInfo));
-        // 安全地获取价格，处理字符串和数字两种情况
-        double price = 0.0;
-        QJsonValue priceValue = order["price"];
-        if (priceValue.isString()) {
-            price = priceValue.toString().toDouble();
-            qDebug() << "订单价格(字符串):" << priceValue.toString() << "解析为:" << price;
-        } else if (priceValue.isDouble()) {
-            price = priceValue.toDouble();
-            qDebug() << "订单价格(数字):" << price;
-        } else {
-            qDebug() << "订单价格类型未知:" << priceValue.type();
+    AvailabilityResponse response = ResponseParser::parseAvailability(reply->readAll());
+    m_timings->markParsed(reply);
+    if (!response.success) {
+        m_statusLabel->setText("余票刷新失败");
+        return;
+    }
+    
+    int changed = 0;
+    for (const AvailabilityUpdate &update : response.updates) {
+        // 期间换了搜索条件，同一时刻表的其他区间不能套用
+        if (update.fromStation != m_displayedQuery.fromStation
+            || update.toStation != m_displayedQuery.toStation) {
+            continue;
         }
-        
-        m_orderTable->setItem(i, 6, new QTableWidgetItem(QString("¥%1").arg(price, 0, 'f', 2)));
-        
-        QTableWidgetItem *statusItem = new QTableWidgetItem(order["status"].toString());
-        if (order["status"].toString() == "confirmed") {
-            statusItem->setForeground(QColor(40, 167, 69)); // 绿色
-        } else {
-            statusItem->setForeground(QColor(220, 53, 69)); // 红色
+        if (m_trainModel->updateAvailability(update.scheduleId, update.seatType,
+                                             update.availableSeats)) {
+            ++changed;
         }
-        m_orderTable->setItem(i, 7, statusItem);
-        
-        m_orderTable->setItem(i, 8, new QTableWidgetItem(formatDateTime(order["createdAt"].toString())));
     }
+    m_timings->markRendered(reply);
     
-    // 调整列宽和行高
-    m_orderTable->resizeColumnsToContents();
-    m_orderTable->resizeRowsToContents(); // 自动调整行高以适应内容
+    m_statusLabel->setText(QString("余票已更新（%1 项变化）").arg(changed));
+}
+
+void MainWindow::onAvailabilityPushed(const AvailabilityUpdate &update)
+{
+    if (update.fromStation != m_displayedQuery.fromStation
+        || update.toStation != m_displayedQuery.toStation) {
+        return;
+    }
+    m_trainModel->updateAvailability(update.scheduleId, update.seatType, update.availableSeats);
 }
 
 void MainWindow::showMessage(const QString &message, bool isSuccess)
@@ -681,18 +748,12 @@ void MainWindow::showMessage(const QString &message, bool isSuccess)
 void MainWindow::setLoading(bool loading)
 {
     m_progressBar->setVisible(loading);
-    m_searchButton->setEnabled(!loading);
-    m_bookButton->setEnabled(!loading && m_trainTable->currentRow() >= 0);
+    // 搜索按钮保持可用：新的搜索会取代进行中的搜索
+    m_bookButton->setEnabled(!loading && selectedTrainRow() >= 0);
     m_queryOrdersButton->setEnabled(!loading);
     m_queryAllOrdersButton->setEnabled(!loading);
 }
 
-QString MainWindow::formatDateTime(const QString &dateTimeStr)
-{
-    QDateTime dateTime = QDateTime::fromString(dateTimeStr, Qt::ISODate);
-    return dateTime.toString("yyyy-MM-dd hh:mm:ss");
-}
-
 bool MainWindow::validateSearchInput()
 {
     if (m_passengerNameEdit->text().trimmed().isEmpty()) {
@@ -11,8 +11,7 @@
 #include <QComboBox>
 #include <QDateEdit>
 #include <QPushButton>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QProgressBar>
 #include <QStatusBar>
 #include <QMessageBox>
@@ -27,6 +26,17 @@
 #include <QJsonArray>
 #include <QTimer>
 #include <QDate>
+#include "NetworkTimings.h"
+#include "TrainTableModel.h"
+#include "ResponseParser.h"
+#include "SearchCache.h"
+#include "AvailabilityStream.h"
+#include "SearchPrefetcher.h"
+#include "OrderTableModel.h"
+#include "SearchRequestManager.h"
+
+class DiagnosticsDialog;
+class TrainTableDelegate;
 
 class MainWindow : public QMainWindow
 {
@@ -38,13 +48,17 @@ public:
 
 private slots:
     void searchTrains();
+    void onSearchInputChanged();
     void bookTicket();
     void queryOrders();
     void queryAllOrders();
     void onTrainSelectionChanged();
-    void onSearchFinished(QNetworkReply *reply);
     void onBookingFinished(QNetworkReply *reply);
-    void onOrderQueryFinished(QNetworkReply *reply);
+    void onOrdersLoaded(int rowCount, bool hasMore);
+    void onOrdersLoadFailed(const QString &message);
+    void showDiagnostics();
+    void onTimingRecorded(const RequestTiming &timing);
+    void onAvailabilityPushed(const AvailabilityUpdate &update);
 
 private:
     void setupUI();
@@ -52,14 +66,22 @@ private:
     void setupTrainListSection();
     void setupOrderSection();
     void setupStatusBar();
+    void setupMenuBar();
     
     void populateStationComboBoxes();
-    void displayTrains(const QJsonArray &trains);
-    void displayOrders(const QJsonArray &orders);
+    SearchQuery currentSearchQuery() const;
+    void startSearch(const SearchQuery &query, bool debounced);
+    void onSearchStarted();
+    void onSearchFinished(QNetworkReply *reply, const SearchQuery &query,
+                          const SearchResponse &response);
+    void onSearchFailed(const SearchQuery &query, const QString &message);
+    void displayTrains(const SearchQuery &query, const QVector<TrainSeatRow> &rows);
+    void refreshAvailability(int trainId);
+    void onAvailabilityFinished(QNetworkReply *reply);
+    int selectedTrainRow() const;
     void showMessage(const QString &message, bool isSuccess = true);
     void setLoading(bool loading);
     
-    QString formatDateTime(const QString &dateTimeStr);
     bool validateSearchInput();
     bool validateBookingInput();
 
@@ -79,7 +101,9 @@ private:
     
     // 车次列表区域
     QGroupBox *m_trainListGroup;
-    QTableWidget *m_trainTable;
+    QTableView *m_trainTable;
+    TrainTableModel *m_trainModel;
+    TrainTableDelegate *m_trainDelegate;
     QPushButton *m_bookButton;
     
     // 订单查询区域
@@ -88,22 +112,35 @@ private:
     QLineEdit *m_queryPassengerIdEdit;
     QPushButton *m_queryOrdersButton;
     QPushButton *m_queryAllOrdersButton;
-    QTableWidget *m_orderTable;
+    QTableView *m_orderTable;
+    OrderTableModel *m_orderModel;
     
     // 状态栏
     QProgressBar *m_progressBar;
     QLabel *m_statusLabel;
+    QLabel *m_timingLabel;
     
     // 网络管理
     QNetworkAccessManager *m_networkManager;
+    NetworkTimings *m_timings;
+    DiagnosticsDialog *m_diagnosticsDialog;
+    AvailabilityStream *m_availabilityStream;
     
     // 数据
-    QJsonArray m_currentTrains;
     int m_selectedTrainRow;
+    SearchCache m_searchCache;
+    SearchPrefetcher *m_prefetcher;
+    SearchRequestManager *m_searchRequests;
+    bool m_searchFromButton;        // 当前搜索由按钮发起，完成后弹出提示
+    SearchQuery m_displayedQuery;   // 车次表当前显示的搜索条件
     
     // 常量
     static const QString API_BASE;
     static const QStringList STATION_LIST;
+    static const int PREFETCH_DAYS = 2;
+    static const int PREFETCH_CONCURRENCY = 2;
+    static const int ORDER_PAGE_SIZE = 100;
+    static const int ORDER_MAX_PAGES = 5;     // 订单表最多保留 500 行
 };
 
 #endif // MAINWINDOW_H 
\ No newline at end of file
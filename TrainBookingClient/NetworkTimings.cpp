@@ -0,0 +1,200 @@
+#include "NetworkTimings.h"
+#include <QNetworkReply>
+#include <QFile>
+#include <QTextStream>
+#include <QtGlobal>
+
+namespace {
+
+QString csvField(const QString &value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n')) {
+        return value;
+    }
+    QString escaped = value;
+    escaped.replace("\"", "\"\"");
+    return QString("\"%1\"").arg(escaped);
+}
+
+QString csvMs(double ms)
+{
+    return ms < 0 ? QString() : QString::number(ms, 'f', 1);
+}
+
+} // namespace
+
+NetworkTimings::NetworkTimings(int capacity, QObject *parent)
+    : QObject(parent)
+    , m_capacity(qMax(1, capacity))
+{
+}
+
+double NetworkTimings::elapsedMs(const Pending &pending)
+{
+    return pending.clock.nsecsElapsed() / 1e6;
+}
+
+void NetworkTimings::track(QNetworkReply *reply, const QString &name)
+{
+    Pending &pending = m_pending[reply];
+    pending.timing.startedAt = QDateTime::currentDateTime();
+    pending.timing.name = name;
+    pending.timing.url = reply->url().toString();
+    pending.clock.start();
+
+    // socketStartedConnecting 只在新建连接时发出，没收到说明复用了已有连接
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    connect(reply, &QNetworkReply::socketStartedConnecting, this, [this, reply]() {
+        auto it = m_pending.find(reply);
+        if (it != m_pending.end() && it->connectingAt < 0) {
+            it->connectingAt = elapsedMs(*it);
+        }
+    });
+    connect(reply, &QNetworkReply::requestSent, this, [this, reply]() {
+        auto it = m_pending.find(reply);
+        if (it != m_pending.end() && it->sentAt < 0) {
+            it->sentAt = elapsedMs(*it);
+        }
+    });
+#endif
+    // 重定向时会多次发出，只记第一次
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, reply]() {
+        auto it = m_pending.find(reply);
+        if (it != m_pending.end() && it->headersAt < 0) {
+            it->headersAt = elapsedMs(*it);
+        }
+    });
+    // 先于调用方的 finished 处理函数连接，保证下载结束时间不含解析
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onFinished(reply);
+    });
+    connect(reply, &QObject::destroyed, this, &NetworkTimings::commit);
+}
+
+void NetworkTimings::onFinished(QNetworkReply *reply)
+{
+    auto it = m_pending.find(reply);
+    if (it == m_pending.end()) {
+        return;
+    }
+
+    Pending &pending = *it;
+    RequestTiming &timing = pending.timing;
+    double finishedAt = elapsedMs(pending);
+
+    timing.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    timing.bytes = reply->bytesAvailable();
+    if (reply->error() != QNetworkReply::NoError) {
+        timing.error = reply->errorString();
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    timing.connectionReused = pending.connectingAt < 0 && pending.sentAt >= 0;
+    if (pending.connectingAt >= 0) {
+        timing.dnsMs = pending.connectingAt;
+        if (pending.sentAt >= 0) {
+            timing.connectMs = pending.sentAt - pending.connectingAt;
+        }
+    }
+#endif
+    if (pending.headersAt >= 0) {
+        timing.ttfbMs = pending.headersAt - qMax(0.0, pending.sentAt);
+        timing.downloadMs = finishedAt - pending.headersAt;
+    }
+
+    pending.lastMarkAt = finishedAt;
+    timing.totalMs = finishedAt;
+}
+
+void NetworkTimings::markParsed(QNetworkReply *reply)
+{
+    auto it = m_pending.find(reply);
+    if (it == m_pending.end() || it->lastMarkAt < 0) {
+        return;
+    }
+    double now = elapsedMs(*it);
+    it->timing.parseMs = now - it->lastMarkAt;
+    it->timing.totalMs = now;
+    it->lastMarkAt = now;
+}
+
+void NetworkTimings::markRendered(QNetworkReply *reply)
+{
+    auto it = m_pending.find(reply);
+    if (it == m_pending.end() || it->lastMarkAt < 0) {
+        return;
+    }
+    double now = elapsedMs(*it);
+    it->timing.renderMs = now - it->lastMarkAt;
+    it->timing.totalMs = now;
+    it->lastMarkAt = now;
+}
+
+void NetworkTimings::commit(QObject *reply)
+{
+    // 回复在 deleteLater 后销毁，此时调用方的处理函数已执行完毕
+    auto it = m_pending.find(reply);
+    if (it == m_pending.end()) {
+        return;
+    }
+    RequestTiming timing = it->timing;
+    bool finished = it->lastMarkAt >= 0;
+    m_pending.erase(it);
+
+    if (!finished) {
+        return; // 未完成就被销毁（如程序退出），没有可用数据
+    }
+
+    m_timings.append(timing);
+    while (m_timings.size() > m_capacity) {
+        m_timings.removeFirst();
+    }
+    emit timingRecorded(timing);
+}
+
+void NetworkTimings::clear()
+{
+    m_timings.clear();
+    emit cleared();
+}
+
+bool NetworkTimings::exportCsv(const QString &filePath, QString *errorMessage) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    out.setGenerateByteOrderMark(true); // 让Excel按UTF-8打开中文
+    out << "started_at,request,url,http_status,bytes,connection_reused,"
+           "dns_ms,connect_ms,ttfb_ms,download_ms,parse_ms,render_ms,total_ms,error\n";
+    for (const RequestTiming &timing : m_timings) {
+        out << timing.startedAt.toString(Qt::ISODateWithMs) << ','
+            << csvField(timing.name) << ','
+            << csvField(timing.url) << ','
+            << timing.httpStatus << ','
+            << timing.bytes << ','
+            << (timing.connectionReused ? 1 : 0) << ','
+            << csvMs(timing.dnsMs) << ','
+            << csvMs(timing.connectMs) << ','
+            << csvMs(timing.ttfbMs) << ','
+            << csvMs(timing.downloadMs) << ','
+            << csvMs(timing.parseMs) << ','
+            << csvMs(timing.renderMs) << ','
+            << csvMs(timing.totalMs) << ','
+            << csvField(timing.error) << '\n';
+    }
+
+    out.flush();
+    if (out.status() != QTextStream::Ok) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef NETWORKTIMINGS_H
+#define NETWORKTIMINGS_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QString>
+
+class QNetworkReply;
+
+// 一次请求各阶段耗时（毫秒），-1 表示该阶段未发生或无法测得
+struct RequestTiming
+{
+    QDateTime startedAt;
+    QString name;           // 搜索、预订、查询订单……
+    QString url;
+    int httpStatus = 0;
+    QString error;          // 网络错误描述，成功时为空
+    qint64 bytes = 0;
+    bool connectionReused = false;
+
+    double dnsMs = -1;      // 发起到开始建立连接（含排队和DNS解析）
+    double connectMs = -1;  // 建立连接到请求发出（含TLS握手）
+    double ttfbMs = -1;     // 请求发出到收到响应头
+    double downloadMs = -1; // 响应头到响应体接收完毕
+    double parseMs = -1;    // JSON解析
+    double renderMs = -1;   // 表格渲染
+    double totalMs = 0;     // 发起到最后一个阶段结束
+};
+
+// 记录每个QNetworkReply的分阶段耗时，保留最近 capacity 条
+class NetworkTimings : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetworkTimings(int capacity = 200, QObject *parent = nullptr);
+
+    // 在 get()/post() 返回后立即调用，之后由回复的信号驱动计时
+    void track(QNetworkReply *reply, const QString &name);
+
+    // 在 finished 处理函数中依次调用，耗时从上一个阶段结束算起
+    void markParsed(QNetworkReply *reply);
+    void markRendered(QNetworkReply *reply);
+
+    const QList<RequestTiming> &timings() const { return m_timings; }
+    int capacity() const { return m_capacity; }
+    void clear();
+
+    bool exportCsv(const QString &filePath, QString *errorMessage = nullptr) const;
+
+signals:
+    void timingRecorded(const RequestTiming &timing);
+    void cleared();
+
+private:
+    struct Pending
+    {
+        RequestTiming timing;
+        QElapsedTimer clock;
+        double connectingAt = -1;
+        double sentAt = -1;
+        double headersAt = -1;
+        double lastMarkAt = -1;
+    };
+
+    static double elapsedMs(const Pending &pending);
+    void onFinished(QNetworkReply *reply);
+    void commit(QObject *reply);
+
+    int m_capacity;
+    QList<RequestTiming> m_timings;
+    QHash<QObject *, Pending> m_pending;
+};
+
+#endif // NETWORKTIMINGS_H
@@ -0,0 +1,255 @@
+#include "OrderTableModel.h"
+#include "NetworkTimings.h"
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QColor>
+#include <QStringList>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+OrderTableModel::OrderTableModel(QNetworkAccessManager *manager, const QString &apiBase,
+                                 NetworkTimings *timings, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_manager(manager)
+    , m_apiBase(apiBase)
+    , m_timings(timings)
+    , m_pageSize(100)
+    , m_maxPages(5)
+    , m_initialPage(false)
+    , m_generation(0)
+    , m_hasOlder(false)
+    , m_hasNewer(false)
+{
+}
+
+void OrderTableModel::load(const QString &passengerName, const QString &passengerId)
+{
+    ++m_generation;
+    if (m_reply) {
+        m_reply->abort();
+    }
+
+    beginResetModel();
+    m_rows.clear();
+    m_pages.clear();
+    m_hasOlder = false;
+    m_hasNewer = false;
+    endResetModel();
+
+    m_passengerName = passengerName;
+    m_passengerId = passengerId;
+    m_initialPage = true;
+    request(Older, QString());
+}
+
+void OrderTableModel::fetchNewer()
+{
+    if (!canFetchNewer() || m_pages.isEmpty()) {
+        return;
+    }
+    request(Newer, m_pages.first().firstCursor);
+}
+
+bool OrderTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_hasOlder && !isLoading();
+}
+
+void OrderTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent) || m_pages.isEmpty()) {
+        return;
+    }
+    request(Older, m_pages.last().lastCursor);
+}
+
+void OrderTableModel::request(Direction direction, const QString &cursor)
+{
+    QUrlQuery query;
+    if (!m_passengerName.isEmpty()) {
+        query.addQueryItem("passengerName", m_passengerName);
+    }
+    if (!m_passengerId.isEmpty()) {
+        query.addQueryItem("passengerId", m_passengerId);
+    }
+    query.addQueryItem("limit", QString::number(m_pageSize));
+    if (!cursor.isEmpty()) {
+        query.addQueryItem("cursor", cursor);
+        query.addQueryItem("direction", direction == Newer ? "before" : "after");
+    }
+
+    QUrl url(m_apiBase + "/orders");
+    url.setQuery(query);
+
+    QNetworkReply *reply = m_manager->get(QNetworkRequest(url));
+    m_timings->track(reply, m_initialPage ? "查询订单" : "加载订单页");
+    m_reply = reply;
+
+    quint64 generation = m_generation;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, direction, generation]() {
+        if (generation != m_generation || reply->error() != QNetworkReply::NoError) {
+            if (generation == m_generation) {
+                m_reply = nullptr;
+                emit loadFailed(reply->errorString());
+            }
+            reply->deleteLater();
+            return;
+        }
+
+        // 在线程池中解码，m_reply 保持到页面合并完成，期间不会重复请求
+        auto *watcher = new QFutureWatcher<OrderPageResponse>(this);
+        connect(watcher, &QFutureWatcher<OrderPageResponse>::finished, this,
+                [this, watcher, reply, direction, generation]() {
+            if (generation == m_generation) {
+                onPageDecoded(reply, direction, watcher->result());
+            }
+            watcher->deleteLater();
+            reply->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(ResponseParser::parseOrderPage, reply->readAll()));
+    });
+}
+
+void OrderTableModel::onPageDecoded(QNetworkReply *reply, Direction direction,
+                                    const OrderPageResponse &response)
+{
+    m_reply = nullptr;
+    m_timings->markParsed(reply);
+
+    if (!response.success) {
+        emit loadFailed(response.message);
+        return;
+    }
+
+    if (direction == Older) {
+        appendPage(response);
+    } else {
+        prependPage(response);
+    }
+    m_timings->markRendered(reply);
+
+    if (m_initialPage) {
+        m_initialPage = false;
+        emit loaded(int(m_rows.size()), m_hasOlder);
+    }
+}
+
+void OrderTableModel::appendPage(const OrderPageResponse &response)
+{
+    m_hasOlder = response.hasMore;
+    if (response.orders.isEmpty()) {
+        return;
+    }
+
+    int first = int(m_rows.size());
+    beginInsertRows(QModelIndex(), first, first + int(response.orders.size()) - 1);
+    m_rows += response.orders;
+    m_pages.append({int(response.orders.size()), response.firstCursor, response.lastCursor});
+    endInsertRows();
+
+    // 超出窗口时丢弃最新的一页
+    if (m_pages.size() > m_maxPages) {
+        int dropped = m_pages.first().size;
+        beginRemoveRows(QModelIndex(), 0, dropped - 1);
+        m_rows.remove(0, dropped);
+        m_pages.removeFirst();
+        m_hasNewer = true;
+        endRemoveRows();
+        emit windowShifted(-dropped);
+    }
+}
+
+void OrderTableModel::prependPage(const OrderPageResponse &response)
+{
+    m_hasNewer = response.hasMore;
+    if (response.orders.isEmpty()) {
+        return;
+    }
+
+    int count = int(response.orders.size());
+    beginInsertRows(QModelIndex(), 0, count - 1);
+    m_rows = response.orders + m_rows;
+    m_pages.prepend({count, response.firstCursor, response.lastCursor});
+    endInsertRows();
+    emit windowShifted(count);
+
+    // 超出窗口时丢弃最早的一页，滚到底部时再经 fetchMore 取回
+    if (m_pages.size() > m_maxPages) {
+        int dropped = m_pages.last().size;
+        int first = int(m_rows.size()) - dropped;
+        beginRemoveRows(QModelIndex(), first, first + dropped - 1);
+        m_rows.remove(first, dropped);
+        m_pages.removeLast();
+        m_hasOlder = true;
+        endRemoveRows();
+    }
+}
+
+int OrderTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_rows.size());
+}
+
+int OrderTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant OrderTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+
+    const OrderRow &order = m_rows[index.row()];
+
+    if (role == Qt::ForegroundRole && index.column() == StatusColumn) {
+        return order.status == "confirmed" ? QColor(40, 167, 69)    // 绿色
+                                           : QColor(220, 53, 69);   // 红色
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case IdColumn:
+        return order.id;
+    case TrainColumn:
+        return order.trainName;
+    case DateColumn:
+        if (order.departureTime.isEmpty()) {
+            return order.date;
+        }
+        return QString("%1\n开车时间: %2").arg(order.date, order.departureTime);
+    case RouteColumn:
+        return QString("%1 → %2").arg(order.fromStation, order.toStation);
+    case SeatColumn:
+        if (order.carriageNumber.isEmpty()) {
+            return QString("未分配 (%1)").arg(order.seatType);
+        }
+        return QString("%1车厢 %2号 (%3)")
+               .arg(order.carriageNumber, order.seatNumber, order.seatType);
+    case PassengerColumn:
+        return QString("%1\n%2").arg(order.passengerName, order.passengerId);
+    case PriceColumn:
+        return QString("¥%1").arg(order.price, 0, 'f', 2);
+    case StatusColumn:
+        return order.status;
+    case CreatedAtColumn:
+        return order.createdAt.toString("yyyy-MM-dd hh:mm:ss");
+    }
+    return QVariant();
+}
+
+QVariant OrderTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    static const QStringList headers = {"订单号", "车次", "日期", "行程", "座位",
+                                        "乘客", "价格", "状态", "创建时间"};
+    return headers.value(section);
+}
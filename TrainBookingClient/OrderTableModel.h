@@ -0,0 +1,100 @@
+#ifndef ORDERTABLEMODEL_H
+#define ORDERTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QList>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+#include <QNetworkReply>
+#include "ResponseParser.h"
+
+class QNetworkAccessManager;
+class NetworkTimings;
+
+// 订单表模型，按需从分页 /orders 接口加载。
+// 视图滚到底部时经 canFetchMore/fetchMore 取下一页；内存中最多保留 maxPages 页，
+// 超出时丢弃另一端的页，滚回去时再用游标重新加载
+class OrderTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        IdColumn,
+        TrainColumn,
+        DateColumn,
+        RouteColumn,
+        SeatColumn,
+        PassengerColumn,
+        PriceColumn,
+        StatusColumn,
+        CreatedAtColumn,
+        ColumnCount
+    };
+
+    OrderTableModel(QNetworkAccessManager *manager, const QString &apiBase,
+                    NetworkTimings *timings, QObject *parent = nullptr);
+
+    void setPageSize(int pageSize) { m_pageSize = pageSize; }
+    void setMaxPages(int maxPages) { m_maxPages = maxPages; }
+
+    // 清空并按条件加载第一页，条件为空时查询所有订单
+    void load(const QString &passengerName, const QString &passengerId);
+    bool isLoading() const { return !m_reply.isNull(); }
+
+    // 窗口前端的页被丢弃过，可以向前加载
+    bool canFetchNewer() const { return m_hasNewer && !isLoading(); }
+    void fetchNewer();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+signals:
+    // load() 的第一页已到达
+    void loaded(int rowCount, bool hasMore);
+    void loadFailed(const QString &message);
+    // 窗口前端插入（正数）或丢弃（负数）了若干行，视图据此保持滚动位置
+    void windowShifted(int rows);
+
+private:
+    enum Direction { Older, Newer };
+
+    struct Page
+    {
+        int size;
+        QString firstCursor;
+        QString lastCursor;
+    };
+
+    void request(Direction direction, const QString &cursor);
+    void onPageDecoded(QNetworkReply *reply, Direction direction,
+                       const OrderPageResponse &response);
+    void appendPage(const OrderPageResponse &response);
+    void prependPage(const OrderPageResponse &response);
+
+    QNetworkAccessManager *m_manager;
+    QString m_apiBase;
+    NetworkTimings *m_timings;
+    int m_pageSize;
+    int m_maxPages;
+
+    QString m_passengerName;
+    QString m_passengerId;
+    bool m_initialPage;             // 正在加载的是 load() 的第一页
+    quint64 m_generation;           // load() 时递增，丢弃上一次查询迟到的页
+    QPointer<QNetworkReply> m_reply;
+
+    QVector<OrderRow> m_rows;       // 当前窗口内的订单，按创建时间倒序
+    QList<Page> m_pages;            // 窗口内各页的大小和边界游标
+    bool m_hasOlder;
+    bool m_hasNewer;
+};
+
+#endif // ORDERTABLEMODEL_H
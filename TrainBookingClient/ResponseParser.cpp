@@ -0,0 +1,122 @@
+#include "ResponseParser.h"
+#include "JsonValues.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonParseError>
+#include <QDebug>
+
+namespace {
+
+// 解析失败时给出可读的错误，而不是空的 message
+bool parseObject(const QByteArray &data, QJsonObject *object, QString *message)
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        *message = QString("响应格式错误: %1").arg(error.errorString());
+        return false;
+    }
+    *object = doc.object();
+    return true;
+}
+
+} // namespace
+
+SearchResponse ResponseParser::parseSearch(const QByteArray &data)
+{
+    qDebug() << "API响应数据:" << data;
+
+    SearchResponse result;
+    QJsonObject response;
+    if (!parseObject(data, &response, &result.message)) {
+        return result;
+    }
+
+    result.success = response["success"].toBool();
+    if (!result.success) {
+        result.message = response["message"].toString();
+        return result;
+    }
+
+    QJsonArray trains = response["data"].toArray();
+    result.trainCount = trains.size();
+    result.rows = TrainTableModel::parseTrains(trains);
+
+    qDebug() << "找到车次数量:" << result.trainCount << "座位类型行数:" << result.rows.size();
+    return result;
+}
+
+OrderPageResponse ResponseParser::parseOrderPage(const QByteArray &data)
+{
+    OrderPageResponse result;
+    QJsonObject response;
+    if (!parseObject(data, &response, &result.message)) {
+        return result;
+    }
+
+    result.success = response["success"].toBool();
+    if (!result.success) {
+        result.message = response["message"].toString();
+        return result;
+    }
+
+    QJsonObject page = response["data"].toObject();
+    result.firstCursor = page["firstCursor"].toString();
+    result.lastCursor = page["lastCursor"].toString();
+    result.hasMore = page["hasMore"].toBool();
+
+    QJsonArray orders = page["orders"].toArray();
+    result.orders.reserve(orders.size());
+    for (const QJsonValue &orderValue : orders) {
+        QJsonObject order = orderValue.toObject();
+
+        OrderRow row;
+        row.id = order["id"].toInt();
+        row.trainName = order["trainName"].toString();
+        row.date = order["date"].toString();
+        row.departureTime = order["departureTime"].toString();
+        row.fromStation = order["fromStation"].toString();
+        row.toStation = order["toStation"].toString();
+        row.carriageNumber = order["carriageNumber"].toString();
+        row.seatNumber = order["seatNumber"].toString();
+        row.seatType = order["seatType"].toString();
+        row.passengerName = order["passengerName"].toString();
+        row.passengerId = order["passengerId"].toString();
+        row.price = priceOf(order["price"]);
+        row.status = order["status"].toString();
+        row.createdAt = QDateTime::fromString(order["createdAt"].toString(), Qt::ISODate);
+        result.orders.append(row);
+    }
+
+    qDebug() << "查询到订单数量:" << result.orders.size();
+    return result;
+}
+
+AvailabilityResponse ResponseParser::parseAvailability(const QByteArray &data)
+{
+    AvailabilityResponse result;
+    QJsonObject response;
+    if (!parseObject(data, &response, &result.message)) {
+        return result;
+    }
+
+    result.success = response["success"].toBool();
+    if (!result.success) {
+        result.message = response["message"].toString();
+        return result;
+    }
+
+    for (const QJsonValue &itemValue : response["data"].toArray()) {
+        QJsonObject item = itemValue.toObject();
+
+        AvailabilityUpdate update;
+        update.scheduleId = item["scheduleId"].toInt();
+        update.seatType = item["seatType"].toString();
+        update.fromStation = item["fromStation"].toString();
+        update.toStation = item["toStation"].toString();
+        update.availableSeats = item["availableSeats"].toInt();
+        result.updates.append(update);
+    }
+    return result;
+}
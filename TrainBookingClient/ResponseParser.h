@@ -0,0 +1,78 @@
+#ifndef RESPONSEPARSER_H
+#define RESPONSEPARSER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include "TrainTableModel.h"
+
+// /search-bookable-trains 的解码结果
+struct SearchResponse
+{
+    bool success = false;
+    QString message;
+    int trainCount = 0;
+    QVector<TrainSeatRow> rows;
+};
+
+struct OrderRow
+{
+    int id = 0;
+    QString trainName;
+    QString date;
+    QString departureTime;
+    QString fromStation;
+    QString toStation;
+    QString carriageNumber;
+    QString seatNumber;
+    QString seatType;
+    QString passengerName;
+    QString passengerId;
+    double price = 0.0;
+    QString status;
+    QDateTime createdAt;
+};
+
+// 分页 /orders（带 limit）的解码结果
+struct OrderPageResponse
+{
+    bool success = false;
+    QString message;
+    QVector<OrderRow> orders;
+    QString firstCursor;    // 本页第一行的游标，向前翻页用
+    QString lastCursor;     // 本页最后一行的游标，向后翻页用
+    bool hasMore = false;   // 请求方向上是否还有更多订单
+};
+
+struct AvailabilityUpdate
+{
+    int scheduleId = 0;
+    QString seatType;
+    QString fromStation;
+    QString toStation;
+    int availableSeats = 0;
+};
+
+// /availability 的解码结果
+struct AvailabilityResponse
+{
+    bool success = false;
+    QString message;
+    QVector<AvailabilityUpdate> updates;
+};
+
+// 把响应字节解码为结构体。只用到 QJson，不碰任何 QObject，
+// 可以放到 QtConcurrent 的线程池里执行
+namespace ResponseParser
+{
+    SearchResponse parseSearch(const QByteArray &data);
+    OrderPageResponse parseOrderPage(const QByteArray &data);
+    AvailabilityResponse parseAvailability(const QByteArray &data);
+}
+
+Q_DECLARE_METATYPE(SearchResponse)
+Q_DECLARE_METATYPE(OrderPageResponse)
+
+#endif // RESPONSEPARSER_H
@@ -0,0 +1,178 @@
+#include "SearchCache.h"
+
+namespace {
+
+int stopIndex(const QVector<ScheduleStop> &schedule, const QString &station)
+{
+    for (int i = 0; i < schedule.size(); ++i) {
+        if (schedule[i].station == station) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+SearchCache::SearchCache(int ttlSeconds, int maxEntries)
+    : m_ttlMs(qint64(ttlSeconds) * 1000)
+    , m_maxEntries(maxEntries)
+{
+    m_clock.start();
+}
+
+QString SearchCache::priceKey(int trainId, const QString &fromStation,
+                              const QString &toStation, const QString &seatType)
+{
+    return QString("%1|%2|%3|%4").arg(trainId).arg(fromStation, toStation, seatType);
+}
+
+bool SearchCache::expired(const Entry &entry) const
+{
+    return m_clock.elapsed() - entry.fetchedAt > m_ttlMs;
+}
+
+bool SearchCache::lookup(const SearchQuery &query, SearchResponse *response) const
+{
+    auto it = m_entries.constFind(query.key());
+    if (it == m_entries.constEnd() || expired(*it)) {
+        return false;
+    }
+
+    const Entry &entry = *it;
+    response->success = true;
+    response->message.clear();
+    response->trainCount = entry.trainCount;
+    response->rows.clear();
+    response->rows.reserve(entry.seats.size());
+
+    for (const Availability &seat : entry.seats) {
+        auto train = m_trains.constFind(seat.trainId);
+        if (train == m_trains.constEnd()) {
+            return false; // 静态信息被清掉了，按未命中处理
+        }
+
+        TrainSeatRow row;
+        row.trainId = seat.trainId;
+        row.scheduleId = seat.scheduleId;
+        row.trainName = train->name;
+        row.fromStation = train->fromStation;
+        row.toStation = train->toStation;
+        row.date = entry.query.date;
+        row.seatType = seat.seatType;
+        row.price = m_prices.value(priceKey(seat.trainId, query.fromStation,
+                                            query.toStation, seat.seatType));
+        row.availableSeats = seat.availableSeats;
+        row.totalSeats = seat.totalSeats;
+        row.schedule = train->schedule;         // 隐式共享，不复制
+        row.scheduleText = train->scheduleText;
+        response->rows.append(row);
+    }
+    return true;
+}
+
+bool SearchCache::contains(const SearchQuery &query) const
+{
+    auto it = m_entries.constFind(query.key());
+    return it != m_entries.constEnd() && !expired(*it);
+}
+
+void SearchCache::store(const SearchQuery &query, const SearchResponse &response)
+{
+    if (!response.success) {
+        return;
+    }
+
+    Entry entry;
+    entry.query = query;
+    entry.trainCount = response.trainCount;
+    entry.fetchedAt = m_clock.elapsed();
+    entry.seats.reserve(response.rows.size());
+
+    for (const TrainSeatRow &row : response.rows) {
+        TrainInfo &train = m_trains[row.trainId];
+        train.name = row.trainName;
+        train.fromStation = row.fromStation;
+        train.toStation = row.toStation;
+        train.schedule = row.schedule;
+        train.scheduleText = row.scheduleText;
+
+        m_prices.insert(priceKey(row.trainId, query.fromStation, query.toStation, row.seatType),
+                        row.price);
+        entry.seats.append({row.trainId, row.scheduleId, row.seatType,
+                            row.availableSeats, row.totalSeats});
+    }
+
+    m_entries.insert(query.key(), entry);
+    evict();
+}
+
+void SearchCache::invalidateBooking(int trainId, const QString &date,
+                                    const QString &fromStation, const QString &toStation)
+{
+    ++m_generation;
+    auto train = m_trains.constFind(trainId);
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        const Entry &entry = *it;
+        bool affected = false;
+
+        if (entry.query.date == date) {
+            for (const Availability &seat : entry.seats) {
+                if (seat.trainId != trainId) {
+                    continue;
+                }
+                if (train == m_trains.constEnd()) {
+                    affected = true; // 没有时刻表无法判断区间，保守处理
+                    break;
+                }
+                // 与后端一致：区间不冲突当且仅当 a.to <= b.from 或 a.from >= b.to
+                int bookedFrom = stopIndex(train->schedule, fromStation);
+                int bookedTo = stopIndex(train->schedule, toStation);
+                int queryFrom = stopIndex(train->schedule, entry.query.fromStation);
+                int queryTo = stopIndex(train->schedule, entry.query.toStation);
+                if (bookedFrom < 0 || bookedTo < 0 || queryFrom < 0 || queryTo < 0) {
+                    affected = true;
+                } else {
+                    affected = !(queryTo <= bookedFrom || queryFrom >= bookedTo);
+                }
+                break;
+            }
+        }
+
+        if (affected) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SearchCache::clear()
+{
+    ++m_generation;
+    m_entries.clear();
+    m_trains.clear();
+    m_prices.clear();
+}
+
+void SearchCache::evict()
+{
+    // 先丢过期的，仍超出上限时丢最早获取的
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (expired(*it)) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    while (m_entries.size() > m_maxEntries) {
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->fetchedAt < oldest->fetchedAt) {
+                oldest = it;
+            }
+        }
+        m_entries.erase(oldest);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "ResponseParser.h"
+
+// 一次车次搜索的条件
+struct SearchQuery
+{
+    QString fromStation;
+    QString toStation;
+    QString date;
+
+    QString key() const { return fromStation + '|' + toStation + '|' + date; }
+};
+
+// 搜索结果缓存，按 (出发站, 到达站, 日期) 存放。
+// 时刻表和票价不随预订变化，按车次单独保存并长期保留；
+// 余票按查询条件保存，超过 TTL 或被预订影响后失效。
+class SearchCache
+{
+public:
+    explicit SearchCache(int ttlSeconds = 30, int maxEntries = 64);
+
+    // 命中且未过期时重建结果，否则返回 false
+    bool lookup(const SearchQuery &query, SearchResponse *response) const;
+    bool contains(const SearchQuery &query) const;
+    void store(const SearchQuery &query, const SearchResponse &response);
+
+    // 车次 trainId 在 date 的 fromStation→toStation 区间余票已变化，
+    // 只丢弃同一天包含该车次且区间与之重叠的查询结果
+    void invalidateBooking(int trainId, const QString &date,
+                           const QString &fromStation, const QString &toStation);
+    void clear();
+    // 每次失效后递增，进行中的请求据此判断结果是否已过时
+    quint64 generation() const { return m_generation; }
+
+private:
+    struct TrainInfo
+    {
+        QString name;
+        QString fromStation;
+        QString toStation;
+        QVector<ScheduleStop> schedule;
+        QString scheduleText;
+    };
+
+    struct Availability
+    {
+        int trainId;
+        int scheduleId;
+        QString seatType;
+        int availableSeats;
+        int totalSeats;
+    };
+
+    struct Entry
+    {
+        SearchQuery query;
+        int trainCount = 0;
+        QVector<Availability> seats;
+        qint64 fetchedAt = 0;
+    };
+
+    static QString priceKey(int trainId, const QString &fromStation,
+                            const QString &toStation, const QString &seatType);
+    bool expired(const Entry &entry) const;
+    void evict();
+
+    qint64 m_ttlMs;
+    int m_maxEntries;
+    QElapsedTimer m_clock;
+    QHash<int, TrainInfo> m_trains;     // 车次ID -> 时刻表
+    QHash<QString, double> m_prices;    // 车次|出发|到达|座位类型 -> 价格
+    QHash<QString, Entry> m_entries;    // SearchQuery::key() -> 余票
+    quint64 m_generation = 0;
+};
+
+#endif // SEARCHCACHE_H
@@ -0,0 +1,143 @@
+#include "SearchPrefetcher.h"
+#include "NetworkTimings.h"
+#include "ResponseParser.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+SearchPrefetcher::SearchPrefetcher(QNetworkAccessManager *manager, const QString &apiBase,
+                                   SearchCache *cache, NetworkTimings *timings,
+                                   QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_apiBase(apiBase)
+    , m_cache(cache)
+    , m_timings(timings)
+    , m_days(2)
+    , m_maxConcurrent(2)
+    , m_generation(0)
+{
+}
+
+void SearchPrefetcher::prefetchAround(const SearchQuery &query,
+                                      const QDate &minDate, const QDate &maxDate)
+{
+    if (query.fromStation != m_fromStation || query.toStation != m_toStation) {
+        cancel();
+        m_fromStation = query.fromStation;
+        m_toStation = query.toStation;
+    }
+
+    QDate center = QDate::fromString(query.date, "yyyy-MM-dd");
+    if (!center.isValid()) {
+        return;
+    }
+
+    // 新的中心日期重新排队：+1, -1, +2, -2 ...
+    m_pending.clear();
+    for (int offset = 1; offset <= m_days; ++offset) {
+        for (int sign : {1, -1}) {
+            QDate date = center.addDays(sign * offset);
+            if (date < minDate || date > maxDate) {
+                continue;
+            }
+
+            SearchQuery neighbor = query;
+            neighbor.date = date.toString("yyyy-MM-dd");
+            if (m_cache->contains(neighbor)) {
+                continue;
+            }
+
+            bool inFlight = false;
+            for (const SearchQuery &running : m_inFlight) {
+                if (running.key() == neighbor.key()) {
+                    inFlight = true;
+                    break;
+                }
+            }
+            if (!inFlight) {
+                m_pending.append(neighbor);
+            }
+        }
+    }
+
+    startNext();
+}
+
+void SearchPrefetcher::cancel()
+{
+    ++m_generation;
+    m_pending.clear();
+
+    const QList<QNetworkReply *> replies = m_inFlight.keys();
+    m_inFlight.clear();
+    for (QNetworkReply *reply : replies) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+void SearchPrefetcher::startNext()
+{
+    while (m_inFlight.size() < m_maxConcurrent && !m_pending.isEmpty()) {
+        SearchQuery query = m_pending.takeFirst();
+        // 排队期间用户可能已经搜索过这一天
+        if (m_cache->contains(query)) {
+            continue;
+        }
+
+        QJsonObject requestData;
+        requestData["fromStation"] = query.fromStation;
+        requestData["toStation"] = query.toStation;
+        requestData["date"] = query.date;
+
+        QNetworkRequest request(QUrl(m_apiBase + "/search-bookable-trains"));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        request.setPriority(QNetworkRequest::LowPriority);
+
+        QNetworkReply *reply = m_manager->post(request, QJsonDocument(requestData).toJson());
+        m_timings->track(reply, "预取车次");
+        m_inFlight.insert(reply, query);
+
+        // 请求发出后发生的预订会让这次结果中的余票过时
+        quint64 cacheGeneration = m_cache->generation();
+        connect(reply, &QNetworkReply::finished, this, [this, reply, query, cacheGeneration]() {
+            onFinished(reply, query, cacheGeneration);
+        });
+    }
+}
+
+void SearchPrefetcher::onFinished(QNetworkReply *reply, const SearchQuery &query,
+                                  quint64 cacheGeneration)
+{
+    m_inFlight.remove(reply);
+
+    // 预取失败不提示用户，切换到该日期时会正常搜索
+    if (reply->error() != QNetworkReply::NoError) {
+        qDebug() << "预取失败:" << query.key() << reply->errorString();
+        reply->deleteLater();
+        startNext();
+        return;
+    }
+
+    quint64 generation = m_generation;
+    auto *watcher = new QFutureWatcher<SearchResponse>(this);
+    connect(watcher, &QFutureWatcher<SearchResponse>::finished, this,
+            [this, watcher, reply, query, generation, cacheGeneration]() {
+        m_timings->markParsed(reply);
+        if (generation == m_generation && cacheGeneration == m_cache->generation()) {
+            m_cache->store(query, watcher->result());
+        }
+        watcher->deleteLater();
+        reply->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(ResponseParser::parseSearch, reply->readAll()));
+
+    startNext();
+}
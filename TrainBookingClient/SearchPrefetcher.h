@@ -0,0 +1,54 @@
+#ifndef SEARCHPREFETCHER_H
+#define SEARCHPREFETCHER_H
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "SearchCache.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class NetworkTimings;
+
+// 在后台预取当前查询前后几天的搜索结果，写入 SearchCache，
+// 用户切换日期时可以直接从缓存显示。
+// 同时进行的请求数有上限且使用低优先级，不挤占用户发起的请求
+class SearchPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    SearchPrefetcher(QNetworkAccessManager *manager, const QString &apiBase,
+                     SearchCache *cache, NetworkTimings *timings,
+                     QObject *parent = nullptr);
+
+    void setDays(int days) { m_days = days; }
+    void setMaxConcurrent(int maxConcurrent) { m_maxConcurrent = maxConcurrent; }
+
+    // 预取 query 前后 days 天（限定在 [minDate, maxDate] 内）中尚未缓存的日期，
+    // 近的日期优先。出发站或到达站与进行中的预取不同时先取消
+    void prefetchAround(const SearchQuery &query, const QDate &minDate, const QDate &maxDate);
+    // 放弃排队的日期并中止进行中的请求
+    void cancel();
+
+private:
+    void startNext();
+    void onFinished(QNetworkReply *reply, const SearchQuery &query, quint64 cacheGeneration);
+
+    QNetworkAccessManager *m_manager;
+    QString m_apiBase;
+    SearchCache *m_cache;
+    NetworkTimings *m_timings;
+    int m_days;
+    int m_maxConcurrent;
+
+    QString m_fromStation;
+    QString m_toStation;
+    quint64 m_generation;           // cancel() 后递增，丢弃旧的解码结果
+    QList<SearchQuery> m_pending;
+    QHash<QNetworkReply *, SearchQuery> m_inFlight;
+};
+
+#endif // SEARCHPREFETCHER_H
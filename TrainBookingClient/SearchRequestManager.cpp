@@ -0,0 +1,109 @@
+#include "SearchRequestManager.h"
+#include "NetworkTimings.h"
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+SearchRequestManager::SearchRequestManager(QNetworkAccessManager *manager, const QString &apiBase,
+                                           NetworkTimings *timings, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_apiBase(apiBase)
+    , m_timings(timings)
+    , m_active(false)
+    , m_generation(0)
+{
+    m_debounceTimer.setSingleShot(true);
+    m_debounceTimer.setInterval(300);
+    connect(&m_debounceTimer, &QTimer::timeout, this, [this]() {
+        search(m_pendingQuery);
+    });
+}
+
+void SearchRequestManager::search(const SearchQuery &query)
+{
+    m_debounceTimer.stop();
+
+    // 相同条件已在进行，等它的结果即可
+    if (m_active && m_activeQuery.key() == query.key()) {
+        return;
+    }
+
+    cancel();
+    start(query);
+}
+
+void SearchRequestManager::searchDebounced(const SearchQuery &query)
+{
+    m_pendingQuery = query;
+    m_debounceTimer.start();
+}
+
+void SearchRequestManager::cancel()
+{
+    m_debounceTimer.stop();
+    ++m_generation;
+    m_active = false;
+
+    if (m_reply) {
+        QNetworkReply *reply = m_reply;
+        m_reply = nullptr;
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+void SearchRequestManager::start(const SearchQuery &query)
+{
+    QJsonObject requestData;
+    requestData["fromStation"] = query.fromStation;
+    requestData["toStation"] = query.toStation;
+    requestData["date"] = query.date;
+
+    QNetworkRequest request(QUrl(m_apiBase + "/search-bookable-trains"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    QNetworkReply *reply = m_manager->post(request, QJsonDocument(requestData).toJson());
+    m_timings->track(reply, "搜索车次");
+
+    m_reply = reply;
+    m_activeQuery = query;
+    m_active = true;
+    emit started(query);
+
+    quint64 generation = m_generation;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, generation]() {
+        onReplyFinished(reply, generation);
+    });
+}
+
+void SearchRequestManager::onReplyFinished(QNetworkReply *reply, quint64 generation)
+{
+    m_reply = nullptr;
+    SearchQuery query = m_activeQuery;
+
+    if (reply->error() != QNetworkReply::NoError) {
+        m_active = false;
+        emit failed(query, reply->errorString());
+        reply->deleteLater();
+        return;
+    }
+
+    // 在线程池中解码；期间仍算进行中，相同条件的搜索继续合并，
+    // 新条件的搜索使 generation 变化，这里的结果随之作废
+    auto *watcher = new QFutureWatcher<SearchResponse>(this);
+    connect(watcher, &QFutureWatcher<SearchResponse>::finished, this,
+            [this, watcher, reply, query, generation]() {
+        if (generation == m_generation) {
+            m_active = false;
+            emit finished(reply, query, watcher->result());
+        }
+        watcher->deleteLater();
+        reply->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(ResponseParser::parseSearch, reply->readAll()));
+}
@@ -0,0 +1,60 @@
+#ifndef SEARCHREQUESTMANAGER_H
+#define SEARCHREQUESTMANAGER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+#include <QNetworkReply>
+#include "ResponseParser.h"
+#include "SearchCache.h"
+
+class QNetworkAccessManager;
+class NetworkTimings;
+
+// 车次搜索请求管理：同一时刻最多一个搜索在进行。
+// 新条件的搜索中止旧请求并丢弃其结果，相同条件的重复搜索并入进行中的请求，
+// 输入变化触发的搜索先去抖，停止变化一段时间后只发最后一次
+class SearchRequestManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    SearchRequestManager(QNetworkAccessManager *manager, const QString &apiBase,
+                         NetworkTimings *timings, QObject *parent = nullptr);
+
+    void setDebounceInterval(int msec) { m_debounceTimer.setInterval(msec); }
+
+    // 立即搜索（点击搜索按钮）
+    void search(const SearchQuery &query);
+    // 去抖后搜索（修改日期、车站）
+    void searchDebounced(const SearchQuery &query);
+    // 放弃等待中的和进行中的搜索，不再发出任何信号
+    void cancel();
+
+    bool isActive() const { return m_active || m_debounceTimer.isActive(); }
+
+signals:
+    void started(const SearchQuery &query);
+    // reply 在槽函数返回后释放，可用于记录解析和渲染耗时
+    void finished(QNetworkReply *reply, const SearchQuery &query,
+                  const SearchResponse &response);
+    void failed(const SearchQuery &query, const QString &message);
+
+private:
+    void start(const SearchQuery &query);
+    void onReplyFinished(QNetworkReply *reply, quint64 generation);
+
+    QNetworkAccessManager *m_manager;
+    QString m_apiBase;
+    NetworkTimings *m_timings;
+    QTimer m_debounceTimer;
+
+    SearchQuery m_pendingQuery;     // 去抖中的条件
+    SearchQuery m_activeQuery;      // 进行中（含解码）的条件
+    bool m_active;
+    quint64 m_generation;           // 每次中止递增，迟到的结果据此丢弃
+    QPointer<QNetworkReply> m_reply;
+};
+
+#endif // SEARCHREQUESTMANAGER_H
@@ -0,0 +1,85 @@
+#include "TrainTableDelegate.h"
+#include "TrainTableModel.h"
+#include <QApplication>
+#include <QPainter>
+#include <QStyle>
+
+namespace {
+
+const int H_PADDING = 8;
+const int V_PADDING = 4;
+
+} // namespace
+
+TrainTableDelegate::TrainTableDelegate(int minRowHeight, QObject *parent)
+    : QStyledItemDelegate(parent)
+    , m_minRowHeight(minRowHeight)
+{
+}
+
+int TrainTableDelegate::rowHeight(int stopCount, const QFontMetrics &fontMetrics) const
+{
+    int lines = qBound(1, stopCount, int(MAX_SCHEDULE_LINES));
+    return qMax(m_minRowHeight, lines * fontMetrics.lineSpacing() + 2 * V_PADDING);
+}
+
+void TrainTableDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                               const QModelIndex &index) const
+{
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+
+    // 只让样式画背景、选中和焦点框，文字自己画
+    QString text = opt.text;
+    opt.text.clear();
+    const QWidget *widget = opt.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    QRect textRect = opt.rect.adjusted(H_PADDING, V_PADDING, -H_PADDING, -V_PADDING);
+    QPalette::ColorRole textRole = (opt.state & QStyle::State_Selected)
+                                   ? QPalette::HighlightedText : QPalette::Text;
+
+    painter->save();
+    painter->setClipRect(textRect);
+    painter->setFont(opt.font);
+    painter->setPen(opt.palette.color(QPalette::Active, textRole));
+    if (index.column() == TrainTableModel::ScheduleColumn) {
+        paintSchedule(painter, textRect, opt.fontMetrics, text);
+    } else {
+        painter->drawText(textRect, opt.displayAlignment,
+                          opt.fontMetrics.elidedText(text, Qt::ElideRight, textRect.width()));
+    }
+    painter->restore();
+}
+
+void TrainTableDelegate::paintSchedule(QPainter *painter, const QRect &rect,
+                                       const QFontMetrics &fontMetrics, const QString &text) const
+{
+    // 逐行绘制，不对整段多行文字排版；画到行底即停，
+    // 超出行高的站点见工具提示
+    int lineHeight = fontMetrics.lineSpacing();
+    int y = rect.top();
+    int start = 0;
+    while (start <= text.size() && y + lineHeight <= rect.bottom() + 1) {
+        int end = text.indexOf('\n', start);
+        if (end < 0) {
+            end = text.size();
+        }
+        QString line = fontMetrics.elidedText(text.mid(start, end - start),
+                                              Qt::ElideRight, rect.width());
+        painter->drawText(rect.left(), y + fontMetrics.ascent(), line);
+        y += lineHeight;
+        start = end + 1;
+    }
+}
+
+QSize TrainTableDelegate::sizeHint(const QStyleOptionViewItem &option,
+                                   const QModelIndex &index) const
+{
+    // 宽度按第一行文字估算，高度由站数决定
+    QString firstLine = index.data(Qt::DisplayRole).toString().section('\n', 0, 0);
+    int stopCount = index.data(TrainTableModel::StopCountRole).toInt();
+    return QSize(option.fontMetrics.horizontalAdvance(firstLine) + 2 * H_PADDING,
+                 rowHeight(stopCount, option.fontMetrics));
+}
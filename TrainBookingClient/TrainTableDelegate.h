@@ -0,0 +1,31 @@
+#ifndef TRAINTABLEDELEGATE_H
+#define TRAINTABLEDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// 车次表的绘制代理：文字直接用 QPainter 绘制并裁剪，
+// 不走 QStyledItemDelegate 的文本排版；行高按时刻表站数计算，不测量文字
+class TrainTableDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit TrainTableDelegate(int minRowHeight, QObject *parent = nullptr);
+
+    // 时刻表有 stopCount 站时的行高，最多显示 MAX_SCHEDULE_LINES 行
+    int rowHeight(int stopCount, const QFontMetrics &fontMetrics) const;
+
+    static const int MAX_SCHEDULE_LINES = 8;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    void paintSchedule(QPainter *painter, const QRect &rect,
+                       const QFontMetrics &fontMetrics, const QString &text) const;
+
+    int m_minRowHeight;
+};
+
+#endif // TRAINTABLEDELEGATE_H
@@ -0,0 +1,172 @@
+#include "TrainTableModel.h"
+#include "JsonValues.h"
+#include <QJsonObject>
+#include <QStringList>
+#include <QColor>
+
+namespace {
+
+QString formatSchedule(const QVector<ScheduleStop> &schedule)
+{
+    QStringList scheduleItems;
+    for (int k = 0; k < schedule.size(); ++k) {
+        const ScheduleStop &stop = schedule[k];
+        if (k == 0) {
+            // 起始站，只显示发车时间
+            scheduleItems << QString("%1 %2").arg(stop.station).arg(stop.departure);
+        } else if (k == schedule.size() - 1) {
+            // 终点站，只显示到达时间
+            scheduleItems << QString("%1 %2").arg(stop.station).arg(stop.arrival);
+        } else {
+            // 中间站，显示到达/发车时间
+            scheduleItems << QString("%1 %2/%3").arg(stop.station).arg(stop.arrival).arg(stop.departure);
+        }
+    }
+    return scheduleItems.join("\n");
+}
+
+} // namespace
+
+TrainTableModel::TrainTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+QVector<TrainSeatRow> TrainTableModel::parseTrains(const QJsonArray &trains)
+{
+    QVector<TrainSeatRow> rows;
+
+    for (const QJsonValue &trainValue : trains) {
+        QJsonObject train = trainValue.toObject();
+
+        QVector<ScheduleStop> schedule;
+        for (const QJsonValue &stopValue : train["schedule"].toArray()) {
+            QJsonObject stop = stopValue.toObject();
+            schedule.append({stop["station"].toString(),
+                             stop["arrival"].toString(),
+                             stop["departure"].toString()});
+        }
+        // 时刻表文字与座位类型无关，各座位类型行共享同一份
+        QString scheduleText = formatSchedule(schedule);
+
+        QJsonArray seatTypes = train["seatTypes"].toArray();
+        for (const QJsonValue &seatTypeValue : seatTypes) {
+            QJsonObject seatType = seatTypeValue.toObject();
+
+            TrainSeatRow row;
+            row.trainId = train["id"].toInt();
+            row.scheduleId = train["scheduleId"].toInt();
+            row.trainName = train["name"].toString();
+            row.fromStation = train["from"].toString();
+            row.toStation = train["to"].toString();
+            row.date = train["date"].toString();
+            row.seatType = seatType["type"].toString();
+            row.price = priceOf(seatType["price"]);
+            row.availableSeats = seatType["availableSeats"].toInt();
+            row.totalSeats = seatType["totalSeats"].toInt();
+            row.schedule = schedule;
+            row.scheduleText = scheduleText;
+            rows.append(row);
+        }
+    }
+
+    return rows;
+}
+
+void TrainTableModel::setRows(QVector<TrainSeatRow> rows)
+{
+    beginResetModel();
+    m_rows = std::move(rows);
+    endResetModel();
+}
+
+bool TrainTableModel::updateAvailability(int scheduleId, const QString &seatType,
+                                         int availableSeats)
+{
+    for (int i = 0; i < m_rows.size(); ++i) {
+        TrainSeatRow &row = m_rows[i];
+        if (row.scheduleId != scheduleId || row.seatType != seatType) {
+            continue;
+        }
+        if (row.availableSeats == availableSeats) {
+            return false;
+        }
+        row.availableSeats = availableSeats;
+        // 售完时整行变灰，所以通知整行
+        emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
+        return true;
+    }
+    return false;
+}
+
+int TrainTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_rows.size());
+}
+
+int TrainTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant TrainTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+
+    const TrainSeatRow &row = m_rows[index.row()];
+    bool soldOut = row.availableSeats == 0;
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case TrainNameColumn: return row.trainName;
+        case FromColumn: return row.fromStation;
+        case ToColumn: return row.toStation;
+        case DateColumn: return row.date;
+        case SeatTypeColumn: return row.seatType;
+        case PriceColumn: return QString("¥%1").arg(row.price, 0, 'f', 2);
+        case AvailableColumn: return row.availableSeats;
+        case TotalColumn: return row.totalSeats;
+        case ScheduleColumn: return row.scheduleText;
+        }
+        break;
+    case StopCountRole:
+        return int(row.schedule.size());
+    case Qt::ToolTipRole:
+        if (index.column() == ScheduleColumn) {
+            return row.scheduleText; // 显示完整时刻表
+        }
+        break;
+    case Qt::TextAlignmentRole:
+        if (index.column() == ScheduleColumn) {
+            return int(Qt::AlignTop | Qt::AlignLeft);
+        }
+        return int(Qt::AlignLeft | Qt::AlignVCenter);
+    case Qt::BackgroundRole:
+        // 没有余票的行显示为灰色
+        if (soldOut) {
+            return QColor(220, 220, 220);
+        }
+        break;
+    case Qt::ForegroundRole:
+        if (soldOut) {
+            return QColor(128, 128, 128);
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+QVariant TrainTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    static const QStringList headers = {"车次", "出发站", "到达站", "日期", "座位类型",
+                                        "价格", "余票", "总票数", "时刻表"};
+    return headers.value(section);
+}
@@ -0,0 +1,75 @@
+#ifndef TRAINTABLEMODEL_H
+#define TRAINTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QJsonArray>
+#include <QString>
+#include <QVector>
+
+struct ScheduleStop
+{
+    QString station;
+    QString arrival;
+    QString departure;
+};
+
+// 车次列表的一行：一个车次的一种座位类型
+struct TrainSeatRow
+{
+    int trainId = 0;
+    int scheduleId = 0;     // 车次在该日期的时刻表ID
+    QString trainName;
+    QString fromStation;
+    QString toStation;
+    QString date;
+    QString seatType;
+    double price = 0.0;
+    int availableSeats = 0;
+    int totalSeats = 0;
+    QVector<ScheduleStop> schedule; // 同一车次的各行共享（隐式共享）
+    QString scheduleText;           // 每个车次只生成一次，同样共享
+};
+
+class TrainTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Role {
+        StopCountRole = Qt::UserRole + 1   // 时刻表站数，用于计算行高
+    };
+
+    enum Column {
+        TrainNameColumn,
+        FromColumn,
+        ToColumn,
+        DateColumn,
+        SeatTypeColumn,
+        PriceColumn,
+        AvailableColumn,
+        TotalColumn,
+        ScheduleColumn,
+        ColumnCount
+    };
+
+    explicit TrainTableModel(QObject *parent = nullptr);
+
+    // /search-bookable-trains 返回的 data 数组展开为每座位类型一行
+    static QVector<TrainSeatRow> parseTrains(const QJsonArray &trains);
+
+    void setRows(QVector<TrainSeatRow> rows);
+    // 原地更新一行的余票，只发出该行的 dataChanged，不影响选中和滚动位置
+    bool updateAvailability(int scheduleId, const QString &seatType, int availableSeats);
+    const TrainSeatRow &row(int row) const { return m_rows[row]; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+private:
+    QVector<TrainSeatRow> m_rows;
+};
+
+#endif // TRAINTABLEMODEL_H
@@ -56,13 +56,13 @@ int main(int argc, char *argv[])
         QLineEdit:focus, QComboBox:focus, QDateEdit:focus {
             border-color: #4CAF50;
         }
-        QTableWidget {
+        QTableView {
             background-color: white;
             alternate-background-color: #f8f9fa;
             selection-background-color: #4CAF50;
             gridline-color: #ddd;
         }
-        QTableWidget::item {
+        QTableView::item {
             padding: 8px;
         }
         QHeaderView::section {
@@ -799,6 +799,7 @@ app.post('/book', async (req, res) => {
         
         await connection.commit();
         console.log('✓ 预订完成，事务提交成功');
+        notifyAvailabilityChanged(scheduleId);
         
         sendSuccess(res, {
             orderId: orderId,
@@ -824,15 +825,189 @@ app.post('/book', async (req, res) => {
     }
 });
 
+// 批量查询余票，预订后客户端只刷新受影响的行
+const MAX_AVAILABILITY_ITEMS = 50;
+
+app.post('/availability', async (req, res) => {
+    try {
+        const { items } = req.body;
+        
+        // 输入验证
+        if (!Array.isArray(items) || items.length === 0) {
+            return sendError(res, '请提供要查询的车次和座位类型', 400);
+        }
+        if (items.length > MAX_AVAILABILITY_ITEMS) {
+            return sendError(res, `一次最多查询 ${MAX_AVAILABILITY_ITEMS} 项`, 400);
+        }
+        for (const item of items) {
+            if (!item || !item.scheduleId || !item.seatType || !item.fromStation || !item.toStation) {
+                return sendError(res, '每一项都需要 scheduleId、seatType、fromStation 和 toStation', 400);
+            }
+        }
+        
+        const counts = await Promise.all(items.map(item =>
+            getAvailableSeats(item.scheduleId, item.seatType, item.fromStation, item.toStation)));
+        
+        const result = items.map((item, i) => ({
+            scheduleId: item.scheduleId,
+            seatType: item.seatType,
+            fromStation: item.fromStation,
+            toStation: item.toStation,
+            availableSeats: counts[i]
+        }));
+        
+        sendSuccess(res, result, '查询成功');
+        
+    } catch (error) {
+        console.error('查询余票失败:', error);
+        sendError(res, '查询失败');
+    }
+});
+
+// 余票推送（Server-Sent Events）
+// 客户端订阅正在查看的时刻表，余票变化后按间隔合并推送，每个时刻表每个间隔最多一条
+const AVAILABILITY_PUSH_INTERVAL_MS = 1000;
+const AVAILABILITY_KEEPALIVE_MS = 15000;
+const MAX_AVAILABILITY_STREAMS = 500;
+const availabilityStreams = new Set();
+const dirtySchedules = new Set();
+let pushingAvailability = false;
+
+app.get('/events/availability', (req, res) => {
+    const { schedules, fromStation, toStation } = req.query;
+    const scheduleIds = new Set(String(schedules || '').split(',')
+        .map(id => parseInt(id))
+        .filter(id => id > 0));
+    
+    // 输入验证
+    if (scheduleIds.size === 0 || scheduleIds.size > MAX_AVAILABILITY_ITEMS || !fromStation || !toStation) {
+        return sendError(res, '请提供时刻表ID列表、出发站和到达站', 400);
+    }
+    if (availabilityStreams.size >= MAX_AVAILABILITY_STREAMS) {
+        return sendError(res, '订阅数已达上限，请稍后重试', 503);
+    }
+    
+    res.writeHead(200, {
+        'Content-Type': 'text/event-stream',
+        'Cache-Control': 'no-cache',
+        'Connection': 'keep-alive'
+    });
+    res.write('retry: 3000\n\n');
+    
+    const stream = { res, scheduleIds, fromStation, toStation };
+    availabilityStreams.add(stream);
+    req.on('close', () => availabilityStreams.delete(stream));
+});
+
+// 预订、取消、恢复成功后调用
+function notifyAvailabilityChanged(scheduleId) {
+    if (availabilityStreams.size > 0) {
+        dirtySchedules.add(scheduleId);
+    }
+}
+
+async function pushAvailability() {
+    if (pushingAvailability || dirtySchedules.size === 0) {
+        return;
+    }
+    pushingAvailability = true;
+    const changed = [...dirtySchedules];
+    dirtySchedules.clear();
+    
+    try {
+        // 同一时刻表、同一区间的订阅者共用一次计算
+        const payloads = new Map();
+        for (const stream of availabilityStreams) {
+            for (const scheduleId of changed) {
+                if (!stream.scheduleIds.has(scheduleId)) {
+                    continue;
+                }
+                const key = `${scheduleId}|${stream.fromStation}|${stream.toStation}`;
+                if (!payloads.has(key)) {
+                    payloads.set(key, getScheduleAvailability(scheduleId, stream.fromStation, stream.toStation));
+                }
+                const payload = await payloads.get(key);
+                // 等待查询期间客户端可能已断开
+                if (!availabilityStreams.has(stream) || stream.res.writableEnded) {
+                    break;
+                }
+                stream.res.write(`event: availability\ndata: ${JSON.stringify(payload)}\n\n`);
+            }
+        }
+    } catch (error) {
+        console.error('推送余票失败:', error);
+        // 留到下一轮重试
+        for (const scheduleId of changed) {
+            dirtySchedules.add(scheduleId);
+        }
+    } finally {
+        pushingAvailability = false;
+    }
+}
+
+async function getScheduleAvailability(scheduleId, fromStation, toStation) {
+    const [seatTypeRows] = await pool.execute(`
+        SELECT DISTINCT c.seat_type
+        FROM carriages c
+        JOIN train_schedules ts ON c.train_id = ts.train_id
+        WHERE ts.id = ?
+    `, [scheduleId]);
+    
+    const seatTypes = await Promise.all(seatTypeRows.map(async row => ({
+        type: row.seat_type,
+        availableSeats: await getAvailableSeats(scheduleId, row.seat_type, fromStation, toStation)
+    })));
+    
+    return { scheduleId, fromStation, toStation, seatTypes };
+}
+
+setInterval(pushAvailability, AVAILABILITY_PUSH_INTERVAL_MS);
+
+// 长时间没有事件时发送注释行，避免代理断开空闲连接
+setInterval(() => {
+    for (const stream of availabilityStreams) {
+        stream.res.write(': keepalive\n\n');
+    }
+}, AVAILABILITY_KEEPALIVE_MS);
+
 // 查询订单
+// 带 limit 时按游标分页：按 (created_at, id) 倒序，游标为某行的这两个值，
+// direction=after 取游标之后（更早）的订单，direction=before 取游标之前（更新）的订单
+const MAX_ORDER_PAGE_SIZE = 200;
+
+function encodeOrderCursor(row) {
+    return Buffer.from(`${row.cursor_time}|${row.id}`).toString('base64url');
+}
+
+function decodeOrderCursor(cursor) {
+    const match = /^(\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2})\|(\d+)$/
+        .exec(Buffer.from(String(cursor), 'base64url').toString());
+    return match ? { time: match[1], id: parseInt(match[2]) } : null;
+}
+
 app.get('/orders', async (req, res) => {
     try {
-        const { passengerName, passengerId } = req.query;
+        const { passengerName, passengerId, cursor, direction = 'after' } = req.query;
+        const paged = req.query.limit !== undefined;
+        const limit = parseInt(req.query.limit);
+        
+        // 输入验证
+        if (paged && !(limit > 0 && limit <= MAX_ORDER_PAGE_SIZE)) {
+            return sendError(res, `limit 必须在 1 到 ${MAX_ORDER_PAGE_SIZE} 之间`, 400);
+        }
+        if (paged && direction !== 'after' && direction !== 'before') {
+            return sendError(res, 'direction 只能是 after 或 before', 400);
+        }
+        const position = cursor ? decodeOrderCursor(cursor) : null;
+        if (cursor && !position) {
+            return sendError(res, '无效的游标', 400);
+        }
         
         let query = `
             SELECT 
                 o.id, o.schedule_id, o.from_station, o.to_station,
                 o.seat_type, o.passenger_name, o.passenger_id, o.price, o.status, o.created_at,
+                DATE_FORMAT(o.created_at, '%Y-%m-%d %H:%i:%s') as cursor_time,
                 t.name as train_name, ts.departure_date,
                 ts_from.departure_time as departure_time,
                 sa.seat_id, s.seat_number, c.carriage_number
@@ -859,9 +1034,26 @@ app.get('/orders', async (req, res) => {
             params.push(passengerId);
         }
         
-        query += ' ORDER BY o.created_at DESC';
+        const newer = paged && direction === 'before';
+        if (paged && position) {
+            query += newer
+                ? ' AND (o.created_at > ? OR (o.created_at = ? AND o.id > ?))'
+                : ' AND (o.created_at < ? OR (o.created_at = ? AND o.id < ?))';
+            params.push(position.time, position.time, position.id);
+        }
         
-        const [rows] = await pool.execute(query, params);
+        // 向前翻页时正序取离游标最近的一页，再反转回倒序；多取一行判断是否还有下一页
+        query += newer ? ' ORDER BY o.created_at ASC, o.id ASC' : ' ORDER BY o.created_at DESC, o.id DESC';
+        if (paged) {
+            query += ` LIMIT ${limit + 1}`;
+        }
+        
+        const [result] = await pool.execute(query, params);
+        const hasMore = paged && result.length > limit;
+        const rows = paged ? result.slice(0, limit) : result;
+        if (newer) {
+            rows.reverse();
+        }
         
         // 整理数据格式
         const orders = rows.map(row => ({
@@ -881,7 +1073,16 @@ app.get('/orders', async (req, res) => {
             createdAt: row.created_at
         }));
         
-        sendSuccess(res, orders, '查询订单成功');
+        if (!paged) {
+            return sendSuccess(res, orders, '查询订单成功');
+        }
+        
+        sendSuccess(res, {
+            orders,
+            firstCursor: rows.length > 0 ? encodeOrderCursor(rows[0]) : null,
+            lastCursor: rows.length > 0 ? encodeOrderCursor(rows[rows.length - 1]) : null,
+            hasMore
+        }, '查询订单成功');
         
     } catch (error) {
         console.error('查询订单失败:', error);
@@ -904,7 +1105,7 @@ app.delete('/orders/:orderId', async (req, res) => {
         
         // 检查订单是否存在且未删除
         const [orderRows] = await connection.execute(`
-            SELECT id, status FROM orders 
+            SELECT id, status, schedule_id FROM orders 
             WHERE id = ? AND is_deleted = FALSE
         `, [orderId]);
         
@@ -928,6 +1129,7 @@ app.delete('/orders/:orderId', async (req, res) => {
         `, [orderId]);
         
         await connection.commit();
+        notifyAvailabilityChanged(orderRows[0].schedule_id);
         
         sendSuccess(res, { orderId: parseInt(orderId) }, '订单取消成功');
         
@@ -1007,6 +1209,9 @@ app.put('/orders/:orderId/restore', async (req, res) => {
         `, [orderId]);
         
         await connection.commit();
+        for (const seat of seatRows) {
+            notifyAvailabilityChanged(seat.schedule_id);
+        }
         
         sendSuccess(res, { orderId: parseInt(orderId) }, '订单恢复成功');
         
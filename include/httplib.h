@@ -157,6 +157,41 @@
 #define CPPHTTPLIB_COMPRESSION_BUFSIZ size_t(16384u)
 #endif
 
+#ifndef CPPHTTPLIB_COMPRESSION_MIN_SIZE
+#define CPPHTTPLIB_COMPRESSION_MIN_SIZE size_t(0u)
+#endif
+
+#ifndef CPPHTTPLIB_COMPRESSION_PROBE_INTERVAL
+#define CPPHTTPLIB_COMPRESSION_PROBE_INTERVAL 64
+#endif
+
+#ifndef CPPHTTPLIB_TRACE_EVENTS_PER_THREAD
+#define CPPHTTPLIB_TRACE_EVENTS_PER_THREAD 8192
+#endif
+
+#ifndef CPPHTTPLIB_TRACE_CAPTURE_MAX_SECOND
+#define CPPHTTPLIB_TRACE_CAPTURE_MAX_SECOND 10
+#endif
+
+#ifndef CPPHTTPLIB_REQUEST_STAGES_MAX
+#define CPPHTTPLIB_REQUEST_STAGES_MAX 32
+#endif
+
+#ifndef CPPHTTPLIB_RECORDING_MAX_BACKLOG
+#define CPPHTTPLIB_RECORDING_MAX_BACKLOG size_t(64u * 1024u * 1024u)
+#endif
+
+#ifdef CPPHTTPLIB_LOCK_PROFILING
+#if defined(__GNUC__) || defined(__clang__) ||                                 \
+    (defined(_MSC_VER) && _MSC_VER >= 1926)
+#define CPPHTTPLIB_CALLER_FILE __builtin_FILE()
+#define CPPHTTPLIB_CALLER_LINE __builtin_LINE()
+#else
+#define CPPHTTPLIB_CALLER_FILE "unknown"
+#define CPPHTTPLIB_CALLER_LINE 0
+#endif
+#endif
+
 #ifndef CPPHTTPLIB_THREAD_POOL_COUNT
 #define CPPHTTPLIB_THREAD_POOL_COUNT                                           \
   ((std::max)(8u, std::thread::hardware_concurrency() > 0                      \
@@ -180,6 +215,14 @@
 #define CPPHTTPLIB_MAX_LINE_LENGTH 32768
 #endif
 
+#ifndef CPPHTTPLIB_MOUNT_CACHE_MAX_FILE_SIZE
+#define CPPHTTPLIB_MOUNT_CACHE_MAX_FILE_SIZE size_t(1048576u)
+#endif
+
+#ifndef CPPHTTPLIB_SENDFILE_THRESHOLD
+#define CPPHTTPLIB_SENDFILE_THRESHOLD size_t(65536u)
+#endif
+
 /*
  * Headers
  */
@@ -252,6 +295,7 @@ using socklen_t = int;
 #include <netinet/in.h>
 #ifdef __linux__
 #include <resolv.h>
+#include <sys/sendfile.h>
 #endif
 #include <csignal>
 #include <netinet/tcp.h>
@@ -259,6 +303,7 @@ using socklen_t = int;
 #include <pthread.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -279,7 +324,9 @@ using socket_t = int;
 #include <cctype>
 #include <climits>
 #include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <errno.h>
 #include <exception>
 #include <fcntl.h>
@@ -368,6 +415,10 @@ using socket_t = int;
 #include <zstd.h>
 #endif
 
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+#include <string_view>
+#endif
+
 /*
  * Declaration
  */
@@ -422,13 +473,16 @@ inline unsigned char to_lower(int c) {
   return table[(unsigned char)(char)c];
 }
 
-inline bool equal(const std::string &a, const std::string &b) {
-  return a.size() == b.size() &&
-         std::equal(a.begin(), a.end(), b.begin(), [](char ca, char cb) {
+inline bool equal(const char *a, size_t al, const char *b, size_t bl) {
+  return al == bl && std::equal(a, a + al, b, [](char ca, char cb) {
            return to_lower(ca) == to_lower(cb);
          });
 }
 
+inline bool equal(const std::string &a, const std::string &b) {
+  return equal(a.data(), a.size(), b.data(), b.size());
+}
+
 struct equal_to {
   bool operator()(const std::string &a, const std::string &b) const {
     return equal(a, b);
@@ -455,8 +509,52 @@ template <typename T>
 using unordered_set = std::unordered_set<T, detail::case_ignore::hash,
                                          detail::case_ignore::equal_to>;
 
+// Same value as `hash` for ASCII input, which is all a header name can hold,
+// but usable in constant expressions.
+inline constexpr size_t token_hash_core(const char *s, size_t l, size_t h) {
+  return (l == 0)
+             ? h
+             : token_hash_core(
+                   s + 1, l - 1,
+                   (((std::numeric_limits<size_t>::max)() >> 6) & h * 33) ^
+                       static_cast<unsigned char>(
+                           (*s >= 'A' && *s <= 'Z') ? *s + ('a' - 'A') : *s));
+}
+
+inline constexpr size_t token_hash(const char *s, size_t l) {
+  return token_hash_core(s, l, 0);
+}
+
 } // namespace case_ignore
 
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+/*
+ * A request header stored as offsets into `Request::header_block_`, so that
+ * copying a Request never leaves a field pointing into someone else's buffer.
+ */
+struct HeaderField {
+  size_t hash = 0; // case_ignore::token_hash of the name
+  uint32_t name_offset = 0;
+  uint32_t name_length = 0;
+  uint32_t value_offset = 0;
+  uint32_t value_length = 0;
+};
+
+using HeaderFields = std::vector<HeaderField>;
+
+// Headers consulted by the server on every request. Their hashes are computed
+// at compile time and their positions are cached while parsing.
+enum class KnownHeader { ContentLength = 0, Connection, ContentType, Count };
+
+constexpr const char *known_header_names[] = {"Content-Length", "Connection",
+                                              "Content-Type"};
+
+constexpr size_t known_header_hashes[] = {
+    case_ignore::token_hash("Content-Length", 14),
+    case_ignore::token_hash("Connection", 10),
+    case_ignore::token_hash("Content-Type", 12)};
+#endif
+
 // This is based on
 // "http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2014/n4189".
 
@@ -749,6 +847,16 @@ struct Request {
   size_t get_header_value_count(const std::string &key) const;
   void set_header(const std::string &key, const std::string &val);
 
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+  // Received headers are not copied into `headers`; they are only reachable
+  // through the accessors above and the views below.
+  std::string_view get_header_value_view(const std::string &key,
+                                         size_t id = 0) const;
+  size_t header_field_count() const;
+  std::pair<std::string_view, std::string_view>
+  header_field(size_t index) const;
+#endif
+
   bool has_trailer(const std::string &key) const;
   std::string get_trailer_value(const std::string &key, size_t id = 0) const;
   size_t get_trailer_value_count(const std::string &key) const;
@@ -767,6 +875,15 @@ struct Request {
   size_t authorization_count_ = 0;
   std::chrono::time_point<std::chrono::steady_clock> start_time_ =
       (std::chrono::steady_clock::time_point::min)();
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+  std::string header_block_;
+  detail::HeaderFields header_fields_;
+  std::array<size_t, static_cast<size_t>(detail::KnownHeader::Count)>
+      known_header_index_ = {{SIZE_MAX, SIZE_MAX, SIZE_MAX}};
+
+  const detail::HeaderField *find_header_field(const std::string &key,
+                                               size_t &id) const;
+#endif
 };
 
 struct Response {
@@ -828,8 +945,10 @@ struct Response {
   ContentProviderResourceReleaser content_provider_resource_releaser_;
   bool is_chunked_content_provider_ = false;
   bool content_provider_success_ = false;
+  int compression_level_ = -1; // Chosen with the coding of a streamed body
   std::string file_content_path_;
   std::string file_content_content_type_;
+  int content_fd_ = -1; // File behind the content provider, for sendfile
 };
 
 class Stream {
@@ -848,6 +967,21 @@ public:
 
   virtual time_t duration() const = 0;
 
+  // While write batching is on, small writes may be held back and sent
+  // together with later ones; `flush` sends whatever is pending. Turning
+  // batching off flushes and returns false if pending bytes could not be
+  // sent. Streams that always write through leave these as no-ops.
+  virtual bool write_batching() const { return false; }
+  virtual bool set_write_batching(bool /*on*/) { return true; }
+  virtual bool flush() { return true; }
+
+  // Sends part of an open file without copying it through user space. Only
+  // plain sockets support this; callers fall back to `write` otherwise.
+  virtual bool can_send_file() const { return false; }
+  virtual ssize_t send_file(int /*fd*/, size_t /*offset*/, size_t /*size*/) {
+    return -1;
+  }
+
   ssize_t write(const char *ptr);
   ssize_t write(const std::string &s);
 };
@@ -863,6 +997,181 @@ public:
   virtual void on_idle() {}
 };
 
+/*
+ * Mutex for locks worth watching under load. Each one is named, and with
+ * CPPHTTPLIB_LOCK_PROFILING defined it records acquisitions, wait times and
+ * the call sites that waited, aggregated by name (see lock_profile()).
+ * Otherwise it is a plain std::mutex. Lock it with MutexLock, which
+ * captures the call site, and wait on it with ConditionVariable.
+ */
+#ifdef CPPHTTPLIB_LOCK_PROFILING
+namespace detail {
+struct LockStats;
+} // namespace detail
+
+class Mutex {
+public:
+  explicit Mutex(const char *name = "mutex");
+
+  Mutex(const Mutex &) = delete;
+  Mutex &operator=(const Mutex &) = delete;
+
+  void lock(const char *file = CPPHTTPLIB_CALLER_FILE,
+            int line = CPPHTTPLIB_CALLER_LINE);
+  bool try_lock();
+  void unlock() { mutex_.unlock(); }
+
+private:
+  std::mutex mutex_;
+  std::shared_ptr<detail::LockStats> stats_;
+};
+
+class MutexLock {
+public:
+  explicit MutexLock(Mutex &mutex, const char *file = CPPHTTPLIB_CALLER_FILE,
+                     int line = CPPHTTPLIB_CALLER_LINE)
+      : mutex_(mutex), file_(file), line_(line) {
+    lock();
+  }
+  ~MutexLock() {
+    if (owns_) { mutex_.unlock(); }
+  }
+
+  MutexLock(const MutexLock &) = delete;
+  MutexLock &operator=(const MutexLock &) = delete;
+
+  // Relocking after a condition variable wait counts against the same site
+  void lock() {
+    mutex_.lock(file_, line_);
+    owns_ = true;
+  }
+  void unlock() {
+    mutex_.unlock();
+    owns_ = false;
+  }
+  bool owns_lock() const { return owns_; }
+
+private:
+  Mutex &mutex_;
+  const char *file_;
+  int line_;
+  bool owns_ = false;
+};
+
+using ConditionVariable = std::condition_variable_any;
+#else
+class Mutex : public std::mutex {
+public:
+  explicit Mutex(const char * /*name*/ = nullptr) {}
+};
+
+using MutexLock = std::unique_lock<std::mutex>;
+using ConditionVariable = std::condition_variable;
+#endif
+
+namespace detail {
+class MemoryRegistry;
+} // namespace detail
+
+/*
+ * Named memory counter. Containers opt in by allocating through
+ * TaggedAllocator; other owners charge and release bytes themselves.
+ * Tags live for the whole process and show up in memory_profile(). Units
+ * say how much data the bytes hold (e.g. seats), so the report can project
+ * the footprint for a different amount of data.
+ */
+class MemoryTag {
+public:
+  static MemoryTag &get(const std::string &name);
+
+  MemoryTag(const MemoryTag &) = delete;
+  MemoryTag &operator=(const MemoryTag &) = delete;
+
+  void charge(size_t bytes) {
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+    auto live = live_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    auto peak = peak_.load(std::memory_order_relaxed);
+    while (live > peak && !peak_.compare_exchange_weak(
+                              peak, live, std::memory_order_relaxed)) {}
+  }
+  void release(size_t bytes) {
+    live_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+  void add_units(int64_t n) { units_.fetch_add(n, std::memory_order_relaxed); }
+
+  const std::string &name() const { return name_; }
+  size_t live() const { return live_.load(std::memory_order_relaxed); }
+  size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+  uint64_t allocations() const {
+    return allocations_.load(std::memory_order_relaxed);
+  }
+  int64_t units() const { return units_.load(std::memory_order_relaxed); }
+
+private:
+  friend class detail::MemoryRegistry;
+  explicit MemoryTag(const std::string &name) : name_(name) {}
+
+  const std::string name_;
+  std::atomic<size_t> live_{0};
+  std::atomic<size_t> peak_{0};
+  std::atomic<uint64_t> allocations_{0};
+  std::atomic<int64_t> units_{0};
+};
+
+template <typename T> class TaggedAllocator {
+public:
+  using value_type = T;
+
+  explicit TaggedAllocator(MemoryTag &tag) : tag_(&tag) {}
+  template <typename U>
+  TaggedAllocator(const TaggedAllocator<U> &other) : tag_(other.tag_) {}
+
+  T *allocate(size_t n) {
+    auto p = std::allocator<T>().allocate(n);
+    tag_->charge(n * sizeof(T));
+    return p;
+  }
+  void deallocate(T *p, size_t n) {
+    tag_->release(n * sizeof(T));
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template <typename U>
+  bool operator==(const TaggedAllocator<U> &other) const {
+    return tag_ == other.tag_;
+  }
+  template <typename U>
+  bool operator!=(const TaggedAllocator<U> &other) const {
+    return tag_ != other.tag_;
+  }
+
+private:
+  template <typename U> friend class TaggedAllocator;
+  MemoryTag *tag_;
+};
+
+// Holds a charge against a tag until destroyed
+class MemoryCharge {
+public:
+  explicit MemoryCharge(MemoryTag &tag, size_t bytes = 0) : tag_(tag) {
+    set(bytes);
+  }
+  ~MemoryCharge() { set(0); }
+
+  MemoryCharge(const MemoryCharge &) = delete;
+  MemoryCharge &operator=(const MemoryCharge &) = delete;
+
+  void set(size_t bytes) {
+    if (bytes_) { tag_.release(bytes_); }
+    if (bytes) { tag_.charge(bytes); }
+    bytes_ = bytes;
+  }
+
+private:
+  MemoryTag &tag_;
+  size_t bytes_ = 0;
+};
+
 class ThreadPool final : public TaskQueue {
 public:
   explicit ThreadPool(size_t n, size_t mqr = 0)
@@ -878,7 +1187,7 @@ public:
 
   bool enqueue(std::function<void()> fn) override {
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      MutexLock lock(mutex_);
       if (max_queued_requests_ > 0 && jobs_.size() >= max_queued_requests_) {
         return false;
       }
@@ -892,7 +1201,7 @@ public:
   void shutdown() override {
     // Stop all worker threads...
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      MutexLock lock(mutex_);
       shutdown_ = true;
     }
 
@@ -912,7 +1221,7 @@ private:
       for (;;) {
         std::function<void()> fn;
         {
-          std::unique_lock<std::mutex> lock(pool_.mutex_);
+          MutexLock lock(pool_.mutex_);
 
           pool_.cond_.wait(
               lock, [&] { return !pool_.jobs_.empty() || pool_.shutdown_; });
@@ -943,8 +1252,8 @@ private:
   bool shutdown_;
   size_t max_queued_requests_ = 0;
 
-  std::condition_variable cond_;
-  std::mutex mutex_;
+  ConditionVariable cond_;
+  Mutex mutex_{"ThreadPool::mutex_"};
 };
 
 using Logger = std::function<void(const Request &, const Response &)>;
@@ -965,8 +1274,73 @@ void default_socket_options(socket_t sock);
 
 const char *status_message(int status);
 
+// Contention report for every httplib::Mutex, most waited-on first. Empty
+// unless built with CPPHTTPLIB_LOCK_PROFILING.
+std::string lock_profile();
+
+// Live and peak bytes for every MemoryTag. With units > 0, each tag that
+// reports units is also scaled to that many units.
+std::string memory_profile(int64_t units = 0);
+
 std::string get_bearer_token_auth(const Request &req);
 
+struct AdmissionClass {
+  std::string name;
+
+  // Requests that belong to this class: "/prefix" or "METHOD /prefix".
+  // Requests matching no class go to the last one.
+  std::vector<std::string> routes;
+
+  // Share of freed slots while several classes are waiting
+  size_t weight = 1;
+
+  // Arrivals beyond this many waiting requests are shed. The queue is further
+  // capped by the idle workers it may hold (see AdmissionControl).
+  size_t max_queue = 64;
+  std::chrono::milliseconds max_wait{1000};
+
+  // CoDel-style shedding: once the queueing delay has stayed above `target`
+  // for `interval`, waiting requests over the target are shed until the
+  // delay drops below it again. Classes that are not sheddable are only
+  // bounded by `max_queue` and `max_wait`.
+  bool sheddable = true;
+  std::chrono::milliseconds target{5};
+  std::chrono::milliseconds interval{100};
+};
+
+// A waiting request holds its worker, and connections that have no worker
+// yet wait in the task queue unclassified. So only half of the workers left
+// over by max_concurrency may wait; the rest keep reading and shedding new
+// requests. Class i of n may use (n - i) / n of those waiting slots, which
+// keeps the last ones for higher priority classes, and when they are all
+// taken it evicts the oldest waiter of a lower priority class. A request that
+// finds no free slot and no room to wait is shed at once.
+struct AdmissionControl {
+  // Worker threads in the server's task queue; 0 for
+  // CPPHTTPLIB_THREAD_POOL_COUNT. Set it when new_task_queue builds a pool of
+  // another size.
+  size_t worker_count = 0;
+
+  // Handlers allowed to run at once; 0 for half the workers. Keep it below
+  // the worker count so idle workers are left to read and classify new
+  // requests.
+  size_t max_concurrency = 0;
+
+  // Highest priority first
+  std::vector<AdmissionClass> classes;
+
+  // Overrides `routes` when set; returns an index into `classes`
+  std::function<size_t(const Request &)> classify;
+};
+
+struct AdmissionClassStats {
+  std::string name;
+  uint64_t admitted = 0;
+  uint64_t shed = 0;
+  size_t queued = 0;
+  double queue_delay_ms = 0; // Moving average
+};
+
 namespace detail {
 
 class MatcherBase {
@@ -1043,6651 +1417,9810 @@ private:
 
 ssize_t write_headers(Stream &strm, const Headers &headers);
 
-} // namespace detail
+enum class EncodingType { None = 0, Gzip, Brotli, Zstd };
 
-class Server {
+struct CachedAsset {
+  struct Variant {
+    std::string content_encoding;
+    std::string data;
+    std::string etag;
+  };
+
+  std::string data;
+  std::string content_type;
+  std::string etag;
+  std::string last_modified;
+  std::vector<Variant> variants; // Smallest first
+};
+
+class AdmissionController {
 public:
-  using Handler = std::function<void(const Request &, Response &)>;
+  explicit AdmissionController(AdmissionControl config);
 
-  using ExceptionHandler =
-      std::function<void(const Request &, Response &, std::exception_ptr ep)>;
+  size_t classify(const Request &req) const;
 
-  enum class HandlerResponse {
-    Handled,
-    Unhandled,
-  };
-  using HandlerWithResponse =
-      std::function<HandlerResponse(const Request &, Response &)>;
+  // Blocks until a request of class `cls` may run. Returns false if it has
+  // been shed instead, with a suggested Retry-After.
+  bool acquire(size_t cls, time_t &retry_after_sec);
+  void release();
 
-  using HandlerWithContentReader = std::function<void(
-      const Request &, Response &, const ContentReader &content_reader)>;
+  std::vector<AdmissionClassStats> stats() const;
 
-  using Expect100ContinueHandler =
-      std::function<int(const Request &, Response &)>;
+private:
+  struct Waiter {
+    ConditionVariable cv;
+    std::chrono::steady_clock::time_point enqueued;
+    enum class State { Waiting, Admitted, Shed } state = State::Waiting;
+  };
 
-  Server();
+  struct ClassState {
+    std::list<Waiter *> queue;
+    int64_t current_weight = 0;
+    std::chrono::steady_clock::time_point first_above_time{};
+    bool dropping = false;
+    double queue_delay_ms = 0;
+    uint64_t admitted = 0;
+    uint64_t shed = 0;
+  };
 
-  virtual ~Server();
+  void grant();
+  bool should_drop(size_t cls, std::chrono::steady_clock::duration sojourn,
+                   std::chrono::steady_clock::time_point now);
+  time_t retry_after(size_t cls) const;
+
+  size_t wait_limit(size_t cls) const;
+  bool evict_below(size_t cls);
+
+  const AdmissionControl config_;
+  const size_t max_concurrency_;
+  const size_t max_waiting_;
+  mutable Mutex mutex_{"AdmissionController::mutex_"};
+  size_t running_ = 0;
+  size_t waiting_ = 0;
+  std::vector<ClassState> classes_;
+};
 
-  virtual bool is_valid() const;
+// One instance of T per thread that touches it, owned by this object. The
+// owning thread finds its instance without locking; `for_each` visits all of
+// them for aggregation.
+template <typename T> class PerThread {
+public:
+  PerThread() : id_(next_id()) {}
 
-  Server &Get(const std::string &pattern, Handler handler);
-  Server &Post(const std::string &pattern, Handler handler);
-  Server &Post(const std::string &pattern, HandlerWithContentReader handler);
-  Server &Put(const std::string &pattern, Handler handler);
-  Server &Put(const std::string &pattern, HandlerWithContentReader handler);
-  Server &Patch(const std::string &pattern, Handler handler);
-  Server &Patch(const std::string &pattern, HandlerWithContentReader handler);
-  Server &Delete(const std::string &pattern, Handler handler);
-  Server &Delete(const std::string &pattern, HandlerWithContentReader handler);
-  Server &Options(const std::string &pattern, Handler handler);
+  T &local() {
+    // A thread usually serves a single Server, so the last instance is
+    // cached in front of the per-thread table
+    thread_local uint64_t last_id = 0;
+    thread_local T *last = nullptr;
+    if (last_id == id_) { return *last; }
 
-  bool set_base_dir(const std::string &dir,
-                    const std::string &mount_point = std::string());
-  bool set_mount_point(const std::string &mount_point, const std::string &dir,
-                       Headers headers = Headers());
-  bool remove_mount_point(const std::string &mount_point);
-  Server &set_file_extension_and_mimetype_mapping(const std::string &ext,
-                                                  const std::string &mime);
-  Server &set_default_file_mimetype(const std::string &mime);
-  Server &set_file_request_handler(Handler handler);
+    thread_local std::unordered_map<uint64_t, T *> table;
+    auto &item = table[id_];
+    if (!item) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      items_.push_back(detail::make_unique<T>());
+      item = items_.back().get();
+    }
 
-  template <class ErrorHandlerFunc>
-  Server &set_error_handler(ErrorHandlerFunc &&handler) {
-    return set_error_handler_core(
-        std::forward<ErrorHandlerFunc>(handler),
-        std::is_convertible<ErrorHandlerFunc, HandlerWithResponse>{});
+    last_id = id_;
+    last = item;
+    return *item;
   }
 
-  Server &set_exception_handler(ExceptionHandler handler);
-
-  Server &set_pre_routing_handler(HandlerWithResponse handler);
-  Server &set_post_routing_handler(Handler handler);
+  template <typename Fn> void for_each(Fn fn) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (const auto &item : items_) {
+      fn(static_cast<const T &>(*item));
+    }
+  }
 
-  Server &set_pre_request_handler(HandlerWithResponse handler);
+private:
+  static uint64_t next_id() {
+    static std::atomic<uint64_t> id{1};
+    return id++;
+  }
 
-  Server &set_expect_100_continue_handler(Expect100ContinueHandler handler);
-  Server &set_logger(Logger logger);
-  Server &set_pre_compression_logger(Logger logger);
+  const uint64_t id_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<T>> items_;
+};
 
-  Server &set_address_family(int family);
-  Server &set_tcp_nodelay(bool on);
-  Server &set_ipv6_v6only(bool on);
-  Server &set_socket_options(SocketOptions socket_options);
+// Log-linear latency histogram in microseconds with 8 sub-buckets per power
+// of two (12.5% precision), in the manner of HdrHistogram. Each instance has
+// a single writer, so recording needs no atomic read-modify-write.
+class LatencyHistogram {
+public:
+  static const size_t bucket_count = 312;
 
-  Server &set_default_headers(Headers headers);
-  Server &
-  set_header_writer(std::function<ssize_t(Stream &, Headers &)> const &writer);
+  void record(uint64_t usec);
+  void merge_into(std::vector<uint64_t> &buckets, uint64_t &count,
+                  uint64_t &sum_usec) const;
 
-  Server &set_keep_alive_max_count(size_t count);
-  Server &set_keep_alive_timeout(time_t sec);
+  static size_t bucket_index(uint64_t usec);
+  static uint64_t bucket_upper_bound(size_t index);
 
-  Server &set_read_timeout(time_t sec, time_t usec = 0);
-  template <class Rep, class Period>
-  Server &set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
+private:
+  std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_usec_{0};
+};
 
-  Server &set_write_timeout(time_t sec, time_t usec = 0);
-  template <class Rep, class Period>
-  Server &set_write_timeout(const std::chrono::duration<Rep, Period> &duration);
+// Request, task queue, byte and connection metrics for a Server. Every worker
+// thread writes to its own shard; shards are merged when scraped.
+class ServerMetrics {
+public:
+  void record_request(const Request &req, int status, uint64_t usec);
+  void record_queue_wait(uint64_t usec);
+  void add_bytes_in(size_t n);
+  void add_bytes_out(size_t n);
+  void connection_opened();
+  void connection_closed();
 
-  Server &set_idle_interval(time_t sec, time_t usec = 0);
-  template <class Rep, class Period>
-  Server &set_idle_interval(const std::chrono::duration<Rep, Period> &duration);
+  template <typename T> bool measure(Stream &strm, T process);
 
-  Server &set_payload_max_length(size_t length);
+  std::string render(const std::string &extra) const;
 
-  bool bind_to_port(const std::string &host, int port, int socket_flags = 0);
-  int bind_to_any_port(const std::string &host, int socket_flags = 0);
-  bool listen_after_bind();
+private:
+  struct Series {
+    std::string method;
+    std::string route;
+    int status = 0;
+    LatencyHistogram latency;
+  };
 
-  bool listen(const std::string &host, int port, int socket_flags = 0);
+  struct Shard {
+    mutable std::mutex mutex; // Guards `series` inserts against scrapes
+    std::unordered_map<std::string, std::unique_ptr<Series>> series;
+    LatencyHistogram queue_wait;
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<int64_t> live{0};
+    std::atomic<int64_t> active{0};
+  };
 
-  bool is_running() const;
-  void wait_until_ready() const;
-  void stop();
-  void decommission();
+  Shard &local_shard() { return shards_.local(); }
 
-  std::function<TaskQueue *(void)> new_task_queue;
+  PerThread<Shard> shards_;
+};
 
-protected:
-  bool process_request(Stream &strm, const std::string &remote_addr,
-                       int remote_port, const std::string &local_addr,
-                       int local_port, bool close_connection,
-                       bool &connection_closed,
-                       const std::function<void(Request &)> &setup_request);
+class AssetCache {
+public:
+  explicit AssetCache(bool precompress) : precompress_(precompress) {}
 
-  std::atomic<socket_t> svr_sock_{INVALID_SOCKET};
-  size_t keep_alive_max_count_ = CPPHTTPLIB_KEEPALIVE_MAX_COUNT;
-  time_t keep_alive_timeout_sec_ = CPPHTTPLIB_KEEPALIVE_TIMEOUT_SECOND;
-  time_t read_timeout_sec_ = CPPHTTPLIB_SERVER_READ_TIMEOUT_SECOND;
-  time_t read_timeout_usec_ = CPPHTTPLIB_SERVER_READ_TIMEOUT_USECOND;
-  time_t write_timeout_sec_ = CPPHTTPLIB_SERVER_WRITE_TIMEOUT_SECOND;
-  time_t write_timeout_usec_ = CPPHTTPLIB_SERVER_WRITE_TIMEOUT_USECOND;
-  time_t idle_interval_sec_ = CPPHTTPLIB_IDLE_INTERVAL_SECOND;
-  time_t idle_interval_usec_ = CPPHTTPLIB_IDLE_INTERVAL_USECOND;
-  size_t payload_max_length_ = CPPHTTPLIB_PAYLOAD_MAX_LENGTH;
+  std::shared_ptr<const CachedAsset> find(const std::string &path) const;
+  std::shared_ptr<const CachedAsset> load(const std::string &path,
+                                          const std::string &content_type);
 
 private:
-  using Handlers =
-      std::vector<std::pair<std::unique_ptr<detail::MatcherBase>, Handler>>;
-  using HandlersForContentReader =
-      std::vector<std::pair<std::unique_ptr<detail::MatcherBase>,
-                            HandlerWithContentReader>>;
+  void add_variants(const std::string &path, CachedAsset &asset) const;
 
-  static std::unique_ptr<detail::MatcherBase>
-  make_matcher(const std::string &pattern);
+  const bool precompress_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const CachedAsset>> assets_;
+};
 
-  Server &set_error_handler_core(HandlerWithResponse handler, std::true_type);
-  Server &set_error_handler_core(Handler handler, std::false_type);
-
-  socket_t create_server_socket(const std::string &host, int port,
-                                int socket_flags,
-                                SocketOptions socket_options) const;
-  int bind_internal(const std::string &host, int port, int socket_flags);
-  bool listen_internal();
-
-  bool routing(Request &req, Response &res, Stream &strm);
-  bool handle_file_request(const Request &req, Response &res);
-  bool dispatch_request(Request &req, Response &res,
-                        const Handlers &handlers) const;
-  bool dispatch_request_for_content_reader(
-      Request &req, Response &res, ContentReader content_reader,
-      const HandlersForContentReader &handlers) const;
-
-  bool parse_request_line(const char *s, Request &req) const;
-  void apply_ranges(const Request &req, Response &res,
-                    std::string &content_type, std::string &boundary) const;
-  bool write_response(Stream &strm, bool close_connection, Request &req,
-                      Response &res);
-  bool write_response_with_content(Stream &strm, bool close_connection,
-                                   const Request &req, Response &res);
-  bool write_response_core(Stream &strm, bool close_connection,
-                           const Request &req, Response &res,
-                           bool need_apply_ranges);
-  bool write_content_with_provider(Stream &strm, const Request &req,
-                                   Response &res, const std::string &boundary,
-                                   const std::string &content_type);
-  bool read_content(Stream &strm, Request &req, Response &res);
-  bool read_content_with_content_receiver(Stream &strm, Request &req,
-                                          Response &res,
-                                          ContentReceiver receiver,
-                                          FormDataHeader multipart_header,
-                                          ContentReceiver multipart_receiver);
-  bool read_content_core(Stream &strm, Request &req, Response &res,
-                         ContentReceiver receiver,
-                         FormDataHeader multipart_header,
-                         ContentReceiver multipart_receiver) const;
-
-  virtual bool process_and_close_socket(socket_t sock);
-
-  std::atomic<bool> is_running_{false};
-  std::atomic<bool> is_decommissioned{false};
-
-  struct MountPointEntry {
-    std::string mount_point;
-    std::string base_dir;
-    Headers headers;
+#ifdef CPPHTTPLIB_LOCK_PROFILING
+// Contention of all the httplib::Mutex instances sharing a name. Uncontended
+// acquisitions only bump a counter; the rest is updated under `mutex` after
+// a wait.
+struct LockStats {
+  explicit LockStats(std::string n) : name(std::move(n)) {}
+
+  struct Site {
+    const char *file;
+    int line;
+    uint64_t waits;
+    uint64_t wait_ns;
   };
-  std::vector<MountPointEntry> base_dirs_;
-  std::map<std::string, std::string> file_extension_and_mimetype_map_;
-  std::string default_file_mimetype_ = "application/octet-stream";
-  Handler file_request_handler_;
 
-  Handlers get_handlers_;
-  Handlers post_handlers_;
-  HandlersForContentReader post_handlers_for_content_reader_;
-  Handlers put_handlers_;
-  HandlersForContentReader put_handlers_for_content_reader_;
-  Handlers patch_handlers_;
-  HandlersForContentReader patch_handlers_for_content_reader_;
-  Handlers delete_handlers_;
-  HandlersForContentReader delete_handlers_for_content_reader_;
-  Handlers options_handlers_;
+  void record_wait(const char *file, int line,
+                   std::chrono::steady_clock::duration wait);
 
-  HandlerWithResponse error_handler_;
-  ExceptionHandler exception_handler_;
-  HandlerWithResponse pre_routing_handler_;
-  Handler post_routing_handler_;
-  HandlerWithResponse pre_request_handler_;
-  Expect100ContinueHandler expect_100_continue_handler_;
+  const std::string name;
+  std::atomic<uint64_t> acquisitions{0};
+  std::mutex mutex;
+  uint64_t waits = 0;
+  uint64_t wait_ns = 0;
+  LatencyHistogram wait_histogram; // In nanoseconds
+  std::vector<Site> sites;
+};
 
-  Logger logger_;
-  Logger pre_compression_logger_;
+class LockRegistry {
+public:
+  static LockRegistry &instance();
 
-  int address_family_ = AF_UNSPEC;
-  bool tcp_nodelay_ = CPPHTTPLIB_TCP_NODELAY;
-  bool ipv6_v6only_ = CPPHTTPLIB_IPV6_V6ONLY;
-  SocketOptions socket_options_ = default_socket_options;
+  std::shared_ptr<LockStats> stats(const char *name);
+  std::string report() const;
 
-  Headers default_headers_;
-  std::function<ssize_t(Stream &, Headers &)> header_writer_ =
-      detail::write_headers;
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<LockStats>> stats_;
 };
+#endif
 
-enum class Error {
-  Success = 0,
-  Unknown,
-  Connection,
-  BindIPAddress,
-  Read,
-  Write,
-  ExceedRedirectCount,
-  Canceled,
-  SSLConnection,
-  SSLLoadingCerts,
-  SSLServerVerification,
-  SSLServerHostnameVerification,
-  UnsupportedMultipartBoundaryChars,
-  Compression,
-  ConnectionTimeout,
-  ProxyConnection,
+class MemoryRegistry {
+public:
+  static MemoryRegistry &instance();
 
-  // For internal use only
-  SSLPeerCouldBeClosed_,
+  MemoryTag &tag(const std::string &name);
+  std::string report(int64_t units) const;
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<MemoryTag>> tags_;
 };
 
-std::string to_string(Error error);
+// Tags charged for every connection and request, looked up once rather than
+// through the registry lock each time
+inline MemoryTag &connection_buffers_tag() {
+  static auto &tag = MemoryTag::get("httplib.connection_buffers");
+  return tag;
+}
 
-std::ostream &operator<<(std::ostream &os, const Error &obj);
+inline MemoryTag &request_bodies_tag() {
+  static auto &tag = MemoryTag::get("httplib.request_bodies");
+  return tag;
+}
 
-class Result {
+// Appends requests to a log file (see read_request_log for the format).
+// Request threads only encode into memory; a writer thread does the I/O.
+// Once CPPHTTPLIB_RECORDING_MAX_BACKLOG bytes are waiting, further requests
+// are dropped rather than slowing the server down.
+class RequestRecorder {
 public:
-  Result() = default;
-  Result(std::unique_ptr<Response> &&res, Error err,
-         Headers &&request_headers = Headers{})
-      : res_(std::move(res)), err_(err),
-        request_headers_(std::move(request_headers)) {}
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  Result(std::unique_ptr<Response> &&res, Error err, Headers &&request_headers,
-         int ssl_error)
-      : res_(std::move(res)), err_(err),
-        request_headers_(std::move(request_headers)), ssl_error_(ssl_error) {}
-  Result(std::unique_ptr<Response> &&res, Error err, Headers &&request_headers,
-         int ssl_error, unsigned long ssl_openssl_error)
-      : res_(std::move(res)), err_(err),
-        request_headers_(std::move(request_headers)), ssl_error_(ssl_error),
-        ssl_openssl_error_(ssl_openssl_error) {}
-#endif
-  // Response
-  operator bool() const { return res_ != nullptr; }
-  bool operator==(std::nullptr_t) const { return res_ == nullptr; }
-  bool operator!=(std::nullptr_t) const { return res_ != nullptr; }
-  const Response &value() const { return *res_; }
-  Response &value() { return *res_; }
-  const Response &operator*() const { return *res_; }
-  Response &operator*() { return *res_; }
-  const Response *operator->() const { return res_.get(); }
-  Response *operator->() { return res_.get(); }
+  explicit RequestRecorder(std::FILE *fp);
+  ~RequestRecorder();
 
-  // Error
-  Error error() const { return err_; }
+  RequestRecorder(const RequestRecorder &) = delete;
+  RequestRecorder &operator=(const RequestRecorder &) = delete;
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  // SSL Error
-  int ssl_error() const { return ssl_error_; }
-  // OpenSSL Error
-  unsigned long ssl_openssl_error() const { return ssl_openssl_error_; }
-#endif
+  uint64_t next_connection_id() { return ++connection_id_; }
 
-  // Request Headers
-  bool has_request_header(const std::string &key) const;
-  std::string get_request_header_value(const std::string &key,
-                                       const char *def = "",
-                                       size_t id = 0) const;
-  size_t get_request_header_value_u64(const std::string &key, size_t def = 0,
-                                      size_t id = 0) const;
-  size_t get_request_header_value_count(const std::string &key) const;
+  void record(std::chrono::steady_clock::time_point arrival,
+              uint64_t connection, const Request &req);
 
 private:
-  std::unique_ptr<Response> res_;
-  Error err_ = Error::Unknown;
-  Headers request_headers_;
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  int ssl_error_ = 0;
-  unsigned long ssl_openssl_error_ = 0;
-#endif
+  void run();
+
+  std::FILE *fp_;
+  const std::chrono::steady_clock::time_point start_;
+  std::atomic<uint64_t> connection_id_{0};
+  Mutex mutex_{"RequestRecorder::mutex_"};
+  ConditionVariable cv_;
+  std::string pending_;
+  bool stop_ = false;
+  std::thread writer_;
 };
 
-class ClientImpl {
-public:
-  explicit ClientImpl(const std::string &host);
+// Id of the connection being served on this thread, for the recorder
+inline uint64_t &recording_connection() {
+  thread_local uint64_t id = 0;
+  return id;
+}
 
-  explicit ClientImpl(const std::string &host, int port);
+struct TraceEvent {
+  const char *name = nullptr; // nullptr marks an unused slot
+  uint64_t request_id = 0;
+  int64_t start_ns = 0; // Since the tracer was created
+  int64_t dur_ns = 0;
+  char detail[64] = {};
+};
 
-  explicit ClientImpl(const std::string &host, int port,
-                      const std::string &client_cert_path,
-                      const std::string &client_key_path);
+// Ring buffers of request stage timings, one per worker thread, merged into
+// the Chrome trace_event format when dumped. Recording only happens while
+// enabled, and takes no lock.
+class StageTracer {
+public:
+  explicit StageTracer(size_t events_per_thread);
 
-  virtual ~ClientImpl();
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void set_enabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
 
-  virtual bool is_valid() const;
+  uint64_t next_request_id() { return ++request_id_; }
 
-  // clang-format off
-  Result Get(const std::string &path, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Params &params, const Headers &headers, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Params &params, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Params &params, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  void record(const char *name, uint64_t request_id,
+              std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end,
+              const std::string &detail = std::string());
 
-  Result Head(const std::string &path);
-  Result Head(const std::string &path, const Headers &headers);
+  std::string to_json(std::chrono::steady_clock::time_point since) const;
 
-  Result Post(const std::string &path);
-  Result Post(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Params &params);
-  Result Post(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers);
-  Result Post(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const Params &params);
-  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+private:
+  // A seqlock: `seq` is odd while the owning thread rewrites the event, so a
+  // dump skips the slots it catches mid-write
+  struct Slot {
+    std::atomic<uint32_t> seq{0};
+    TraceEvent event;
+  };
 
-  Result Put(const std::string &path);
-  Result Put(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Params &params);
-  Result Put(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers);
-  Result Put(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const Params &params);
-  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  // Written only by its own thread. `slots` is published once allocated.
+  struct Ring {
+    std::unique_ptr<Slot[]> storage;
+    std::atomic<Slot *> slots{nullptr};
+    size_t next = 0;
+    uint32_t tid = 0;
+  };
 
-  Result Patch(const std::string &path);
-  Result Patch(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Params &params);
-  Result Patch(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const Params &params);
-  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  const size_t capacity_;
+  const std::chrono::steady_clock::time_point epoch_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> request_id_{0};
+  std::atomic<uint32_t> tid_{0};
+  PerThread<Ring> rings_;
+};
 
-  Result Delete(const std::string &path, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Params &params, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, const Params &params, DownloadProgress progress = nullptr);
+// Stage timings and annotations of one request, kept for the slow-request
+// log until the request is known to be slow or sampled
+struct RequestStages {
+  struct Stage {
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration duration;
+  };
 
-  Result Options(const std::string &path);
-  Result Options(const std::string &path, const Headers &headers);
-  // clang-format on
+  void clear() {
+    count = 0;
+    fields.clear();
+  }
 
-  bool send(Request &req, Response &res, Error &error);
-  Result send(const Request &req);
+  Stage stages[CPPHTTPLIB_REQUEST_STAGES_MAX];
+  size_t count = 0;
+  std::vector<std::pair<std::string, std::string>> fields;
+};
 
-  void stop();
+// The traced request being processed on this thread, if any. Stages go to
+// the tracer, the slow-request log, or both.
+struct TraceContext {
+  StageTracer *tracer = nullptr;
+  uint64_t request_id = 0;
+  RequestStages *stages = nullptr;
 
-  std::string host() const;
-  int port() const;
-
-  size_t is_socket_open() const;
-  socket_t socket() const;
-
-  void set_hostname_addr_map(std::map<std::string, std::string> addr_map);
+  bool active() const { return tracer || stages; }
 
-  void set_default_headers(Headers headers);
+  void record(const char *name, std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end) {
+    if (tracer) { tracer->record(name, request_id, start, end); }
+    if (stages && stages->count < CPPHTTPLIB_REQUEST_STAGES_MAX) {
+      stages->stages[stages->count++] = {name, start, end - start};
+    }
+  }
+};
 
-  void
-  set_header_writer(std::function<ssize_t(Stream &, Headers &)> const &writer);
+inline TraceContext &trace_context() {
+  thread_local TraceContext context;
+  return context;
+}
 
-  void set_address_family(int family);
-  void set_tcp_nodelay(bool on);
-  void set_ipv6_v6only(bool on);
-  void set_socket_options(SocketOptions socket_options);
+} // namespace detail
 
-  void set_connection_timeout(time_t sec, time_t usec = 0);
-  template <class Rep, class Period>
-  void
-  set_connection_timeout(const std::chrono::duration<Rep, Period> &duration);
+// Times a stage of the request being handled on the current thread, when
+// the Server has tracing or the slow-request log enabled; otherwise it does
+// nothing. `name` must outlive the trace, e.g. a string literal.
+//
+//   svr.Get("/orders", [](const Request &req, Response &res) {
+//     auto orders = find_orders(req);
+//     TraceScope scope("serialize");
+//     res.set_content(to_json(orders), "application/json");
+//   });
+class TraceScope {
+public:
+  explicit TraceScope(const char *name);
+  ~TraceScope();
 
-  void set_read_timeout(time_t sec, time_t usec = 0);
-  template <class Rep, class Period>
-  void set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
 
-  void set_write_timeout(time_t sec, time_t usec = 0);
-  template <class Rep, class Period>
-  void set_write_timeout(const std::chrono::duration<Rep, Period> &duration);
+private:
+  const char *name_;
+  bool active_;
+  std::chrono::steady_clock::time_point start_;
+};
 
-  void set_max_timeout(time_t msec);
-  template <class Rep, class Period>
-  void set_max_timeout(const std::chrono::duration<Rep, Period> &duration);
+// Adds a field to the slow-request log record of the request being handled
+// on the current thread, e.g. the shard it hit or how many seats it scanned.
+// Does nothing when the slow-request log is off.
+void annotate_request(const std::string &key, const std::string &value);
+
+struct MountPointOptions {
+  // Keep each file in memory after its first read, along with a strong ETag
+  // and Last-Modified. Cached files are never re-read, so changes on disk are
+  // not picked up until the mount point is set again.
+  bool cache_files = false;
+
+  // Serve cached files precompressed, chosen by Accept-Encoding. A `.gz`,
+  // `.br` or `.zst` sibling on disk is used as is; otherwise the variant is
+  // built with the compressors compiled in when the file is first loaded.
+  // Implies `cache_files`.
+  bool precompress = false;
+};
 
-  void set_basic_auth(const std::string &username, const std::string &password);
-  void set_bearer_token_auth(const std::string &token);
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void set_digest_auth(const std::string &username,
-                       const std::string &password);
-#endif
+struct CompressionPolicy {
+  // Codings in order of preference. The first one the client accepts and
+  // that is within the CPU budget is used.
+  std::vector<std::string> codecs = {"br", "gzip", "zstd"};
 
-  void set_keep_alive(bool on);
-  void set_follow_location(bool on);
+  // Starting level, or -1 for the codec's default
+  int level = -1;
 
-  void set_path_encode(bool on);
+  // Bodies smaller than this are sent uncompressed. Streamed bodies have no
+  // size up front and are not affected.
+  size_t min_size = CPPHTTPLIB_COMPRESSION_MIN_SIZE;
 
-  void set_compress(bool on);
+  // CPU budget in nanoseconds per input byte, or 0 for none. A codec that
+  // costs more on a route steps down one level at a time. At its lowest level
+  // it is skipped, apart from one probe every
+  // CPPHTTPLIB_COMPRESSION_PROBE_INTERVAL responses to re-measure it.
+  double max_cpu_ns_per_byte = 0;
+};
 
-  void set_decompress(bool on);
+struct CompressionStats {
+  uint64_t compressed = 0; // Responses compressed
+  uint64_t skipped = 0;    // Compressible responses sent as is
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  uint64_t cpu_ns = 0;
 
-  void set_interface(const std::string &intf);
+  uint64_t bytes_saved() const {
+    return bytes_in > bytes_out ? bytes_in - bytes_out : 0;
+  }
+};
 
-  void set_proxy(const std::string &host, int port);
-  void set_proxy_basic_auth(const std::string &username,
-                            const std::string &password);
-  void set_proxy_bearer_token_auth(const std::string &token);
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void set_proxy_digest_auth(const std::string &username,
-                             const std::string &password);
-#endif
+// A request captured by Server::set_request_recording
+struct RecordedRequest {
+  uint64_t time_us = 0;    // Since recording started
+  uint64_t connection = 0; // Requests that arrived on the same connection
+  std::string method;
+  std::string target; // Path and query, as sent
+  std::string content_type;
+  std::string body;
+};
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void set_ca_cert_path(const std::string &ca_cert_file_path,
-                        const std::string &ca_cert_dir_path = std::string());
-  void set_ca_cert_store(X509_STORE *ca_cert_store);
-  X509_STORE *create_ca_cert_store(const char *ca_cert, std::size_t size) const;
-#endif
+/*
+ * Reads a log written by Server::set_request_recording. The log starts with
+ * "HLOG", a version byte and the wall-clock start time in microseconds since
+ * the epoch. Each record is its length followed by time_us, connection,
+ * method, target, content_type and body. Integers are LEB128 varints and
+ * strings are a varint length followed by the bytes. A truncated last record,
+ * as left by a crash, is ignored.
+ */
+bool read_request_log(const std::string &path,
+                      std::vector<RecordedRequest> &requests,
+                      uint64_t *start_unix_us = nullptr);
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void enable_server_certificate_verification(bool enabled);
-  void enable_server_hostname_verification(bool enabled);
-  void set_server_certificate_verifier(
-      std::function<SSLVerifierResponse(SSL *ssl)> verifier);
-#endif
+struct SlowRequestLogOptions {
+  // Requests at least this slow are always logged
+  std::chrono::milliseconds threshold{500};
 
-  void set_logger(Logger logger);
+  // Also log one in this many of the other requests at random; 0 for none
+  size_t sample_one_in = 0;
 
-protected:
-  struct Socket {
-    socket_t sock = INVALID_SOCKET;
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-    SSL *ssl = nullptr;
-#endif
+  // Parameters and annotations to log as a salted hash, e.g. "passengerId".
+  // The salt is random per log, so hashes only match within one log.
+  std::vector<std::string> hashed_params;
 
-    bool is_open() const { return sock != INVALID_SOCKET; }
-  };
+  // Records waiting for the writer thread. When it falls this far behind,
+  // records are dropped rather than making requests wait.
+  size_t queue_capacity = 4096;
+};
 
-  virtual bool create_and_connect_socket(Socket &socket, Error &error);
+namespace detail {
 
-  // All of:
-  //   shutdown_ssl
-  //   shutdown_socket
-  //   close_socket
-  // should ONLY be called when socket_mutex_ is locked.
-  // Also, shutdown_ssl and close_socket should also NOT be called concurrently
-  // with a DIFFERENT thread sending requests using that socket.
-  virtual void shutdown_ssl(Socket &socket, bool shutdown_gracefully);
-  void shutdown_socket(Socket &socket) const;
-  void close_socket(Socket &socket);
+// Bounded multi-producer queue of lines, drained to a file by its own
+// thread. Producers never lock or block; when the queue is full the line is
+// dropped and counted, and the count is written to the file later.
+class AsyncLogWriter {
+public:
+  AsyncLogWriter(std::FILE *fp, size_t capacity);
+  ~AsyncLogWriter();
 
-  bool process_request(Stream &strm, Request &req, Response &res,
-                       bool close_connection, Error &error);
+  AsyncLogWriter(const AsyncLogWriter &) = delete;
+  AsyncLogWriter &operator=(const AsyncLogWriter &) = delete;
 
-  bool write_content_with_provider(Stream &strm, const Request &req,
-                                   Error &error) const;
+  bool push(std::string &&line);
 
-  void copy_settings(const ClientImpl &rhs);
+private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    std::string line;
+  };
 
-  // Socket endpoint information
-  const std::string host_;
-  const int port_;
-  const std::string host_and_port_;
+  bool pop(std::string &line);
+  void run();
+
+  std::FILE *fp_;
+  std::unique_ptr<Cell[]> cells_;
+  const size_t mask_;
+  std::atomic<size_t> enqueue_pos_{0};
+  size_t dequeue_pos_ = 0; // Writer thread only
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<bool> stop_{false};
+  std::thread writer_;
+};
 
-  // Current open socket
-  Socket socket_;
-  mutable std::mutex socket_mutex_;
-  std::recursive_mutex request_mutex_;
+// One JSON line per request that is slow or sampled
+class SlowRequestLog {
+public:
+  SlowRequestLog(std::FILE *fp, const SlowRequestLogOptions &options);
 
-  // These are all protected under socket_mutex
-  size_t socket_requests_in_flight_ = 0;
-  std::thread::id socket_requests_are_from_thread_ = std::thread::id();
-  bool socket_should_be_closed_when_request_is_done_ = false;
+  void log(const Request &req, int status,
+           std::chrono::steady_clock::time_point start,
+           std::chrono::steady_clock::time_point end,
+           const RequestStages &stages);
 
-  // Hostname-IP map
-  std::map<std::string, std::string> addr_map_;
+private:
+  std::string value(const std::string &key, const std::string &value) const;
 
-  // Default headers
-  Headers default_headers_;
+  const SlowRequestLogOptions options_;
+  uint64_t salt_;
+  AsyncLogWriter writer_;
+};
 
-  // Header writer
-  std::function<ssize_t(Stream &, Headers &)> header_writer_ =
-      detail::write_headers;
+} // namespace detail
 
-  // Settings
-  std::string client_cert_path_;
-  std::string client_key_path_;
+struct EventStreamOptions {
+  // Each stream sends at most one event per topic per interval; newer
+  // publishes within the interval replace older ones
+  std::chrono::milliseconds coalesce_interval{1000};
 
-  time_t connection_timeout_sec_ = CPPHTTPLIB_CONNECTION_TIMEOUT_SECOND;
-  time_t connection_timeout_usec_ = CPPHTTPLIB_CONNECTION_TIMEOUT_USECOND;
-  time_t read_timeout_sec_ = CPPHTTPLIB_CLIENT_READ_TIMEOUT_SECOND;
-  time_t read_timeout_usec_ = CPPHTTPLIB_CLIENT_READ_TIMEOUT_USECOND;
-  time_t write_timeout_sec_ = CPPHTTPLIB_CLIENT_WRITE_TIMEOUT_SECOND;
-  time_t write_timeout_usec_ = CPPHTTPLIB_CLIENT_WRITE_TIMEOUT_USECOND;
-  time_t max_timeout_msec_ = CPPHTTPLIB_CLIENT_MAX_TIMEOUT_MSECOND;
+  // A comment line is sent after this long without events, so proxies keep
+  // the stream open and a departed client is noticed on the failed write
+  std::chrono::milliseconds keepalive_interval{15000};
 
-  std::string basic_auth_username_;
-  std::string basic_auth_password_;
-  std::string bearer_token_auth_token_;
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  std::string digest_auth_username_;
-  std::string digest_auth_password_;
-#endif
+  // Worker threads in the server's task queue; 0 for
+  // CPPHTTPLIB_THREAD_POOL_COUNT. Set it when new_task_queue builds a pool of
+  // another size.
+  size_t worker_count = 0;
 
-  bool keep_alive_ = false;
-  bool follow_location_ = false;
+  // Every open stream occupies a worker thread. Beyond this many, subscribe()
+  // answers 503 so streams cannot starve ordinary requests. 0 for a quarter
+  // of the workers.
+  size_t max_streams = 0;
+};
 
-  bool path_encode_ = true;
+/*
+ * Server-Sent Events fan-out over chunked responses. subscribe() turns a
+ * response into a text/event-stream of the topics the client asked for;
+ * publish() replaces a topic's payload and wakes its streams. Only the
+ * newest payload per topic is kept, so a burst of updates reaches each
+ * client as one event per coalesce interval. Topics nobody subscribes to
+ * are not stored. The hub must outlive the server it serves.
+ */
+class EventHub {
+public:
+  explicit EventHub(const EventStreamOptions &options = EventStreamOptions());
+  ~EventHub();
 
-  int address_family_ = AF_UNSPEC;
-  bool tcp_nodelay_ = CPPHTTPLIB_TCP_NODELAY;
-  bool ipv6_v6only_ = CPPHTTPLIB_IPV6_V6ONLY;
-  SocketOptions socket_options_ = nullptr;
+  EventHub(const EventHub &) = delete;
+  EventHub &operator=(const EventHub &) = delete;
 
-  bool compress_ = false;
-  bool decompress_ = true;
+  // Returns false when the topic has no subscribers
+  bool publish(const std::string &topic, const std::string &event,
+               const std::string &data);
 
-  std::string interface_;
+  // Sets up res as an event stream; false (and 503) when max_streams is hit
+  bool subscribe(Response &res, std::vector<std::string> topics);
 
-  std::string proxy_host_;
-  int proxy_port_ = -1;
+  // Topics with at least one subscriber, for publishers that compute
+  // payloads per subscription (e.g. per station pair)
+  std::vector<std::string>
+  subscribed_topics(const std::string &prefix = std::string()) const;
 
-  std::string proxy_basic_auth_username_;
-  std::string proxy_basic_auth_password_;
-  std::string proxy_bearer_token_auth_token_;
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  std::string proxy_digest_auth_username_;
-  std::string proxy_digest_auth_password_;
-#endif
+  size_t stream_count() const;
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  std::string ca_cert_file_path_;
-  std::string ca_cert_dir_path_;
+  // Ends every stream; later subscriptions are refused
+  void close();
 
-  X509_STORE *ca_cert_store_ = nullptr;
-#endif
+private:
+  struct Topic {
+    std::string event;
+    std::string data;
+    uint64_t version = 0; // 0 until first published
+    size_t subscribers = 0;
+  };
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  bool server_certificate_verification_ = true;
-  bool server_hostname_verification_ = true;
-  std::function<SSLVerifierResponse(SSL *ssl)> server_certificate_verifier_;
-#endif
+  struct Stream {
+    std::vector<std::string> topics;
+    std::vector<uint64_t> sent; // Version sent, per entry of topics
+    uint64_t checked = 0;       // Hub version last scanned
+    std::chrono::steady_clock::time_point last_flush;
+    std::chrono::steady_clock::time_point last_write;
+  };
 
-  Logger logger_;
+  bool has_update(Stream &stream);
+  bool next_chunk(Stream &stream, std::string &chunk);
+  void release(Stream &stream);
+
+  const EventStreamOptions options_;
+  const size_t max_streams_;
+  mutable Mutex mutex_{"EventHub::mutex_"};
+  ConditionVariable cv_;
+  std::unordered_map<std::string, Topic> topics_;
+  uint64_t version_ = 0;
+  size_t streams_ = 0;
+  bool closed_ = false;
+};
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  int last_ssl_error_ = 0;
-  unsigned long last_openssl_error_ = 0;
-#endif
+class Server {
+public:
+  using Handler = std::function<void(const Request &, Response &)>;
 
-private:
-  bool send_(Request &req, Response &res, Error &error);
-  Result send_(Request &&req);
+  using ExceptionHandler =
+      std::function<void(const Request &, Response &, std::exception_ptr ep)>;
 
-  socket_t create_client_socket(Error &error) const;
-  bool read_response_line(Stream &strm, const Request &req,
-                          Response &res) const;
-  bool write_request(Stream &strm, Request &req, bool close_connection,
-                     Error &error);
-  bool redirect(Request &req, Response &res, Error &error);
-  bool create_redirect_client(const std::string &scheme,
-                              const std::string &host, int port, Request &req,
-                              Response &res, const std::string &path,
-                              const std::string &location, Error &error);
-  template <typename ClientType> void setup_redirect_client(ClientType &client);
-  bool handle_request(Stream &strm, Request &req, Response &res,
-                      bool close_connection, Error &error);
-  std::unique_ptr<Response> send_with_content_provider(
-      Request &req, const char *body, size_t content_length,
-      ContentProvider content_provider,
-      ContentProviderWithoutLength content_provider_without_length,
-      const std::string &content_type, Error &error);
-  Result send_with_content_provider(
-      const std::string &method, const std::string &path,
-      const Headers &headers, const char *body, size_t content_length,
-      ContentProvider content_provider,
-      ContentProviderWithoutLength content_provider_without_length,
-      const std::string &content_type, UploadProgress progress);
-  ContentProviderWithoutLength get_multipart_content_provider(
-      const std::string &boundary, const UploadFormDataItems &items,
-      const FormDataProviderItems &provider_items) const;
+  enum class HandlerResponse {
+    Handled,
+    Unhandled,
+  };
+  using HandlerWithResponse =
+      std::function<HandlerResponse(const Request &, Response &)>;
 
-  std::string adjust_host_string(const std::string &host) const;
+  using HandlerWithContentReader = std::function<void(
+      const Request &, Response &, const ContentReader &content_reader)>;
 
-  virtual bool
-  process_socket(const Socket &socket,
-                 std::chrono::time_point<std::chrono::steady_clock> start_time,
-                 std::function<bool(Stream &strm)> callback);
-  virtual bool is_ssl() const;
-};
+  using Expect100ContinueHandler =
+      std::function<int(const Request &, Response &)>;
 
-class Client {
-public:
-  // Universal interface
-  explicit Client(const std::string &scheme_host_port);
+  Server();
 
-  explicit Client(const std::string &scheme_host_port,
-                  const std::string &client_cert_path,
-                  const std::string &client_key_path);
+  virtual ~Server();
 
-  // HTTP only interface
-  explicit Client(const std::string &host, int port);
+  virtual bool is_valid() const;
 
-  explicit Client(const std::string &host, int port,
-                  const std::string &client_cert_path,
-                  const std::string &client_key_path);
-
-  Client(Client &&) = default;
-  Client &operator=(Client &&) = default;
-
-  ~Client();
-
-  bool is_valid() const;
-
-  // clang-format off
-  Result Get(const std::string &path, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Params &params, const Headers &headers, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Params &params, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-  Result Get(const std::string &path, const Params &params, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-
-  Result Head(const std::string &path);
-  Result Head(const std::string &path, const Headers &headers);
-
-  Result Post(const std::string &path);
-  Result Post(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Params &params);
-  Result Post(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers);
-  Result Post(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const Params &params);
-  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
-  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-
-  Result Put(const std::string &path);
-  Result Put(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Params &params);
-  Result Put(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers);
-  Result Put(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const Params &params);
-  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
-  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-
-  Result Patch(const std::string &path);
-  Result Patch(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Params &params);
-  Result Patch(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers);
-  Result Patch(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const Params &params);
-  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
-  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
-
-  Result Delete(const std::string &path, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Params &params, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
-  Result Delete(const std::string &path, const Headers &headers, const Params &params, DownloadProgress progress = nullptr);
+  Server &Get(const std::string &pattern, Handler handler);
+  Server &Post(const std::string &pattern, Handler handler);
+  Server &Post(const std::string &pattern, HandlerWithContentReader handler);
+  Server &Put(const std::string &pattern, Handler handler);
+  Server &Put(const std::string &pattern, HandlerWithContentReader handler);
+  Server &Patch(const std::string &pattern, Handler handler);
+  Server &Patch(const std::string &pattern, HandlerWithContentReader handler);
+  Server &Delete(const std::string &pattern, Handler handler);
+  Server &Delete(const std::string &pattern, HandlerWithContentReader handler);
+  Server &Options(const std::string &pattern, Handler handler);
 
-  Result Options(const std::string &path);
-  Result Options(const std::string &path, const Headers &headers);
-  // clang-format on
+  bool set_base_dir(const std::string &dir,
+                    const std::string &mount_point = std::string());
+  bool set_mount_point(const std::string &mount_point, const std::string &dir,
+                       Headers headers = Headers());
+  bool set_mount_point(const std::string &mount_point, const std::string &dir,
+                       Headers headers, const MountPointOptions &options);
+  bool remove_mount_point(const std::string &mount_point);
+  Server &set_file_extension_and_mimetype_mapping(const std::string &ext,
+                                                  const std::string &mime);
+  Server &set_default_file_mimetype(const std::string &mime);
+  Server &set_file_request_handler(Handler handler);
 
-  bool send(Request &req, Response &res, Error &error);
-  Result send(const Request &req);
+  template <class ErrorHandlerFunc>
+  Server &set_error_handler(ErrorHandlerFunc &&handler) {
+    return set_error_handler_core(
+        std::forward<ErrorHandlerFunc>(handler),
+        std::is_convertible<ErrorHandlerFunc, HandlerWithResponse>{});
+  }
 
-  void stop();
+  Server &set_exception_handler(ExceptionHandler handler);
 
-  std::string host() const;
-  int port() const;
+  Server &set_pre_routing_handler(HandlerWithResponse handler);
+  Server &set_post_routing_handler(Handler handler);
 
-  size_t is_socket_open() const;
-  socket_t socket() const;
+  Server &set_pre_request_handler(HandlerWithResponse handler);
 
-  void set_hostname_addr_map(std::map<std::string, std::string> addr_map);
+  Server &set_expect_100_continue_handler(Expect100ContinueHandler handler);
+  Server &set_logger(Logger logger);
+  Server &set_pre_compression_logger(Logger logger);
 
-  void set_default_headers(Headers headers);
+  Server &set_address_family(int family);
+  Server &set_tcp_nodelay(bool on);
+  Server &set_ipv6_v6only(bool on);
+  Server &set_socket_options(SocketOptions socket_options);
 
-  void
+  Server &set_default_headers(Headers headers);
+  Server &
   set_header_writer(std::function<ssize_t(Stream &, Headers &)> const &writer);
 
-  void set_address_family(int family);
-  void set_tcp_nodelay(bool on);
-  void set_socket_options(SocketOptions socket_options);
+  Server &set_keep_alive_max_count(size_t count);
+  Server &set_keep_alive_timeout(time_t sec);
 
-  void set_connection_timeout(time_t sec, time_t usec = 0);
+  Server &set_read_timeout(time_t sec, time_t usec = 0);
   template <class Rep, class Period>
-  void
-  set_connection_timeout(const std::chrono::duration<Rep, Period> &duration);
+  Server &set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
 
-  void set_read_timeout(time_t sec, time_t usec = 0);
+  Server &set_write_timeout(time_t sec, time_t usec = 0);
   template <class Rep, class Period>
-  void set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
+  Server &set_write_timeout(const std::chrono::duration<Rep, Period> &duration);
 
-  void set_write_timeout(time_t sec, time_t usec = 0);
+  Server &set_idle_interval(time_t sec, time_t usec = 0);
   template <class Rep, class Period>
-  void set_write_timeout(const std::chrono::duration<Rep, Period> &duration);
+  Server &set_idle_interval(const std::chrono::duration<Rep, Period> &duration);
 
-  void set_max_timeout(time_t msec);
-  template <class Rep, class Period>
-  void set_max_timeout(const std::chrono::duration<Rep, Period> &duration);
+  Server &set_payload_max_length(size_t length);
 
-  void set_basic_auth(const std::string &username, const std::string &password);
-  void set_bearer_token_auth(const std::string &token);
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void set_digest_auth(const std::string &username,
-                       const std::string &password);
-#endif
+  Server &set_metrics_endpoint(const std::string &path = "/metrics");
+  std::string metrics_text() const;
 
-  void set_keep_alive(bool on);
-  void set_follow_location(bool on);
+  Server &set_lock_profile_endpoint(const std::string &path = "/debug/locks");
+  Server &set_memory_endpoint(const std::string &path = "/debug/memory");
 
-  void set_path_encode(bool on);
-  void set_url_encode(bool on);
+  // Append a JSON line to `path` for each request that is slow or sampled,
+  // with its stage timings and annotate_request() fields; an empty path
+  // stops logging. Call before listen().
+  bool set_slow_request_log(
+      const std::string &path,
+      const SlowRequestLogOptions &options = SlowRequestLogOptions());
 
-  void set_compress(bool on);
+  // Log every request to `path` for replaying later; an empty path stops
+  // recording. Call before listen(). Bodies consumed through a ContentReader
+  // are not captured.
+  bool set_request_recording(const std::string &path);
 
-  void set_decompress(bool on);
+  Server &set_tracing(bool on, size_t events_per_thread =
+                                   CPPHTTPLIB_TRACE_EVENTS_PER_THREAD);
+  Server &set_trace_endpoint(const std::string &path = "/debug/trace");
+  std::string trace_json(time_t seconds) const;
 
-  void set_interface(const std::string &intf);
+  Server &set_admission_control(AdmissionControl config);
+  std::vector<AdmissionClassStats> admission_stats() const;
 
-  void set_proxy(const std::string &host, int port);
-  void set_proxy_basic_auth(const std::string &username,
-                            const std::string &password);
-  void set_proxy_bearer_token_auth(const std::string &token);
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void set_proxy_digest_auth(const std::string &username,
-                             const std::string &password);
-#endif
+  Server &set_compression_policy(CompressionPolicy policy);
+  Server &set_compression_policy(const std::string &pattern,
+                                 CompressionPolicy policy);
+  CompressionStats compression_stats() const;
+  CompressionStats compression_stats(const std::string &pattern) const;
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void enable_server_certificate_verification(bool enabled);
-  void enable_server_hostname_verification(bool enabled);
-  void set_server_certificate_verifier(
-      std::function<SSLVerifierResponse(SSL *ssl)> verifier);
-#endif
+  bool bind_to_port(const std::string &host, int port, int socket_flags = 0);
+  int bind_to_any_port(const std::string &host, int socket_flags = 0);
+  bool listen_after_bind();
 
-  void set_logger(Logger logger);
+  bool listen(const std::string &host, int port, int socket_flags = 0);
 
-  // SSL
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  void set_ca_cert_path(const std::string &ca_cert_file_path,
-                        const std::string &ca_cert_dir_path = std::string());
+  bool is_running() const;
+  void wait_until_ready() const;
+  void stop();
+  void decommission();
 
-  void set_ca_cert_store(X509_STORE *ca_cert_store);
-  void load_ca_cert_store(const char *ca_cert, std::size_t size);
+  std::function<TaskQueue *(void)> new_task_queue;
 
-  long get_openssl_verify_result() const;
+protected:
+  bool process_request(Stream &strm, const std::string &remote_addr,
+                       int remote_port, const std::string &local_addr,
+                       int local_port, bool close_connection,
+                       bool &connection_closed,
+                       const std::function<void(Request &)> &setup_request);
 
-  SSL_CTX *ssl_context() const;
-#endif
+  std::atomic<socket_t> svr_sock_{INVALID_SOCKET};
+  size_t keep_alive_max_count_ = CPPHTTPLIB_KEEPALIVE_MAX_COUNT;
+  time_t keep_alive_timeout_sec_ = CPPHTTPLIB_KEEPALIVE_TIMEOUT_SECOND;
+  time_t read_timeout_sec_ = CPPHTTPLIB_SERVER_READ_TIMEOUT_SECOND;
+  time_t read_timeout_usec_ = CPPHTTPLIB_SERVER_READ_TIMEOUT_USECOND;
+  time_t write_timeout_sec_ = CPPHTTPLIB_SERVER_WRITE_TIMEOUT_SECOND;
+  time_t write_timeout_usec_ = CPPHTTPLIB_SERVER_WRITE_TIMEOUT_USECOND;
+  time_t idle_interval_sec_ = CPPHTTPLIB_IDLE_INTERVAL_SECOND;
+  time_t idle_interval_usec_ = CPPHTTPLIB_IDLE_INTERVAL_USECOND;
+  size_t payload_max_length_ = CPPHTTPLIB_PAYLOAD_MAX_LENGTH;
+  std::unique_ptr<detail::ServerMetrics> metrics_;
+  std::unique_ptr<detail::StageTracer> tracer_;
+  std::atomic<bool> trace_capturing_{false};
+  std::unique_ptr<detail::RequestRecorder> recorder_;
+  std::unique_ptr<detail::SlowRequestLog> slow_log_;
 
 private:
-  std::unique_ptr<ClientImpl> cli_;
-
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  bool is_ssl_ = false;
-#endif
-};
-
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-class SSLServer : public Server {
-public:
-  SSLServer(const char *cert_path, const char *private_key_path,
-            const char *client_ca_cert_file_path = nullptr,
-            const char *client_ca_cert_dir_path = nullptr,
-            const char *private_key_password = nullptr);
+  using Handlers =
+      std::vector<std::pair<std::unique_ptr<detail::MatcherBase>, Handler>>;
+  using HandlersForContentReader =
+      std::vector<std::pair<std::unique_ptr<detail::MatcherBase>,
+                            HandlerWithContentReader>>;
 
-  SSLServer(X509 *cert, EVP_PKEY *private_key,
-            X509_STORE *client_ca_cert_store = nullptr);
+  static std::unique_ptr<detail::MatcherBase>
+  make_matcher(const std::string &pattern);
 
-  SSLServer(
-      const std::function<bool(SSL_CTX &ssl_ctx)> &setup_ssl_ctx_callback);
+  Server &set_error_handler_core(HandlerWithResponse handler, std::true_type);
+  Server &set_error_handler_core(Handler handler, std::false_type);
 
-  ~SSLServer() override;
+  socket_t create_server_socket(const std::string &host, int port,
+                                int socket_flags,
+                                SocketOptions socket_options) const;
+  int bind_internal(const std::string &host, int port, int socket_flags);
+  bool listen_internal();
 
-  bool is_valid() const override;
-
-  SSL_CTX *ssl_context() const;
+  bool routing(Request &req, Response &res, Stream &strm);
+  bool handle_file_request(const Request &req, Response &res);
+  void serve_cached_asset(const Request &req, Response &res,
+                          const Headers &headers,
+                          std::shared_ptr<const detail::CachedAsset> asset);
+  bool set_file_content_provider(Response &res, const std::string &path,
+                                 const std::string &content_type) const;
+  bool dispatch_request(Request &req, Response &res,
+                        const Handlers &handlers) const;
+  bool dispatch_request_for_content_reader(
+      Request &req, Response &res, ContentReader content_reader,
+      const HandlersForContentReader &handlers) const;
 
-  void update_certs(X509 *cert, EVP_PKEY *private_key,
-                    X509_STORE *client_ca_cert_store = nullptr);
+  bool parse_request_line(const char *s, Request &req) const;
+  void apply_ranges(const Request &req, Response &res,
+                    std::string &content_type, std::string &boundary) const;
+  bool write_response(Stream &strm, bool close_connection, Request &req,
+                      Response &res);
+  bool write_response_with_content(Stream &strm, bool close_connection,
+                                   const Request &req, Response &res);
+  bool write_response_core(Stream &strm, bool close_connection,
+                           const Request &req, Response &res,
+                           bool need_apply_ranges);
+  bool write_content_with_provider(Stream &strm, const Request &req,
+                                   Response &res, const std::string &boundary,
+                                   const std::string &content_type);
+  detail::EncodingType choose_encoding(const Request &req, const Response &res,
+                                       bool streamed, size_t size,
+                                       int &level) const;
+  void record_compression(const Request &req, detail::EncodingType type,
+                          int level, size_t bytes_in, size_t bytes_out,
+                          uint64_t cpu_ns) const;
+  struct RouteCompression;
+  RouteCompression &compression_route(const std::string &route) const;
+  bool read_content(Stream &strm, Request &req, Response &res);
+  bool read_content_with_content_receiver(Stream &strm, Request &req,
+                                          Response &res,
+                                          ContentReceiver receiver,
+                                          FormDataHeader multipart_header,
+                                          ContentReceiver multipart_receiver);
+  bool read_content_core(Stream &strm, Request &req, Response &res,
+                         ContentReceiver receiver,
+                         FormDataHeader multipart_header,
+                         ContentReceiver multipart_receiver) const;
 
-private:
-  bool process_and_close_socket(socket_t sock) override;
+  virtual bool process_and_close_socket(socket_t sock);
 
-  SSL_CTX *ctx_;
-  std::mutex ctx_mutex_;
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  int last_ssl_error_ = 0;
-#endif
-};
+  std::atomic<bool> is_running_{false};
+  std::atomic<bool> is_decommissioned{false};
 
-class SSLClient final : public ClientImpl {
-public:
-  explicit SSLClient(const std::string &host);
+  struct MountPointEntry {
+    std::string mount_point;
+    std::string base_dir;
+    Headers headers;
+    std::shared_ptr<detail::AssetCache> cache;
+  };
+  std::vector<MountPointEntry> base_dirs_;
+  std::map<std::string, std::string> file_extension_and_mimetype_map_;
+  std::string default_file_mimetype_ = "application/octet-stream";
+  Handler file_request_handler_;
 
-  explicit SSLClient(const std::string &host, int port);
+  Handlers get_handlers_;
+  Handlers post_handlers_;
+  HandlersForContentReader post_handlers_for_content_reader_;
+  Handlers put_handlers_;
+  HandlersForContentReader put_handlers_for_content_reader_;
+  Handlers patch_handlers_;
+  HandlersForContentReader patch_handlers_for_content_reader_;
+  Handlers delete_handlers_;
+  HandlersForContentReader delete_handlers_for_content_reader_;
+  Handlers options_handlers_;
 
-  explicit SSLClient(const std::string &host, int port,
-                     const std::string &client_cert_path,
-                     const std::string &client_key_path,
-                     const std::string &private_key_password = std::string());
+  HandlerWithResponse error_handler_;
+  ExceptionHandler exception_handler_;
+  HandlerWithResponse pre_routing_handler_;
+  Handler post_routing_handler_;
+  HandlerWithResponse pre_request_handler_;
+  Expect100ContinueHandler expect_100_continue_handler_;
 
-  explicit SSLClient(const std::string &host, int port, X509 *client_cert,
-                     EVP_PKEY *client_key,
-                     const std::string &private_key_password = std::string());
+  Logger logger_;
+  Logger pre_compression_logger_;
 
-  ~SSLClient() override;
+  std::unique_ptr<detail::AdmissionController> admission_;
+
+  // Every response reads its route's codec state, so all of it is atomic.
+  // Only the cost tracking behind level changes takes a lock, and only in
+  // record_compression on routes with a CPU budget.
+  struct CodecState {
+    std::atomic<int> level{-1};
+    std::atomic<bool> disabled{false};
+    std::atomic<size_t> since_probe{0};
+    double cost_ns_per_byte = 0; // Guarded by RouteCompression::tuning
+    size_t samples = 0;          // Guarded by RouteCompression::tuning
+  };
+  struct CompressionCounters {
+    std::atomic<uint64_t> compressed{0};
+    std::atomic<uint64_t> skipped{0};
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<uint64_t> cpu_ns{0};
+
+    CompressionStats load() const {
+      CompressionStats s;
+      s.compressed = compressed.load(std::memory_order_relaxed);
+      s.skipped = skipped.load(std::memory_order_relaxed);
+      s.bytes_in = bytes_in.load(std::memory_order_relaxed);
+      s.bytes_out = bytes_out.load(std::memory_order_relaxed);
+      s.cpu_ns = cpu_ns.load(std::memory_order_relaxed);
+      return s;
+    }
+  };
+  struct RouteCompression {
+    CodecState codecs[static_cast<size_t>(detail::EncodingType::Zstd) + 1];
+    CompressionCounters stats;
+    Mutex tuning{"Server::RouteCompression::tuning"};
+  };
+  using CompressionRouteTable =
+      std::unordered_map<std::string, RouteCompression *>;
+
+  CompressionPolicy default_compression_policy_;
+  std::unordered_map<std::string, CompressionPolicy> compression_policies_;
+  // Routes are looked up in an immutable table swapped in whole when a route
+  // is first seen. Entries and replaced tables live as long as the server,
+  // so a reader never sees either freed.
+  mutable std::atomic<const CompressionRouteTable *> compression_routes_{
+      nullptr};
+  mutable Mutex compression_mutex_{"Server::compression_mutex_"};
+  mutable std::vector<std::unique_ptr<RouteCompression>>
+      compression_route_entries_;
+  mutable std::vector<std::unique_ptr<const CompressionRouteTable>>
+      compression_route_tables_;
+  mutable CompressionCounters compression_stats_;
 
-  bool is_valid() const override;
+  int address_family_ = AF_UNSPEC;
+  bool tcp_nodelay_ = CPPHTTPLIB_TCP_NODELAY;
+  bool ipv6_v6only_ = CPPHTTPLIB_IPV6_V6ONLY;
+  SocketOptions socket_options_ = default_socket_options;
 
-  void set_ca_cert_store(X509_STORE *ca_cert_store);
-  void load_ca_cert_store(const char *ca_cert, std::size_t size);
+  Headers default_headers_;
+  std::function<ssize_t(Stream &, Headers &)> header_writer_ =
+      detail::write_headers;
+};
 
-  long get_openssl_verify_result() const;
+enum class Error {
+  Success = 0,
+  Unknown,
+  Connection,
+  BindIPAddress,
+  Read,
+  Write,
+  ExceedRedirectCount,
+  Canceled,
+  SSLConnection,
+  SSLLoadingCerts,
+  SSLServerVerification,
+  SSLServerHostnameVerification,
+  UnsupportedMultipartBoundaryChars,
+  Compression,
+  ConnectionTimeout,
+  ProxyConnection,
 
-  SSL_CTX *ssl_context() const;
+  // For internal use only
+  SSLPeerCouldBeClosed_,
+};
 
-private:
-  bool create_and_connect_socket(Socket &socket, Error &error) override;
-  void shutdown_ssl(Socket &socket, bool shutdown_gracefully) override;
-  void shutdown_ssl_impl(Socket &socket, bool shutdown_gracefully);
+std::string to_string(Error error);
 
-  bool
-  process_socket(const Socket &socket,
-                 std::chrono::time_point<std::chrono::steady_clock> start_time,
-                 std::function<bool(Stream &strm)> callback) override;
-  bool is_ssl() const override;
+std::ostream &operator<<(std::ostream &os, const Error &obj);
 
-  bool connect_with_proxy(
-      Socket &sock,
-      std::chrono::time_point<std::chrono::steady_clock> start_time,
-      Response &res, bool &success, Error &error);
-  bool initialize_ssl(Socket &socket, Error &error);
+class Result {
+public:
+  Result() = default;
+  Result(std::unique_ptr<Response> &&res, Error err,
+         Headers &&request_headers = Headers{})
+      : res_(std::move(res)), err_(err),
+        request_headers_(std::move(request_headers)) {}
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  Result(std::unique_ptr<Response> &&res, Error err, Headers &&request_headers,
+         int ssl_error)
+      : res_(std::move(res)), err_(err),
+        request_headers_(std::move(request_headers)), ssl_error_(ssl_error) {}
+  Result(std::unique_ptr<Response> &&res, Error err, Headers &&request_headers,
+         int ssl_error, unsigned long ssl_openssl_error)
+      : res_(std::move(res)), err_(err),
+        request_headers_(std::move(request_headers)), ssl_error_(ssl_error),
+        ssl_openssl_error_(ssl_openssl_error) {}
+#endif
+  // Response
+  operator bool() const { return res_ != nullptr; }
+  bool operator==(std::nullptr_t) const { return res_ == nullptr; }
+  bool operator!=(std::nullptr_t) const { return res_ != nullptr; }
+  const Response &value() const { return *res_; }
+  Response &value() { return *res_; }
+  const Response &operator*() const { return *res_; }
+  Response &operator*() { return *res_; }
+  const Response *operator->() const { return res_.get(); }
+  Response *operator->() { return res_.get(); }
 
-  bool load_certs();
+  // Error
+  Error error() const { return err_; }
 
-  bool verify_host(X509 *server_cert) const;
-  bool verify_host_with_subject_alt_name(X509 *server_cert) const;
-  bool verify_host_with_common_name(X509 *server_cert) const;
-  bool check_host_name(const char *pattern, size_t pattern_len) const;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  // SSL Error
+  int ssl_error() const { return ssl_error_; }
+  // OpenSSL Error
+  unsigned long ssl_openssl_error() const { return ssl_openssl_error_; }
+#endif
 
-  SSL_CTX *ctx_;
-  std::mutex ctx_mutex_;
-  std::once_flag initialize_cert_;
+  // Request Headers
+  bool has_request_header(const std::string &key) const;
+  std::string get_request_header_value(const std::string &key,
+                                       const char *def = "",
+                                       size_t id = 0) const;
+  size_t get_request_header_value_u64(const std::string &key, size_t def = 0,
+                                      size_t id = 0) const;
+  size_t get_request_header_value_count(const std::string &key) const;
 
-  std::vector<std::string> host_components_;
+private:
+  std::unique_ptr<Response> res_;
+  Error err_ = Error::Unknown;
+  Headers request_headers_;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  int ssl_error_ = 0;
+  unsigned long ssl_openssl_error_ = 0;
+#endif
+};
 
-  long verify_result_ = 0;
+class ClientImpl {
+public:
+  explicit ClientImpl(const std::string &host);
 
-  friend class ClientImpl;
-};
-#endif
+  explicit ClientImpl(const std::string &host, int port);
 
-/*
- * Implementation of template methods.
- */
+  explicit ClientImpl(const std::string &host, int port,
+                      const std::string &client_cert_path,
+                      const std::string &client_key_path);
 
-namespace detail {
+  virtual ~ClientImpl();
 
-template <typename T, typename U>
-inline void duration_to_sec_and_usec(const T &duration, U callback) {
-  auto sec = std::chrono::duration_cast<std::chrono::seconds>(duration).count();
-  auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
-                  duration - std::chrono::seconds(sec))
-                  .count();
-  callback(static_cast<time_t>(sec), static_cast<time_t>(usec));
-}
+  virtual bool is_valid() const;
 
-template <size_t N> inline constexpr size_t str_len(const char (&)[N]) {
-  return N - 1;
-}
+  // clang-format off
+  Result Get(const std::string &path, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Params &params, const Headers &headers, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Params &params, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Params &params, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
 
-inline bool is_numeric(const std::string &str) {
-  return !str.empty() &&
-         std::all_of(str.cbegin(), str.cend(),
-                     [](unsigned char c) { return std::isdigit(c); });
-}
+  Result Head(const std::string &path);
+  Result Head(const std::string &path, const Headers &headers);
 
-inline size_t get_header_value_u64(const Headers &headers,
-                                   const std::string &key, size_t def,
-                                   size_t id, bool &is_invalid_value) {
-  is_invalid_value = false;
-  auto rng = headers.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) {
-    if (is_numeric(it->second)) {
-      return std::strtoull(it->second.data(), nullptr, 10);
-    } else {
-      is_invalid_value = true;
-    }
+  Result Post(const std::string &path);
+  Result Post(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Params &params);
+  Result Post(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers);
+  Result Post(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const Params &params);
+  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Put(const std::string &path);
+  Result Put(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Params &params);
+  Result Put(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers);
+  Result Put(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const Params &params);
+  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Patch(const std::string &path);
+  Result Patch(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Params &params);
+  Result Patch(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const Params &params);
+  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Delete(const std::string &path, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Params &params, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, const Params &params, DownloadProgress progress = nullptr);
+
+  Result Options(const std::string &path);
+  Result Options(const std::string &path, const Headers &headers);
+  // clang-format on
+
+  bool send(Request &req, Response &res, Error &error);
+  Result send(const Request &req);
+
+  void stop();
+
+  std::string host() const;
+  int port() const;
+
+  size_t is_socket_open() const;
+  socket_t socket() const;
+
+  void set_hostname_addr_map(std::map<std::string, std::string> addr_map);
+
+  void set_default_headers(Headers headers);
+
+  void
+  set_header_writer(std::function<ssize_t(Stream &, Headers &)> const &writer);
+
+  void set_address_family(int family);
+  void set_tcp_nodelay(bool on);
+  void set_ipv6_v6only(bool on);
+  void set_socket_options(SocketOptions socket_options);
+
+  void set_connection_timeout(time_t sec, time_t usec = 0);
+  template <class Rep, class Period>
+  void
+  set_connection_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_read_timeout(time_t sec, time_t usec = 0);
+  template <class Rep, class Period>
+  void set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_write_timeout(time_t sec, time_t usec = 0);
+  template <class Rep, class Period>
+  void set_write_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_max_timeout(time_t msec);
+  template <class Rep, class Period>
+  void set_max_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_basic_auth(const std::string &username, const std::string &password);
+  void set_bearer_token_auth(const std::string &token);
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void set_digest_auth(const std::string &username,
+                       const std::string &password);
+#endif
+
+  void set_keep_alive(bool on);
+  void set_follow_location(bool on);
+
+  void set_path_encode(bool on);
+
+  void set_compress(bool on);
+
+  void set_decompress(bool on);
+
+  void set_interface(const std::string &intf);
+
+  void set_proxy(const std::string &host, int port);
+  void set_proxy_basic_auth(const std::string &username,
+                            const std::string &password);
+  void set_proxy_bearer_token_auth(const std::string &token);
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void set_proxy_digest_auth(const std::string &username,
+                             const std::string &password);
+#endif
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void set_ca_cert_path(const std::string &ca_cert_file_path,
+                        const std::string &ca_cert_dir_path = std::string());
+  void set_ca_cert_store(X509_STORE *ca_cert_store);
+  X509_STORE *create_ca_cert_store(const char *ca_cert, std::size_t size) const;
+#endif
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void enable_server_certificate_verification(bool enabled);
+  void enable_server_hostname_verification(bool enabled);
+  void set_server_certificate_verifier(
+      std::function<SSLVerifierResponse(SSL *ssl)> verifier);
+#endif
+
+  void set_logger(Logger logger);
+
+protected:
+  struct Socket {
+    socket_t sock = INVALID_SOCKET;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+    SSL *ssl = nullptr;
+#endif
+
+    bool is_open() const { return sock != INVALID_SOCKET; }
+  };
+
+  virtual bool create_and_connect_socket(Socket &socket, Error &error);
+
+  // All of:
+  //   shutdown_ssl
+  //   shutdown_socket
+  //   close_socket
+  // should ONLY be called when socket_mutex_ is locked.
+  // Also, shutdown_ssl and close_socket should also NOT be called concurrently
+  // with a DIFFERENT thread sending requests using that socket.
+  virtual void shutdown_ssl(Socket &socket, bool shutdown_gracefully);
+  void shutdown_socket(Socket &socket) const;
+  void close_socket(Socket &socket);
+
+  bool process_request(Stream &strm, Request &req, Response &res,
+                       bool close_connection, Error &error);
+
+  bool write_content_with_provider(Stream &strm, const Request &req,
+                                   Error &error) const;
+
+  void copy_settings(const ClientImpl &rhs);
+
+  // Socket endpoint information
+  const std::string host_;
+  const int port_;
+  const std::string host_and_port_;
+
+  // Current open socket
+  Socket socket_;
+  mutable std::mutex socket_mutex_;
+  std::recursive_mutex request_mutex_;
+
+  // These are all protected under socket_mutex
+  size_t socket_requests_in_flight_ = 0;
+  std::thread::id socket_requests_are_from_thread_ = std::thread::id();
+  bool socket_should_be_closed_when_request_is_done_ = false;
+
+  // Hostname-IP map
+  std::map<std::string, std::string> addr_map_;
+
+  // Default headers
+  Headers default_headers_;
+
+  // Header writer
+  std::function<ssize_t(Stream &, Headers &)> header_writer_ =
+      detail::write_headers;
+
+  // Settings
+  std::string client_cert_path_;
+  std::string client_key_path_;
+
+  time_t connection_timeout_sec_ = CPPHTTPLIB_CONNECTION_TIMEOUT_SECOND;
+  time_t connection_timeout_usec_ = CPPHTTPLIB_CONNECTION_TIMEOUT_USECOND;
+  time_t read_timeout_sec_ = CPPHTTPLIB_CLIENT_READ_TIMEOUT_SECOND;
+  time_t read_timeout_usec_ = CPPHTTPLIB_CLIENT_READ_TIMEOUT_USECOND;
+  time_t write_timeout_sec_ = CPPHTTPLIB_CLIENT_WRITE_TIMEOUT_SECOND;
+  time_t write_timeout_usec_ = CPPHTTPLIB_CLIENT_WRITE_TIMEOUT_USECOND;
+  time_t max_timeout_msec_ = CPPHTTPLIB_CLIENT_MAX_TIMEOUT_MSECOND;
+
+  std::string basic_auth_username_;
+  std::string basic_auth_password_;
+  std::string bearer_token_auth_token_;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  std::string digest_auth_username_;
+  std::string digest_auth_password_;
+#endif
+
+  bool keep_alive_ = false;
+  bool follow_location_ = false;
+
+  bool path_encode_ = true;
+
+  int address_family_ = AF_UNSPEC;
+  bool tcp_nodelay_ = CPPHTTPLIB_TCP_NODELAY;
+  bool ipv6_v6only_ = CPPHTTPLIB_IPV6_V6ONLY;
+  SocketOptions socket_options_ = nullptr;
+
+  bool compress_ = false;
+  bool decompress_ = true;
+
+  std::string interface_;
+
+  std::string proxy_host_;
+  int proxy_port_ = -1;
+
+  std::string proxy_basic_auth_username_;
+  std::string proxy_basic_auth_password_;
+  std::string proxy_bearer_token_auth_token_;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  std::string proxy_digest_auth_username_;
+  std::string proxy_digest_auth_password_;
+#endif
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  std::string ca_cert_file_path_;
+  std::string ca_cert_dir_path_;
+
+  X509_STORE *ca_cert_store_ = nullptr;
+#endif
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  bool server_certificate_verification_ = true;
+  bool server_hostname_verification_ = true;
+  std::function<SSLVerifierResponse(SSL *ssl)> server_certificate_verifier_;
+#endif
+
+  Logger logger_;
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  int last_ssl_error_ = 0;
+  unsigned long last_openssl_error_ = 0;
+#endif
+
+private:
+  bool send_(Request &req, Response &res, Error &error);
+  Result send_(Request &&req);
+
+  socket_t create_client_socket(Error &error) const;
+  bool read_response_line(Stream &strm, const Request &req,
+                          Response &res) const;
+  bool write_request(Stream &strm, Request &req, bool close_connection,
+                     Error &error);
+  bool redirect(Request &req, Response &res, Error &error);
+  bool create_redirect_client(const std::string &scheme,
+                              const std::string &host, int port, Request &req,
+                              Response &res, const std::string &path,
+                              const std::string &location, Error &error);
+  template <typename ClientType> void setup_redirect_client(ClientType &client);
+  bool handle_request(Stream &strm, Request &req, Response &res,
+                      bool close_connection, Error &error);
+  std::unique_ptr<Response> send_with_content_provider(
+      Request &req, const char *body, size_t content_length,
+      ContentProvider content_provider,
+      ContentProviderWithoutLength content_provider_without_length,
+      const std::string &content_type, Error &error);
+  Result send_with_content_provider(
+      const std::string &method, const std::string &path,
+      const Headers &headers, const char *body, size_t content_length,
+      ContentProvider content_provider,
+      ContentProviderWithoutLength content_provider_without_length,
+      const std::string &content_type, UploadProgress progress);
+  ContentProviderWithoutLength get_multipart_content_provider(
+      const std::string &boundary, const UploadFormDataItems &items,
+      const FormDataProviderItems &provider_items) const;
+
+  std::string adjust_host_string(const std::string &host) const;
+
+  virtual bool
+  process_socket(const Socket &socket,
+                 std::chrono::time_point<std::chrono::steady_clock> start_time,
+                 std::function<bool(Stream &strm)> callback);
+  virtual bool is_ssl() const;
+};
+
+class Client {
+public:
+  // Universal interface
+  explicit Client(const std::string &scheme_host_port);
+
+  explicit Client(const std::string &scheme_host_port,
+                  const std::string &client_cert_path,
+                  const std::string &client_key_path);
+
+  // HTTP only interface
+  explicit Client(const std::string &host, int port);
+
+  explicit Client(const std::string &host, int port,
+                  const std::string &client_cert_path,
+                  const std::string &client_key_path);
+
+  Client(Client &&) = default;
+  Client &operator=(Client &&) = default;
+
+  ~Client();
+
+  bool is_valid() const;
+
+  // clang-format off
+  Result Get(const std::string &path, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Params &params, const Headers &headers, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Params &params, const Headers &headers, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+  Result Get(const std::string &path, const Params &params, const Headers &headers, ResponseHandler response_handler, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Head(const std::string &path);
+  Result Head(const std::string &path, const Headers &headers);
+
+  Result Post(const std::string &path);
+  Result Post(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Params &params);
+  Result Post(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers);
+  Result Post(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const Params &params);
+  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
+  Result Post(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Put(const std::string &path);
+  Result Put(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Params &params);
+  Result Put(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers);
+  Result Put(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const Params &params);
+  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
+  Result Put(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Patch(const std::string &path);
+  Result Patch(const std::string &path, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Params &params);
+  Result Patch(const std::string &path, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers);
+  Result Patch(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, size_t content_length, ContentProvider content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, ContentProviderWithoutLength content_provider, const std::string &content_type, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const Params &params);
+  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const std::string &boundary, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const UploadFormDataItems &items, const FormDataProviderItems &provider_items, UploadProgress progress = nullptr);
+  Result Patch(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, ContentReceiver content_receiver, DownloadProgress progress = nullptr);
+
+  Result Delete(const std::string &path, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Params &params, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, const char *body, size_t content_length, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, const std::string &body, const std::string &content_type, DownloadProgress progress = nullptr);
+  Result Delete(const std::string &path, const Headers &headers, const Params &params, DownloadProgress progress = nullptr);
+
+  Result Options(const std::string &path);
+  Result Options(const std::string &path, const Headers &headers);
+  // clang-format on
+
+  bool send(Request &req, Response &res, Error &error);
+  Result send(const Request &req);
+
+  void stop();
+
+  std::string host() const;
+  int port() const;
+
+  size_t is_socket_open() const;
+  socket_t socket() const;
+
+  void set_hostname_addr_map(std::map<std::string, std::string> addr_map);
+
+  void set_default_headers(Headers headers);
+
+  void
+  set_header_writer(std::function<ssize_t(Stream &, Headers &)> const &writer);
+
+  void set_address_family(int family);
+  void set_tcp_nodelay(bool on);
+  void set_socket_options(SocketOptions socket_options);
+
+  void set_connection_timeout(time_t sec, time_t usec = 0);
+  template <class Rep, class Period>
+  void
+  set_connection_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_read_timeout(time_t sec, time_t usec = 0);
+  template <class Rep, class Period>
+  void set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_write_timeout(time_t sec, time_t usec = 0);
+  template <class Rep, class Period>
+  void set_write_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_max_timeout(time_t msec);
+  template <class Rep, class Period>
+  void set_max_timeout(const std::chrono::duration<Rep, Period> &duration);
+
+  void set_basic_auth(const std::string &username, const std::string &password);
+  void set_bearer_token_auth(const std::string &token);
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void set_digest_auth(const std::string &username,
+                       const std::string &password);
+#endif
+
+  void set_keep_alive(bool on);
+  void set_follow_location(bool on);
+
+  void set_path_encode(bool on);
+  void set_url_encode(bool on);
+
+  void set_compress(bool on);
+
+  void set_decompress(bool on);
+
+  void set_interface(const std::string &intf);
+
+  void set_proxy(const std::string &host, int port);
+  void set_proxy_basic_auth(const std::string &username,
+                            const std::string &password);
+  void set_proxy_bearer_token_auth(const std::string &token);
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void set_proxy_digest_auth(const std::string &username,
+                             const std::string &password);
+#endif
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void enable_server_certificate_verification(bool enabled);
+  void enable_server_hostname_verification(bool enabled);
+  void set_server_certificate_verifier(
+      std::function<SSLVerifierResponse(SSL *ssl)> verifier);
+#endif
+
+  void set_logger(Logger logger);
+
+  // SSL
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  void set_ca_cert_path(const std::string &ca_cert_file_path,
+                        const std::string &ca_cert_dir_path = std::string());
+
+  void set_ca_cert_store(X509_STORE *ca_cert_store);
+  void load_ca_cert_store(const char *ca_cert, std::size_t size);
+
+  long get_openssl_verify_result() const;
+
+  SSL_CTX *ssl_context() const;
+#endif
+
+private:
+  std::unique_ptr<ClientImpl> cli_;
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  bool is_ssl_ = false;
+#endif
+};
+
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+class SSLServer : public Server {
+public:
+  SSLServer(const char *cert_path, const char *private_key_path,
+            const char *client_ca_cert_file_path = nullptr,
+            const char *client_ca_cert_dir_path = nullptr,
+            const char *private_key_password = nullptr);
+
+  SSLServer(X509 *cert, EVP_PKEY *private_key,
+            X509_STORE *client_ca_cert_store = nullptr);
+
+  SSLServer(
+      const std::function<bool(SSL_CTX &ssl_ctx)> &setup_ssl_ctx_callback);
+
+  ~SSLServer() override;
+
+  bool is_valid() const override;
+
+  SSL_CTX *ssl_context() const;
+
+  void update_certs(X509 *cert, EVP_PKEY *private_key,
+                    X509_STORE *client_ca_cert_store = nullptr);
+
+private:
+  bool process_and_close_socket(socket_t sock) override;
+
+  SSL_CTX *ctx_;
+  std::mutex ctx_mutex_;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  int last_ssl_error_ = 0;
+#endif
+};
+
+class SSLClient final : public ClientImpl {
+public:
+  explicit SSLClient(const std::string &host);
+
+  explicit SSLClient(const std::string &host, int port);
+
+  explicit SSLClient(const std::string &host, int port,
+                     const std::string &client_cert_path,
+                     const std::string &client_key_path,
+                     const std::string &private_key_password = std::string());
+
+  explicit SSLClient(const std::string &host, int port, X509 *client_cert,
+                     EVP_PKEY *client_key,
+                     const std::string &private_key_password = std::string());
+
+  ~SSLClient() override;
+
+  bool is_valid() const override;
+
+  void set_ca_cert_store(X509_STORE *ca_cert_store);
+  void load_ca_cert_store(const char *ca_cert, std::size_t size);
+
+  long get_openssl_verify_result() const;
+
+  SSL_CTX *ssl_context() const;
+
+private:
+  bool create_and_connect_socket(Socket &socket, Error &error) override;
+  void shutdown_ssl(Socket &socket, bool shutdown_gracefully) override;
+  void shutdown_ssl_impl(Socket &socket, bool shutdown_gracefully);
+
+  bool
+  process_socket(const Socket &socket,
+                 std::chrono::time_point<std::chrono::steady_clock> start_time,
+                 std::function<bool(Stream &strm)> callback) override;
+  bool is_ssl() const override;
+
+  bool connect_with_proxy(
+      Socket &sock,
+      std::chrono::time_point<std::chrono::steady_clock> start_time,
+      Response &res, bool &success, Error &error);
+  bool initialize_ssl(Socket &socket, Error &error);
+
+  bool load_certs();
+
+  bool verify_host(X509 *server_cert) const;
+  bool verify_host_with_subject_alt_name(X509 *server_cert) const;
+  bool verify_host_with_common_name(X509 *server_cert) const;
+  bool check_host_name(const char *pattern, size_t pattern_len) const;
+
+  SSL_CTX *ctx_;
+  std::mutex ctx_mutex_;
+  std::once_flag initialize_cert_;
+
+  std::vector<std::string> host_components_;
+
+  long verify_result_ = 0;
+
+  friend class ClientImpl;
+};
+#endif
+
+/*
+ * Implementation of template methods.
+ */
+
+namespace detail {
+
+template <typename T, typename U>
+inline void duration_to_sec_and_usec(const T &duration, U callback) {
+  auto sec = std::chrono::duration_cast<std::chrono::seconds>(duration).count();
+  auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                  duration - std::chrono::seconds(sec))
+                  .count();
+  callback(static_cast<time_t>(sec), static_cast<time_t>(usec));
+}
+
+template <size_t N> inline constexpr size_t str_len(const char (&)[N]) {
+  return N - 1;
+}
+
+inline bool is_numeric(const char *s, size_t n) {
+  return n > 0 && std::all_of(s, s + n, [](unsigned char c) {
+           return std::isdigit(c);
+         });
+}
+
+inline bool is_numeric(const std::string &str) {
+  return is_numeric(str.data(), str.size());
+}
+
+inline size_t get_header_value_u64(const Headers &headers,
+                                   const std::string &key, size_t def,
+                                   size_t id, bool &is_invalid_value) {
+  is_invalid_value = false;
+  auto rng = headers.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) {
+    if (is_numeric(it->second)) {
+      return std::strtoull(it->second.data(), nullptr, 10);
+    } else {
+      is_invalid_value = true;
+    }
+  }
+  return def;
+}
+
+inline size_t get_header_value_u64(const Headers &headers,
+                                   const std::string &key, size_t def,
+                                   size_t id) {
+  bool dummy = false;
+  return get_header_value_u64(headers, key, def, id, dummy);
+}
+
+} // namespace detail
+
+namespace detail {
+
+inline size_t get_header_value_u64(const Request &req, const std::string &key,
+                                   size_t def, size_t id,
+                                   bool &is_invalid_value) {
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+  auto field = req.find_header_field(key, id);
+  if (field) {
+    is_invalid_value = false;
+    auto val = req.header_block_.data() + field->value_offset;
+    if (is_numeric(val, field->value_length)) {
+      return std::strtoull(val, nullptr, 10);
+    }
+    is_invalid_value = true;
+    return def;
+  }
+#endif
+  return get_header_value_u64(req.headers, key, def, id, is_invalid_value);
+}
+
+inline size_t get_header_value_u64(const Response &res, const std::string &key,
+                                   size_t def, size_t id,
+                                   bool &is_invalid_value) {
+  return get_header_value_u64(res.headers, key, def, id, is_invalid_value);
+}
+
+} // namespace detail
+
+inline size_t Request::get_header_value_u64(const std::string &key, size_t def,
+                                            size_t id) const {
+  bool dummy = false;
+  return detail::get_header_value_u64(*this, key, def, id, dummy);
+}
+
+inline size_t Response::get_header_value_u64(const std::string &key, size_t def,
+                                             size_t id) const {
+  return detail::get_header_value_u64(headers, key, def, id);
+}
+
+namespace detail {
+
+inline bool set_socket_opt_impl(socket_t sock, int level, int optname,
+                                const void *optval, socklen_t optlen) {
+  return setsockopt(sock, level, optname,
+#ifdef _WIN64
+                    reinterpret_cast<const char *>(optval),
+#else
+                    optval,
+#endif
+                    optlen) == 0;
+}
+
+inline bool set_socket_opt(socket_t sock, int level, int optname, int optval) {
+  return set_socket_opt_impl(sock, level, optname, &optval, sizeof(optval));
+}
+
+inline bool set_socket_opt_time(socket_t sock, int level, int optname,
+                                time_t sec, time_t usec) {
+#ifdef _WIN64
+  auto timeout = static_cast<uint32_t>(sec * 1000 + usec / 1000);
+#else
+  timeval timeout;
+  timeout.tv_sec = static_cast<long>(sec);
+  timeout.tv_usec = static_cast<decltype(timeout.tv_usec)>(usec);
+#endif
+  return set_socket_opt_impl(sock, level, optname, &timeout, sizeof(timeout));
+}
+
+} // namespace detail
+
+inline void default_socket_options(socket_t sock) {
+  detail::set_socket_opt(sock, SOL_SOCKET,
+#ifdef SO_REUSEPORT
+                         SO_REUSEPORT,
+#else
+                         SO_REUSEADDR,
+#endif
+                         1);
+}
+
+inline const char *status_message(int status) {
+  switch (status) {
+  case StatusCode::Continue_100: return "Continue";
+  case StatusCode::SwitchingProtocol_101: return "Switching Protocol";
+  case StatusCode::Processing_102: return "Processing";
+  case StatusCode::EarlyHints_103: return "Early Hints";
+  case StatusCode::OK_200: return "OK";
+  case StatusCode::Created_201: return "Created";
+  case StatusCode::Accepted_202: return "Accepted";
+  case StatusCode::NonAuthoritativeInformation_203:
+    return "Non-Authoritative Information";
+  case StatusCode::NoContent_204: return "No Content";
+  case StatusCode::ResetContent_205: return "Reset Content";
+  case StatusCode::PartialContent_206: return "Partial Content";
+  case StatusCode::MultiStatus_207: return "Multi-Status";
+  case StatusCode::AlreadyReported_208: return "Already Reported";
+  case StatusCode::IMUsed_226: return "IM Used";
+  case StatusCode::MultipleChoices_300: return "Multiple Choices";
+  case StatusCode::MovedPermanently_301: return "Moved Permanently";
+  case StatusCode::Found_302: return "Found";
+  case StatusCode::SeeOther_303: return "See Other";
+  case StatusCode::NotModified_304: return "Not Modified";
+  case StatusCode::UseProxy_305: return "Use Proxy";
+  case StatusCode::unused_306: return "unused";
+  case StatusCode::TemporaryRedirect_307: return "Temporary Redirect";
+  case StatusCode::PermanentRedirect_308: return "Permanent Redirect";
+  case StatusCode::BadRequest_400: return "Bad Request";
+  case StatusCode::Unauthorized_401: return "Unauthorized";
+  case StatusCode::PaymentRequired_402: return "Payment Required";
+  case StatusCode::Forbidden_403: return "Forbidden";
+  case StatusCode::NotFound_404: return "Not Found";
+  case StatusCode::MethodNotAllowed_405: return "Method Not Allowed";
+  case StatusCode::NotAcceptable_406: return "Not Acceptable";
+  case StatusCode::ProxyAuthenticationRequired_407:
+    return "Proxy Authentication Required";
+  case StatusCode::RequestTimeout_408: return "Request Timeout";
+  case StatusCode::Conflict_409: return "Conflict";
+  case StatusCode::Gone_410: return "Gone";
+  case StatusCode::LengthRequired_411: return "Length Required";
+  case StatusCode::PreconditionFailed_412: return "Precondition Failed";
+  case StatusCode::PayloadTooLarge_413: return "Payload Too Large";
+  case StatusCode::UriTooLong_414: return "URI Too Long";
+  case StatusCode::UnsupportedMediaType_415: return "Unsupported Media Type";
+  case StatusCode::RangeNotSatisfiable_416: return "Range Not Satisfiable";
+  case StatusCode::ExpectationFailed_417: return "Expectation Failed";
+  case StatusCode::ImATeapot_418: return "I'm a teapot";
+  case StatusCode::MisdirectedRequest_421: return "Misdirected Request";
+  case StatusCode::UnprocessableContent_422: return "Unprocessable Content";
+  case StatusCode::Locked_423: return "Locked";
+  case StatusCode::FailedDependency_424: return "Failed Dependency";
+  case StatusCode::TooEarly_425: return "Too Early";
+  case StatusCode::UpgradeRequired_426: return "Upgrade Required";
+  case StatusCode::PreconditionRequired_428: return "Precondition Required";
+  case StatusCode::TooManyRequests_429: return "Too Many Requests";
+  case StatusCode::RequestHeaderFieldsTooLarge_431:
+    return "Request Header Fields Too Large";
+  case StatusCode::UnavailableForLegalReasons_451:
+    return "Unavailable For Legal Reasons";
+  case StatusCode::NotImplemented_501: return "Not Implemented";
+  case StatusCode::BadGateway_502: return "Bad Gateway";
+  case StatusCode::ServiceUnavailable_503: return "Service Unavailable";
+  case StatusCode::GatewayTimeout_504: return "Gateway Timeout";
+  case StatusCode::HttpVersionNotSupported_505:
+    return "HTTP Version Not Supported";
+  case StatusCode::VariantAlsoNegotiates_506: return "Variant Also Negotiates";
+  case StatusCode::InsufficientStorage_507: return "Insufficient Storage";
+  case StatusCode::LoopDetected_508: return "Loop Detected";
+  case StatusCode::NotExtended_510: return "Not Extended";
+  case StatusCode::NetworkAuthenticationRequired_511:
+    return "Network Authentication Required";
+
+  default:
+  case StatusCode::InternalServerError_500: return "Internal Server Error";
+  }
+}
+
+inline std::string get_bearer_token_auth(const Request &req) {
+  if (req.has_header("Authorization")) {
+    constexpr auto bearer_header_prefix_len = detail::str_len("Bearer ");
+    return req.get_header_value("Authorization")
+        .substr(bearer_header_prefix_len);
+  }
+  return "";
+}
+
+template <class Rep, class Period>
+inline Server &
+Server::set_read_timeout(const std::chrono::duration<Rep, Period> &duration) {
+  detail::duration_to_sec_and_usec(
+      duration, [&](time_t sec, time_t usec) { set_read_timeout(sec, usec); });
+  return *this;
+}
+
+template <class Rep, class Period>
+inline Server &
+Server::set_write_timeout(const std::chrono::duration<Rep, Period> &duration) {
+  detail::duration_to_sec_and_usec(
+      duration, [&](time_t sec, time_t usec) { set_write_timeout(sec, usec); });
+  return *this;
+}
+
+template <class Rep, class Period>
+inline Server &
+Server::set_idle_interval(const std::chrono::duration<Rep, Period> &duration) {
+  detail::duration_to_sec_and_usec(
+      duration, [&](time_t sec, time_t usec) { set_idle_interval(sec, usec); });
+  return *this;
+}
+
+inline std::string to_string(const Error error) {
+  switch (error) {
+  case Error::Success: return "Success (no error)";
+  case Error::Connection: return "Could not establish connection";
+  case Error::BindIPAddress: return "Failed to bind IP address";
+  case Error::Read: return "Failed to read connection";
+  case Error::Write: return "Failed to write connection";
+  case Error::ExceedRedirectCount: return "Maximum redirect count exceeded";
+  case Error::Canceled: return "Connection handling canceled";
+  case Error::SSLConnection: return "SSL connection failed";
+  case Error::SSLLoadingCerts: return "SSL certificate loading failed";
+  case Error::SSLServerVerification: return "SSL server verification failed";
+  case Error::SSLServerHostnameVerification:
+    return "SSL server hostname verification failed";
+  case Error::UnsupportedMultipartBoundaryChars:
+    return "Unsupported HTTP multipart boundary characters";
+  case Error::Compression: return "Compression failed";
+  case Error::ConnectionTimeout: return "Connection timed out";
+  case Error::ProxyConnection: return "Proxy connection failed";
+  case Error::Unknown: return "Unknown";
+  default: break;
+  }
+
+  return "Invalid";
+}
+
+inline std::ostream &operator<<(std::ostream &os, const Error &obj) {
+  os << to_string(obj);
+  os << " (" << static_cast<std::underlying_type<Error>::type>(obj) << ')';
+  return os;
+}
+
+inline size_t Result::get_request_header_value_u64(const std::string &key,
+                                                   size_t def,
+                                                   size_t id) const {
+  return detail::get_header_value_u64(request_headers_, key, def, id);
+}
+
+template <class Rep, class Period>
+inline void ClientImpl::set_connection_timeout(
+    const std::chrono::duration<Rep, Period> &duration) {
+  detail::duration_to_sec_and_usec(duration, [&](time_t sec, time_t usec) {
+    set_connection_timeout(sec, usec);
+  });
+}
+
+template <class Rep, class Period>
+inline void ClientImpl::set_read_timeout(
+    const std::chrono::duration<Rep, Period> &duration) {
+  detail::duration_to_sec_and_usec(
+      duration, [&](time_t sec, time_t usec) { set_read_timeout(sec, usec); });
+}
+
+template <class Rep, class Period>
+inline void ClientImpl::set_write_timeout(
+    const std::chrono::duration<Rep, Period> &duration) {
+  detail::duration_to_sec_and_usec(
+      duration, [&](time_t sec, time_t usec) { set_write_timeout(sec, usec); });
+}
+
+template <class Rep, class Period>
+inline void ClientImpl::set_max_timeout(
+    const std::chrono::duration<Rep, Period> &duration) {
+  auto msec =
+      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  set_max_timeout(msec);
+}
+
+template <class Rep, class Period>
+inline void Client::set_connection_timeout(
+    const std::chrono::duration<Rep, Period> &duration) {
+  cli_->set_connection_timeout(duration);
+}
+
+template <class Rep, class Period>
+inline void
+Client::set_read_timeout(const std::chrono::duration<Rep, Period> &duration) {
+  cli_->set_read_timeout(duration);
+}
+
+template <class Rep, class Period>
+inline void
+Client::set_write_timeout(const std::chrono::duration<Rep, Period> &duration) {
+  cli_->set_write_timeout(duration);
+}
+
+template <class Rep, class Period>
+inline void
+Client::set_max_timeout(const std::chrono::duration<Rep, Period> &duration) {
+  cli_->set_max_timeout(duration);
+}
+
+/*
+ * Forward declarations and types that will be part of the .h file if split into
+ * .h + .cc.
+ */
+
+std::string hosted_at(const std::string &hostname);
+
+void hosted_at(const std::string &hostname, std::vector<std::string> &addrs);
+
+std::string encode_uri_component(const std::string &value);
+
+std::string encode_uri(const std::string &value);
+
+std::string decode_uri_component(const std::string &value);
+
+std::string decode_uri(const std::string &value);
+
+std::string encode_query_param(const std::string &value);
+
+std::string append_query_params(const std::string &path, const Params &params);
+
+std::pair<std::string, std::string> make_range_header(const Ranges &ranges);
+
+std::pair<std::string, std::string>
+make_basic_authentication_header(const std::string &username,
+                                 const std::string &password,
+                                 bool is_proxy = false);
+
+namespace detail {
+
+#if defined(_WIN64)
+inline std::wstring u8string_to_wstring(const char *s) {
+  std::wstring ws;
+  auto len = static_cast<int>(strlen(s));
+  auto wlen = ::MultiByteToWideChar(CP_UTF8, 0, s, len, nullptr, 0);
+  if (wlen > 0) {
+    ws.resize(wlen);
+    wlen = ::MultiByteToWideChar(
+        CP_UTF8, 0, s, len,
+        const_cast<LPWSTR>(reinterpret_cast<LPCWSTR>(ws.data())), wlen);
+    if (wlen != static_cast<int>(ws.size())) { ws.clear(); }
+  }
+  return ws;
+}
+#endif
+
+struct FileStat {
+  FileStat(const std::string &path);
+  bool is_file() const;
+  bool is_dir() const;
+  size_t size() const;
+  time_t mtime() const;
+
+private:
+#if defined(_WIN64)
+  struct _stat st_;
+#else
+  struct stat st_;
+#endif
+  int ret_ = -1;
+};
+
+std::string decode_path(const std::string &s, bool convert_plus_to_space);
+
+std::string trim_copy(const std::string &s);
+
+void divide(
+    const char *data, std::size_t size, char d,
+    std::function<void(const char *, std::size_t, const char *, std::size_t)>
+        fn);
+
+void divide(
+    const std::string &str, char d,
+    std::function<void(const char *, std::size_t, const char *, std::size_t)>
+        fn);
+
+void split(const char *b, const char *e, char d,
+           std::function<void(const char *, const char *)> fn);
+
+void split(const char *b, const char *e, char d, size_t m,
+           std::function<void(const char *, const char *)> fn);
+
+bool process_client_socket(
+    socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
+    time_t write_timeout_sec, time_t write_timeout_usec,
+    time_t max_timeout_msec,
+    std::chrono::time_point<std::chrono::steady_clock> start_time,
+    std::function<bool(Stream &)> callback);
+
+socket_t create_client_socket(const std::string &host, const std::string &ip,
+                              int port, int address_family, bool tcp_nodelay,
+                              bool ipv6_v6only, SocketOptions socket_options,
+                              time_t connection_timeout_sec,
+                              time_t connection_timeout_usec,
+                              time_t read_timeout_sec, time_t read_timeout_usec,
+                              time_t write_timeout_sec,
+                              time_t write_timeout_usec,
+                              const std::string &intf, Error &error);
+
+const char *get_header_value(const Headers &headers, const std::string &key,
+                             const char *def, size_t id);
+
+std::string params_to_query_str(const Params &params);
+
+void parse_query_text(const char *data, std::size_t size, Params &params);
+
+void parse_query_text(const std::string &s, Params &params);
+
+bool parse_multipart_boundary(const std::string &content_type,
+                              std::string &boundary);
+
+bool parse_range_header(const std::string &s, Ranges &ranges);
+
+bool parse_accept_header(const std::string &s,
+                         std::vector<std::string> &content_types);
+
+int close_socket(socket_t sock);
+
+ssize_t send_socket(socket_t sock, const void *ptr, size_t size, int flags);
+
+ssize_t read_socket(socket_t sock, void *ptr, size_t size, int flags);
+
+bool accepts_encoding(const std::string &accept_encoding,
+                      const std::string &coding);
+
+class BufferStream final : public Stream {
+public:
+  BufferStream() = default;
+  ~BufferStream() override = default;
+
+  bool is_readable() const override;
+  bool wait_readable() const override;
+  bool wait_writable() const override;
+  ssize_t read(char *ptr, size_t size) override;
+  ssize_t write(const char *ptr, size_t size) override;
+  void get_remote_ip_and_port(std::string &ip, int &port) const override;
+  void get_local_ip_and_port(std::string &ip, int &port) const override;
+  socket_t socket() const override;
+  time_t duration() const override;
+
+  const std::string &get_buffer() const;
+
+private:
+  std::string buffer;
+  size_t position = 0;
+};
+
+class compressor {
+public:
+  virtual ~compressor() = default;
+
+  typedef std::function<bool(const char *data, size_t data_len)> Callback;
+  virtual bool compress(const char *data, size_t data_length, bool last,
+                        Callback callback) = 0;
+};
+
+class decompressor {
+public:
+  virtual ~decompressor() = default;
+
+  virtual bool is_valid() const = 0;
+
+  typedef std::function<bool(const char *data, size_t data_len)> Callback;
+  virtual bool decompress(const char *data, size_t data_length,
+                          Callback callback) = 0;
+};
+
+class nocompressor final : public compressor {
+public:
+  ~nocompressor() override = default;
+
+  bool compress(const char *data, size_t data_length, bool /*last*/,
+                Callback callback) override;
+};
+
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+class gzip_compressor final : public compressor {
+public:
+  gzip_compressor();
+  ~gzip_compressor() override;
+
+  bool compress(const char *data, size_t data_length, bool last,
+                Callback callback) override;
+  bool reset(int level);
+
+private:
+  bool is_valid_ = false;
+  z_stream strm_;
+};
+
+class gzip_decompressor final : public decompressor {
+public:
+  gzip_decompressor();
+  ~gzip_decompressor() override;
+
+  bool is_valid() const override;
+
+  bool decompress(const char *data, size_t data_length,
+                  Callback callback) override;
+
+private:
+  bool is_valid_ = false;
+  z_stream strm_;
+};
+#endif
+
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+class brotli_compressor final : public compressor {
+public:
+  brotli_compressor();
+  ~brotli_compressor();
+
+  bool compress(const char *data, size_t data_length, bool last,
+                Callback callback) override;
+  bool reset(int level);
+
+private:
+  BrotliEncoderState *state_ = nullptr;
+};
+
+class brotli_decompressor final : public decompressor {
+public:
+  brotli_decompressor();
+  ~brotli_decompressor();
+
+  bool is_valid() const override;
+
+  bool decompress(const char *data, size_t data_length,
+                  Callback callback) override;
+
+private:
+  BrotliDecoderResult decoder_r;
+  BrotliDecoderState *decoder_s = nullptr;
+};
+#endif
+
+#ifdef CPPHTTPLIB_ZSTD_SUPPORT
+class zstd_compressor : public compressor {
+public:
+  zstd_compressor();
+  ~zstd_compressor();
+
+  bool compress(const char *data, size_t data_length, bool last,
+                Callback callback) override;
+  bool reset(int level);
+
+private:
+  ZSTD_CCtx *ctx_ = nullptr;
+};
+
+class zstd_decompressor : public decompressor {
+public:
+  zstd_decompressor();
+  ~zstd_decompressor();
+
+  bool is_valid() const override;
+
+  bool decompress(const char *data, size_t data_length,
+                  Callback callback) override;
+
+private:
+  ZSTD_DCtx *ctx_ = nullptr;
+};
+#endif
+
+// NOTE: until the read size reaches `fixed_buffer_size`, use `fixed_buffer`
+// to store data. The call can set memory on stack for performance.
+class stream_line_reader {
+public:
+  stream_line_reader(Stream &strm, char *fixed_buffer,
+                     size_t fixed_buffer_size);
+  const char *ptr() const;
+  size_t size() const;
+  bool end_with_crlf() const;
+  bool getline();
+
+private:
+  void append(char c);
+
+  Stream &strm_;
+  char *fixed_buffer_;
+  const size_t fixed_buffer_size_;
+  size_t fixed_buffer_used_size_ = 0;
+  std::string growable_buffer_;
+};
+
+class mmap {
+public:
+  mmap(const char *path);
+  ~mmap();
+
+  bool open(const char *path);
+  void close();
+
+  bool is_open() const;
+  size_t size() const;
+  const char *data() const;
+#if !defined(_WIN64)
+  int fd() const;
+#endif
+
+private:
+#if defined(_WIN64)
+  HANDLE hFile_ = NULL;
+  HANDLE hMapping_ = NULL;
+#else
+  int fd_ = -1;
+#endif
+  size_t size_ = 0;
+  void *addr_ = nullptr;
+  bool is_open_empty_file = false;
+};
+
+// NOTE: https://www.rfc-editor.org/rfc/rfc9110#section-5
+namespace fields {
+
+inline bool is_token_char(char c) {
+  return std::isalnum(c) || c == '!' || c == '#' || c == '$' || c == '%' ||
+         c == '&' || c == '\'' || c == '*' || c == '+' || c == '-' ||
+         c == '.' || c == '^' || c == '_' || c == '`' || c == '|' || c == '~';
+}
+
+inline bool is_token(const char *s, size_t n) {
+  if (!n) { return false; }
+  return std::all_of(s, s + n, is_token_char);
+}
+
+inline bool is_token(const std::string &s) {
+  return is_token(s.data(), s.size());
+}
+
+inline bool is_field_name(const std::string &s) { return is_token(s); }
+
+inline bool is_vchar(char c) { return c >= 33 && c <= 126; }
+
+inline bool is_obs_text(char c) { return 128 <= static_cast<unsigned char>(c); }
+
+inline bool is_field_vchar(char c) { return is_vchar(c) || is_obs_text(c); }
+
+inline bool is_field_content(const char *s, size_t n) {
+  if (!n) { return true; }
+
+  if (n == 1) {
+    return is_field_vchar(s[0]);
+  } else if (n == 2) {
+    return is_field_vchar(s[0]) && is_field_vchar(s[1]);
+  } else {
+    size_t i = 0;
+
+    if (!is_field_vchar(s[i])) { return false; }
+    i++;
+
+    while (i < n - 1) {
+      auto c = s[i++];
+      if (c == ' ' || c == '\t' || is_field_vchar(c)) {
+      } else {
+        return false;
+      }
+    }
+
+    return is_field_vchar(s[i]);
+  }
+}
+
+inline bool is_field_content(const std::string &s) {
+  return is_field_content(s.data(), s.size());
+}
+
+inline bool is_field_value(const std::string &s) { return is_field_content(s); }
+
+} // namespace fields
+
+} // namespace detail
+
+// ----------------------------------------------------------------------------
+
+/*
+ * Implementation that will be part of the .cc file if split into .h + .cc.
+ */
+
+namespace detail {
+
+inline bool is_hex(char c, int &v) {
+  if (0x20 <= c && isdigit(c)) {
+    v = c - '0';
+    return true;
+  } else if ('A' <= c && c <= 'F') {
+    v = c - 'A' + 10;
+    return true;
+  } else if ('a' <= c && c <= 'f') {
+    v = c - 'a' + 10;
+    return true;
+  }
+  return false;
+}
+
+inline bool from_hex_to_i(const std::string &s, size_t i, size_t cnt,
+                          int &val) {
+  if (i >= s.size()) { return false; }
+
+  val = 0;
+  for (; cnt; i++, cnt--) {
+    if (!s[i]) { return false; }
+    auto v = 0;
+    if (is_hex(s[i], v)) {
+      val = val * 16 + v;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline std::string from_i_to_hex(size_t n) {
+  static const auto charset = "0123456789abcdef";
+  std::string ret;
+  do {
+    ret = charset[n & 15] + ret;
+    n >>= 4;
+  } while (n > 0);
+  return ret;
+}
+
+inline size_t to_utf8(int code, char *buff) {
+  if (code < 0x0080) {
+    buff[0] = static_cast<char>(code & 0x7F);
+    return 1;
+  } else if (code < 0x0800) {
+    buff[0] = static_cast<char>(0xC0 | ((code >> 6) & 0x1F));
+    buff[1] = static_cast<char>(0x80 | (code & 0x3F));
+    return 2;
+  } else if (code < 0xD800) {
+    buff[0] = static_cast<char>(0xE0 | ((code >> 12) & 0xF));
+    buff[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    buff[2] = static_cast<char>(0x80 | (code & 0x3F));
+    return 3;
+  } else if (code < 0xE000) { // D800 - DFFF is invalid...
+    return 0;
+  } else if (code < 0x10000) {
+    buff[0] = static_cast<char>(0xE0 | ((code >> 12) & 0xF));
+    buff[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    buff[2] = static_cast<char>(0x80 | (code & 0x3F));
+    return 3;
+  } else if (code < 0x110000) {
+    buff[0] = static_cast<char>(0xF0 | ((code >> 18) & 0x7));
+    buff[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    buff[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    buff[3] = static_cast<char>(0x80 | (code & 0x3F));
+    return 4;
+  }
+
+  // NOTREACHED
+  return 0;
+}
+
+// NOTE: This code came up with the following stackoverflow post:
+// https://stackoverflow.com/questions/180947/base64-decode-snippet-in-c
+inline std::string base64_encode(const std::string &in) {
+  static const auto lookup =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string out;
+  out.reserve(in.size());
+
+  auto val = 0;
+  auto valb = -6;
+
+  for (auto c : in) {
+    val = (val << 8) + static_cast<uint8_t>(c);
+    valb += 8;
+    while (valb >= 0) {
+      out.push_back(lookup[(val >> valb) & 0x3F]);
+      valb -= 6;
+    }
+  }
+
+  if (valb > -6) { out.push_back(lookup[((val << 8) >> (valb + 8)) & 0x3F]); }
+
+  while (out.size() % 4) {
+    out.push_back('=');
+  }
+
+  return out;
+}
+
+inline bool is_valid_path(const std::string &path) {
+  size_t level = 0;
+  size_t i = 0;
+
+  // Skip slash
+  while (i < path.size() && path[i] == '/') {
+    i++;
+  }
+
+  while (i < path.size()) {
+    // Read component
+    auto beg = i;
+    while (i < path.size() && path[i] != '/') {
+      if (path[i] == '\0') {
+        return false;
+      } else if (path[i] == '\\') {
+        return false;
+      }
+      i++;
+    }
+
+    auto len = i - beg;
+    assert(len > 0);
+
+    if (!path.compare(beg, len, ".")) {
+      ;
+    } else if (!path.compare(beg, len, "..")) {
+      if (level == 0) { return false; }
+      level--;
+    } else {
+      level++;
+    }
+
+    // Skip slash
+    while (i < path.size() && path[i] == '/') {
+      i++;
+    }
+  }
+
+  return true;
+}
+
+inline FileStat::FileStat(const std::string &path) {
+#if defined(_WIN64)
+  auto wpath = u8string_to_wstring(path.c_str());
+  ret_ = _wstat(wpath.c_str(), &st_);
+#else
+  ret_ = stat(path.c_str(), &st_);
+#endif
+}
+inline bool FileStat::is_file() const {
+  return ret_ >= 0 && S_ISREG(st_.st_mode);
+}
+inline bool FileStat::is_dir() const {
+  return ret_ >= 0 && S_ISDIR(st_.st_mode);
+}
+inline size_t FileStat::size() const {
+  return ret_ >= 0 ? static_cast<size_t>(st_.st_size) : 0;
+}
+inline time_t FileStat::mtime() const { return ret_ >= 0 ? st_.st_mtime : 0; }
+
+// NOTE: https://www.rfc-editor.org/rfc/rfc9110#section-5.6.7
+inline std::string http_date(time_t t) {
+  static const char *days[] = {"Sun", "Mon", "Tue", "Wed",
+                               "Thu", "Fri", "Sat"};
+  static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+  struct tm tm_buf;
+#if defined(_WIN64)
+  if (gmtime_s(&tm_buf, &t) != 0) { return std::string(); }
+#else
+  if (!gmtime_r(&t, &tm_buf)) { return std::string(); }
+#endif
+
+  char buf[64];
+  auto len = snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                      days[tm_buf.tm_wday], tm_buf.tm_mday,
+                      months[tm_buf.tm_mon], tm_buf.tm_year + 1900,
+                      tm_buf.tm_hour, tm_buf.tm_min, tm_buf.tm_sec);
+  return std::string(buf, static_cast<size_t>(len));
+}
+
+// Strong validator derived from the content (FNV-1a) and its length
+inline std::string make_etag(const std::string &data) {
+  uint64_t hash = 14695981039346656037ull;
+  for (auto c : data) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+
+  char buf[48];
+  auto len = snprintf(buf, sizeof(buf), "\"%016llx-%zx\"",
+                      static_cast<unsigned long long>(hash), data.size());
+  return std::string(buf, static_cast<size_t>(len));
+}
+
+// NOTE: https://www.rfc-editor.org/rfc/rfc9110#section-13.1.2
+// If-None-Match is "*" or a list of entity tags, any of which may match, and
+// uses the weak comparison function.
+inline bool etag_matches(const std::string &if_none_match,
+                         const std::string &etag) {
+  auto matched = false;
+  split(if_none_match.data(), if_none_match.data() + if_none_match.size(), ',',
+        [&](const char *b, const char *e) {
+          if (matched) { return; }
+          if (e - b == 1 && *b == '*') {
+            matched = true;
+            return;
+          }
+          if (e - b > 2 && b[0] == 'W' && b[1] == '/') { b += 2; }
+          matched = !etag.compare(0, std::string::npos, b,
+                                  static_cast<size_t>(e - b));
+        });
+  return matched;
+}
+
+inline std::string encode_path(const std::string &s) {
+  std::string result;
+  result.reserve(s.size());
+
+  for (size_t i = 0; s[i]; i++) {
+    switch (s[i]) {
+    case ' ': result += "%20"; break;
+    case '+': result += "%2B"; break;
+    case '\r': result += "%0D"; break;
+    case '\n': result += "%0A"; break;
+    case '\'': result += "%27"; break;
+    case ',': result += "%2C"; break;
+    // case ':': result += "%3A"; break; // ok? probably...
+    case ';': result += "%3B"; break;
+    default:
+      auto c = static_cast<uint8_t>(s[i]);
+      if (c >= 0x80) {
+        result += '%';
+        char hex[4];
+        auto len = snprintf(hex, sizeof(hex) - 1, "%02X", c);
+        assert(len == 2);
+        result.append(hex, static_cast<size_t>(len));
+      } else {
+        result += s[i];
+      }
+      break;
+    }
   }
-  return def;
+
+  return result;
 }
 
-inline size_t get_header_value_u64(const Headers &headers,
-                                   const std::string &key, size_t def,
-                                   size_t id) {
-  bool dummy = false;
-  return get_header_value_u64(headers, key, def, id, dummy);
+inline std::string decode_path(const std::string &s,
+                               bool convert_plus_to_space) {
+  std::string result;
+
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '%' && i + 1 < s.size()) {
+      if (s[i + 1] == 'u') {
+        auto val = 0;
+        if (from_hex_to_i(s, i + 2, 4, val)) {
+          // 4 digits Unicode codes
+          char buff[4];
+          size_t len = to_utf8(val, buff);
+          if (len > 0) { result.append(buff, len); }
+          i += 5; // 'u0000'
+        } else {
+          result += s[i];
+        }
+      } else {
+        auto val = 0;
+        if (from_hex_to_i(s, i + 1, 2, val)) {
+          // 2 digits hex codes
+          result += static_cast<char>(val);
+          i += 2; // '00'
+        } else {
+          result += s[i];
+        }
+      }
+    } else if (convert_plus_to_space && s[i] == '+') {
+      result += ' ';
+    } else {
+      result += s[i];
+    }
+  }
+
+  return result;
 }
 
-} // namespace detail
+inline std::string file_extension(const std::string &path) {
+  std::smatch m;
+  thread_local auto re = std::regex("\\.([a-zA-Z0-9]+)$");
+  if (std::regex_search(path, m, re)) { return m[1].str(); }
+  return std::string();
+}
 
-inline size_t Request::get_header_value_u64(const std::string &key, size_t def,
-                                            size_t id) const {
-  return detail::get_header_value_u64(headers, key, def, id);
+inline bool is_space_or_tab(char c) { return c == ' ' || c == '\t'; }
+
+inline std::pair<size_t, size_t> trim(const char *b, const char *e, size_t left,
+                                      size_t right) {
+  while (b + left < e && is_space_or_tab(b[left])) {
+    left++;
+  }
+  while (right > 0 && is_space_or_tab(b[right - 1])) {
+    right--;
+  }
+  return std::make_pair(left, right);
 }
 
-inline size_t Response::get_header_value_u64(const std::string &key, size_t def,
-                                             size_t id) const {
-  return detail::get_header_value_u64(headers, key, def, id);
+inline std::string trim_copy(const std::string &s) {
+  auto r = trim(s.data(), s.data() + s.size(), 0, s.size());
+  return s.substr(r.first, r.second - r.first);
 }
 
-namespace detail {
+inline std::string trim_double_quotes_copy(const std::string &s) {
+  if (s.length() >= 2 && s.front() == '"' && s.back() == '"') {
+    return s.substr(1, s.size() - 2);
+  }
+  return s;
+}
 
-inline bool set_socket_opt_impl(socket_t sock, int level, int optname,
-                                const void *optval, socklen_t optlen) {
-  return setsockopt(sock, level, optname,
-#ifdef _WIN64
-                    reinterpret_cast<const char *>(optval),
-#else
-                    optval,
-#endif
-                    optlen) == 0;
+inline void
+divide(const char *data, std::size_t size, char d,
+       std::function<void(const char *, std::size_t, const char *, std::size_t)>
+           fn) {
+  const auto it = std::find(data, data + size, d);
+  const auto found = static_cast<std::size_t>(it != data + size);
+  const auto lhs_data = data;
+  const auto lhs_size = static_cast<std::size_t>(it - data);
+  const auto rhs_data = it + found;
+  const auto rhs_size = size - lhs_size - found;
+
+  fn(lhs_data, lhs_size, rhs_data, rhs_size);
 }
 
-inline bool set_socket_opt(socket_t sock, int level, int optname, int optval) {
-  return set_socket_opt_impl(sock, level, optname, &optval, sizeof(optval));
+inline void
+divide(const std::string &str, char d,
+       std::function<void(const char *, std::size_t, const char *, std::size_t)>
+           fn) {
+  divide(str.data(), str.size(), d, std::move(fn));
 }
 
-inline bool set_socket_opt_time(socket_t sock, int level, int optname,
-                                time_t sec, time_t usec) {
-#ifdef _WIN64
-  auto timeout = static_cast<uint32_t>(sec * 1000 + usec / 1000);
+inline void split(const char *b, const char *e, char d,
+                  std::function<void(const char *, const char *)> fn) {
+  return split(b, e, d, (std::numeric_limits<size_t>::max)(), std::move(fn));
+}
+
+inline void split(const char *b, const char *e, char d, size_t m,
+                  std::function<void(const char *, const char *)> fn) {
+  size_t i = 0;
+  size_t beg = 0;
+  size_t count = 1;
+
+  while (e ? (b + i < e) : (b[i] != '\0')) {
+    if (b[i] == d && count < m) {
+      auto r = trim(b, e, beg, i);
+      if (r.first < r.second) { fn(&b[r.first], &b[r.second]); }
+      beg = i + 1;
+      count++;
+    }
+    i++;
+  }
+
+  if (i) {
+    auto r = trim(b, e, beg, i);
+    if (r.first < r.second) { fn(&b[r.first], &b[r.second]); }
+  }
+}
+
+inline stream_line_reader::stream_line_reader(Stream &strm, char *fixed_buffer,
+                                              size_t fixed_buffer_size)
+    : strm_(strm), fixed_buffer_(fixed_buffer),
+      fixed_buffer_size_(fixed_buffer_size) {}
+
+inline const char *stream_line_reader::ptr() const {
+  if (growable_buffer_.empty()) {
+    return fixed_buffer_;
+  } else {
+    return growable_buffer_.data();
+  }
+}
+
+inline size_t stream_line_reader::size() const {
+  if (growable_buffer_.empty()) {
+    return fixed_buffer_used_size_;
+  } else {
+    return growable_buffer_.size();
+  }
+}
+
+inline bool stream_line_reader::end_with_crlf() const {
+  auto end = ptr() + size();
+  return size() >= 2 && end[-2] == '\r' && end[-1] == '\n';
+}
+
+inline bool stream_line_reader::getline() {
+  fixed_buffer_used_size_ = 0;
+  growable_buffer_.clear();
+
+#ifndef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
+  char prev_byte = 0;
+#endif
+
+  for (size_t i = 0;; i++) {
+    if (size() >= CPPHTTPLIB_MAX_LINE_LENGTH) {
+      // Treat exceptionally long lines as an error to
+      // prevent infinite loops/memory exhaustion
+      return false;
+    }
+    char byte;
+    auto n = strm_.read(&byte, 1);
+
+    if (n < 0) {
+      return false;
+    } else if (n == 0) {
+      if (i == 0) {
+        return false;
+      } else {
+        break;
+      }
+    }
+
+    append(byte);
+
+#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
+    if (byte == '\n') { break; }
 #else
-  timeval timeout;
-  timeout.tv_sec = static_cast<long>(sec);
-  timeout.tv_usec = static_cast<decltype(timeout.tv_usec)>(usec);
+    if (prev_byte == '\r' && byte == '\n') { break; }
+    prev_byte = byte;
 #endif
-  return set_socket_opt_impl(sock, level, optname, &timeout, sizeof(timeout));
+  }
+
+  return true;
+}
+
+inline void stream_line_reader::append(char c) {
+  if (fixed_buffer_used_size_ < fixed_buffer_size_ - 1) {
+    fixed_buffer_[fixed_buffer_used_size_++] = c;
+    fixed_buffer_[fixed_buffer_used_size_] = '\0';
+  } else {
+    if (growable_buffer_.empty()) {
+      assert(fixed_buffer_[fixed_buffer_used_size_] == '\0');
+      growable_buffer_.assign(fixed_buffer_, fixed_buffer_used_size_);
+    }
+    growable_buffer_ += c;
+  }
 }
 
-} // namespace detail
+inline mmap::mmap(const char *path) { open(path); }
+
+inline mmap::~mmap() { close(); }
+
+inline bool mmap::open(const char *path) {
+  close();
+
+#if defined(_WIN64)
+  auto wpath = u8string_to_wstring(path);
+  if (wpath.empty()) { return false; }
+
+  hFile_ = ::CreateFile2(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                         OPEN_EXISTING, NULL);
+
+  if (hFile_ == INVALID_HANDLE_VALUE) { return false; }
+
+  LARGE_INTEGER size{};
+  if (!::GetFileSizeEx(hFile_, &size)) { return false; }
+  // If the following line doesn't compile due to QuadPart, update Windows SDK.
+  // See:
+  // https://github.com/yhirose/cpp-httplib/issues/1903#issuecomment-2316520721
+  if (static_cast<ULONGLONG>(size.QuadPart) >
+      (std::numeric_limits<decltype(size_)>::max)()) {
+    // `size_t` might be 32-bits, on 32-bits Windows.
+    return false;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+
+  hMapping_ =
+      ::CreateFileMappingFromApp(hFile_, NULL, PAGE_READONLY, size_, NULL);
+
+  // Special treatment for an empty file...
+  if (hMapping_ == NULL && size_ == 0) {
+    close();
+    is_open_empty_file = true;
+    return true;
+  }
+
+  if (hMapping_ == NULL) {
+    close();
+    return false;
+  }
 
-inline void default_socket_options(socket_t sock) {
-  detail::set_socket_opt(sock, SOL_SOCKET,
-#ifdef SO_REUSEPORT
-                         SO_REUSEPORT,
-#else
-                         SO_REUSEADDR,
-#endif
-                         1);
-}
+  addr_ = ::MapViewOfFileFromApp(hMapping_, FILE_MAP_READ, 0, 0);
 
-inline const char *status_message(int status) {
-  switch (status) {
-  case StatusCode::Continue_100: return "Continue";
-  case StatusCode::SwitchingProtocol_101: return "Switching Protocol";
-  case StatusCode::Processing_102: return "Processing";
-  case StatusCode::EarlyHints_103: return "Early Hints";
-  case StatusCode::OK_200: return "OK";
-  case StatusCode::Created_201: return "Created";
-  case StatusCode::Accepted_202: return "Accepted";
-  case StatusCode::NonAuthoritativeInformation_203:
-    return "Non-Authoritative Information";
-  case StatusCode::NoContent_204: return "No Content";
-  case StatusCode::ResetContent_205: return "Reset Content";
-  case StatusCode::PartialContent_206: return "Partial Content";
-  case StatusCode::MultiStatus_207: return "Multi-Status";
-  case StatusCode::AlreadyReported_208: return "Already Reported";
-  case StatusCode::IMUsed_226: return "IM Used";
-  case StatusCode::MultipleChoices_300: return "Multiple Choices";
-  case StatusCode::MovedPermanently_301: return "Moved Permanently";
-  case StatusCode::Found_302: return "Found";
-  case StatusCode::SeeOther_303: return "See Other";
-  case StatusCode::NotModified_304: return "Not Modified";
-  case StatusCode::UseProxy_305: return "Use Proxy";
-  case StatusCode::unused_306: return "unused";
-  case StatusCode::TemporaryRedirect_307: return "Temporary Redirect";
-  case StatusCode::PermanentRedirect_308: return "Permanent Redirect";
-  case StatusCode::BadRequest_400: return "Bad Request";
-  case StatusCode::Unauthorized_401: return "Unauthorized";
-  case StatusCode::PaymentRequired_402: return "Payment Required";
-  case StatusCode::Forbidden_403: return "Forbidden";
-  case StatusCode::NotFound_404: return "Not Found";
-  case StatusCode::MethodNotAllowed_405: return "Method Not Allowed";
-  case StatusCode::NotAcceptable_406: return "Not Acceptable";
-  case StatusCode::ProxyAuthenticationRequired_407:
-    return "Proxy Authentication Required";
-  case StatusCode::RequestTimeout_408: return "Request Timeout";
-  case StatusCode::Conflict_409: return "Conflict";
-  case StatusCode::Gone_410: return "Gone";
-  case StatusCode::LengthRequired_411: return "Length Required";
-  case StatusCode::PreconditionFailed_412: return "Precondition Failed";
-  case StatusCode::PayloadTooLarge_413: return "Payload Too Large";
-  case StatusCode::UriTooLong_414: return "URI Too Long";
-  case StatusCode::UnsupportedMediaType_415: return "Unsupported Media Type";
-  case StatusCode::RangeNotSatisfiable_416: return "Range Not Satisfiable";
-  case StatusCode::ExpectationFailed_417: return "Expectation Failed";
-  case StatusCode::ImATeapot_418: return "I'm a teapot";
-  case StatusCode::MisdirectedRequest_421: return "Misdirected Request";
-  case StatusCode::UnprocessableContent_422: return "Unprocessable Content";
-  case StatusCode::Locked_423: return "Locked";
-  case StatusCode::FailedDependency_424: return "Failed Dependency";
-  case StatusCode::TooEarly_425: return "Too Early";
-  case StatusCode::UpgradeRequired_426: return "Upgrade Required";
-  case StatusCode::PreconditionRequired_428: return "Precondition Required";
-  case StatusCode::TooManyRequests_429: return "Too Many Requests";
-  case StatusCode::RequestHeaderFieldsTooLarge_431:
-    return "Request Header Fields Too Large";
-  case StatusCode::UnavailableForLegalReasons_451:
-    return "Unavailable For Legal Reasons";
-  case StatusCode::NotImplemented_501: return "Not Implemented";
-  case StatusCode::BadGateway_502: return "Bad Gateway";
-  case StatusCode::ServiceUnavailable_503: return "Service Unavailable";
-  case StatusCode::GatewayTimeout_504: return "Gateway Timeout";
-  case StatusCode::HttpVersionNotSupported_505:
-    return "HTTP Version Not Supported";
-  case StatusCode::VariantAlsoNegotiates_506: return "Variant Also Negotiates";
-  case StatusCode::InsufficientStorage_507: return "Insufficient Storage";
-  case StatusCode::LoopDetected_508: return "Loop Detected";
-  case StatusCode::NotExtended_510: return "Not Extended";
-  case StatusCode::NetworkAuthenticationRequired_511:
-    return "Network Authentication Required";
+  if (addr_ == nullptr) {
+    close();
+    return false;
+  }
+#else
+  fd_ = ::open(path, O_RDONLY);
+  if (fd_ == -1) { return false; }
 
-  default:
-  case StatusCode::InternalServerError_500: return "Internal Server Error";
+  struct stat sb;
+  if (fstat(fd_, &sb) == -1) {
+    close();
+    return false;
   }
-}
+  size_ = static_cast<size_t>(sb.st_size);
 
-inline std::string get_bearer_token_auth(const Request &req) {
-  if (req.has_header("Authorization")) {
-    constexpr auto bearer_header_prefix_len = detail::str_len("Bearer ");
-    return req.get_header_value("Authorization")
-        .substr(bearer_header_prefix_len);
+  addr_ = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+
+  // Special treatment for an empty file...
+  if (addr_ == MAP_FAILED && size_ == 0) {
+    close();
+    is_open_empty_file = true;
+    return false;
   }
-  return "";
-}
+#endif
 
-template <class Rep, class Period>
-inline Server &
-Server::set_read_timeout(const std::chrono::duration<Rep, Period> &duration) {
-  detail::duration_to_sec_and_usec(
-      duration, [&](time_t sec, time_t usec) { set_read_timeout(sec, usec); });
-  return *this;
+  return true;
 }
 
-template <class Rep, class Period>
-inline Server &
-Server::set_write_timeout(const std::chrono::duration<Rep, Period> &duration) {
-  detail::duration_to_sec_and_usec(
-      duration, [&](time_t sec, time_t usec) { set_write_timeout(sec, usec); });
-  return *this;
+inline bool mmap::is_open() const {
+  return is_open_empty_file ? true : addr_ != nullptr;
 }
 
-template <class Rep, class Period>
-inline Server &
-Server::set_idle_interval(const std::chrono::duration<Rep, Period> &duration) {
-  detail::duration_to_sec_and_usec(
-      duration, [&](time_t sec, time_t usec) { set_idle_interval(sec, usec); });
-  return *this;
+inline size_t mmap::size() const { return size_; }
+#if !defined(_WIN64)
+inline int mmap::fd() const { return fd_; }
+#endif
+
+inline const char *mmap::data() const {
+  return is_open_empty_file ? "" : static_cast<const char *>(addr_);
 }
 
-inline std::string to_string(const Error error) {
-  switch (error) {
-  case Error::Success: return "Success (no error)";
-  case Error::Connection: return "Could not establish connection";
-  case Error::BindIPAddress: return "Failed to bind IP address";
-  case Error::Read: return "Failed to read connection";
-  case Error::Write: return "Failed to write connection";
-  case Error::ExceedRedirectCount: return "Maximum redirect count exceeded";
-  case Error::Canceled: return "Connection handling canceled";
-  case Error::SSLConnection: return "SSL connection failed";
-  case Error::SSLLoadingCerts: return "SSL certificate loading failed";
-  case Error::SSLServerVerification: return "SSL server verification failed";
-  case Error::SSLServerHostnameVerification:
-    return "SSL server hostname verification failed";
-  case Error::UnsupportedMultipartBoundaryChars:
-    return "Unsupported HTTP multipart boundary characters";
-  case Error::Compression: return "Compression failed";
-  case Error::ConnectionTimeout: return "Connection timed out";
-  case Error::ProxyConnection: return "Proxy connection failed";
-  case Error::Unknown: return "Unknown";
-  default: break;
+inline void mmap::close() {
+#if defined(_WIN64)
+  if (addr_) {
+    ::UnmapViewOfFile(addr_);
+    addr_ = nullptr;
   }
 
-  return "Invalid";
-}
+  if (hMapping_) {
+    ::CloseHandle(hMapping_);
+    hMapping_ = NULL;
+  }
 
-inline std::ostream &operator<<(std::ostream &os, const Error &obj) {
-  os << to_string(obj);
-  os << " (" << static_cast<std::underlying_type<Error>::type>(obj) << ')';
-  return os;
-}
+  if (hFile_ != INVALID_HANDLE_VALUE) {
+    ::CloseHandle(hFile_);
+    hFile_ = INVALID_HANDLE_VALUE;
+  }
 
-inline size_t Result::get_request_header_value_u64(const std::string &key,
-                                                   size_t def,
-                                                   size_t id) const {
-  return detail::get_header_value_u64(request_headers_, key, def, id);
-}
+  is_open_empty_file = false;
+#else
+  if (addr_ != nullptr) {
+    munmap(addr_, size_);
+    addr_ = nullptr;
+  }
 
-template <class Rep, class Period>
-inline void ClientImpl::set_connection_timeout(
-    const std::chrono::duration<Rep, Period> &duration) {
-  detail::duration_to_sec_and_usec(duration, [&](time_t sec, time_t usec) {
-    set_connection_timeout(sec, usec);
-  });
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+#endif
+  size_ = 0;
+}
+inline int close_socket(socket_t sock) {
+#ifdef _WIN64
+  return closesocket(sock);
+#else
+  return close(sock);
+#endif
 }
 
-template <class Rep, class Period>
-inline void ClientImpl::set_read_timeout(
-    const std::chrono::duration<Rep, Period> &duration) {
-  detail::duration_to_sec_and_usec(
-      duration, [&](time_t sec, time_t usec) { set_read_timeout(sec, usec); });
+template <typename T> inline ssize_t handle_EINTR(T fn) {
+  ssize_t res = 0;
+  while (true) {
+    res = fn();
+    if (res < 0 && errno == EINTR) {
+      std::this_thread::sleep_for(std::chrono::microseconds{1});
+      continue;
+    }
+    break;
+  }
+  return res;
 }
 
-template <class Rep, class Period>
-inline void ClientImpl::set_write_timeout(
-    const std::chrono::duration<Rep, Period> &duration) {
-  detail::duration_to_sec_and_usec(
-      duration, [&](time_t sec, time_t usec) { set_write_timeout(sec, usec); });
+inline ssize_t read_socket(socket_t sock, void *ptr, size_t size, int flags) {
+  return handle_EINTR([&]() {
+    return recv(sock,
+#ifdef _WIN64
+                static_cast<char *>(ptr), static_cast<int>(size),
+#else
+                ptr, size,
+#endif
+                flags);
+  });
 }
 
-template <class Rep, class Period>
-inline void ClientImpl::set_max_timeout(
-    const std::chrono::duration<Rep, Period> &duration) {
-  auto msec =
-      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-  set_max_timeout(msec);
+inline ssize_t send_socket(socket_t sock, const void *ptr, size_t size,
+                           int flags) {
+  return handle_EINTR([&]() {
+    return send(sock,
+#ifdef _WIN64
+                static_cast<const char *>(ptr), static_cast<int>(size),
+#else
+                ptr, size,
+#endif
+                flags);
+  });
 }
 
-template <class Rep, class Period>
-inline void Client::set_connection_timeout(
-    const std::chrono::duration<Rep, Period> &duration) {
-  cli_->set_connection_timeout(duration);
+inline int poll_wrapper(struct pollfd *fds, nfds_t nfds, int timeout) {
+#ifdef _WIN64
+  return ::WSAPoll(fds, nfds, timeout);
+#else
+  return ::poll(fds, nfds, timeout);
+#endif
 }
 
-template <class Rep, class Period>
-inline void
-Client::set_read_timeout(const std::chrono::duration<Rep, Period> &duration) {
-  cli_->set_read_timeout(duration);
-}
+template <bool Read>
+inline ssize_t select_impl(socket_t sock, time_t sec, time_t usec) {
+#ifdef __APPLE__
+  if (sock >= FD_SETSIZE) { return -1; }
 
-template <class Rep, class Period>
-inline void
-Client::set_write_timeout(const std::chrono::duration<Rep, Period> &duration) {
-  cli_->set_write_timeout(duration);
-}
+  fd_set fds, *rfds, *wfds;
+  FD_ZERO(&fds);
+  FD_SET(sock, &fds);
+  rfds = (Read ? &fds : nullptr);
+  wfds = (Read ? nullptr : &fds);
 
-template <class Rep, class Period>
-inline void
-Client::set_max_timeout(const std::chrono::duration<Rep, Period> &duration) {
-  cli_->set_max_timeout(duration);
+  timeval tv;
+  tv.tv_sec = static_cast<long>(sec);
+  tv.tv_usec = static_cast<decltype(tv.tv_usec)>(usec);
+
+  return handle_EINTR([&]() {
+    return select(static_cast<int>(sock + 1), rfds, wfds, nullptr, &tv);
+  });
+#else
+  struct pollfd pfd;
+  pfd.fd = sock;
+  pfd.events = (Read ? POLLIN : POLLOUT);
+
+  auto timeout = static_cast<int>(sec * 1000 + usec / 1000);
+
+  return handle_EINTR([&]() { return poll_wrapper(&pfd, 1, timeout); });
+#endif
 }
 
-/*
- * Forward declarations and types that will be part of the .h file if split into
- * .h + .cc.
- */
+inline ssize_t select_read(socket_t sock, time_t sec, time_t usec) {
+  return select_impl<true>(sock, sec, usec);
+}
 
-std::string hosted_at(const std::string &hostname);
+inline ssize_t select_write(socket_t sock, time_t sec, time_t usec) {
+  return select_impl<false>(sock, sec, usec);
+}
 
-void hosted_at(const std::string &hostname, std::vector<std::string> &addrs);
+inline Error wait_until_socket_is_ready(socket_t sock, time_t sec,
+                                        time_t usec) {
+#ifdef __APPLE__
+  if (sock >= FD_SETSIZE) { return Error::Connection; }
 
-std::string encode_uri_component(const std::string &value);
+  fd_set fdsr, fdsw;
+  FD_ZERO(&fdsr);
+  FD_ZERO(&fdsw);
+  FD_SET(sock, &fdsr);
+  FD_SET(sock, &fdsw);
 
-std::string encode_uri(const std::string &value);
+  timeval tv;
+  tv.tv_sec = static_cast<long>(sec);
+  tv.tv_usec = static_cast<decltype(tv.tv_usec)>(usec);
 
-std::string decode_uri_component(const std::string &value);
+  auto ret = handle_EINTR([&]() {
+    return select(static_cast<int>(sock + 1), &fdsr, &fdsw, nullptr, &tv);
+  });
 
-std::string decode_uri(const std::string &value);
+  if (ret == 0) { return Error::ConnectionTimeout; }
 
-std::string encode_query_param(const std::string &value);
+  if (ret > 0 && (FD_ISSET(sock, &fdsr) || FD_ISSET(sock, &fdsw))) {
+    auto error = 0;
+    socklen_t len = sizeof(error);
+    auto res = getsockopt(sock, SOL_SOCKET, SO_ERROR,
+                          reinterpret_cast<char *>(&error), &len);
+    auto successful = res >= 0 && !error;
+    return successful ? Error::Success : Error::Connection;
+  }
 
-std::string append_query_params(const std::string &path, const Params &params);
+  return Error::Connection;
+#else
+  struct pollfd pfd_read;
+  pfd_read.fd = sock;
+  pfd_read.events = POLLIN | POLLOUT;
 
-std::pair<std::string, std::string> make_range_header(const Ranges &ranges);
+  auto timeout = static_cast<int>(sec * 1000 + usec / 1000);
 
-std::pair<std::string, std::string>
-make_basic_authentication_header(const std::string &username,
-                                 const std::string &password,
-                                 bool is_proxy = false);
+  auto poll_res =
+      handle_EINTR([&]() { return poll_wrapper(&pfd_read, 1, timeout); });
 
-namespace detail {
+  if (poll_res == 0) { return Error::ConnectionTimeout; }
 
-#if defined(_WIN64)
-inline std::wstring u8string_to_wstring(const char *s) {
-  std::wstring ws;
-  auto len = static_cast<int>(strlen(s));
-  auto wlen = ::MultiByteToWideChar(CP_UTF8, 0, s, len, nullptr, 0);
-  if (wlen > 0) {
-    ws.resize(wlen);
-    wlen = ::MultiByteToWideChar(
-        CP_UTF8, 0, s, len,
-        const_cast<LPWSTR>(reinterpret_cast<LPCWSTR>(ws.data())), wlen);
-    if (wlen != static_cast<int>(ws.size())) { ws.clear(); }
+  if (poll_res > 0 && pfd_read.revents & (POLLIN | POLLOUT)) {
+    auto error = 0;
+    socklen_t len = sizeof(error);
+    auto res = getsockopt(sock, SOL_SOCKET, SO_ERROR,
+                          reinterpret_cast<char *>(&error), &len);
+    auto successful = res >= 0 && !error;
+    return successful ? Error::Success : Error::Connection;
   }
-  return ws;
-}
-#endif
-
-struct FileStat {
-  FileStat(const std::string &path);
-  bool is_file() const;
-  bool is_dir() const;
 
-private:
-#if defined(_WIN64)
-  struct _stat st_;
-#else
-  struct stat st_;
+  return Error::Connection;
 #endif
-  int ret_ = -1;
-};
-
-std::string decode_path(const std::string &s, bool convert_plus_to_space);
+}
 
-std::string trim_copy(const std::string &s);
+inline bool is_socket_alive(socket_t sock) {
+  const auto val = detail::select_read(sock, 0, 0);
+  if (val == 0) {
+    return true;
+  } else if (val < 0 && errno == EBADF) {
+    return false;
+  }
+  char buf[1];
+  return detail::read_socket(sock, &buf[0], sizeof(buf), MSG_PEEK) > 0;
+}
 
-void divide(
-    const char *data, std::size_t size, char d,
-    std::function<void(const char *, std::size_t, const char *, std::size_t)>
-        fn);
+class SocketStream final : public Stream {
+public:
+  SocketStream(socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
+               time_t write_timeout_sec, time_t write_timeout_usec,
+               time_t max_timeout_msec = 0,
+               std::chrono::time_point<std::chrono::steady_clock> start_time =
+                   (std::chrono::steady_clock::time_point::min)());
+  ~SocketStream() override;
 
-void divide(
-    const std::string &str, char d,
-    std::function<void(const char *, std::size_t, const char *, std::size_t)>
-        fn);
+  bool is_readable() const override;
+  bool wait_readable() const override;
+  bool wait_writable() const override;
+  ssize_t read(char *ptr, size_t size) override;
+  ssize_t write(const char *ptr, size_t size) override;
+  void get_remote_ip_and_port(std::string &ip, int &port) const override;
+  void get_local_ip_and_port(std::string &ip, int &port) const override;
+  socket_t socket() const override;
+  time_t duration() const override;
+  bool write_batching() const override;
+  bool set_write_batching(bool on) override;
+  bool flush() override;
+  bool can_send_file() const override;
+  ssize_t send_file(int fd, size_t offset, size_t size) override;
 
-void split(const char *b, const char *e, char d,
-           std::function<void(const char *, const char *)> fn);
+private:
+  socket_t sock_;
+  time_t read_timeout_sec_;
+  time_t read_timeout_usec_;
+  time_t write_timeout_sec_;
+  time_t write_timeout_usec_;
+  time_t max_timeout_msec_;
+  const std::chrono::time_point<std::chrono::steady_clock> start_time_;
 
-void split(const char *b, const char *e, char d, size_t m,
-           std::function<void(const char *, const char *)> fn);
+  std::vector<char, TaggedAllocator<char>> read_buff_;
+  size_t read_buff_off_ = 0;
+  size_t read_buff_content_size_ = 0;
 
-bool process_client_socket(
-    socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
-    time_t write_timeout_sec, time_t write_timeout_usec,
-    time_t max_timeout_msec,
-    std::chrono::time_point<std::chrono::steady_clock> start_time,
-    std::function<bool(Stream &)> callback);
+  bool write_batching_ = false;
+  std::string write_buff_;
 
-socket_t create_client_socket(const std::string &host, const std::string &ip,
-                              int port, int address_family, bool tcp_nodelay,
-                              bool ipv6_v6only, SocketOptions socket_options,
-                              time_t connection_timeout_sec,
-                              time_t connection_timeout_usec,
-                              time_t read_timeout_sec, time_t read_timeout_usec,
-                              time_t write_timeout_sec,
-                              time_t write_timeout_usec,
-                              const std::string &intf, Error &error);
+  static const size_t read_buff_size_ = 1024l * 4;
+};
 
-const char *get_header_value(const Headers &headers, const std::string &key,
-                             const char *def, size_t id);
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+class SSLSocketStream final : public Stream {
+public:
+  SSLSocketStream(
+      socket_t sock, SSL *ssl, time_t read_timeout_sec,
+      time_t read_timeout_usec, time_t write_timeout_sec,
+      time_t write_timeout_usec, time_t max_timeout_msec = 0,
+      std::chrono::time_point<std::chrono::steady_clock> start_time =
+          (std::chrono::steady_clock::time_point::min)());
+  ~SSLSocketStream() override;
 
-std::string params_to_query_str(const Params &params);
+  bool is_readable() const override;
+  bool wait_readable() const override;
+  bool wait_writable() const override;
+  ssize_t read(char *ptr, size_t size) override;
+  ssize_t write(const char *ptr, size_t size) override;
+  void get_remote_ip_and_port(std::string &ip, int &port) const override;
+  void get_local_ip_and_port(std::string &ip, int &port) const override;
+  socket_t socket() const override;
+  time_t duration() const override;
 
-void parse_query_text(const char *data, std::size_t size, Params &params);
+private:
+  socket_t sock_;
+  SSL *ssl_;
+  time_t read_timeout_sec_;
+  time_t read_timeout_usec_;
+  time_t write_timeout_sec_;
+  time_t write_timeout_usec_;
+  time_t max_timeout_msec_;
+  const std::chrono::time_point<std::chrono::steady_clock> start_time_;
+};
+#endif
 
-void parse_query_text(const std::string &s, Params &params);
+inline bool keep_alive(const std::atomic<socket_t> &svr_sock, socket_t sock,
+                       time_t keep_alive_timeout_sec) {
+  using namespace std::chrono;
 
-bool parse_multipart_boundary(const std::string &content_type,
-                              std::string &boundary);
+  const auto interval_usec =
+      CPPHTTPLIB_KEEPALIVE_TIMEOUT_CHECK_INTERVAL_USECOND;
 
-bool parse_range_header(const std::string &s, Ranges &ranges);
+  // Avoid expensive `steady_clock::now()` call for the first time
+  if (select_read(sock, 0, interval_usec) > 0) { return true; }
 
-bool parse_accept_header(const std::string &s,
-                         std::vector<std::string> &content_types);
+  const auto start = steady_clock::now() - microseconds{interval_usec};
+  const auto timeout = seconds{keep_alive_timeout_sec};
 
-int close_socket(socket_t sock);
+  while (true) {
+    if (svr_sock == INVALID_SOCKET) {
+      break; // Server socket is closed
+    }
 
-ssize_t send_socket(socket_t sock, const void *ptr, size_t size, int flags);
+    auto val = select_read(sock, 0, interval_usec);
+    if (val < 0) {
+      break; // Ssocket error
+    } else if (val == 0) {
+      if (steady_clock::now() - start > timeout) {
+        break; // Timeout
+      }
+    } else {
+      return true; // Ready for read
+    }
+  }
 
-ssize_t read_socket(socket_t sock, void *ptr, size_t size, int flags);
+  return false;
+}
 
-enum class EncodingType { None = 0, Gzip, Brotli, Zstd };
+template <typename T>
+inline bool
+process_server_socket_core(const std::atomic<socket_t> &svr_sock, socket_t sock,
+                           size_t keep_alive_max_count,
+                           time_t keep_alive_timeout_sec, Stream &strm,
+                           T callback) {
+  assert(keep_alive_max_count > 0);
+  auto ret = false;
+  auto count = keep_alive_max_count;
+  // A pipelined request that is already buffered is served right away
+  // instead of waiting for the socket to poll readable again.
+  while (count > 0 && (strm.is_readable() ||
+                       keep_alive(svr_sock, sock, keep_alive_timeout_sec))) {
+    auto close_connection = count == 1;
+    auto connection_closed = false;
+    ret = callback(close_connection, connection_closed);
+    if (!ret || connection_closed) { break; }
+    count--;
+  }
+  return ret;
+}
 
-EncodingType encoding_type(const Request &req, const Response &res);
+template <typename T>
+inline bool
+process_server_socket(const std::atomic<socket_t> &svr_sock, socket_t sock,
+                      size_t keep_alive_max_count,
+                      time_t keep_alive_timeout_sec, time_t read_timeout_sec,
+                      time_t read_timeout_usec, time_t write_timeout_sec,
+                      time_t write_timeout_usec, T callback) {
+  // The stream lives as long as the connection so that bytes read ahead for
+  // pipelined requests are not lost between requests. Responses are batched
+  // while more requests are buffered and go out together once they drain.
+  SocketStream strm(sock, read_timeout_sec, read_timeout_usec,
+                    write_timeout_sec, write_timeout_usec);
+  strm.set_write_batching(true);
 
-class BufferStream final : public Stream {
-public:
-  BufferStream() = default;
-  ~BufferStream() override = default;
+  auto ret = process_server_socket_core(
+      svr_sock, sock, keep_alive_max_count, keep_alive_timeout_sec, strm,
+      [&](bool close_connection, bool &connection_closed) {
+        auto handled = callback(strm, close_connection, connection_closed);
+        if (!strm.is_readable() && !strm.flush()) { return false; }
+        return handled;
+      });
 
-  bool is_readable() const override;
-  bool wait_readable() const override;
-  bool wait_writable() const override;
-  ssize_t read(char *ptr, size_t size) override;
-  ssize_t write(const char *ptr, size_t size) override;
-  void get_remote_ip_and_port(std::string &ip, int &port) const override;
-  void get_local_ip_and_port(std::string &ip, int &port) const override;
-  socket_t socket() const override;
-  time_t duration() const override;
+  if (!strm.flush()) { return false; }
+  return ret;
+}
 
-  const std::string &get_buffer() const;
+inline bool process_client_socket(
+    socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
+    time_t write_timeout_sec, time_t write_timeout_usec,
+    time_t max_timeout_msec,
+    std::chrono::time_point<std::chrono::steady_clock> start_time,
+    std::function<bool(Stream &)> callback) {
+  SocketStream strm(sock, read_timeout_sec, read_timeout_usec,
+                    write_timeout_sec, write_timeout_usec, max_timeout_msec,
+                    start_time);
+  return callback(strm);
+}
 
-private:
-  std::string buffer;
-  size_t position = 0;
-};
+inline int shutdown_socket(socket_t sock) {
+#ifdef _WIN64
+  return shutdown(sock, SD_BOTH);
+#else
+  return shutdown(sock, SHUT_RDWR);
+#endif
+}
 
-class compressor {
-public:
-  virtual ~compressor() = default;
+inline std::string escape_abstract_namespace_unix_domain(const std::string &s) {
+  if (s.size() > 1 && s[0] == '\0') {
+    auto ret = s;
+    ret[0] = '@';
+    return ret;
+  }
+  return s;
+}
 
-  typedef std::function<bool(const char *data, size_t data_len)> Callback;
-  virtual bool compress(const char *data, size_t data_length, bool last,
-                        Callback callback) = 0;
-};
+inline std::string
+unescape_abstract_namespace_unix_domain(const std::string &s) {
+  if (s.size() > 1 && s[0] == '@') {
+    auto ret = s;
+    ret[0] = '\0';
+    return ret;
+  }
+  return s;
+}
 
-class decompressor {
-public:
-  virtual ~decompressor() = default;
+inline int getaddrinfo_with_timeout(const char *node, const char *service,
+                                    const struct addrinfo *hints,
+                                    struct addrinfo **res, time_t timeout_sec) {
+#ifdef CPPHTTPLIB_USE_NON_BLOCKING_GETADDRINFO
+  if (timeout_sec <= 0) {
+    // No timeout specified, use standard getaddrinfo
+    return getaddrinfo(node, service, hints, res);
+  }
 
-  virtual bool is_valid() const = 0;
+#ifdef _WIN64
+  // Windows-specific implementation using GetAddrInfoEx with overlapped I/O
+  OVERLAPPED overlapped = {0};
+  HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if (!event) { return EAI_FAIL; }
 
-  typedef std::function<bool(const char *data, size_t data_len)> Callback;
-  virtual bool decompress(const char *data, size_t data_length,
-                          Callback callback) = 0;
-};
+  overlapped.hEvent = event;
 
-class nocompressor final : public compressor {
-public:
-  ~nocompressor() override = default;
+  PADDRINFOEXW result_addrinfo = nullptr;
+  HANDLE cancel_handle = nullptr;
 
-  bool compress(const char *data, size_t data_length, bool /*last*/,
-                Callback callback) override;
-};
+  ADDRINFOEXW hints_ex = {0};
+  if (hints) {
+    hints_ex.ai_flags = hints->ai_flags;
+    hints_ex.ai_family = hints->ai_family;
+    hints_ex.ai_socktype = hints->ai_socktype;
+    hints_ex.ai_protocol = hints->ai_protocol;
+  }
 
-#ifdef CPPHTTPLIB_ZLIB_SUPPORT
-class gzip_compressor final : public compressor {
-public:
-  gzip_compressor();
-  ~gzip_compressor() override;
+  auto wnode = u8string_to_wstring(node);
+  auto wservice = u8string_to_wstring(service);
 
-  bool compress(const char *data, size_t data_length, bool last,
-                Callback callback) override;
+  auto ret = ::GetAddrInfoExW(wnode.data(), wservice.data(), NS_DNS, nullptr,
+                              hints ? &hints_ex : nullptr, &result_addrinfo,
+                              nullptr, &overlapped, nullptr, &cancel_handle);
 
-private:
-  bool is_valid_ = false;
-  z_stream strm_;
-};
+  if (ret == WSA_IO_PENDING) {
+    auto wait_result =
+        ::WaitForSingleObject(event, static_cast<DWORD>(timeout_sec * 1000));
+    if (wait_result == WAIT_TIMEOUT) {
+      if (cancel_handle) { ::GetAddrInfoExCancel(&cancel_handle); }
+      ::CloseHandle(event);
+      return EAI_AGAIN;
+    }
 
-class gzip_decompressor final : public decompressor {
-public:
-  gzip_decompressor();
-  ~gzip_decompressor() override;
+    DWORD bytes_returned;
+    if (!::GetOverlappedResult((HANDLE)INVALID_SOCKET, &overlapped,
+                               &bytes_returned, FALSE)) {
+      ::CloseHandle(event);
+      return ::WSAGetLastError();
+    }
+  }
 
-  bool is_valid() const override;
+  ::CloseHandle(event);
 
-  bool decompress(const char *data, size_t data_length,
-                  Callback callback) override;
+  if (ret == NO_ERROR || ret == WSA_IO_PENDING) {
+    *res = reinterpret_cast<struct addrinfo *>(result_addrinfo);
+    return 0;
+  }
 
-private:
-  bool is_valid_ = false;
-  z_stream strm_;
-};
-#endif
+  return ret;
+#elif defined(TARGET_OS_OSX)
+  // macOS implementation using CFHost API for asynchronous DNS resolution
+  CFStringRef hostname_ref = CFStringCreateWithCString(
+      kCFAllocatorDefault, node, kCFStringEncodingUTF8);
+  if (!hostname_ref) { return EAI_MEMORY; }
 
-#ifdef CPPHTTPLIB_BROTLI_SUPPORT
-class brotli_compressor final : public compressor {
-public:
-  brotli_compressor();
-  ~brotli_compressor();
+  CFHostRef host_ref = CFHostCreateWithName(kCFAllocatorDefault, hostname_ref);
+  CFRelease(hostname_ref);
+  if (!host_ref) { return EAI_MEMORY; }
 
-  bool compress(const char *data, size_t data_length, bool last,
-                Callback callback) override;
+  // Set up context for callback
+  struct CFHostContext {
+    bool completed = false;
+    bool success = false;
+    CFArrayRef addresses = nullptr;
+    std::mutex mutex;
+    std::condition_variable cv;
+  } context;
 
-private:
-  BrotliEncoderState *state_ = nullptr;
-};
+  CFHostClientContext client_context;
+  memset(&client_context, 0, sizeof(client_context));
+  client_context.info = &context;
 
-class brotli_decompressor final : public decompressor {
-public:
-  brotli_decompressor();
-  ~brotli_decompressor();
+  // Set callback
+  auto callback = [](CFHostRef theHost, CFHostInfoType /*typeInfo*/,
+                     const CFStreamError *error, void *info) {
+    auto ctx = static_cast<CFHostContext *>(info);
+    std::lock_guard<std::mutex> lock(ctx->mutex);
 
-  bool is_valid() const override;
+    if (error && error->error != 0) {
+      ctx->success = false;
+    } else {
+      Boolean hasBeenResolved;
+      ctx->addresses = CFHostGetAddressing(theHost, &hasBeenResolved);
+      if (ctx->addresses && hasBeenResolved) {
+        CFRetain(ctx->addresses);
+        ctx->success = true;
+      } else {
+        ctx->success = false;
+      }
+    }
+    ctx->completed = true;
+    ctx->cv.notify_one();
+  };
+
+  if (!CFHostSetClient(host_ref, callback, &client_context)) {
+    CFRelease(host_ref);
+    return EAI_SYSTEM;
+  }
 
-  bool decompress(const char *data, size_t data_length,
-                  Callback callback) override;
+  // Schedule on run loop
+  CFRunLoopRef run_loop = CFRunLoopGetCurrent();
+  CFHostScheduleWithRunLoop(host_ref, run_loop, kCFRunLoopDefaultMode);
 
-private:
-  BrotliDecoderResult decoder_r;
-  BrotliDecoderState *decoder_s = nullptr;
-};
-#endif
+  // Start resolution
+  CFStreamError stream_error;
+  if (!CFHostStartInfoResolution(host_ref, kCFHostAddresses, &stream_error)) {
+    CFHostUnscheduleFromRunLoop(host_ref, run_loop, kCFRunLoopDefaultMode);
+    CFRelease(host_ref);
+    return EAI_FAIL;
+  }
 
-#ifdef CPPHTTPLIB_ZSTD_SUPPORT
-class zstd_compressor : public compressor {
-public:
-  zstd_compressor();
-  ~zstd_compressor();
+  // Wait for completion with timeout
+  auto timeout_time =
+      std::chrono::steady_clock::now() + std::chrono::seconds(timeout_sec);
+  bool timed_out = false;
 
-  bool compress(const char *data, size_t data_length, bool last,
-                Callback callback) override;
+  {
+    std::unique_lock<std::mutex> lock(context.mutex);
 
-private:
-  ZSTD_CCtx *ctx_ = nullptr;
-};
+    while (!context.completed) {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= timeout_time) {
+        timed_out = true;
+        break;
+      }
 
-class zstd_decompressor : public decompressor {
-public:
-  zstd_decompressor();
-  ~zstd_decompressor();
+      // Run the runloop for a short time
+      lock.unlock();
+      CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.1, true);
+      lock.lock();
+    }
+  }
 
-  bool is_valid() const override;
+  // Clean up
+  CFHostUnscheduleFromRunLoop(host_ref, run_loop, kCFRunLoopDefaultMode);
+  CFHostSetClient(host_ref, nullptr, nullptr);
 
-  bool decompress(const char *data, size_t data_length,
-                  Callback callback) override;
+  if (timed_out || !context.completed) {
+    CFHostCancelInfoResolution(host_ref, kCFHostAddresses);
+    CFRelease(host_ref);
+    return EAI_AGAIN;
+  }
 
-private:
-  ZSTD_DCtx *ctx_ = nullptr;
-};
-#endif
+  if (!context.success || !context.addresses) {
+    CFRelease(host_ref);
+    return EAI_NODATA;
+  }
 
-// NOTE: until the read size reaches `fixed_buffer_size`, use `fixed_buffer`
-// to store data. The call can set memory on stack for performance.
-class stream_line_reader {
-public:
-  stream_line_reader(Stream &strm, char *fixed_buffer,
-                     size_t fixed_buffer_size);
-  const char *ptr() const;
-  size_t size() const;
-  bool end_with_crlf() const;
-  bool getline();
+  // Convert CFArray to addrinfo
+  CFIndex count = CFArrayGetCount(context.addresses);
+  if (count == 0) {
+    CFRelease(context.addresses);
+    CFRelease(host_ref);
+    return EAI_NODATA;
+  }
 
-private:
-  void append(char c);
+  struct addrinfo *result_addrinfo = nullptr;
+  struct addrinfo **current = &result_addrinfo;
 
-  Stream &strm_;
-  char *fixed_buffer_;
-  const size_t fixed_buffer_size_;
-  size_t fixed_buffer_used_size_ = 0;
-  std::string growable_buffer_;
-};
+  for (CFIndex i = 0; i < count; i++) {
+    CFDataRef addr_data =
+        static_cast<CFDataRef>(CFArrayGetValueAtIndex(context.addresses, i));
+    if (!addr_data) continue;
 
-class mmap {
-public:
-  mmap(const char *path);
-  ~mmap();
+    const struct sockaddr *sockaddr_ptr =
+        reinterpret_cast<const struct sockaddr *>(CFDataGetBytePtr(addr_data));
+    socklen_t sockaddr_len = static_cast<socklen_t>(CFDataGetLength(addr_data));
 
-  bool open(const char *path);
-  void close();
+    // Allocate addrinfo structure
+    *current = static_cast<struct addrinfo *>(malloc(sizeof(struct addrinfo)));
+    if (!*current) {
+      freeaddrinfo(result_addrinfo);
+      CFRelease(context.addresses);
+      CFRelease(host_ref);
+      return EAI_MEMORY;
+    }
 
-  bool is_open() const;
-  size_t size() const;
-  const char *data() const;
+    memset(*current, 0, sizeof(struct addrinfo));
 
-private:
-#if defined(_WIN64)
-  HANDLE hFile_ = NULL;
-  HANDLE hMapping_ = NULL;
-#else
-  int fd_ = -1;
-#endif
-  size_t size_ = 0;
-  void *addr_ = nullptr;
-  bool is_open_empty_file = false;
-};
+    // Set up addrinfo fields
+    (*current)->ai_family = sockaddr_ptr->sa_family;
+    (*current)->ai_socktype = hints ? hints->ai_socktype : SOCK_STREAM;
+    (*current)->ai_protocol = hints ? hints->ai_protocol : IPPROTO_TCP;
+    (*current)->ai_addrlen = sockaddr_len;
 
-// NOTE: https://www.rfc-editor.org/rfc/rfc9110#section-5
-namespace fields {
+    // Copy sockaddr
+    (*current)->ai_addr = static_cast<struct sockaddr *>(malloc(sockaddr_len));
+    if (!(*current)->ai_addr) {
+      freeaddrinfo(result_addrinfo);
+      CFRelease(context.addresses);
+      CFRelease(host_ref);
+      return EAI_MEMORY;
+    }
+    memcpy((*current)->ai_addr, sockaddr_ptr, sockaddr_len);
 
-inline bool is_token_char(char c) {
-  return std::isalnum(c) || c == '!' || c == '#' || c == '$' || c == '%' ||
-         c == '&' || c == '\'' || c == '*' || c == '+' || c == '-' ||
-         c == '.' || c == '^' || c == '_' || c == '`' || c == '|' || c == '~';
-}
+    // Set port if service is specified
+    if (service && strlen(service) > 0) {
+      int port = atoi(service);
+      if (port > 0) {
+        if (sockaddr_ptr->sa_family == AF_INET) {
+          reinterpret_cast<struct sockaddr_in *>((*current)->ai_addr)
+              ->sin_port = htons(static_cast<uint16_t>(port));
+        } else if (sockaddr_ptr->sa_family == AF_INET6) {
+          reinterpret_cast<struct sockaddr_in6 *>((*current)->ai_addr)
+              ->sin6_port = htons(static_cast<uint16_t>(port));
+        }
+      }
+    }
 
-inline bool is_token(const std::string &s) {
-  if (s.empty()) { return false; }
-  for (auto c : s) {
-    if (!is_token_char(c)) { return false; }
+    current = &((*current)->ai_next);
   }
-  return true;
-}
 
-inline bool is_field_name(const std::string &s) { return is_token(s); }
+  CFRelease(context.addresses);
+  CFRelease(host_ref);
 
-inline bool is_vchar(char c) { return c >= 33 && c <= 126; }
+  *res = result_addrinfo;
+  return 0;
+#elif defined(_GNU_SOURCE) && defined(__GLIBC__) &&                            \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 2))
+  // Linux implementation using getaddrinfo_a for asynchronous DNS resolution
+  struct gaicb request;
+  struct gaicb *requests[1] = {&request};
+  struct sigevent sevp;
+  struct timespec timeout;
 
-inline bool is_obs_text(char c) { return 128 <= static_cast<unsigned char>(c); }
+  // Initialize the request structure
+  memset(&request, 0, sizeof(request));
+  request.ar_name = node;
+  request.ar_service = service;
+  request.ar_request = hints;
 
-inline bool is_field_vchar(char c) { return is_vchar(c) || is_obs_text(c); }
+  // Set up timeout
+  timeout.tv_sec = timeout_sec;
+  timeout.tv_nsec = 0;
 
-inline bool is_field_content(const std::string &s) {
-  if (s.empty()) { return true; }
+  // Initialize sigevent structure (not used, but required)
+  memset(&sevp, 0, sizeof(sevp));
+  sevp.sigev_notify = SIGEV_NONE;
 
-  if (s.size() == 1) {
-    return is_field_vchar(s[0]);
-  } else if (s.size() == 2) {
-    return is_field_vchar(s[0]) && is_field_vchar(s[1]);
-  } else {
-    size_t i = 0;
+  // Start asynchronous resolution
+  int start_result = getaddrinfo_a(GAI_NOWAIT, requests, 1, &sevp);
+  if (start_result != 0) { return start_result; }
 
-    if (!is_field_vchar(s[i])) { return false; }
-    i++;
+  // Wait for completion with timeout
+  int wait_result =
+      gai_suspend((const struct gaicb *const *)requests, 1, &timeout);
 
-    while (i < s.size() - 1) {
-      auto c = s[i++];
-      if (c == ' ' || c == '\t' || is_field_vchar(c)) {
-      } else {
-        return false;
-      }
+  if (wait_result == 0) {
+    // Completed successfully, get the result
+    int gai_result = gai_error(&request);
+    if (gai_result == 0) {
+      *res = request.ar_result;
+      return 0;
+    } else {
+      // Clean up on error
+      if (request.ar_result) { freeaddrinfo(request.ar_result); }
+      return gai_result;
     }
-
-    return is_field_vchar(s[i]);
+  } else if (wait_result == EAI_AGAIN) {
+    // Timeout occurred, cancel the request
+    gai_cancel(&request);
+    return EAI_AGAIN;
+  } else {
+    // Other error occurred
+    gai_cancel(&request);
+    return wait_result;
   }
-}
+#else
+  // Fallback implementation using thread-based timeout for other Unix systems
+  std::mutex result_mutex;
+  std::condition_variable result_cv;
+  auto completed = false;
+  auto result = EAI_SYSTEM;
+  struct addrinfo *result_addrinfo = nullptr;
 
-inline bool is_field_value(const std::string &s) { return is_field_content(s); }
+  std::thread resolve_thread([&]() {
+    auto thread_result = getaddrinfo(node, service, hints, &result_addrinfo);
 
-} // namespace fields
+    std::lock_guard<std::mutex> lock(result_mutex);
+    result = thread_result;
+    completed = true;
+    result_cv.notify_one();
+  });
 
-} // namespace detail
+  // Wait for completion or timeout
+  std::unique_lock<std::mutex> lock(result_mutex);
+  auto finished = result_cv.wait_for(lock, std::chrono::seconds(timeout_sec),
+                                     [&] { return completed; });
 
-// ----------------------------------------------------------------------------
+  if (finished) {
+    // Operation completed within timeout
+    resolve_thread.join();
+    *res = result_addrinfo;
+    return result;
+  } else {
+    // Timeout occurred
+    resolve_thread.detach(); // Let the thread finish in background
+    return EAI_AGAIN;        // Return timeout error
+  }
+#endif
+#else
+  (void)(timeout_sec); // Unused parameter for non-blocking getaddrinfo
+  return getaddrinfo(node, service, hints, res);
+#endif
+}
 
-/*
- * Implementation that will be part of the .cc file if split into .h + .cc.
- */
+template <typename BindOrConnect>
+socket_t create_socket(const std::string &host, const std::string &ip, int port,
+                       int address_family, int socket_flags, bool tcp_nodelay,
+                       bool ipv6_v6only, SocketOptions socket_options,
+                       BindOrConnect bind_or_connect, time_t timeout_sec = 0) {
+  // Get address info
+  const char *node = nullptr;
+  struct addrinfo hints;
+  struct addrinfo *result;
 
-namespace detail {
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_IP;
 
-inline bool is_hex(char c, int &v) {
-  if (0x20 <= c && isdigit(c)) {
-    v = c - '0';
-    return true;
-  } else if ('A' <= c && c <= 'F') {
-    v = c - 'A' + 10;
-    return true;
-  } else if ('a' <= c && c <= 'f') {
-    v = c - 'a' + 10;
-    return true;
+  if (!ip.empty()) {
+    node = ip.c_str();
+    // Ask getaddrinfo to convert IP in c-string to address
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_flags = AI_NUMERICHOST;
+  } else {
+    if (!host.empty()) { node = host.c_str(); }
+    hints.ai_family = address_family;
+    hints.ai_flags = socket_flags;
   }
-  return false;
-}
 
-inline bool from_hex_to_i(const std::string &s, size_t i, size_t cnt,
-                          int &val) {
-  if (i >= s.size()) { return false; }
+#if !defined(_WIN64) || defined(CPPHTTPLIB_HAVE_AFUNIX_H)
+  if (hints.ai_family == AF_UNIX) {
+    const auto addrlen = host.length();
+    if (addrlen > sizeof(sockaddr_un::sun_path)) { return INVALID_SOCKET; }
 
-  val = 0;
-  for (; cnt; i++, cnt--) {
-    if (!s[i]) { return false; }
-    auto v = 0;
-    if (is_hex(s[i], v)) {
-      val = val * 16 + v;
-    } else {
-      return false;
-    }
-  }
-  return true;
-}
+#ifdef SOCK_CLOEXEC
+    auto sock = socket(hints.ai_family, hints.ai_socktype | SOCK_CLOEXEC,
+                       hints.ai_protocol);
+#else
+    auto sock = socket(hints.ai_family, hints.ai_socktype, hints.ai_protocol);
+#endif
 
-inline std::string from_i_to_hex(size_t n) {
-  static const auto charset = "0123456789abcdef";
-  std::string ret;
-  do {
-    ret = charset[n & 15] + ret;
-    n >>= 4;
-  } while (n > 0);
-  return ret;
-}
+    if (sock != INVALID_SOCKET) {
+      sockaddr_un addr{};
+      addr.sun_family = AF_UNIX;
 
-inline size_t to_utf8(int code, char *buff) {
-  if (code < 0x0080) {
-    buff[0] = static_cast<char>(code & 0x7F);
-    return 1;
-  } else if (code < 0x0800) {
-    buff[0] = static_cast<char>(0xC0 | ((code >> 6) & 0x1F));
-    buff[1] = static_cast<char>(0x80 | (code & 0x3F));
-    return 2;
-  } else if (code < 0xD800) {
-    buff[0] = static_cast<char>(0xE0 | ((code >> 12) & 0xF));
-    buff[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
-    buff[2] = static_cast<char>(0x80 | (code & 0x3F));
-    return 3;
-  } else if (code < 0xE000) { // D800 - DFFF is invalid...
-    return 0;
-  } else if (code < 0x10000) {
-    buff[0] = static_cast<char>(0xE0 | ((code >> 12) & 0xF));
-    buff[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
-    buff[2] = static_cast<char>(0x80 | (code & 0x3F));
-    return 3;
-  } else if (code < 0x110000) {
-    buff[0] = static_cast<char>(0xF0 | ((code >> 18) & 0x7));
-    buff[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
-    buff[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
-    buff[3] = static_cast<char>(0x80 | (code & 0x3F));
-    return 4;
-  }
+      auto unescaped_host = unescape_abstract_namespace_unix_domain(host);
+      std::copy(unescaped_host.begin(), unescaped_host.end(), addr.sun_path);
 
-  // NOTREACHED
-  return 0;
-}
+      hints.ai_addr = reinterpret_cast<sockaddr *>(&addr);
+      hints.ai_addrlen = static_cast<socklen_t>(
+          sizeof(addr) - sizeof(addr.sun_path) + addrlen);
 
-// NOTE: This code came up with the following stackoverflow post:
-// https://stackoverflow.com/questions/180947/base64-decode-snippet-in-c
-inline std::string base64_encode(const std::string &in) {
-  static const auto lookup =
-      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+#ifndef SOCK_CLOEXEC
+#ifndef _WIN64
+      fcntl(sock, F_SETFD, FD_CLOEXEC);
+#endif
+#endif
 
-  std::string out;
-  out.reserve(in.size());
+      if (socket_options) { socket_options(sock); }
 
-  auto val = 0;
-  auto valb = -6;
+#ifdef _WIN64
+      // Setting SO_REUSEADDR seems not to work well with AF_UNIX on windows, so
+      // remove the option.
+      detail::set_socket_opt(sock, SOL_SOCKET, SO_REUSEADDR, 0);
+#endif
 
-  for (auto c : in) {
-    val = (val << 8) + static_cast<uint8_t>(c);
-    valb += 8;
-    while (valb >= 0) {
-      out.push_back(lookup[(val >> valb) & 0x3F]);
-      valb -= 6;
+      bool dummy;
+      if (!bind_or_connect(sock, hints, dummy)) {
+        close_socket(sock);
+        sock = INVALID_SOCKET;
+      }
     }
+    return sock;
   }
+#endif
 
-  if (valb > -6) { out.push_back(lookup[((val << 8) >> (valb + 8)) & 0x3F]); }
+  auto service = std::to_string(port);
 
-  while (out.size() % 4) {
-    out.push_back('=');
+  if (getaddrinfo_with_timeout(node, service.c_str(), &hints, &result,
+                               timeout_sec)) {
+#if defined __linux__ && !defined __ANDROID__
+    res_init();
+#endif
+    return INVALID_SOCKET;
   }
+  auto se = detail::scope_exit([&] { freeaddrinfo(result); });
 
-  return out;
-}
+  for (auto rp = result; rp; rp = rp->ai_next) {
+    // Create a socket
+#ifdef _WIN64
+    auto sock =
+        WSASocketW(rp->ai_family, rp->ai_socktype, rp->ai_protocol, nullptr, 0,
+                   WSA_FLAG_NO_HANDLE_INHERIT | WSA_FLAG_OVERLAPPED);
+    /**
+     * Since the WSA_FLAG_NO_HANDLE_INHERIT is only supported on Windows 7 SP1
+     * and above the socket creation fails on older Windows Systems.
+     *
+     * Let's try to create a socket the old way in this case.
+     *
+     * Reference:
+     * https://docs.microsoft.com/en-us/windows/win32/api/winsock2/nf-winsock2-wsasocketa
+     *
+     * WSA_FLAG_NO_HANDLE_INHERIT:
+     * This flag is supported on Windows 7 with SP1, Windows Server 2008 R2 with
+     * SP1, and later
+     *
+     */
+    if (sock == INVALID_SOCKET) {
+      sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+    }
+#else
 
-inline bool is_valid_path(const std::string &path) {
-  size_t level = 0;
-  size_t i = 0;
+#ifdef SOCK_CLOEXEC
+    auto sock =
+        socket(rp->ai_family, rp->ai_socktype | SOCK_CLOEXEC, rp->ai_protocol);
+#else
+    auto sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+#endif
 
-  // Skip slash
-  while (i < path.size() && path[i] == '/') {
-    i++;
-  }
+#endif
+    if (sock == INVALID_SOCKET) { continue; }
 
-  while (i < path.size()) {
-    // Read component
-    auto beg = i;
-    while (i < path.size() && path[i] != '/') {
-      if (path[i] == '\0') {
-        return false;
-      } else if (path[i] == '\\') {
-        return false;
-      }
-      i++;
+#if !defined _WIN64 && !defined SOCK_CLOEXEC
+    if (fcntl(sock, F_SETFD, FD_CLOEXEC) == -1) {
+      close_socket(sock);
+      continue;
     }
+#endif
 
-    auto len = i - beg;
-    assert(len > 0);
+    if (tcp_nodelay) { set_socket_opt(sock, IPPROTO_TCP, TCP_NODELAY, 1); }
 
-    if (!path.compare(beg, len, ".")) {
-      ;
-    } else if (!path.compare(beg, len, "..")) {
-      if (level == 0) { return false; }
-      level--;
-    } else {
-      level++;
+    if (rp->ai_family == AF_INET6) {
+      set_socket_opt(sock, IPPROTO_IPV6, IPV6_V6ONLY, ipv6_v6only ? 1 : 0);
     }
 
-    // Skip slash
-    while (i < path.size() && path[i] == '/') {
-      i++;
-    }
+    if (socket_options) { socket_options(sock); }
+
+    // bind or connect
+    auto quit = false;
+    if (bind_or_connect(sock, *rp, quit)) { return sock; }
+
+    close_socket(sock);
+
+    if (quit) { break; }
   }
 
-  return true;
+  return INVALID_SOCKET;
 }
 
-inline FileStat::FileStat(const std::string &path) {
-#if defined(_WIN64)
-  auto wpath = u8string_to_wstring(path.c_str());
-  ret_ = _wstat(wpath.c_str(), &st_);
+inline void set_nonblocking(socket_t sock, bool nonblocking) {
+#ifdef _WIN64
+  auto flags = nonblocking ? 1UL : 0UL;
+  ioctlsocket(sock, FIONBIO, &flags);
 #else
-  ret_ = stat(path.c_str(), &st_);
+  auto flags = fcntl(sock, F_GETFL, 0);
+  fcntl(sock, F_SETFL,
+        nonblocking ? (flags | O_NONBLOCK) : (flags & (~O_NONBLOCK)));
 #endif
 }
-inline bool FileStat::is_file() const {
-  return ret_ >= 0 && S_ISREG(st_.st_mode);
-}
-inline bool FileStat::is_dir() const {
-  return ret_ >= 0 && S_ISDIR(st_.st_mode);
+
+inline bool is_connection_error() {
+#ifdef _WIN64
+  return WSAGetLastError() != WSAEWOULDBLOCK;
+#else
+  return errno != EINPROGRESS;
+#endif
 }
 
-inline std::string encode_path(const std::string &s) {
-  std::string result;
-  result.reserve(s.size());
+inline bool bind_ip_address(socket_t sock, const std::string &host) {
+  struct addrinfo hints;
+  struct addrinfo *result;
 
-  for (size_t i = 0; s[i]; i++) {
-    switch (s[i]) {
-    case ' ': result += "%20"; break;
-    case '+': result += "%2B"; break;
-    case '\r': result += "%0D"; break;
-    case '\n': result += "%0A"; break;
-    case '\'': result += "%27"; break;
-    case ',': result += "%2C"; break;
-    // case ':': result += "%3A"; break; // ok? probably...
-    case ';': result += "%3B"; break;
-    default:
-      auto c = static_cast<uint8_t>(s[i]);
-      if (c >= 0x80) {
-        result += '%';
-        char hex[4];
-        auto len = snprintf(hex, sizeof(hex) - 1, "%02X", c);
-        assert(len == 2);
-        result.append(hex, static_cast<size_t>(len));
-      } else {
-        result += s[i];
-      }
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = 0;
+
+  if (getaddrinfo_with_timeout(host.c_str(), "0", &hints, &result, 0)) {
+    return false;
+  }
+
+  auto se = detail::scope_exit([&] { freeaddrinfo(result); });
+
+  auto ret = false;
+  for (auto rp = result; rp; rp = rp->ai_next) {
+    const auto &ai = *rp;
+    if (!::bind(sock, ai.ai_addr, static_cast<socklen_t>(ai.ai_addrlen))) {
+      ret = true;
       break;
     }
   }
 
-  return result;
+  return ret;
 }
 
-inline std::string decode_path(const std::string &s,
-                               bool convert_plus_to_space) {
-  std::string result;
+#if !defined _WIN64 && !defined ANDROID && !defined _AIX && !defined __MVS__
+#define USE_IF2IP
+#endif
 
-  for (size_t i = 0; i < s.size(); i++) {
-    if (s[i] == '%' && i + 1 < s.size()) {
-      if (s[i + 1] == 'u') {
-        auto val = 0;
-        if (from_hex_to_i(s, i + 2, 4, val)) {
-          // 4 digits Unicode codes
-          char buff[4];
-          size_t len = to_utf8(val, buff);
-          if (len > 0) { result.append(buff, len); }
-          i += 5; // 'u0000'
-        } else {
-          result += s[i];
+#ifdef USE_IF2IP
+inline std::string if2ip(int address_family, const std::string &ifn) {
+  struct ifaddrs *ifap;
+  getifaddrs(&ifap);
+  auto se = detail::scope_exit([&] { freeifaddrs(ifap); });
+
+  std::string addr_candidate;
+  for (auto ifa = ifap; ifa; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr && ifn == ifa->ifa_name &&
+        (AF_UNSPEC == address_family ||
+         ifa->ifa_addr->sa_family == address_family)) {
+      if (ifa->ifa_addr->sa_family == AF_INET) {
+        auto sa = reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr);
+        char buf[INET_ADDRSTRLEN];
+        if (inet_ntop(AF_INET, &sa->sin_addr, buf, INET_ADDRSTRLEN)) {
+          return std::string(buf, INET_ADDRSTRLEN);
         }
-      } else {
-        auto val = 0;
-        if (from_hex_to_i(s, i + 1, 2, val)) {
-          // 2 digits hex codes
-          result += static_cast<char>(val);
-          i += 2; // '00'
-        } else {
-          result += s[i];
+      } else if (ifa->ifa_addr->sa_family == AF_INET6) {
+        auto sa = reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_addr);
+        if (!IN6_IS_ADDR_LINKLOCAL(&sa->sin6_addr)) {
+          char buf[INET6_ADDRSTRLEN] = {};
+          if (inet_ntop(AF_INET6, &sa->sin6_addr, buf, INET6_ADDRSTRLEN)) {
+            // equivalent to mac's IN6_IS_ADDR_UNIQUE_LOCAL
+            auto s6_addr_head = sa->sin6_addr.s6_addr[0];
+            if (s6_addr_head == 0xfc || s6_addr_head == 0xfd) {
+              addr_candidate = std::string(buf, INET6_ADDRSTRLEN);
+            } else {
+              return std::string(buf, INET6_ADDRSTRLEN);
+            }
+          }
         }
       }
-    } else if (convert_plus_to_space && s[i] == '+') {
-      result += ' ';
-    } else {
-      result += s[i];
     }
   }
-
-  return result;
-}
-
-inline std::string file_extension(const std::string &path) {
-  std::smatch m;
-  thread_local auto re = std::regex("\\.([a-zA-Z0-9]+)$");
-  if (std::regex_search(path, m, re)) { return m[1].str(); }
-  return std::string();
-}
-
-inline bool is_space_or_tab(char c) { return c == ' ' || c == '\t'; }
-
-inline std::pair<size_t, size_t> trim(const char *b, const char *e, size_t left,
-                                      size_t right) {
-  while (b + left < e && is_space_or_tab(b[left])) {
-    left++;
-  }
-  while (right > 0 && is_space_or_tab(b[right - 1])) {
-    right--;
-  }
-  return std::make_pair(left, right);
-}
-
-inline std::string trim_copy(const std::string &s) {
-  auto r = trim(s.data(), s.data() + s.size(), 0, s.size());
-  return s.substr(r.first, r.second - r.first);
-}
-
-inline std::string trim_double_quotes_copy(const std::string &s) {
-  if (s.length() >= 2 && s.front() == '"' && s.back() == '"') {
-    return s.substr(1, s.size() - 2);
-  }
-  return s;
-}
-
-inline void
-divide(const char *data, std::size_t size, char d,
-       std::function<void(const char *, std::size_t, const char *, std::size_t)>
-           fn) {
-  const auto it = std::find(data, data + size, d);
-  const auto found = static_cast<std::size_t>(it != data + size);
-  const auto lhs_data = data;
-  const auto lhs_size = static_cast<std::size_t>(it - data);
-  const auto rhs_data = it + found;
-  const auto rhs_size = size - lhs_size - found;
-
-  fn(lhs_data, lhs_size, rhs_data, rhs_size);
+  return addr_candidate;
 }
+#endif
 
-inline void
-divide(const std::string &str, char d,
-       std::function<void(const char *, std::size_t, const char *, std::size_t)>
-           fn) {
-  divide(str.data(), str.size(), d, std::move(fn));
-}
+inline socket_t create_client_socket(
+    const std::string &host, const std::string &ip, int port,
+    int address_family, bool tcp_nodelay, bool ipv6_v6only,
+    SocketOptions socket_options, time_t connection_timeout_sec,
+    time_t connection_timeout_usec, time_t read_timeout_sec,
+    time_t read_timeout_usec, time_t write_timeout_sec,
+    time_t write_timeout_usec, const std::string &intf, Error &error) {
+  auto sock = create_socket(
+      host, ip, port, address_family, 0, tcp_nodelay, ipv6_v6only,
+      std::move(socket_options),
+      [&](socket_t sock2, struct addrinfo &ai, bool &quit) -> bool {
+        if (!intf.empty()) {
+#ifdef USE_IF2IP
+          auto ip_from_if = if2ip(address_family, intf);
+          if (ip_from_if.empty()) { ip_from_if = intf; }
+          if (!bind_ip_address(sock2, ip_from_if)) {
+            error = Error::BindIPAddress;
+            return false;
+          }
+#endif
+        }
 
-inline void split(const char *b, const char *e, char d,
-                  std::function<void(const char *, const char *)> fn) {
-  return split(b, e, d, (std::numeric_limits<size_t>::max)(), std::move(fn));
-}
+        set_nonblocking(sock2, true);
 
-inline void split(const char *b, const char *e, char d, size_t m,
-                  std::function<void(const char *, const char *)> fn) {
-  size_t i = 0;
-  size_t beg = 0;
-  size_t count = 1;
+        auto ret =
+            ::connect(sock2, ai.ai_addr, static_cast<socklen_t>(ai.ai_addrlen));
 
-  while (e ? (b + i < e) : (b[i] != '\0')) {
-    if (b[i] == d && count < m) {
-      auto r = trim(b, e, beg, i);
-      if (r.first < r.second) { fn(&b[r.first], &b[r.second]); }
-      beg = i + 1;
-      count++;
-    }
-    i++;
-  }
+        if (ret < 0) {
+          if (is_connection_error()) {
+            error = Error::Connection;
+            return false;
+          }
+          error = wait_until_socket_is_ready(sock2, connection_timeout_sec,
+                                             connection_timeout_usec);
+          if (error != Error::Success) {
+            if (error == Error::ConnectionTimeout) { quit = true; }
+            return false;
+          }
+        }
 
-  if (i) {
-    auto r = trim(b, e, beg, i);
-    if (r.first < r.second) { fn(&b[r.first], &b[r.second]); }
-  }
-}
+        set_nonblocking(sock2, false);
+        set_socket_opt_time(sock2, SOL_SOCKET, SO_RCVTIMEO, read_timeout_sec,
+                            read_timeout_usec);
+        set_socket_opt_time(sock2, SOL_SOCKET, SO_SNDTIMEO, write_timeout_sec,
+                            write_timeout_usec);
 
-inline stream_line_reader::stream_line_reader(Stream &strm, char *fixed_buffer,
-                                              size_t fixed_buffer_size)
-    : strm_(strm), fixed_buffer_(fixed_buffer),
-      fixed_buffer_size_(fixed_buffer_size) {}
+        error = Error::Success;
+        return true;
+      },
+      connection_timeout_sec); // Pass DNS timeout
 
-inline const char *stream_line_reader::ptr() const {
-  if (growable_buffer_.empty()) {
-    return fixed_buffer_;
+  if (sock != INVALID_SOCKET) {
+    error = Error::Success;
   } else {
-    return growable_buffer_.data();
+    if (error == Error::Success) { error = Error::Connection; }
   }
+
+  return sock;
 }
 
-inline size_t stream_line_reader::size() const {
-  if (growable_buffer_.empty()) {
-    return fixed_buffer_used_size_;
+inline bool get_ip_and_port(const struct sockaddr_storage &addr,
+                            socklen_t addr_len, std::string &ip, int &port) {
+  if (addr.ss_family == AF_INET) {
+    port = ntohs(reinterpret_cast<const struct sockaddr_in *>(&addr)->sin_port);
+  } else if (addr.ss_family == AF_INET6) {
+    port =
+        ntohs(reinterpret_cast<const struct sockaddr_in6 *>(&addr)->sin6_port);
   } else {
-    return growable_buffer_.size();
+    return false;
   }
-}
 
-inline bool stream_line_reader::end_with_crlf() const {
-  auto end = ptr() + size();
-  return size() >= 2 && end[-2] == '\r' && end[-1] == '\n';
-}
+  std::array<char, NI_MAXHOST> ipstr{};
+  if (getnameinfo(reinterpret_cast<const struct sockaddr *>(&addr), addr_len,
+                  ipstr.data(), static_cast<socklen_t>(ipstr.size()), nullptr,
+                  0, NI_NUMERICHOST)) {
+    return false;
+  }
 
-inline bool stream_line_reader::getline() {
-  fixed_buffer_used_size_ = 0;
-  growable_buffer_.clear();
+  ip = ipstr.data();
+  return true;
+}
 
-#ifndef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
-  char prev_byte = 0;
-#endif
+inline void get_local_ip_and_port(socket_t sock, std::string &ip, int &port) {
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  if (!getsockname(sock, reinterpret_cast<struct sockaddr *>(&addr),
+                   &addr_len)) {
+    get_ip_and_port(addr, addr_len, ip, port);
+  }
+}
 
-  for (size_t i = 0;; i++) {
-    if (size() >= CPPHTTPLIB_MAX_LINE_LENGTH) {
-      // Treat exceptionally long lines as an error to
-      // prevent infinite loops/memory exhaustion
-      return false;
-    }
-    char byte;
-    auto n = strm_.read(&byte, 1);
+inline void get_remote_ip_and_port(socket_t sock, std::string &ip, int &port) {
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
 
-    if (n < 0) {
-      return false;
-    } else if (n == 0) {
-      if (i == 0) {
-        return false;
-      } else {
-        break;
+  if (!getpeername(sock, reinterpret_cast<struct sockaddr *>(&addr),
+                   &addr_len)) {
+#ifndef _WIN64
+    if (addr.ss_family == AF_UNIX) {
+#if defined(__linux__)
+      struct ucred ucred;
+      socklen_t len = sizeof(ucred);
+      if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &ucred, &len) == 0) {
+        port = ucred.pid;
+      }
+#elif defined(SOL_LOCAL) && defined(SO_PEERPID)
+      pid_t pid;
+      socklen_t len = sizeof(pid);
+      if (getsockopt(sock, SOL_LOCAL, SO_PEERPID, &pid, &len) == 0) {
+        port = pid;
       }
+#endif
+      return;
     }
-
-    append(byte);
-
-#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
-    if (byte == '\n') { break; }
-#else
-    if (prev_byte == '\r' && byte == '\n') { break; }
-    prev_byte = byte;
 #endif
+    get_ip_and_port(addr, addr_len, ip, port);
   }
-
-  return true;
 }
 
-inline void stream_line_reader::append(char c) {
-  if (fixed_buffer_used_size_ < fixed_buffer_size_ - 1) {
-    fixed_buffer_[fixed_buffer_used_size_++] = c;
-    fixed_buffer_[fixed_buffer_used_size_] = '\0';
-  } else {
-    if (growable_buffer_.empty()) {
-      assert(fixed_buffer_[fixed_buffer_used_size_] == '\0');
-      growable_buffer_.assign(fixed_buffer_, fixed_buffer_used_size_);
-    }
-    growable_buffer_ += c;
-  }
+inline constexpr unsigned int str2tag_core(const char *s, size_t l,
+                                           unsigned int h) {
+  return (l == 0)
+             ? h
+             : str2tag_core(
+                   s + 1, l - 1,
+                   // Unsets the 6 high bits of h, therefore no overflow happens
+                   (((std::numeric_limits<unsigned int>::max)() >> 6) &
+                    h * 33) ^
+                       static_cast<unsigned char>(*s));
 }
 
-inline mmap::mmap(const char *path) { open(path); }
-
-inline mmap::~mmap() { close(); }
+inline unsigned int str2tag(const std::string &s) {
+  return str2tag_core(s.data(), s.size(), 0);
+}
 
-inline bool mmap::open(const char *path) {
-  close();
+namespace udl {
 
-#if defined(_WIN64)
-  auto wpath = u8string_to_wstring(path);
-  if (wpath.empty()) { return false; }
+inline constexpr unsigned int operator""_t(const char *s, size_t l) {
+  return str2tag_core(s, l, 0);
+}
 
-  hFile_ = ::CreateFile2(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ,
-                         OPEN_EXISTING, NULL);
+} // namespace udl
 
-  if (hFile_ == INVALID_HANDLE_VALUE) { return false; }
+inline std::string
+find_content_type(const std::string &path,
+                  const std::map<std::string, std::string> &user_data,
+                  const std::string &default_content_type) {
+  auto ext = file_extension(path);
 
-  LARGE_INTEGER size{};
-  if (!::GetFileSizeEx(hFile_, &size)) { return false; }
-  // If the following line doesn't compile due to QuadPart, update Windows SDK.
-  // See:
-  // https://github.com/yhirose/cpp-httplib/issues/1903#issuecomment-2316520721
-  if (static_cast<ULONGLONG>(size.QuadPart) >
-      (std::numeric_limits<decltype(size_)>::max)()) {
-    // `size_t` might be 32-bits, on 32-bits Windows.
-    return false;
-  }
-  size_ = static_cast<size_t>(size.QuadPart);
+  auto it = user_data.find(ext);
+  if (it != user_data.end()) { return it->second; }
 
-  hMapping_ =
-      ::CreateFileMappingFromApp(hFile_, NULL, PAGE_READONLY, size_, NULL);
+  using udl::operator""_t;
 
-  // Special treatment for an empty file...
-  if (hMapping_ == NULL && size_ == 0) {
-    close();
-    is_open_empty_file = true;
-    return true;
-  }
+  switch (str2tag(ext)) {
+  default: return default_content_type;
 
-  if (hMapping_ == NULL) {
-    close();
-    return false;
-  }
+  case "css"_t: return "text/css";
+  case "csv"_t: return "text/csv";
+  case "htm"_t:
+  case "html"_t: return "text/html";
+  case "js"_t:
+  case "mjs"_t: return "text/javascript";
+  case "txt"_t: return "text/plain";
+  case "vtt"_t: return "text/vtt";
 
-  addr_ = ::MapViewOfFileFromApp(hMapping_, FILE_MAP_READ, 0, 0);
+  case "apng"_t: return "image/apng";
+  case "avif"_t: return "image/avif";
+  case "bmp"_t: return "image/bmp";
+  case "gif"_t: return "image/gif";
+  case "png"_t: return "image/png";
+  case "svg"_t: return "image/svg+xml";
+  case "webp"_t: return "image/webp";
+  case "ico"_t: return "image/x-icon";
+  case "tif"_t: return "image/tiff";
+  case "tiff"_t: return "image/tiff";
+  case "jpg"_t:
+  case "jpeg"_t: return "image/jpeg";
 
-  if (addr_ == nullptr) {
-    close();
-    return false;
-  }
-#else
-  fd_ = ::open(path, O_RDONLY);
-  if (fd_ == -1) { return false; }
+  case "mp4"_t: return "video/mp4";
+  case "mpeg"_t: return "video/mpeg";
+  case "webm"_t: return "video/webm";
 
-  struct stat sb;
-  if (fstat(fd_, &sb) == -1) {
-    close();
-    return false;
-  }
-  size_ = static_cast<size_t>(sb.st_size);
+  case "mp3"_t: return "audio/mp3";
+  case "mpga"_t: return "audio/mpeg";
+  case "weba"_t: return "audio/webm";
+  case "wav"_t: return "audio/wave";
 
-  addr_ = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  case "otf"_t: return "font/otf";
+  case "ttf"_t: return "font/ttf";
+  case "woff"_t: return "font/woff";
+  case "woff2"_t: return "font/woff2";
 
-  // Special treatment for an empty file...
-  if (addr_ == MAP_FAILED && size_ == 0) {
-    close();
-    is_open_empty_file = true;
-    return false;
+  case "7z"_t: return "application/x-7z-compressed";
+  case "atom"_t: return "application/atom+xml";
+  case "pdf"_t: return "application/pdf";
+  case "json"_t: return "application/json";
+  case "rss"_t: return "application/rss+xml";
+  case "tar"_t: return "application/x-tar";
+  case "xht"_t:
+  case "xhtml"_t: return "application/xhtml+xml";
+  case "xslt"_t: return "application/xslt+xml";
+  case "xml"_t: return "application/xml";
+  case "gz"_t: return "application/gzip";
+  case "zip"_t: return "application/zip";
+  case "wasm"_t: return "application/wasm";
   }
-#endif
-
-  return true;
 }
 
-inline bool mmap::is_open() const {
-  return is_open_empty_file ? true : addr_ != nullptr;
-}
+inline bool can_compress_content_type(const std::string &content_type) {
+  using udl::operator""_t;
 
-inline size_t mmap::size() const { return size_; }
+  auto tag = str2tag(content_type);
 
-inline const char *mmap::data() const {
-  return is_open_empty_file ? "" : static_cast<const char *>(addr_);
-}
+  switch (tag) {
+  case "image/svg+xml"_t:
+  case "application/javascript"_t:
+  case "application/json"_t:
+  case "application/xml"_t:
+  case "application/protobuf"_t:
+  case "application/xhtml+xml"_t: return true;
+
+  case "text/event-stream"_t: return false;
 
-inline void mmap::close() {
-#if defined(_WIN64)
-  if (addr_) {
-    ::UnmapViewOfFile(addr_);
-    addr_ = nullptr;
+  default: return !content_type.rfind("text/", 0);
   }
+}
 
-  if (hMapping_) {
-    ::CloseHandle(hMapping_);
-    hMapping_ = NULL;
-  }
+// NOTE: https://www.rfc-editor.org/rfc/rfc9110#section-12.5.3
+inline bool accepts_encoding(const std::string &accept_encoding,
+                             const std::string &coding) {
+  auto exact = -1;
+  auto wildcard = -1;
 
-  if (hFile_ != INVALID_HANDLE_VALUE) {
-    ::CloseHandle(hFile_);
-    hFile_ = INVALID_HANDLE_VALUE;
-  }
+  split(accept_encoding.data(),
+        accept_encoding.data() + accept_encoding.size(), ',',
+        [&](const char *b, const char *e) {
+          std::string item(b, e);
+          auto params = item.find(';');
+          auto name = trim_copy(item.substr(0, params));
 
-  is_open_empty_file = false;
-#else
-  if (addr_ != nullptr) {
-    munmap(addr_, size_);
-    addr_ = nullptr;
-  }
+          auto accepted = 1;
+          if (params != std::string::npos) {
+            auto q = item.find("q=", params);
+            if (q != std::string::npos &&
+                std::strtod(item.c_str() + q + 2, nullptr) <= 0.0) {
+              accepted = 0;
+            }
+          }
 
-  if (fd_ != -1) {
-    ::close(fd_);
-    fd_ = -1;
-  }
-#endif
-  size_ = 0;
+          if (case_ignore::equal(name, coding)) {
+            exact = accepted;
+          } else if (name == "*") {
+            wildcard = accepted;
+          }
+        });
+
+  return exact != -1 ? exact == 1 : wildcard == 1;
 }
-inline int close_socket(socket_t sock) {
-#ifdef _WIN64
-  return closesocket(sock);
+
+inline uint64_t thread_cpu_time_ns() {
+#if defined(_WIN64)
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return 0;
+  }
+  auto to_u64 = [](const FILETIME &t) {
+    return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+  };
+  return (to_u64(kernel) + to_u64(user)) * 100;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) { return 0; }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+         static_cast<uint64_t>(ts.tv_nsec);
 #else
-  return close(sock);
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
 #endif
 }
 
-template <typename T> inline ssize_t handle_EINTR(T fn) {
-  ssize_t res = 0;
-  while (true) {
-    res = fn();
-    if (res < 0 && errno == EINTR) {
-      std::this_thread::sleep_for(std::chrono::microseconds{1});
-      continue;
-    }
-    break;
+inline const char *encoding_name(EncodingType type) {
+  switch (type) {
+  case EncodingType::Gzip: return "gzip";
+  case EncodingType::Brotli: return "br";
+  case EncodingType::Zstd: return "zstd";
+  default: return "";
   }
-  return res;
 }
 
-inline ssize_t read_socket(socket_t sock, void *ptr, size_t size, int flags) {
-  return handle_EINTR([&]() {
-    return recv(sock,
-#ifdef _WIN64
-                static_cast<char *>(ptr), static_cast<int>(size),
-#else
-                ptr, size,
+// Only codings compiled in are recognized
+inline EncodingType encoding_from_name(const std::string &name) {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+  if (name == "gzip") { return EncodingType::Gzip; }
 #endif
-                flags);
-  });
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+  if (name == "br") { return EncodingType::Brotli; }
+#endif
+#ifdef CPPHTTPLIB_ZSTD_SUPPORT
+  if (name == "zstd") { return EncodingType::Zstd; }
+#endif
+  (void)name;
+  return EncodingType::None;
 }
 
-inline ssize_t send_socket(socket_t sock, const void *ptr, size_t size,
-                           int flags) {
-  return handle_EINTR([&]() {
-    return send(sock,
-#ifdef _WIN64
-                static_cast<const char *>(ptr), static_cast<int>(size),
-#else
-                ptr, size,
-#endif
-                flags);
-  });
+// Levels used when the policy leaves it to the codec, and the cheapest ones
+inline int default_compression_level(EncodingType type) {
+  switch (type) {
+  case EncodingType::Gzip: return 6;
+  case EncodingType::Brotli: return 11;
+  default: return 1;
+  }
 }
 
-inline int poll_wrapper(struct pollfd *fds, nfds_t nfds, int timeout) {
-#ifdef _WIN64
-  return ::WSAPoll(fds, nfds, timeout);
-#else
-  return ::poll(fds, nfds, timeout);
-#endif
+inline int min_compression_level(EncodingType type) {
+  return type == EncodingType::Brotli ? 0 : 1;
 }
 
-template <bool Read>
-inline ssize_t select_impl(socket_t sock, time_t sec, time_t usec) {
-#ifdef __APPLE__
-  if (sock >= FD_SETSIZE) { return -1; }
+// Returns this thread's compressor for `type`, reset for a new response at
+// `level`. Contexts are kept for the life of the thread instead of being
+// set up again for each response.
+inline compressor *thread_local_compressor(EncodingType type, int level) {
+  (void)level;
+  switch (type) {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+  case EncodingType::Gzip: {
+    static thread_local gzip_compressor c;
+    return c.reset(level < 0 ? Z_DEFAULT_COMPRESSION : level) ? &c : nullptr;
+  }
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+  case EncodingType::Brotli: {
+    static thread_local brotli_compressor c;
+    return c.reset(level) ? &c : nullptr;
+  }
+#endif
+#ifdef CPPHTTPLIB_ZSTD_SUPPORT
+  case EncodingType::Zstd: {
+    static thread_local zstd_compressor c;
+    return c.reset(level) ? &c : nullptr;
+  }
+#endif
+  default: return nullptr;
+  }
+}
 
-  fd_set fds, *rfds, *wfds;
-  FD_ZERO(&fds);
-  FD_SET(sock, &fds);
-  rfds = (Read ? &fds : nullptr);
-  wfds = (Read ? nullptr : &fds);
+// Counts bytes and the CPU time spent compressing, excluding the time spent
+// in the callback
+class measured_compressor final : public compressor {
+public:
+  explicit measured_compressor(compressor &c) : c_(c) {}
 
-  timeval tv;
-  tv.tv_sec = static_cast<long>(sec);
-  tv.tv_usec = static_cast<decltype(tv.tv_usec)>(usec);
+  bool compress(const char *data, size_t data_length, bool last,
+                Callback callback) override {
+    auto start = thread_cpu_time_ns();
+    uint64_t callback_ns = 0;
+    bytes_in += data_length;
+    auto ret = c_.compress(data, data_length, last,
+                           [&](const char *d, size_t n) {
+                             auto t = thread_cpu_time_ns();
+                             bytes_out += n;
+                             auto r = callback(d, n);
+                             callback_ns += thread_cpu_time_ns() - t;
+                             return r;
+                           });
+    auto elapsed = thread_cpu_time_ns() - start;
+    cpu_ns += elapsed > callback_ns ? elapsed - callback_ns : 0;
+    return ret;
+  }
 
-  return handle_EINTR([&]() {
-    return select(static_cast<int>(sock + 1), rfds, wfds, nullptr, &tv);
-  });
-#else
-  struct pollfd pfd;
-  pfd.fd = sock;
-  pfd.events = (Read ? POLLIN : POLLOUT);
+  size_t bytes_in = 0;
+  size_t bytes_out = 0;
+  uint64_t cpu_ns = 0;
 
-  auto timeout = static_cast<int>(sec * 1000 + usec / 1000);
+private:
+  compressor &c_;
+};
 
-  return handle_EINTR([&]() { return poll_wrapper(&pfd, 1, timeout); });
-#endif
+inline bool nocompressor::compress(const char *data, size_t data_length,
+                                   bool /*last*/, Callback callback) {
+  if (!data_length) { return true; }
+  return callback(data, data_length);
 }
 
-inline ssize_t select_read(socket_t sock, time_t sec, time_t usec) {
-  return select_impl<true>(sock, sec, usec);
-}
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+inline gzip_compressor::gzip_compressor() {
+  std::memset(&strm_, 0, sizeof(strm_));
+  strm_.zalloc = Z_NULL;
+  strm_.zfree = Z_NULL;
+  strm_.opaque = Z_NULL;
 
-inline ssize_t select_write(socket_t sock, time_t sec, time_t usec) {
-  return select_impl<false>(sock, sec, usec);
+  is_valid_ = deflateInit2(&strm_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
+                           Z_DEFAULT_STRATEGY) == Z_OK;
 }
 
-inline Error wait_until_socket_is_ready(socket_t sock, time_t sec,
-                                        time_t usec) {
-#ifdef __APPLE__
-  if (sock >= FD_SETSIZE) { return Error::Connection; }
-
-  fd_set fdsr, fdsw;
-  FD_ZERO(&fdsr);
-  FD_ZERO(&fdsw);
-  FD_SET(sock, &fdsr);
-  FD_SET(sock, &fdsw);
+inline gzip_compressor::~gzip_compressor() { deflateEnd(&strm_); }
 
-  timeval tv;
-  tv.tv_sec = static_cast<long>(sec);
-  tv.tv_usec = static_cast<decltype(tv.tv_usec)>(usec);
+inline bool gzip_compressor::reset(int level) {
+  is_valid_ = is_valid_ && deflateReset(&strm_) == Z_OK &&
+              deflateParams(&strm_, level, Z_DEFAULT_STRATEGY) == Z_OK;
+  return is_valid_;
+}
 
-  auto ret = handle_EINTR([&]() {
-    return select(static_cast<int>(sock + 1), &fdsr, &fdsw, nullptr, &tv);
-  });
+inline bool gzip_compressor::compress(const char *data, size_t data_length,
+                                      bool last, Callback callback) {
+  assert(is_valid_);
 
-  if (ret == 0) { return Error::ConnectionTimeout; }
+  do {
+    constexpr size_t max_avail_in =
+        (std::numeric_limits<decltype(strm_.avail_in)>::max)();
 
-  if (ret > 0 && (FD_ISSET(sock, &fdsr) || FD_ISSET(sock, &fdsw))) {
-    auto error = 0;
-    socklen_t len = sizeof(error);
-    auto res = getsockopt(sock, SOL_SOCKET, SO_ERROR,
-                          reinterpret_cast<char *>(&error), &len);
-    auto successful = res >= 0 && !error;
-    return successful ? Error::Success : Error::Connection;
-  }
+    strm_.avail_in = static_cast<decltype(strm_.avail_in)>(
+        (std::min)(data_length, max_avail_in));
+    strm_.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data));
 
-  return Error::Connection;
-#else
-  struct pollfd pfd_read;
-  pfd_read.fd = sock;
-  pfd_read.events = POLLIN | POLLOUT;
+    data_length -= strm_.avail_in;
+    data += strm_.avail_in;
 
-  auto timeout = static_cast<int>(sec * 1000 + usec / 1000);
+    auto flush = (last && data_length == 0) ? Z_FINISH : Z_NO_FLUSH;
+    auto ret = Z_OK;
 
-  auto poll_res =
-      handle_EINTR([&]() { return poll_wrapper(&pfd_read, 1, timeout); });
+    std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
+    do {
+      strm_.avail_out = static_cast<uInt>(buff.size());
+      strm_.next_out = reinterpret_cast<Bytef *>(buff.data());
 
-  if (poll_res == 0) { return Error::ConnectionTimeout; }
+      ret = deflate(&strm_, flush);
+      if (ret == Z_STREAM_ERROR) { return false; }
 
-  if (poll_res > 0 && pfd_read.revents & (POLLIN | POLLOUT)) {
-    auto error = 0;
-    socklen_t len = sizeof(error);
-    auto res = getsockopt(sock, SOL_SOCKET, SO_ERROR,
-                          reinterpret_cast<char *>(&error), &len);
-    auto successful = res >= 0 && !error;
-    return successful ? Error::Success : Error::Connection;
-  }
+      if (!callback(buff.data(), buff.size() - strm_.avail_out)) {
+        return false;
+      }
+    } while (strm_.avail_out == 0);
 
-  return Error::Connection;
-#endif
-}
+    assert((flush == Z_FINISH && ret == Z_STREAM_END) ||
+           (flush == Z_NO_FLUSH && ret == Z_OK));
+    assert(strm_.avail_in == 0);
+  } while (data_length > 0);
 
-inline bool is_socket_alive(socket_t sock) {
-  const auto val = detail::select_read(sock, 0, 0);
-  if (val == 0) {
-    return true;
-  } else if (val < 0 && errno == EBADF) {
-    return false;
-  }
-  char buf[1];
-  return detail::read_socket(sock, &buf[0], sizeof(buf), MSG_PEEK) > 0;
+  return true;
 }
 
-class SocketStream final : public Stream {
-public:
-  SocketStream(socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
-               time_t write_timeout_sec, time_t write_timeout_usec,
-               time_t max_timeout_msec = 0,
-               std::chrono::time_point<std::chrono::steady_clock> start_time =
-                   (std::chrono::steady_clock::time_point::min)());
-  ~SocketStream() override;
-
-  bool is_readable() const override;
-  bool wait_readable() const override;
-  bool wait_writable() const override;
-  ssize_t read(char *ptr, size_t size) override;
-  ssize_t write(const char *ptr, size_t size) override;
-  void get_remote_ip_and_port(std::string &ip, int &port) const override;
-  void get_local_ip_and_port(std::string &ip, int &port) const override;
-  socket_t socket() const override;
-  time_t duration() const override;
+inline gzip_decompressor::gzip_decompressor() {
+  std::memset(&strm_, 0, sizeof(strm_));
+  strm_.zalloc = Z_NULL;
+  strm_.zfree = Z_NULL;
+  strm_.opaque = Z_NULL;
 
-private:
-  socket_t sock_;
-  time_t read_timeout_sec_;
-  time_t read_timeout_usec_;
-  time_t write_timeout_sec_;
-  time_t write_timeout_usec_;
-  time_t max_timeout_msec_;
-  const std::chrono::time_point<std::chrono::steady_clock> start_time_;
+  // 15 is the value of wbits, which should be at the maximum possible value
+  // to ensure that any gzip stream can be decoded. The offset of 32 specifies
+  // that the stream type should be automatically detected either gzip or
+  // deflate.
+  is_valid_ = inflateInit2(&strm_, 32 + 15) == Z_OK;
+}
 
-  std::vector<char> read_buff_;
-  size_t read_buff_off_ = 0;
-  size_t read_buff_content_size_ = 0;
+inline gzip_decompressor::~gzip_decompressor() { inflateEnd(&strm_); }
 
-  static const size_t read_buff_size_ = 1024l * 4;
-};
+inline bool gzip_decompressor::is_valid() const { return is_valid_; }
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-class SSLSocketStream final : public Stream {
-public:
-  SSLSocketStream(
-      socket_t sock, SSL *ssl, time_t read_timeout_sec,
-      time_t read_timeout_usec, time_t write_timeout_sec,
-      time_t write_timeout_usec, time_t max_timeout_msec = 0,
-      std::chrono::time_point<std::chrono::steady_clock> start_time =
-          (std::chrono::steady_clock::time_point::min)());
-  ~SSLSocketStream() override;
+inline bool gzip_decompressor::decompress(const char *data, size_t data_length,
+                                          Callback callback) {
+  assert(is_valid_);
 
-  bool is_readable() const override;
-  bool wait_readable() const override;
-  bool wait_writable() const override;
-  ssize_t read(char *ptr, size_t size) override;
-  ssize_t write(const char *ptr, size_t size) override;
-  void get_remote_ip_and_port(std::string &ip, int &port) const override;
-  void get_local_ip_and_port(std::string &ip, int &port) const override;
-  socket_t socket() const override;
-  time_t duration() const override;
+  auto ret = Z_OK;
 
-private:
-  socket_t sock_;
-  SSL *ssl_;
-  time_t read_timeout_sec_;
-  time_t read_timeout_usec_;
-  time_t write_timeout_sec_;
-  time_t write_timeout_usec_;
-  time_t max_timeout_msec_;
-  const std::chrono::time_point<std::chrono::steady_clock> start_time_;
-};
-#endif
+  do {
+    constexpr size_t max_avail_in =
+        (std::numeric_limits<decltype(strm_.avail_in)>::max)();
 
-inline bool keep_alive(const std::atomic<socket_t> &svr_sock, socket_t sock,
-                       time_t keep_alive_timeout_sec) {
-  using namespace std::chrono;
+    strm_.avail_in = static_cast<decltype(strm_.avail_in)>(
+        (std::min)(data_length, max_avail_in));
+    strm_.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data));
 
-  const auto interval_usec =
-      CPPHTTPLIB_KEEPALIVE_TIMEOUT_CHECK_INTERVAL_USECOND;
+    data_length -= strm_.avail_in;
+    data += strm_.avail_in;
 
-  // Avoid expensive `steady_clock::now()` call for the first time
-  if (select_read(sock, 0, interval_usec) > 0) { return true; }
+    std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
+    while (strm_.avail_in > 0 && ret == Z_OK) {
+      strm_.avail_out = static_cast<uInt>(buff.size());
+      strm_.next_out = reinterpret_cast<Bytef *>(buff.data());
 
-  const auto start = steady_clock::now() - microseconds{interval_usec};
-  const auto timeout = seconds{keep_alive_timeout_sec};
+      ret = inflate(&strm_, Z_NO_FLUSH);
 
-  while (true) {
-    if (svr_sock == INVALID_SOCKET) {
-      break; // Server socket is closed
-    }
+      assert(ret != Z_STREAM_ERROR);
+      switch (ret) {
+      case Z_NEED_DICT:
+      case Z_DATA_ERROR:
+      case Z_MEM_ERROR: inflateEnd(&strm_); return false;
+      }
 
-    auto val = select_read(sock, 0, interval_usec);
-    if (val < 0) {
-      break; // Ssocket error
-    } else if (val == 0) {
-      if (steady_clock::now() - start > timeout) {
-        break; // Timeout
+      if (!callback(buff.data(), buff.size() - strm_.avail_out)) {
+        return false;
       }
-    } else {
-      return true; // Ready for read
     }
-  }
 
-  return false;
-}
+    if (ret != Z_OK && ret != Z_STREAM_END) { return false; }
 
-template <typename T>
-inline bool
-process_server_socket_core(const std::atomic<socket_t> &svr_sock, socket_t sock,
-                           size_t keep_alive_max_count,
-                           time_t keep_alive_timeout_sec, T callback) {
-  assert(keep_alive_max_count > 0);
-  auto ret = false;
-  auto count = keep_alive_max_count;
-  while (count > 0 && keep_alive(svr_sock, sock, keep_alive_timeout_sec)) {
-    auto close_connection = count == 1;
-    auto connection_closed = false;
-    ret = callback(close_connection, connection_closed);
-    if (!ret || connection_closed) { break; }
-    count--;
-  }
-  return ret;
-}
+  } while (data_length > 0);
 
-template <typename T>
-inline bool
-process_server_socket(const std::atomic<socket_t> &svr_sock, socket_t sock,
-                      size_t keep_alive_max_count,
-                      time_t keep_alive_timeout_sec, time_t read_timeout_sec,
-                      time_t read_timeout_usec, time_t write_timeout_sec,
-                      time_t write_timeout_usec, T callback) {
-  return process_server_socket_core(
-      svr_sock, sock, keep_alive_max_count, keep_alive_timeout_sec,
-      [&](bool close_connection, bool &connection_closed) {
-        SocketStream strm(sock, read_timeout_sec, read_timeout_usec,
-                          write_timeout_sec, write_timeout_usec);
-        return callback(strm, close_connection, connection_closed);
-      });
+  return true;
 }
+#endif
 
-inline bool process_client_socket(
-    socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
-    time_t write_timeout_sec, time_t write_timeout_usec,
-    time_t max_timeout_msec,
-    std::chrono::time_point<std::chrono::steady_clock> start_time,
-    std::function<bool(Stream &)> callback) {
-  SocketStream strm(sock, read_timeout_sec, read_timeout_usec,
-                    write_timeout_sec, write_timeout_usec, max_timeout_msec,
-                    start_time);
-  return callback(strm);
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+inline brotli_compressor::brotli_compressor() {
+  state_ = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
 }
 
-inline int shutdown_socket(socket_t sock) {
-#ifdef _WIN64
-  return shutdown(sock, SD_BOTH);
-#else
-  return shutdown(sock, SHUT_RDWR);
-#endif
+inline brotli_compressor::~brotli_compressor() {
+  BrotliEncoderDestroyInstance(state_);
 }
 
-inline std::string escape_abstract_namespace_unix_domain(const std::string &s) {
-  if (s.size() > 1 && s[0] == '\0') {
-    auto ret = s;
-    ret[0] = '@';
-    return ret;
+// The encoder has no reset, so a finished state is replaced
+inline bool brotli_compressor::reset(int level) {
+  BrotliEncoderDestroyInstance(state_);
+  state_ = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+  if (!state_) { return false; }
+  if (level >= 0) {
+    BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY,
+                              static_cast<uint32_t>(level));
   }
-  return s;
+  return true;
 }
 
-inline std::string
-unescape_abstract_namespace_unix_domain(const std::string &s) {
-  if (s.size() > 1 && s[0] == '@') {
-    auto ret = s;
-    ret[0] = '\0';
-    return ret;
-  }
-  return s;
-}
+inline bool brotli_compressor::compress(const char *data, size_t data_length,
+                                        bool last, Callback callback) {
+  std::array<uint8_t, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
 
-inline int getaddrinfo_with_timeout(const char *node, const char *service,
-                                    const struct addrinfo *hints,
-                                    struct addrinfo **res, time_t timeout_sec) {
-#ifdef CPPHTTPLIB_USE_NON_BLOCKING_GETADDRINFO
-  if (timeout_sec <= 0) {
-    // No timeout specified, use standard getaddrinfo
-    return getaddrinfo(node, service, hints, res);
-  }
+  auto operation = last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+  auto available_in = data_length;
+  auto next_in = reinterpret_cast<const uint8_t *>(data);
 
-#ifdef _WIN64
-  // Windows-specific implementation using GetAddrInfoEx with overlapped I/O
-  OVERLAPPED overlapped = {0};
-  HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
-  if (!event) { return EAI_FAIL; }
+  for (;;) {
+    if (last) {
+      if (BrotliEncoderIsFinished(state_)) { break; }
+    } else {
+      if (!available_in) { break; }
+    }
 
-  overlapped.hEvent = event;
+    auto available_out = buff.size();
+    auto next_out = buff.data();
 
-  PADDRINFOEXW result_addrinfo = nullptr;
-  HANDLE cancel_handle = nullptr;
+    if (!BrotliEncoderCompressStream(state_, operation, &available_in, &next_in,
+                                     &available_out, &next_out, nullptr)) {
+      return false;
+    }
 
-  ADDRINFOEXW hints_ex = {0};
-  if (hints) {
-    hints_ex.ai_flags = hints->ai_flags;
-    hints_ex.ai_family = hints->ai_family;
-    hints_ex.ai_socktype = hints->ai_socktype;
-    hints_ex.ai_protocol = hints->ai_protocol;
+    auto output_bytes = buff.size() - available_out;
+    if (output_bytes) {
+      callback(reinterpret_cast<const char *>(buff.data()), output_bytes);
+    }
   }
 
-  auto wnode = u8string_to_wstring(node);
-  auto wservice = u8string_to_wstring(service);
-
-  auto ret = ::GetAddrInfoExW(wnode.data(), wservice.data(), NS_DNS, nullptr,
-                              hints ? &hints_ex : nullptr, &result_addrinfo,
-                              nullptr, &overlapped, nullptr, &cancel_handle);
+  return true;
+}
 
-  if (ret == WSA_IO_PENDING) {
-    auto wait_result =
-        ::WaitForSingleObject(event, static_cast<DWORD>(timeout_sec * 1000));
-    if (wait_result == WAIT_TIMEOUT) {
-      if (cancel_handle) { ::GetAddrInfoExCancel(&cancel_handle); }
-      ::CloseHandle(event);
-      return EAI_AGAIN;
-    }
+inline brotli_decompressor::brotli_decompressor() {
+  decoder_s = BrotliDecoderCreateInstance(0, 0, 0);
+  decoder_r = decoder_s ? BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT
+                        : BROTLI_DECODER_RESULT_ERROR;
+}
 
-    DWORD bytes_returned;
-    if (!::GetOverlappedResult((HANDLE)INVALID_SOCKET, &overlapped,
-                               &bytes_returned, FALSE)) {
-      ::CloseHandle(event);
-      return ::WSAGetLastError();
-    }
-  }
+inline brotli_decompressor::~brotli_decompressor() {
+  if (decoder_s) { BrotliDecoderDestroyInstance(decoder_s); }
+}
 
-  ::CloseHandle(event);
+inline bool brotli_decompressor::is_valid() const { return decoder_s; }
 
-  if (ret == NO_ERROR || ret == WSA_IO_PENDING) {
-    *res = reinterpret_cast<struct addrinfo *>(result_addrinfo);
+inline bool brotli_decompressor::decompress(const char *data,
+                                            size_t data_length,
+                                            Callback callback) {
+  if (decoder_r == BROTLI_DECODER_RESULT_SUCCESS ||
+      decoder_r == BROTLI_DECODER_RESULT_ERROR) {
     return 0;
   }
 
-  return ret;
-#elif defined(TARGET_OS_OSX)
-  // macOS implementation using CFHost API for asynchronous DNS resolution
-  CFStringRef hostname_ref = CFStringCreateWithCString(
-      kCFAllocatorDefault, node, kCFStringEncodingUTF8);
-  if (!hostname_ref) { return EAI_MEMORY; }
-
-  CFHostRef host_ref = CFHostCreateWithName(kCFAllocatorDefault, hostname_ref);
-  CFRelease(hostname_ref);
-  if (!host_ref) { return EAI_MEMORY; }
+  auto next_in = reinterpret_cast<const uint8_t *>(data);
+  size_t avail_in = data_length;
+  size_t total_out;
 
-  // Set up context for callback
-  struct CFHostContext {
-    bool completed = false;
-    bool success = false;
-    CFArrayRef addresses = nullptr;
-    std::mutex mutex;
-    std::condition_variable cv;
-  } context;
+  decoder_r = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
 
-  CFHostClientContext client_context;
-  memset(&client_context, 0, sizeof(client_context));
-  client_context.info = &context;
+  std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
+  while (decoder_r == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+    char *next_out = buff.data();
+    size_t avail_out = buff.size();
 
-  // Set callback
-  auto callback = [](CFHostRef theHost, CFHostInfoType /*typeInfo*/,
-                     const CFStreamError *error, void *info) {
-    auto ctx = static_cast<CFHostContext *>(info);
-    std::lock_guard<std::mutex> lock(ctx->mutex);
+    decoder_r = BrotliDecoderDecompressStream(
+        decoder_s, &avail_in, &next_in, &avail_out,
+        reinterpret_cast<uint8_t **>(&next_out), &total_out);
 
-    if (error && error->error != 0) {
-      ctx->success = false;
-    } else {
-      Boolean hasBeenResolved;
-      ctx->addresses = CFHostGetAddressing(theHost, &hasBeenResolved);
-      if (ctx->addresses && hasBeenResolved) {
-        CFRetain(ctx->addresses);
-        ctx->success = true;
-      } else {
-        ctx->success = false;
-      }
-    }
-    ctx->completed = true;
-    ctx->cv.notify_one();
-  };
+    if (decoder_r == BROTLI_DECODER_RESULT_ERROR) { return false; }
 
-  if (!CFHostSetClient(host_ref, callback, &client_context)) {
-    CFRelease(host_ref);
-    return EAI_SYSTEM;
+    if (!callback(buff.data(), buff.size() - avail_out)) { return false; }
   }
 
-  // Schedule on run loop
-  CFRunLoopRef run_loop = CFRunLoopGetCurrent();
-  CFHostScheduleWithRunLoop(host_ref, run_loop, kCFRunLoopDefaultMode);
+  return decoder_r == BROTLI_DECODER_RESULT_SUCCESS ||
+         decoder_r == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT;
+}
+#endif
 
-  // Start resolution
-  CFStreamError stream_error;
-  if (!CFHostStartInfoResolution(host_ref, kCFHostAddresses, &stream_error)) {
-    CFHostUnscheduleFromRunLoop(host_ref, run_loop, kCFRunLoopDefaultMode);
-    CFRelease(host_ref);
-    return EAI_FAIL;
+#ifdef CPPHTTPLIB_ZSTD_SUPPORT
+inline zstd_compressor::zstd_compressor() {
+  ctx_ = ZSTD_createCCtx();
+  ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, ZSTD_fast);
+}
+
+inline zstd_compressor::~zstd_compressor() { ZSTD_freeCCtx(ctx_); }
+
+inline bool zstd_compressor::reset(int level) {
+  if (ZSTD_isError(ZSTD_CCtx_reset(ctx_, ZSTD_reset_session_only))) {
+    return false;
   }
+  return !ZSTD_isError(ZSTD_CCtx_setParameter(
+      ctx_, ZSTD_c_compressionLevel, level >= 0 ? level : ZSTD_fast));
+}
 
-  // Wait for completion with timeout
-  auto timeout_time =
-      std::chrono::steady_clock::now() + std::chrono::seconds(timeout_sec);
-  bool timed_out = false;
+inline bool zstd_compressor::compress(const char *data, size_t data_length,
+                                      bool last, Callback callback) {
+  std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
 
-  {
-    std::unique_lock<std::mutex> lock(context.mutex);
+  ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+  ZSTD_inBuffer input = {data, data_length, 0};
 
-    while (!context.completed) {
-      auto now = std::chrono::steady_clock::now();
-      if (now >= timeout_time) {
-        timed_out = true;
-        break;
-      }
+  bool finished;
+  do {
+    ZSTD_outBuffer output = {buff.data(), CPPHTTPLIB_COMPRESSION_BUFSIZ, 0};
+    size_t const remaining = ZSTD_compressStream2(ctx_, &output, &input, mode);
 
-      // Run the runloop for a short time
-      lock.unlock();
-      CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.1, true);
-      lock.lock();
-    }
-  }
+    if (ZSTD_isError(remaining)) { return false; }
 
-  // Clean up
-  CFHostUnscheduleFromRunLoop(host_ref, run_loop, kCFRunLoopDefaultMode);
-  CFHostSetClient(host_ref, nullptr, nullptr);
+    if (!callback(buff.data(), output.pos)) { return false; }
 
-  if (timed_out || !context.completed) {
-    CFHostCancelInfoResolution(host_ref, kCFHostAddresses);
-    CFRelease(host_ref);
-    return EAI_AGAIN;
-  }
+    finished = last ? (remaining == 0) : (input.pos == input.size);
 
-  if (!context.success || !context.addresses) {
-    CFRelease(host_ref);
-    return EAI_NODATA;
-  }
+  } while (!finished);
 
-  // Convert CFArray to addrinfo
-  CFIndex count = CFArrayGetCount(context.addresses);
-  if (count == 0) {
-    CFRelease(context.addresses);
-    CFRelease(host_ref);
-    return EAI_NODATA;
-  }
+  return true;
+}
 
-  struct addrinfo *result_addrinfo = nullptr;
-  struct addrinfo **current = &result_addrinfo;
+inline zstd_decompressor::zstd_decompressor() { ctx_ = ZSTD_createDCtx(); }
 
-  for (CFIndex i = 0; i < count; i++) {
-    CFDataRef addr_data =
-        static_cast<CFDataRef>(CFArrayGetValueAtIndex(context.addresses, i));
-    if (!addr_data) continue;
+inline zstd_decompressor::~zstd_decompressor() { ZSTD_freeDCtx(ctx_); }
 
-    const struct sockaddr *sockaddr_ptr =
-        reinterpret_cast<const struct sockaddr *>(CFDataGetBytePtr(addr_data));
-    socklen_t sockaddr_len = static_cast<socklen_t>(CFDataGetLength(addr_data));
+inline bool zstd_decompressor::is_valid() const { return ctx_ != nullptr; }
 
-    // Allocate addrinfo structure
-    *current = static_cast<struct addrinfo *>(malloc(sizeof(struct addrinfo)));
-    if (!*current) {
-      freeaddrinfo(result_addrinfo);
-      CFRelease(context.addresses);
-      CFRelease(host_ref);
-      return EAI_MEMORY;
-    }
+inline bool zstd_decompressor::decompress(const char *data, size_t data_length,
+                                          Callback callback) {
+  std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
+  ZSTD_inBuffer input = {data, data_length, 0};
 
-    memset(*current, 0, sizeof(struct addrinfo));
+  while (input.pos < input.size) {
+    ZSTD_outBuffer output = {buff.data(), CPPHTTPLIB_COMPRESSION_BUFSIZ, 0};
+    size_t const remaining = ZSTD_decompressStream(ctx_, &output, &input);
 
-    // Set up addrinfo fields
-    (*current)->ai_family = sockaddr_ptr->sa_family;
-    (*current)->ai_socktype = hints ? hints->ai_socktype : SOCK_STREAM;
-    (*current)->ai_protocol = hints ? hints->ai_protocol : IPPROTO_TCP;
-    (*current)->ai_addrlen = sockaddr_len;
+    if (ZSTD_isError(remaining)) { return false; }
 
-    // Copy sockaddr
-    (*current)->ai_addr = static_cast<struct sockaddr *>(malloc(sockaddr_len));
-    if (!(*current)->ai_addr) {
-      freeaddrinfo(result_addrinfo);
-      CFRelease(context.addresses);
-      CFRelease(host_ref);
-      return EAI_MEMORY;
-    }
-    memcpy((*current)->ai_addr, sockaddr_ptr, sockaddr_len);
+    if (!callback(buff.data(), output.pos)) { return false; }
+  }
 
-    // Set port if service is specified
-    if (service && strlen(service) > 0) {
-      int port = atoi(service);
-      if (port > 0) {
-        if (sockaddr_ptr->sa_family == AF_INET) {
-          reinterpret_cast<struct sockaddr_in *>((*current)->ai_addr)
-              ->sin_port = htons(static_cast<uint16_t>(port));
-        } else if (sockaddr_ptr->sa_family == AF_INET6) {
-          reinterpret_cast<struct sockaddr_in6 *>((*current)->ai_addr)
-              ->sin6_port = htons(static_cast<uint16_t>(port));
-        }
-      }
-    }
+  return true;
+}
+#endif
 
-    current = &((*current)->ai_next);
+inline bool has_header(const Headers &headers, const std::string &key) {
+  return headers.find(key) != headers.end();
+}
+
+inline const char *get_header_value(const Headers &headers,
+                                    const std::string &key, const char *def,
+                                    size_t id) {
+  auto rng = headers.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) { return it->second.c_str(); }
+  return def;
+}
+
+template <typename T>
+inline bool parse_header(const char *beg, const char *end, T fn) {
+  // Skip trailing spaces and tabs.
+  while (beg < end && is_space_or_tab(end[-1])) {
+    end--;
   }
 
-  CFRelease(context.addresses);
-  CFRelease(host_ref);
+  auto p = beg;
+  while (p < end && *p != ':') {
+    p++;
+  }
 
-  *res = result_addrinfo;
-  return 0;
-#elif defined(_GNU_SOURCE) && defined(__GLIBC__) &&                            \
-    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 2))
-  // Linux implementation using getaddrinfo_a for asynchronous DNS resolution
-  struct gaicb request;
-  struct gaicb *requests[1] = {&request};
-  struct sigevent sevp;
-  struct timespec timeout;
+  auto name = std::string(beg, p);
+  if (!detail::fields::is_field_name(name)) { return false; }
 
-  // Initialize the request structure
-  memset(&request, 0, sizeof(request));
-  request.ar_name = node;
-  request.ar_service = service;
-  request.ar_request = hints;
+  if (p == end) { return false; }
 
-  // Set up timeout
-  timeout.tv_sec = timeout_sec;
-  timeout.tv_nsec = 0;
+  auto key_end = p;
 
-  // Initialize sigevent structure (not used, but required)
-  memset(&sevp, 0, sizeof(sevp));
-  sevp.sigev_notify = SIGEV_NONE;
+  if (*p++ != ':') { return false; }
 
-  // Start asynchronous resolution
-  int start_result = getaddrinfo_a(GAI_NOWAIT, requests, 1, &sevp);
-  if (start_result != 0) { return start_result; }
+  while (p < end && is_space_or_tab(*p)) {
+    p++;
+  }
 
-  // Wait for completion with timeout
-  int wait_result =
-      gai_suspend((const struct gaicb *const *)requests, 1, &timeout);
+  if (p <= end) {
+    auto key_len = key_end - beg;
+    if (!key_len) { return false; }
 
-  if (wait_result == 0) {
-    // Completed successfully, get the result
-    int gai_result = gai_error(&request);
-    if (gai_result == 0) {
-      *res = request.ar_result;
-      return 0;
+    auto key = std::string(beg, key_end);
+    auto val = std::string(p, end);
+
+    if (!detail::fields::is_field_value(val)) { return false; }
+
+    if (case_ignore::equal(key, "Location") ||
+        case_ignore::equal(key, "Referer")) {
+      fn(key, val);
     } else {
-      // Clean up on error
-      if (request.ar_result) { freeaddrinfo(request.ar_result); }
-      return gai_result;
+      fn(key, decode_path(val, false));
     }
-  } else if (wait_result == EAI_AGAIN) {
-    // Timeout occurred, cancel the request
-    gai_cancel(&request);
-    return EAI_AGAIN;
-  } else {
-    // Other error occurred
-    gai_cancel(&request);
-    return wait_result;
+
+    return true;
   }
-#else
-  // Fallback implementation using thread-based timeout for other Unix systems
-  std::mutex result_mutex;
-  std::condition_variable result_cv;
-  auto completed = false;
-  auto result = EAI_SYSTEM;
-  struct addrinfo *result_addrinfo = nullptr;
 
-  std::thread resolve_thread([&]() {
-    auto thread_result = getaddrinfo(node, service, hints, &result_addrinfo);
+  return false;
+}
 
-    std::lock_guard<std::mutex> lock(result_mutex);
-    result = thread_result;
-    completed = true;
-    result_cv.notify_one();
-  });
+inline bool read_headers(Stream &strm, Headers &headers) {
+  const auto bufsiz = 2048;
+  char buf[bufsiz];
+  stream_line_reader line_reader(strm, buf, bufsiz);
 
-  // Wait for completion or timeout
-  std::unique_lock<std::mutex> lock(result_mutex);
-  auto finished = result_cv.wait_for(lock, std::chrono::seconds(timeout_sec),
-                                     [&] { return completed; });
+  size_t header_count = 0;
 
-  if (finished) {
-    // Operation completed within timeout
-    resolve_thread.join();
-    *res = result_addrinfo;
-    return result;
-  } else {
-    // Timeout occurred
-    resolve_thread.detach(); // Let the thread finish in background
-    return EAI_AGAIN;        // Return timeout error
-  }
-#endif
+  for (;;) {
+    if (!line_reader.getline()) { return false; }
+
+    // Check if the line ends with CRLF.
+    auto line_terminator_len = 2;
+    if (line_reader.end_with_crlf()) {
+      // Blank line indicates end of headers.
+      if (line_reader.size() == 2) { break; }
+    } else {
+#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
+      // Blank line indicates end of headers.
+      if (line_reader.size() == 1) { break; }
+      line_terminator_len = 1;
 #else
-  (void)(timeout_sec); // Unused parameter for non-blocking getaddrinfo
-  return getaddrinfo(node, service, hints, res);
+      continue; // Skip invalid line.
 #endif
-}
+    }
 
-template <typename BindOrConnect>
-socket_t create_socket(const std::string &host, const std::string &ip, int port,
-                       int address_family, int socket_flags, bool tcp_nodelay,
-                       bool ipv6_v6only, SocketOptions socket_options,
-                       BindOrConnect bind_or_connect, time_t timeout_sec = 0) {
-  // Get address info
-  const char *node = nullptr;
-  struct addrinfo hints;
-  struct addrinfo *result;
+    if (line_reader.size() > CPPHTTPLIB_HEADER_MAX_LENGTH) { return false; }
 
-  memset(&hints, 0, sizeof(struct addrinfo));
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = IPPROTO_IP;
+    // Check header count limit
+    if (header_count >= CPPHTTPLIB_HEADER_MAX_COUNT) { return false; }
 
-  if (!ip.empty()) {
-    node = ip.c_str();
-    // Ask getaddrinfo to convert IP in c-string to address
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_flags = AI_NUMERICHOST;
-  } else {
-    if (!host.empty()) { node = host.c_str(); }
-    hints.ai_family = address_family;
-    hints.ai_flags = socket_flags;
+    // Exclude line terminator
+    auto end = line_reader.ptr() + line_reader.size() - line_terminator_len;
+
+    if (!parse_header(line_reader.ptr(), end,
+                      [&](const std::string &key, const std::string &val) {
+                        headers.emplace(key, val);
+                      })) {
+      return false;
+    }
+
+    header_count++;
   }
 
-#if !defined(_WIN64) || defined(CPPHTTPLIB_HAVE_AFUNIX_H)
-  if (hints.ai_family == AF_UNIX) {
-    const auto addrlen = host.length();
-    if (addrlen > sizeof(sockaddr_un::sun_path)) { return INVALID_SOCKET; }
+  return true;
+}
 
-#ifdef SOCK_CLOEXEC
-    auto sock = socket(hints.ai_family, hints.ai_socktype | SOCK_CLOEXEC,
-                       hints.ai_protocol);
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+// Reads the header section into `req.header_block_` and indexes it in place
+// rather than allocating a key and a value string per header.
+inline bool read_headers(Stream &strm, Request &req) {
+  const auto bufsiz = 2048;
+  char buf[bufsiz];
+  stream_line_reader line_reader(strm, buf, bufsiz);
+
+  auto &block = req.header_block_;
+  auto &fields = req.header_fields_;
+  block.reserve(bufsiz);
+  fields.reserve(16);
+
+  for (;;) {
+    if (!line_reader.getline()) { return false; }
+
+    // Check if the line ends with CRLF.
+    auto line_terminator_len = 2;
+    if (line_reader.end_with_crlf()) {
+      // Blank line indicates end of headers.
+      if (line_reader.size() == 2) { break; }
+    } else {
+#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
+      // Blank line indicates end of headers.
+      if (line_reader.size() == 1) { break; }
+      line_terminator_len = 1;
 #else
-    auto sock = socket(hints.ai_family, hints.ai_socktype, hints.ai_protocol);
+      continue; // Skip invalid line.
 #endif
+    }
 
-    if (sock != INVALID_SOCKET) {
-      sockaddr_un addr{};
-      addr.sun_family = AF_UNIX;
+    if (line_reader.size() > CPPHTTPLIB_HEADER_MAX_LENGTH) { return false; }
 
-      auto unescaped_host = unescape_abstract_namespace_unix_domain(host);
-      std::copy(unescaped_host.begin(), unescaped_host.end(), addr.sun_path);
+    // Check header count limit
+    if (fields.size() >= CPPHTTPLIB_HEADER_MAX_COUNT) { return false; }
 
-      hints.ai_addr = reinterpret_cast<sockaddr *>(&addr);
-      hints.ai_addrlen = static_cast<socklen_t>(
-          sizeof(addr) - sizeof(addr.sun_path) + addrlen);
+    auto offset = block.size();
+    block.append(line_reader.ptr(), line_reader.size());
 
-#ifndef SOCK_CLOEXEC
-#ifndef _WIN64
-      fcntl(sock, F_SETFD, FD_CLOEXEC);
-#endif
-#endif
+    // Exclude line terminator
+    auto beg = &block[offset];
+    auto end = beg + line_reader.size() - line_terminator_len;
 
-      if (socket_options) { socket_options(sock); }
+    // Skip trailing spaces and tabs.
+    while (beg < end && is_space_or_tab(end[-1])) {
+      end--;
+    }
 
-#ifdef _WIN64
-      // Setting SO_REUSEADDR seems not to work well with AF_UNIX on windows, so
-      // remove the option.
-      detail::set_socket_opt(sock, SOL_SOCKET, SO_REUSEADDR, 0);
-#endif
+    auto p = beg;
+    while (p < end && *p != ':') {
+      p++;
+    }
 
-      bool dummy;
-      if (!bind_or_connect(sock, hints, dummy)) {
-        close_socket(sock);
-        sock = INVALID_SOCKET;
-      }
+    auto key_len = static_cast<size_t>(p - beg);
+    if (!fields::is_token(beg, key_len) || p == end) { return false; }
+    p++;
+
+    while (p < end && is_space_or_tab(*p)) {
+      p++;
     }
-    return sock;
-  }
-#endif
 
-  auto service = std::to_string(port);
+    auto val_len = static_cast<size_t>(end - p);
+    if (!fields::is_field_content(p, val_len)) { return false; }
 
-  if (getaddrinfo_with_timeout(node, service.c_str(), &hints, &result,
-                               timeout_sec)) {
-#if defined __linux__ && !defined __ANDROID__
-    res_init();
-#endif
-    return INVALID_SOCKET;
-  }
-  auto se = detail::scope_exit([&] { freeaddrinfo(result); });
+    if (std::memchr(p, '%', val_len) &&
+        !case_ignore::equal(beg, key_len, "Location", 8) &&
+        !case_ignore::equal(beg, key_len, "Referer", 7)) {
+      // Decoding never makes a value longer, so it can be done in place.
+      auto decoded = decode_path(std::string(p, val_len), false);
+      std::memcpy(p, decoded.data(), decoded.size());
+      val_len = decoded.size();
+    }
+    p[val_len] = '\0';
 
-  for (auto rp = result; rp; rp = rp->ai_next) {
-    // Create a socket
-#ifdef _WIN64
-    auto sock =
-        WSASocketW(rp->ai_family, rp->ai_socktype, rp->ai_protocol, nullptr, 0,
-                   WSA_FLAG_NO_HANDLE_INHERIT | WSA_FLAG_OVERLAPPED);
-    /**
-     * Since the WSA_FLAG_NO_HANDLE_INHERIT is only supported on Windows 7 SP1
-     * and above the socket creation fails on older Windows Systems.
-     *
-     * Let's try to create a socket the old way in this case.
-     *
-     * Reference:
-     * https://docs.microsoft.com/en-us/windows/win32/api/winsock2/nf-winsock2-wsasocketa
-     *
-     * WSA_FLAG_NO_HANDLE_INHERIT:
-     * This flag is supported on Windows 7 with SP1, Windows Server 2008 R2 with
-     * SP1, and later
-     *
-     */
-    if (sock == INVALID_SOCKET) {
-      sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+    HeaderField field;
+    field.hash = case_ignore::token_hash(beg, key_len);
+    field.name_offset = static_cast<uint32_t>(offset);
+    field.name_length = static_cast<uint32_t>(key_len);
+    field.value_offset = static_cast<uint32_t>(p - block.data());
+    field.value_length = static_cast<uint32_t>(val_len);
+
+    for (size_t i = 0; i < req.known_header_index_.size(); i++) {
+      if (field.hash == known_header_hashes[i] &&
+          req.known_header_index_[i] == SIZE_MAX &&
+          case_ignore::equal(beg, key_len, known_header_names[i],
+                             std::strlen(known_header_names[i]))) {
+        req.known_header_index_[i] = fields.size();
+      }
     }
-#else
 
-#ifdef SOCK_CLOEXEC
-    auto sock =
-        socket(rp->ai_family, rp->ai_socktype | SOCK_CLOEXEC, rp->ai_protocol);
-#else
-    auto sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-#endif
+    fields.push_back(field);
+  }
 
+  return true;
+}
 #endif
-    if (sock == INVALID_SOCKET) { continue; }
 
-#if !defined _WIN64 && !defined SOCK_CLOEXEC
-    if (fcntl(sock, F_SETFD, FD_CLOEXEC) == -1) {
-      close_socket(sock);
-      continue;
-    }
-#endif
+inline bool read_content_with_length(Stream &strm, size_t len,
+                                     DownloadProgress progress,
+                                     ContentReceiverWithProgress out) {
+  char buf[CPPHTTPLIB_RECV_BUFSIZ];
 
-    if (tcp_nodelay) { set_socket_opt(sock, IPPROTO_TCP, TCP_NODELAY, 1); }
+  size_t r = 0;
+  while (r < len) {
+    auto read_len = static_cast<size_t>(len - r);
+    auto n = strm.read(buf, (std::min)(read_len, CPPHTTPLIB_RECV_BUFSIZ));
+    if (n <= 0) { return false; }
 
-    if (rp->ai_family == AF_INET6) {
-      set_socket_opt(sock, IPPROTO_IPV6, IPV6_V6ONLY, ipv6_v6only ? 1 : 0);
+    if (!out(buf, static_cast<size_t>(n), r, len)) { return false; }
+    r += static_cast<size_t>(n);
+
+    if (progress) {
+      if (!progress(r, len)) { return false; }
     }
+  }
 
-    if (socket_options) { socket_options(sock); }
+  return true;
+}
+
+inline void skip_content_with_length(Stream &strm, size_t len) {
+  char buf[CPPHTTPLIB_RECV_BUFSIZ];
+  size_t r = 0;
+  while (r < len) {
+    auto read_len = static_cast<size_t>(len - r);
+    auto n = strm.read(buf, (std::min)(read_len, CPPHTTPLIB_RECV_BUFSIZ));
+    if (n <= 0) { return; }
+    r += static_cast<size_t>(n);
+  }
+}
+
+enum class ReadContentResult {
+  Success,         // Successfully read the content
+  PayloadTooLarge, // The content exceeds the specified payload limit
+  Error            // An error occurred while reading the content
+};
 
-    // bind or connect
-    auto quit = false;
-    if (bind_or_connect(sock, *rp, quit)) { return sock; }
+inline ReadContentResult
+read_content_without_length(Stream &strm, size_t payload_max_length,
+                            ContentReceiverWithProgress out) {
+  char buf[CPPHTTPLIB_RECV_BUFSIZ];
+  size_t r = 0;
+  for (;;) {
+    auto n = strm.read(buf, CPPHTTPLIB_RECV_BUFSIZ);
+    if (n == 0) { return ReadContentResult::Success; }
+    if (n < 0) { return ReadContentResult::Error; }
 
-    close_socket(sock);
+    // Check if adding this data would exceed the payload limit
+    if (r > payload_max_length ||
+        payload_max_length - r < static_cast<size_t>(n)) {
+      return ReadContentResult::PayloadTooLarge;
+    }
 
-    if (quit) { break; }
+    if (!out(buf, static_cast<size_t>(n), r, 0)) {
+      return ReadContentResult::Error;
+    }
+    r += static_cast<size_t>(n);
   }
 
-  return INVALID_SOCKET;
+  return ReadContentResult::Success;
 }
 
-inline void set_nonblocking(socket_t sock, bool nonblocking) {
-#ifdef _WIN64
-  auto flags = nonblocking ? 1UL : 0UL;
-  ioctlsocket(sock, FIONBIO, &flags);
-#else
-  auto flags = fcntl(sock, F_GETFL, 0);
-  fcntl(sock, F_SETFL,
-        nonblocking ? (flags | O_NONBLOCK) : (flags & (~O_NONBLOCK)));
-#endif
-}
+template <typename T>
+inline ReadContentResult read_content_chunked(Stream &strm, T &x,
+                                              size_t payload_max_length,
+                                              ContentReceiverWithProgress out) {
+  const auto bufsiz = 16;
+  char buf[bufsiz];
 
-inline bool is_connection_error() {
-#ifdef _WIN64
-  return WSAGetLastError() != WSAEWOULDBLOCK;
-#else
-  return errno != EINPROGRESS;
-#endif
-}
+  stream_line_reader line_reader(strm, buf, bufsiz);
 
-inline bool bind_ip_address(socket_t sock, const std::string &host) {
-  struct addrinfo hints;
-  struct addrinfo *result;
+  if (!line_reader.getline()) { return ReadContentResult::Error; }
 
-  memset(&hints, 0, sizeof(struct addrinfo));
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = 0;
+  unsigned long chunk_len;
+  size_t total_len = 0;
+  while (true) {
+    char *end_ptr;
 
-  if (getaddrinfo_with_timeout(host.c_str(), "0", &hints, &result, 0)) {
-    return false;
-  }
+    chunk_len = std::strtoul(line_reader.ptr(), &end_ptr, 16);
 
-  auto se = detail::scope_exit([&] { freeaddrinfo(result); });
+    if (end_ptr == line_reader.ptr()) { return ReadContentResult::Error; }
+    if (chunk_len == ULONG_MAX) { return ReadContentResult::Error; }
 
-  auto ret = false;
-  for (auto rp = result; rp; rp = rp->ai_next) {
-    const auto &ai = *rp;
-    if (!::bind(sock, ai.ai_addr, static_cast<socklen_t>(ai.ai_addrlen))) {
-      ret = true;
-      break;
+    if (chunk_len == 0) { break; }
+
+    // Check if adding this chunk would exceed the payload limit
+    if (total_len > payload_max_length ||
+        payload_max_length - total_len < chunk_len) {
+      return ReadContentResult::PayloadTooLarge;
     }
-  }
 
-  return ret;
-}
+    total_len += chunk_len;
 
-#if !defined _WIN64 && !defined ANDROID && !defined _AIX && !defined __MVS__
-#define USE_IF2IP
-#endif
+    if (!read_content_with_length(strm, chunk_len, nullptr, out)) {
+      return ReadContentResult::Error;
+    }
 
-#ifdef USE_IF2IP
-inline std::string if2ip(int address_family, const std::string &ifn) {
-  struct ifaddrs *ifap;
-  getifaddrs(&ifap);
-  auto se = detail::scope_exit([&] { freeifaddrs(ifap); });
+    if (!line_reader.getline()) { return ReadContentResult::Error; }
 
-  std::string addr_candidate;
-  for (auto ifa = ifap; ifa; ifa = ifa->ifa_next) {
-    if (ifa->ifa_addr && ifn == ifa->ifa_name &&
-        (AF_UNSPEC == address_family ||
-         ifa->ifa_addr->sa_family == address_family)) {
-      if (ifa->ifa_addr->sa_family == AF_INET) {
-        auto sa = reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr);
-        char buf[INET_ADDRSTRLEN];
-        if (inet_ntop(AF_INET, &sa->sin_addr, buf, INET_ADDRSTRLEN)) {
-          return std::string(buf, INET_ADDRSTRLEN);
-        }
-      } else if (ifa->ifa_addr->sa_family == AF_INET6) {
-        auto sa = reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_addr);
-        if (!IN6_IS_ADDR_LINKLOCAL(&sa->sin6_addr)) {
-          char buf[INET6_ADDRSTRLEN] = {};
-          if (inet_ntop(AF_INET6, &sa->sin6_addr, buf, INET6_ADDRSTRLEN)) {
-            // equivalent to mac's IN6_IS_ADDR_UNIQUE_LOCAL
-            auto s6_addr_head = sa->sin6_addr.s6_addr[0];
-            if (s6_addr_head == 0xfc || s6_addr_head == 0xfd) {
-              addr_candidate = std::string(buf, INET6_ADDRSTRLEN);
-            } else {
-              return std::string(buf, INET6_ADDRSTRLEN);
-            }
-          }
-        }
-      }
+    if (strcmp(line_reader.ptr(), "\r\n") != 0) {
+      return ReadContentResult::Error;
     }
+
+    if (!line_reader.getline()) { return ReadContentResult::Error; }
   }
-  return addr_candidate;
-}
-#endif
 
-inline socket_t create_client_socket(
-    const std::string &host, const std::string &ip, int port,
-    int address_family, bool tcp_nodelay, bool ipv6_v6only,
-    SocketOptions socket_options, time_t connection_timeout_sec,
-    time_t connection_timeout_usec, time_t read_timeout_sec,
-    time_t read_timeout_usec, time_t write_timeout_sec,
-    time_t write_timeout_usec, const std::string &intf, Error &error) {
-  auto sock = create_socket(
-      host, ip, port, address_family, 0, tcp_nodelay, ipv6_v6only,
-      std::move(socket_options),
-      [&](socket_t sock2, struct addrinfo &ai, bool &quit) -> bool {
-        if (!intf.empty()) {
-#ifdef USE_IF2IP
-          auto ip_from_if = if2ip(address_family, intf);
-          if (ip_from_if.empty()) { ip_from_if = intf; }
-          if (!bind_ip_address(sock2, ip_from_if)) {
-            error = Error::BindIPAddress;
-            return false;
-          }
-#endif
-        }
+  assert(chunk_len == 0);
 
-        set_nonblocking(sock2, true);
+  // NOTE: In RFC 9112, '7.1 Chunked Transfer Coding' mentions "The chunked
+  // transfer coding is complete when a chunk with a chunk-size of zero is
+  // received, possibly followed by a trailer section, and finally terminated by
+  // an empty line". https://www.rfc-editor.org/rfc/rfc9112.html#section-7.1
+  //
+  // In '7.1.3. Decoding Chunked', however, the pseudo-code in the section
+  // does't care for the existence of the final CRLF. In other words, it seems
+  // to be ok whether the final CRLF exists or not in the chunked data.
+  // https://www.rfc-editor.org/rfc/rfc9112.html#section-7.1.3
+  //
+  // According to the reference code in RFC 9112, cpp-httplib now allows
+  // chunked transfer coding data without the final CRLF.
+  if (!line_reader.getline()) { return ReadContentResult::Success; }
 
-        auto ret =
-            ::connect(sock2, ai.ai_addr, static_cast<socklen_t>(ai.ai_addrlen));
+  // RFC 7230 Section 4.1.2 - Headers prohibited in trailers
+  thread_local case_ignore::unordered_set<std::string> prohibited_trailers = {
+      // Message framing
+      "transfer-encoding", "content-length",
 
-        if (ret < 0) {
-          if (is_connection_error()) {
-            error = Error::Connection;
-            return false;
-          }
-          error = wait_until_socket_is_ready(sock2, connection_timeout_sec,
-                                             connection_timeout_usec);
-          if (error != Error::Success) {
-            if (error == Error::ConnectionTimeout) { quit = true; }
-            return false;
-          }
-        }
+      // Routing
+      "host",
 
-        set_nonblocking(sock2, false);
-        set_socket_opt_time(sock2, SOL_SOCKET, SO_RCVTIMEO, read_timeout_sec,
-                            read_timeout_usec);
-        set_socket_opt_time(sock2, SOL_SOCKET, SO_SNDTIMEO, write_timeout_sec,
-                            write_timeout_usec);
+      // Authentication
+      "authorization", "www-authenticate", "proxy-authenticate",
+      "proxy-authorization", "cookie", "set-cookie",
 
-        error = Error::Success;
-        return true;
-      },
-      connection_timeout_sec); // Pass DNS timeout
+      // Request modifiers
+      "cache-control", "expect", "max-forwards", "pragma", "range", "te",
 
-  if (sock != INVALID_SOCKET) {
-    error = Error::Success;
-  } else {
-    if (error == Error::Success) { error = Error::Connection; }
-  }
+      // Response control
+      "age", "expires", "date", "location", "retry-after", "vary", "warning",
 
-  return sock;
-}
+      // Payload processing
+      "content-encoding", "content-type", "content-range", "trailer"};
 
-inline bool get_ip_and_port(const struct sockaddr_storage &addr,
-                            socklen_t addr_len, std::string &ip, int &port) {
-  if (addr.ss_family == AF_INET) {
-    port = ntohs(reinterpret_cast<const struct sockaddr_in *>(&addr)->sin_port);
-  } else if (addr.ss_family == AF_INET6) {
-    port =
-        ntohs(reinterpret_cast<const struct sockaddr_in6 *>(&addr)->sin6_port);
-  } else {
-    return false;
+  // Parse declared trailer headers once for performance
+  case_ignore::unordered_set<std::string> declared_trailers;
+  if (x.has_header("Trailer")) {
+    auto trailer_header = x.get_header_value("Trailer");
+
+    split(trailer_header.data(), trailer_header.data() + trailer_header.size(),
+          ',',
+          [&](const char *b, const char *e) {
+            std::string key(b, e);
+            if (prohibited_trailers.find(key) == prohibited_trailers.end()) {
+              declared_trailers.insert(key);
+            }
+          });
   }
 
-  std::array<char, NI_MAXHOST> ipstr{};
-  if (getnameinfo(reinterpret_cast<const struct sockaddr *>(&addr), addr_len,
-                  ipstr.data(), static_cast<socklen_t>(ipstr.size()), nullptr,
-                  0, NI_NUMERICHOST)) {
-    return false;
+  size_t trailer_header_count = 0;
+  while (strcmp(line_reader.ptr(), "\r\n") != 0) {
+    if (line_reader.size() > CPPHTTPLIB_HEADER_MAX_LENGTH) {
+      return ReadContentResult::Error;
+    }
+
+    // Check trailer header count limit
+    if (trailer_header_count >= CPPHTTPLIB_HEADER_MAX_COUNT) {
+      return ReadContentResult::Error;
+    }
+
+    // Exclude line terminator
+    constexpr auto line_terminator_len = 2;
+    auto end = line_reader.ptr() + line_reader.size() - line_terminator_len;
+
+    parse_header(line_reader.ptr(), end,
+                 [&](const std::string &key, const std::string &val) {
+                   if (declared_trailers.find(key) != declared_trailers.end()) {
+                     x.trailers.emplace(key, val);
+                     trailer_header_count++;
+                   }
+                 });
+
+    if (!line_reader.getline()) { return ReadContentResult::Error; }
   }
 
-  ip = ipstr.data();
-  return true;
+  return ReadContentResult::Success;
 }
 
-inline void get_local_ip_and_port(socket_t sock, std::string &ip, int &port) {
-  struct sockaddr_storage addr;
-  socklen_t addr_len = sizeof(addr);
-  if (!getsockname(sock, reinterpret_cast<struct sockaddr *>(&addr),
-                   &addr_len)) {
-    get_ip_and_port(addr, addr_len, ip, port);
-  }
+template <typename T> inline bool is_chunked_transfer_encoding(const T &x) {
+  return case_ignore::equal(x.get_header_value("Transfer-Encoding"), "chunked");
 }
 
-inline void get_remote_ip_and_port(socket_t sock, std::string &ip, int &port) {
-  struct sockaddr_storage addr;
-  socklen_t addr_len = sizeof(addr);
+template <typename T, typename U>
+bool prepare_content_receiver(T &x, int &status,
+                              ContentReceiverWithProgress receiver,
+                              bool decompress, U callback) {
+  if (decompress) {
+    std::string encoding = x.get_header_value("Content-Encoding");
+    std::unique_ptr<decompressor> decompressor;
 
-  if (!getpeername(sock, reinterpret_cast<struct sockaddr *>(&addr),
-                   &addr_len)) {
-#ifndef _WIN64
-    if (addr.ss_family == AF_UNIX) {
-#if defined(__linux__)
-      struct ucred ucred;
-      socklen_t len = sizeof(ucred);
-      if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &ucred, &len) == 0) {
-        port = ucred.pid;
-      }
-#elif defined(SOL_LOCAL) && defined(SO_PEERPID)
-      pid_t pid;
-      socklen_t len = sizeof(pid);
-      if (getsockopt(sock, SOL_LOCAL, SO_PEERPID, &pid, &len) == 0) {
-        port = pid;
-      }
+    if (encoding == "gzip" || encoding == "deflate") {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+      decompressor = detail::make_unique<gzip_decompressor>();
+#else
+      status = StatusCode::UnsupportedMediaType_415;
+      return false;
 #endif
-      return;
-    }
+    } else if (encoding.find("br") != std::string::npos) {
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+      decompressor = detail::make_unique<brotli_decompressor>();
+#else
+      status = StatusCode::UnsupportedMediaType_415;
+      return false;
 #endif
-    get_ip_and_port(addr, addr_len, ip, port);
-  }
-}
-
-inline constexpr unsigned int str2tag_core(const char *s, size_t l,
-                                           unsigned int h) {
-  return (l == 0)
-             ? h
-             : str2tag_core(
-                   s + 1, l - 1,
-                   // Unsets the 6 high bits of h, therefore no overflow happens
-                   (((std::numeric_limits<unsigned int>::max)() >> 6) &
-                    h * 33) ^
-                       static_cast<unsigned char>(*s));
-}
-
-inline unsigned int str2tag(const std::string &s) {
-  return str2tag_core(s.data(), s.size(), 0);
-}
+    } else if (encoding == "zstd") {
+#ifdef CPPHTTPLIB_ZSTD_SUPPORT
+      decompressor = detail::make_unique<zstd_decompressor>();
+#else
+      status = StatusCode::UnsupportedMediaType_415;
+      return false;
+#endif
+    }
 
-namespace udl {
+    if (decompressor) {
+      if (decompressor->is_valid()) {
+        ContentReceiverWithProgress out = [&](const char *buf, size_t n,
+                                              size_t off, size_t len) {
+          return decompressor->decompress(buf, n,
+                                          [&](const char *buf2, size_t n2) {
+                                            return receiver(buf2, n2, off, len);
+                                          });
+        };
+        return callback(std::move(out));
+      } else {
+        status = StatusCode::InternalServerError_500;
+        return false;
+      }
+    }
+  }
 
-inline constexpr unsigned int operator""_t(const char *s, size_t l) {
-  return str2tag_core(s, l, 0);
+  ContentReceiverWithProgress out = [&](const char *buf, size_t n, size_t off,
+                                        size_t len) {
+    return receiver(buf, n, off, len);
+  };
+  return callback(std::move(out));
 }
 
-} // namespace udl
-
-inline std::string
-find_content_type(const std::string &path,
-                  const std::map<std::string, std::string> &user_data,
-                  const std::string &default_content_type) {
-  auto ext = file_extension(path);
-
-  auto it = user_data.find(ext);
-  if (it != user_data.end()) { return it->second; }
-
-  using udl::operator""_t;
+template <typename T>
+bool read_content(Stream &strm, T &x, size_t payload_max_length, int &status,
+                  DownloadProgress progress,
+                  ContentReceiverWithProgress receiver, bool decompress) {
+  return prepare_content_receiver(
+      x, status, std::move(receiver), decompress,
+      [&](const ContentReceiverWithProgress &out) {
+        auto ret = true;
+        auto exceed_payload_max_length = false;
 
-  switch (str2tag(ext)) {
-  default: return default_content_type;
+        if (is_chunked_transfer_encoding(x)) {
+          auto result = read_content_chunked(strm, x, payload_max_length, out);
+          if (result == ReadContentResult::Success) {
+            ret = true;
+          } else if (result == ReadContentResult::PayloadTooLarge) {
+            exceed_payload_max_length = true;
+            ret = false;
+          } else {
+            ret = false;
+          }
+        } else if (!x.has_header("Content-Length")) {
+          auto result =
+              read_content_without_length(strm, payload_max_length, out);
+          if (result == ReadContentResult::Success) {
+            ret = true;
+          } else if (result == ReadContentResult::PayloadTooLarge) {
+            exceed_payload_max_length = true;
+            ret = false;
+          } else {
+            ret = false;
+          }
+        } else {
+          auto is_invalid_value = false;
+          auto len = get_header_value_u64(x, "Content-Length",
+                                          (std::numeric_limits<size_t>::max)(),
+                                          0, is_invalid_value);
 
-  case "css"_t: return "text/css";
-  case "csv"_t: return "text/csv";
-  case "htm"_t:
-  case "html"_t: return "text/html";
-  case "js"_t:
-  case "mjs"_t: return "text/javascript";
-  case "txt"_t: return "text/plain";
-  case "vtt"_t: return "text/vtt";
+          if (is_invalid_value) {
+            ret = false;
+          } else if (len > payload_max_length) {
+            exceed_payload_max_length = true;
+            skip_content_with_length(strm, len);
+            ret = false;
+          } else if (len > 0) {
+            ret = read_content_with_length(strm, len, std::move(progress), out);
+          }
+        }
 
-  case "apng"_t: return "image/apng";
-  case "avif"_t: return "image/avif";
-  case "bmp"_t: return "image/bmp";
-  case "gif"_t: return "image/gif";
-  case "png"_t: return "image/png";
-  case "svg"_t: return "image/svg+xml";
-  case "webp"_t: return "image/webp";
-  case "ico"_t: return "image/x-icon";
-  case "tif"_t: return "image/tiff";
-  case "tiff"_t: return "image/tiff";
-  case "jpg"_t:
-  case "jpeg"_t: return "image/jpeg";
+        if (!ret) {
+          status = exceed_payload_max_length ? StatusCode::PayloadTooLarge_413
+                                             : StatusCode::BadRequest_400;
+        }
+        return ret;
+      });
+}
 
-  case "mp4"_t: return "video/mp4";
-  case "mpeg"_t: return "video/mpeg";
-  case "webm"_t: return "video/webm";
+inline ssize_t write_request_line(Stream &strm, const std::string &method,
+                                  const std::string &path) {
+  std::string s = method;
+  s += " ";
+  s += path;
+  s += " HTTP/1.1\r\n";
+  return strm.write(s.data(), s.size());
+}
 
-  case "mp3"_t: return "audio/mp3";
-  case "mpga"_t: return "audio/mpeg";
-  case "weba"_t: return "audio/webm";
-  case "wav"_t: return "audio/wave";
+inline ssize_t write_response_line(Stream &strm, int status) {
+  std::string s = "HTTP/1.1 ";
+  s += std::to_string(status);
+  s += " ";
+  s += httplib::status_message(status);
+  s += "\r\n";
+  return strm.write(s.data(), s.size());
+}
 
-  case "otf"_t: return "font/otf";
-  case "ttf"_t: return "font/ttf";
-  case "woff"_t: return "font/woff";
-  case "woff2"_t: return "font/woff2";
+inline ssize_t write_headers(Stream &strm, const Headers &headers) {
+  ssize_t write_len = 0;
+  for (const auto &x : headers) {
+    std::string s;
+    s = x.first;
+    s += ": ";
+    s += x.second;
+    s += "\r\n";
 
-  case "7z"_t: return "application/x-7z-compressed";
-  case "atom"_t: return "application/atom+xml";
-  case "pdf"_t: return "application/pdf";
-  case "json"_t: return "application/json";
-  case "rss"_t: return "application/rss+xml";
-  case "tar"_t: return "application/x-tar";
-  case "xht"_t:
-  case "xhtml"_t: return "application/xhtml+xml";
-  case "xslt"_t: return "application/xslt+xml";
-  case "xml"_t: return "application/xml";
-  case "gz"_t: return "application/gzip";
-  case "zip"_t: return "application/zip";
-  case "wasm"_t: return "application/wasm";
+    auto len = strm.write(s.data(), s.size());
+    if (len < 0) { return len; }
+    write_len += len;
   }
+  auto len = strm.write("\r\n");
+  if (len < 0) { return len; }
+  write_len += len;
+  return write_len;
 }
 
-inline bool can_compress_content_type(const std::string &content_type) {
-  using udl::operator""_t;
-
-  auto tag = str2tag(content_type);
-
-  switch (tag) {
-  case "image/svg+xml"_t:
-  case "application/javascript"_t:
-  case "application/json"_t:
-  case "application/xml"_t:
-  case "application/protobuf"_t:
-  case "application/xhtml+xml"_t: return true;
-
-  case "text/event-stream"_t: return false;
+inline bool write_data(Stream &strm, const char *d, size_t l) {
+  size_t offset = 0;
+  while (offset < l) {
+    auto length = strm.write(d + offset, l - offset);
+    if (length < 0) { return false; }
+    offset += static_cast<size_t>(length);
+  }
+  return true;
+}
 
-  default: return !content_type.rfind("text/", 0);
+template <typename T>
+inline bool write_file_content(Stream &strm, int fd, size_t offset,
+                               size_t length, T is_shutting_down) {
+  auto end_offset = offset + length;
+  while (offset < end_offset && !is_shutting_down()) {
+    auto n = strm.send_file(fd, offset, end_offset - offset);
+    if (n <= 0) { return false; }
+    offset += static_cast<size_t>(n);
   }
+  return offset == end_offset;
 }
 
-inline EncodingType encoding_type(const Request &req, const Response &res) {
-  auto ret =
-      detail::can_compress_content_type(res.get_header_value("Content-Type"));
-  if (!ret) { return EncodingType::None; }
+template <typename T>
+inline bool write_content_with_progress(Stream &strm,
+                                        const ContentProvider &content_provider,
+                                        size_t offset, size_t length,
+                                        T is_shutting_down,
+                                        const UploadProgress &upload_progress,
+                                        Error &error) {
+  size_t end_offset = offset + length;
+  size_t start_offset = offset;
+  auto ok = true;
+  DataSink data_sink;
 
-  const auto &s = req.get_header_value("Accept-Encoding");
-  (void)(s);
+  data_sink.write = [&](const char *d, size_t l) -> bool {
+    if (ok) {
+      if (write_data(strm, d, l)) {
+        offset += l;
 
-#ifdef CPPHTTPLIB_BROTLI_SUPPORT
-  // TODO: 'Accept-Encoding' has br, not br;q=0
-  ret = s.find("br") != std::string::npos;
-  if (ret) { return EncodingType::Brotli; }
-#endif
+        if (upload_progress && length > 0) {
+          size_t current_written = offset - start_offset;
+          if (!upload_progress(current_written, length)) {
+            ok = false;
+            return false;
+          }
+        }
+      } else {
+        ok = false;
+      }
+    }
+    return ok;
+  };
 
-#ifdef CPPHTTPLIB_ZLIB_SUPPORT
-  // TODO: 'Accept-Encoding' has gzip, not gzip;q=0
-  ret = s.find("gzip") != std::string::npos;
-  if (ret) { return EncodingType::Gzip; }
-#endif
+  data_sink.is_writable = [&]() -> bool { return strm.wait_writable(); };
 
-#ifdef CPPHTTPLIB_ZSTD_SUPPORT
-  // TODO: 'Accept-Encoding' has zstd, not zstd;q=0
-  ret = s.find("zstd") != std::string::npos;
-  if (ret) { return EncodingType::Zstd; }
-#endif
+  while (offset < end_offset && !is_shutting_down()) {
+    if (!strm.wait_writable()) {
+      error = Error::Write;
+      return false;
+    } else if (!content_provider(offset, end_offset - offset, data_sink)) {
+      error = Error::Canceled;
+      return false;
+    } else if (!ok) {
+      error = Error::Write;
+      return false;
+    }
+  }
 
-  return EncodingType::None;
+  error = Error::Success;
+  return true;
 }
 
-inline bool nocompressor::compress(const char *data, size_t data_length,
-                                   bool /*last*/, Callback callback) {
-  if (!data_length) { return true; }
-  return callback(data, data_length);
+template <typename T>
+inline bool write_content(Stream &strm, const ContentProvider &content_provider,
+                          size_t offset, size_t length, T is_shutting_down,
+                          Error &error) {
+  return write_content_with_progress<T>(strm, content_provider, offset, length,
+                                        is_shutting_down, nullptr, error);
 }
 
-#ifdef CPPHTTPLIB_ZLIB_SUPPORT
-inline gzip_compressor::gzip_compressor() {
-  std::memset(&strm_, 0, sizeof(strm_));
-  strm_.zalloc = Z_NULL;
-  strm_.zfree = Z_NULL;
-  strm_.opaque = Z_NULL;
-
-  is_valid_ = deflateInit2(&strm_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
-                           Z_DEFAULT_STRATEGY) == Z_OK;
+template <typename T>
+inline bool write_content(Stream &strm, const ContentProvider &content_provider,
+                          size_t offset, size_t length,
+                          const T &is_shutting_down) {
+  auto error = Error::Success;
+  return write_content(strm, content_provider, offset, length, is_shutting_down,
+                       error);
 }
 
-inline gzip_compressor::~gzip_compressor() { deflateEnd(&strm_); }
-
-inline bool gzip_compressor::compress(const char *data, size_t data_length,
-                                      bool last, Callback callback) {
-  assert(is_valid_);
-
-  do {
-    constexpr size_t max_avail_in =
-        (std::numeric_limits<decltype(strm_.avail_in)>::max)();
-
-    strm_.avail_in = static_cast<decltype(strm_.avail_in)>(
-        (std::min)(data_length, max_avail_in));
-    strm_.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data));
-
-    data_length -= strm_.avail_in;
-    data += strm_.avail_in;
-
-    auto flush = (last && data_length == 0) ? Z_FINISH : Z_NO_FLUSH;
-    auto ret = Z_OK;
-
-    std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
-    do {
-      strm_.avail_out = static_cast<uInt>(buff.size());
-      strm_.next_out = reinterpret_cast<Bytef *>(buff.data());
+template <typename T>
+inline bool
+write_content_without_length(Stream &strm,
+                             const ContentProvider &content_provider,
+                             const T &is_shutting_down) {
+  size_t offset = 0;
+  auto data_available = true;
+  auto ok = true;
+  DataSink data_sink;
 
-      ret = deflate(&strm_, flush);
-      if (ret == Z_STREAM_ERROR) { return false; }
+  data_sink.write = [&](const char *d, size_t l) -> bool {
+    if (ok) {
+      offset += l;
+      if (!write_data(strm, d, l)) { ok = false; }
+    }
+    return ok;
+  };
 
-      if (!callback(buff.data(), buff.size() - strm_.avail_out)) {
-        return false;
-      }
-    } while (strm_.avail_out == 0);
+  data_sink.is_writable = [&]() -> bool { return strm.wait_writable(); };
 
-    assert((flush == Z_FINISH && ret == Z_STREAM_END) ||
-           (flush == Z_NO_FLUSH && ret == Z_OK));
-    assert(strm_.avail_in == 0);
-  } while (data_length > 0);
+  data_sink.done = [&](void) { data_available = false; };
 
+  while (data_available && !is_shutting_down()) {
+    if (!strm.wait_writable()) {
+      return false;
+    } else if (!content_provider(offset, 0, data_sink)) {
+      return false;
+    } else if (!ok) {
+      return false;
+    }
+  }
   return true;
 }
 
-inline gzip_decompressor::gzip_decompressor() {
-  std::memset(&strm_, 0, sizeof(strm_));
-  strm_.zalloc = Z_NULL;
-  strm_.zfree = Z_NULL;
-  strm_.opaque = Z_NULL;
-
-  // 15 is the value of wbits, which should be at the maximum possible value
-  // to ensure that any gzip stream can be decoded. The offset of 32 specifies
-  // that the stream type should be automatically detected either gzip or
-  // deflate.
-  is_valid_ = inflateInit2(&strm_, 32 + 15) == Z_OK;
-}
-
-inline gzip_decompressor::~gzip_decompressor() { inflateEnd(&strm_); }
-
-inline bool gzip_decompressor::is_valid() const { return is_valid_; }
-
-inline bool gzip_decompressor::decompress(const char *data, size_t data_length,
-                                          Callback callback) {
-  assert(is_valid_);
+template <typename T, typename U>
+inline bool
+write_content_chunked(Stream &strm, const ContentProvider &content_provider,
+                      const T &is_shutting_down, U &compressor, Error &error) {
+  size_t offset = 0;
+  auto data_available = true;
+  auto ok = true;
+  DataSink data_sink;
 
-  auto ret = Z_OK;
+  data_sink.write = [&](const char *d, size_t l) -> bool {
+    if (ok) {
+      data_available = l > 0;
+      offset += l;
 
-  do {
-    constexpr size_t max_avail_in =
-        (std::numeric_limits<decltype(strm_.avail_in)>::max)();
+      std::string payload;
+      if (compressor.compress(d, l, false,
+                              [&](const char *data, size_t data_len) {
+                                payload.append(data, data_len);
+                                return true;
+                              })) {
+        if (!payload.empty()) {
+          // Emit chunked response header and footer for each chunk
+          auto chunk =
+              from_i_to_hex(payload.size()) + "\r\n" + payload + "\r\n";
+          if (!write_data(strm, chunk.data(), chunk.size())) { ok = false; }
+        }
+      } else {
+        ok = false;
+      }
+    }
+    return ok;
+  };
 
-    strm_.avail_in = static_cast<decltype(strm_.avail_in)>(
-        (std::min)(data_length, max_avail_in));
-    strm_.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data));
+  data_sink.is_writable = [&]() -> bool { return strm.wait_writable(); };
 
-    data_length -= strm_.avail_in;
-    data += strm_.avail_in;
+  auto done_with_trailer = [&](const Headers *trailer) {
+    if (!ok) { return; }
 
-    std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
-    while (strm_.avail_in > 0 && ret == Z_OK) {
-      strm_.avail_out = static_cast<uInt>(buff.size());
-      strm_.next_out = reinterpret_cast<Bytef *>(buff.data());
+    data_available = false;
 
-      ret = inflate(&strm_, Z_NO_FLUSH);
+    std::string payload;
+    if (!compressor.compress(nullptr, 0, true,
+                             [&](const char *data, size_t data_len) {
+                               payload.append(data, data_len);
+                               return true;
+                             })) {
+      ok = false;
+      return;
+    }
 
-      assert(ret != Z_STREAM_ERROR);
-      switch (ret) {
-      case Z_NEED_DICT:
-      case Z_DATA_ERROR:
-      case Z_MEM_ERROR: inflateEnd(&strm_); return false;
+    if (!payload.empty()) {
+      // Emit chunked response header and footer for each chunk
+      auto chunk = from_i_to_hex(payload.size()) + "\r\n" + payload + "\r\n";
+      if (!write_data(strm, chunk.data(), chunk.size())) {
+        ok = false;
+        return;
       }
+    }
 
-      if (!callback(buff.data(), buff.size() - strm_.avail_out)) {
-        return false;
+    constexpr const char done_marker[] = "0\r\n";
+    if (!write_data(strm, done_marker, str_len(done_marker))) { ok = false; }
+
+    // Trailer
+    if (trailer) {
+      for (const auto &kv : *trailer) {
+        std::string field_line = kv.first + ": " + kv.second + "\r\n";
+        if (!write_data(strm, field_line.data(), field_line.size())) {
+          ok = false;
+        }
       }
     }
 
-    if (ret != Z_OK && ret != Z_STREAM_END) { return false; }
+    constexpr const char crlf[] = "\r\n";
+    if (!write_data(strm, crlf, str_len(crlf))) { ok = false; }
+  };
+
+  data_sink.done = [&](void) { done_with_trailer(nullptr); };
+
+  data_sink.done_with_trailer = [&](const Headers &trailer) {
+    done_with_trailer(&trailer);
+  };
 
-  } while (data_length > 0);
+  while (data_available && !is_shutting_down()) {
+    if (!strm.wait_writable()) {
+      error = Error::Write;
+      return false;
+    } else if (!content_provider(offset, 0, data_sink)) {
+      error = Error::Canceled;
+      return false;
+    } else if (!ok) {
+      error = Error::Write;
+      return false;
+    }
+  }
 
+  error = Error::Success;
   return true;
 }
-#endif
 
-#ifdef CPPHTTPLIB_BROTLI_SUPPORT
-inline brotli_compressor::brotli_compressor() {
-  state_ = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+template <typename T, typename U>
+inline bool write_content_chunked(Stream &strm,
+                                  const ContentProvider &content_provider,
+                                  const T &is_shutting_down, U &compressor) {
+  auto error = Error::Success;
+  return write_content_chunked(strm, content_provider, is_shutting_down,
+                               compressor, error);
 }
 
-inline brotli_compressor::~brotli_compressor() {
-  BrotliEncoderDestroyInstance(state_);
-}
+template <typename T>
+inline bool redirect(T &cli, Request &req, Response &res,
+                     const std::string &path, const std::string &location,
+                     Error &error) {
+  Request new_req = req;
+  new_req.path = path;
+  new_req.redirect_count_ -= 1;
 
-inline bool brotli_compressor::compress(const char *data, size_t data_length,
-                                        bool last, Callback callback) {
-  std::array<uint8_t, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
+  if (res.status == StatusCode::SeeOther_303 &&
+      (req.method != "GET" && req.method != "HEAD")) {
+    new_req.method = "GET";
+    new_req.body.clear();
+    new_req.headers.clear();
+  }
 
-  auto operation = last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
-  auto available_in = data_length;
-  auto next_in = reinterpret_cast<const uint8_t *>(data);
+  Response new_res;
 
-  for (;;) {
-    if (last) {
-      if (BrotliEncoderIsFinished(state_)) { break; }
-    } else {
-      if (!available_in) { break; }
-    }
+  auto ret = cli.send(new_req, new_res, error);
+  if (ret) {
+    req = new_req;
+    res = new_res;
 
-    auto available_out = buff.size();
-    auto next_out = buff.data();
+    if (res.location.empty()) { res.location = location; }
+  }
+  return ret;
+}
 
-    if (!BrotliEncoderCompressStream(state_, operation, &available_in, &next_in,
-                                     &available_out, &next_out, nullptr)) {
-      return false;
-    }
+inline std::string params_to_query_str(const Params &params) {
+  std::string query;
 
-    auto output_bytes = buff.size() - available_out;
-    if (output_bytes) {
-      callback(reinterpret_cast<const char *>(buff.data()), output_bytes);
-    }
+  for (auto it = params.begin(); it != params.end(); ++it) {
+    if (it != params.begin()) { query += "&"; }
+    query += it->first;
+    query += "=";
+    query += httplib::encode_uri_component(it->second);
   }
+  return query;
+}
 
-  return true;
+inline void parse_query_text(const char *data, std::size_t size,
+                             Params &params) {
+  std::set<std::string> cache;
+  split(data, data + size, '&', [&](const char *b, const char *e) {
+    std::string kv(b, e);
+    if (cache.find(kv) != cache.end()) { return; }
+    cache.insert(std::move(kv));
+
+    std::string key;
+    std::string val;
+    divide(b, static_cast<std::size_t>(e - b), '=',
+           [&](const char *lhs_data, std::size_t lhs_size, const char *rhs_data,
+               std::size_t rhs_size) {
+             key.assign(lhs_data, lhs_size);
+             val.assign(rhs_data, rhs_size);
+           });
+
+    if (!key.empty()) {
+      params.emplace(decode_path(key, true), decode_path(val, true));
+    }
+  });
 }
 
-inline brotli_decompressor::brotli_decompressor() {
-  decoder_s = BrotliDecoderCreateInstance(0, 0, 0);
-  decoder_r = decoder_s ? BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT
-                        : BROTLI_DECODER_RESULT_ERROR;
+inline void parse_query_text(const std::string &s, Params &params) {
+  parse_query_text(s.data(), s.size(), params);
 }
 
-inline brotli_decompressor::~brotli_decompressor() {
-  if (decoder_s) { BrotliDecoderDestroyInstance(decoder_s); }
+inline bool parse_multipart_boundary(const std::string &content_type,
+                                     std::string &boundary) {
+  auto boundary_keyword = "boundary=";
+  auto pos = content_type.find(boundary_keyword);
+  if (pos == std::string::npos) { return false; }
+  auto end = content_type.find(';', pos);
+  auto beg = pos + strlen(boundary_keyword);
+  boundary = trim_double_quotes_copy(content_type.substr(beg, end - beg));
+  return !boundary.empty();
 }
 
-inline bool brotli_decompressor::is_valid() const { return decoder_s; }
+inline void parse_disposition_params(const std::string &s, Params &params) {
+  std::set<std::string> cache;
+  split(s.data(), s.data() + s.size(), ';', [&](const char *b, const char *e) {
+    std::string kv(b, e);
+    if (cache.find(kv) != cache.end()) { return; }
+    cache.insert(kv);
 
-inline bool brotli_decompressor::decompress(const char *data,
-                                            size_t data_length,
-                                            Callback callback) {
-  if (decoder_r == BROTLI_DECODER_RESULT_SUCCESS ||
-      decoder_r == BROTLI_DECODER_RESULT_ERROR) {
-    return 0;
-  }
+    std::string key;
+    std::string val;
+    split(b, e, '=', [&](const char *b2, const char *e2) {
+      if (key.empty()) {
+        key.assign(b2, e2);
+      } else {
+        val.assign(b2, e2);
+      }
+    });
 
-  auto next_in = reinterpret_cast<const uint8_t *>(data);
-  size_t avail_in = data_length;
-  size_t total_out;
+    if (!key.empty()) {
+      params.emplace(trim_double_quotes_copy((key)),
+                     trim_double_quotes_copy((val)));
+    }
+  });
+}
 
-  decoder_r = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+#ifdef CPPHTTPLIB_NO_EXCEPTIONS
+inline bool parse_range_header(const std::string &s, Ranges &ranges) {
+#else
+inline bool parse_range_header(const std::string &s, Ranges &ranges) try {
+#endif
+  auto is_valid = [](const std::string &str) {
+    return std::all_of(str.cbegin(), str.cend(),
+                       [](unsigned char c) { return std::isdigit(c); });
+  };
 
-  std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
-  while (decoder_r == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
-    char *next_out = buff.data();
-    size_t avail_out = buff.size();
+  if (s.size() > 7 && s.compare(0, 6, "bytes=") == 0) {
+    const auto pos = static_cast<size_t>(6);
+    const auto len = static_cast<size_t>(s.size() - 6);
+    auto all_valid_ranges = true;
+    split(&s[pos], &s[pos + len], ',', [&](const char *b, const char *e) {
+      if (!all_valid_ranges) { return; }
 
-    decoder_r = BrotliDecoderDecompressStream(
-        decoder_s, &avail_in, &next_in, &avail_out,
-        reinterpret_cast<uint8_t **>(&next_out), &total_out);
+      const auto it = std::find(b, e, '-');
+      if (it == e) {
+        all_valid_ranges = false;
+        return;
+      }
 
-    if (decoder_r == BROTLI_DECODER_RESULT_ERROR) { return false; }
+      const auto lhs = std::string(b, it);
+      const auto rhs = std::string(it + 1, e);
+      if (!is_valid(lhs) || !is_valid(rhs)) {
+        all_valid_ranges = false;
+        return;
+      }
 
-    if (!callback(buff.data(), buff.size() - avail_out)) { return false; }
-  }
+      const auto first =
+          static_cast<ssize_t>(lhs.empty() ? -1 : std::stoll(lhs));
+      const auto last =
+          static_cast<ssize_t>(rhs.empty() ? -1 : std::stoll(rhs));
+      if ((first == -1 && last == -1) ||
+          (first != -1 && last != -1 && first > last)) {
+        all_valid_ranges = false;
+        return;
+      }
 
-  return decoder_r == BROTLI_DECODER_RESULT_SUCCESS ||
-         decoder_r == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT;
+      ranges.emplace_back(first, last);
+    });
+    return all_valid_ranges && !ranges.empty();
+  }
+  return false;
+#ifdef CPPHTTPLIB_NO_EXCEPTIONS
 }
+#else
+} catch (...) { return false; }
 #endif
 
-#ifdef CPPHTTPLIB_ZSTD_SUPPORT
-inline zstd_compressor::zstd_compressor() {
-  ctx_ = ZSTD_createCCtx();
-  ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, ZSTD_fast);
-}
+inline bool parse_accept_header(const std::string &s,
+                                std::vector<std::string> &content_types) {
+  content_types.clear();
 
-inline zstd_compressor::~zstd_compressor() { ZSTD_freeCCtx(ctx_); }
+  // Empty string is considered valid (no preference)
+  if (s.empty()) { return true; }
 
-inline bool zstd_compressor::compress(const char *data, size_t data_length,
-                                      bool last, Callback callback) {
-  std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
+  // Check for invalid patterns: leading/trailing commas or consecutive commas
+  if (s.front() == ',' || s.back() == ',' ||
+      s.find(",,") != std::string::npos) {
+    return false;
+  }
 
-  ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
-  ZSTD_inBuffer input = {data, data_length, 0};
+  struct AcceptEntry {
+    std::string media_type;
+    double quality;
+    int order; // Original order in header
+  };
 
-  bool finished;
-  do {
-    ZSTD_outBuffer output = {buff.data(), CPPHTTPLIB_COMPRESSION_BUFSIZ, 0};
-    size_t const remaining = ZSTD_compressStream2(ctx_, &output, &input, mode);
+  std::vector<AcceptEntry> entries;
+  int order = 0;
+  bool has_invalid_entry = false;
+
+  // Split by comma and parse each entry
+  split(s.data(), s.data() + s.size(), ',', [&](const char *b, const char *e) {
+    std::string entry(b, e);
+    entry = trim_copy(entry);
+
+    if (entry.empty()) {
+      has_invalid_entry = true;
+      return;
+    }
+
+    AcceptEntry accept_entry;
+    accept_entry.quality = 1.0; // Default quality
+    accept_entry.order = order++;
 
-    if (ZSTD_isError(remaining)) { return false; }
+    // Find q= parameter
+    auto q_pos = entry.find(";q=");
+    if (q_pos == std::string::npos) { q_pos = entry.find("; q="); }
 
-    if (!callback(buff.data(), output.pos)) { return false; }
+    if (q_pos != std::string::npos) {
+      // Extract media type (before q parameter)
+      accept_entry.media_type = trim_copy(entry.substr(0, q_pos));
 
-    finished = last ? (remaining == 0) : (input.pos == input.size);
+      // Extract quality value
+      auto q_start = entry.find('=', q_pos) + 1;
+      auto q_end = entry.find(';', q_start);
+      if (q_end == std::string::npos) { q_end = entry.length(); }
 
-  } while (!finished);
+      std::string quality_str =
+          trim_copy(entry.substr(q_start, q_end - q_start));
+      if (quality_str.empty()) {
+        has_invalid_entry = true;
+        return;
+      }
 
-  return true;
-}
+      try {
+        accept_entry.quality = std::stod(quality_str);
+        // Check if quality is in valid range [0.0, 1.0]
+        if (accept_entry.quality < 0.0 || accept_entry.quality > 1.0) {
+          has_invalid_entry = true;
+          return;
+        }
+      } catch (...) {
+        has_invalid_entry = true;
+        return;
+      }
+    } else {
+      // No quality parameter, use entire entry as media type
+      accept_entry.media_type = entry;
+    }
 
-inline zstd_decompressor::zstd_decompressor() { ctx_ = ZSTD_createDCtx(); }
+    // Remove additional parameters from media type
+    auto param_pos = accept_entry.media_type.find(';');
+    if (param_pos != std::string::npos) {
+      accept_entry.media_type =
+          trim_copy(accept_entry.media_type.substr(0, param_pos));
+    }
 
-inline zstd_decompressor::~zstd_decompressor() { ZSTD_freeDCtx(ctx_); }
+    // Basic validation of media type format
+    if (accept_entry.media_type.empty()) {
+      has_invalid_entry = true;
+      return;
+    }
 
-inline bool zstd_decompressor::is_valid() const { return ctx_ != nullptr; }
+    // Check for basic media type format (should contain '/' or be '*')
+    if (accept_entry.media_type != "*" &&
+        accept_entry.media_type.find('/') == std::string::npos) {
+      has_invalid_entry = true;
+      return;
+    }
 
-inline bool zstd_decompressor::decompress(const char *data, size_t data_length,
-                                          Callback callback) {
-  std::array<char, CPPHTTPLIB_COMPRESSION_BUFSIZ> buff{};
-  ZSTD_inBuffer input = {data, data_length, 0};
+    entries.push_back(accept_entry);
+  });
 
-  while (input.pos < input.size) {
-    ZSTD_outBuffer output = {buff.data(), CPPHTTPLIB_COMPRESSION_BUFSIZ, 0};
-    size_t const remaining = ZSTD_decompressStream(ctx_, &output, &input);
+  // Return false if any invalid entry was found
+  if (has_invalid_entry) { return false; }
 
-    if (ZSTD_isError(remaining)) { return false; }
+  // Sort by quality (descending), then by original order (ascending)
+  std::sort(entries.begin(), entries.end(),
+            [](const AcceptEntry &a, const AcceptEntry &b) {
+              if (a.quality != b.quality) {
+                return a.quality > b.quality; // Higher quality first
+              }
+              return a.order < b.order; // Earlier order first for same quality
+            });
 
-    if (!callback(buff.data(), output.pos)) { return false; }
+  // Extract sorted media types
+  content_types.reserve(entries.size());
+  for (const auto &entry : entries) {
+    content_types.push_back(entry.media_type);
   }
 
   return true;
 }
-#endif
-
-inline bool has_header(const Headers &headers, const std::string &key) {
-  return headers.find(key) != headers.end();
-}
 
-inline const char *get_header_value(const Headers &headers,
-                                    const std::string &key, const char *def,
-                                    size_t id) {
-  auto rng = headers.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) { return it->second.c_str(); }
-  return def;
-}
+class FormDataParser {
+public:
+  FormDataParser() = default;
 
-template <typename T>
-inline bool parse_header(const char *beg, const char *end, T fn) {
-  // Skip trailing spaces and tabs.
-  while (beg < end && is_space_or_tab(end[-1])) {
-    end--;
+  void set_boundary(std::string &&boundary) {
+    boundary_ = boundary;
+    dash_boundary_crlf_ = dash_ + boundary_ + crlf_;
+    crlf_dash_boundary_ = crlf_ + dash_ + boundary_;
   }
 
-  auto p = beg;
-  while (p < end && *p != ':') {
-    p++;
-  }
+  bool is_valid() const { return is_valid_; }
 
-  auto name = std::string(beg, p);
-  if (!detail::fields::is_field_name(name)) { return false; }
+  bool parse(const char *buf, size_t n, const FormDataHeader &header_callback,
+             const ContentReceiver &content_callback) {
 
-  if (p == end) { return false; }
+    buf_append(buf, n);
 
-  auto key_end = p;
+    while (buf_size() > 0) {
+      switch (state_) {
+      case 0: { // Initial boundary
+        auto pos = buf_find(dash_boundary_crlf_);
+        if (pos == buf_size()) { return true; }
+        buf_erase(pos + dash_boundary_crlf_.size());
+        state_ = 1;
+        break;
+      }
+      case 1: { // New entry
+        clear_file_info();
+        state_ = 2;
+        break;
+      }
+      case 2: { // Headers
+        auto pos = buf_find(crlf_);
+        if (pos > CPPHTTPLIB_HEADER_MAX_LENGTH) { return false; }
+        while (pos < buf_size()) {
+          // Empty line
+          if (pos == 0) {
+            if (!header_callback(file_)) {
+              is_valid_ = false;
+              return false;
+            }
+            buf_erase(crlf_.size());
+            state_ = 3;
+            break;
+          }
 
-  if (*p++ != ':') { return false; }
+          const auto header = buf_head(pos);
 
-  while (p < end && is_space_or_tab(*p)) {
-    p++;
-  }
+          if (!parse_header(header.data(), header.data() + header.size(),
+                            [&](const std::string &, const std::string &) {})) {
+            is_valid_ = false;
+            return false;
+          }
 
-  if (p <= end) {
-    auto key_len = key_end - beg;
-    if (!key_len) { return false; }
+          // Parse and emplace space trimmed headers into a map
+          if (!parse_header(
+                  header.data(), header.data() + header.size(),
+                  [&](const std::string &key, const std::string &val) {
+                    file_.headers.emplace(key, val);
+                  })) {
+            is_valid_ = false;
+            return false;
+          }
 
-    auto key = std::string(beg, key_end);
-    auto val = std::string(p, end);
+          constexpr const char header_content_type[] = "Content-Type:";
 
-    if (!detail::fields::is_field_value(val)) { return false; }
+          if (start_with_case_ignore(header, header_content_type)) {
+            file_.content_type =
+                trim_copy(header.substr(str_len(header_content_type)));
+          } else {
+            thread_local const std::regex re_content_disposition(
+                R"~(^Content-Disposition:\s*form-data;\s*(.*)$)~",
+                std::regex_constants::icase);
 
-    if (case_ignore::equal(key, "Location") ||
-        case_ignore::equal(key, "Referer")) {
-      fn(key, val);
-    } else {
-      fn(key, decode_path(val, false));
+            std::smatch m;
+            if (std::regex_match(header, m, re_content_disposition)) {
+              Params params;
+              parse_disposition_params(m[1], params);
+
+              auto it = params.find("name");
+              if (it != params.end()) {
+                file_.name = it->second;
+              } else {
+                is_valid_ = false;
+                return false;
+              }
+
+              it = params.find("filename");
+              if (it != params.end()) { file_.filename = it->second; }
+
+              it = params.find("filename*");
+              if (it != params.end()) {
+                // Only allow UTF-8 encoding...
+                thread_local const std::regex re_rfc5987_encoding(
+                    R"~(^UTF-8''(.+?)$)~", std::regex_constants::icase);
+
+                std::smatch m2;
+                if (std::regex_match(it->second, m2, re_rfc5987_encoding)) {
+                  file_.filename = decode_path(m2[1], false); // override...
+                } else {
+                  is_valid_ = false;
+                  return false;
+                }
+              }
+            }
+          }
+          buf_erase(pos + crlf_.size());
+          pos = buf_find(crlf_);
+        }
+        if (state_ != 3) { return true; }
+        break;
+      }
+      case 3: { // Body
+        if (crlf_dash_boundary_.size() > buf_size()) { return true; }
+        auto pos = buf_find(crlf_dash_boundary_);
+        if (pos < buf_size()) {
+          if (!content_callback(buf_data(), pos)) {
+            is_valid_ = false;
+            return false;
+          }
+          buf_erase(pos + crlf_dash_boundary_.size());
+          state_ = 4;
+        } else {
+          auto len = buf_size() - crlf_dash_boundary_.size();
+          if (len > 0) {
+            if (!content_callback(buf_data(), len)) {
+              is_valid_ = false;
+              return false;
+            }
+            buf_erase(len);
+          }
+          return true;
+        }
+        break;
+      }
+      case 4: { // Boundary
+        if (crlf_.size() > buf_size()) { return true; }
+        if (buf_start_with(crlf_)) {
+          buf_erase(crlf_.size());
+          state_ = 1;
+        } else {
+          if (dash_.size() > buf_size()) { return true; }
+          if (buf_start_with(dash_)) {
+            buf_erase(dash_.size());
+            is_valid_ = true;
+            buf_erase(buf_size()); // Remove epilogue
+          } else {
+            return true;
+          }
+        }
+        break;
+      }
+      }
     }
 
     return true;
   }
 
-  return false;
-}
-
-inline bool read_headers(Stream &strm, Headers &headers) {
-  const auto bufsiz = 2048;
-  char buf[bufsiz];
-  stream_line_reader line_reader(strm, buf, bufsiz);
-
-  size_t header_count = 0;
-
-  for (;;) {
-    if (!line_reader.getline()) { return false; }
+private:
+  void clear_file_info() {
+    file_.name.clear();
+    file_.filename.clear();
+    file_.content_type.clear();
+    file_.headers.clear();
+  }
 
-    // Check if the line ends with CRLF.
-    auto line_terminator_len = 2;
-    if (line_reader.end_with_crlf()) {
-      // Blank line indicates end of headers.
-      if (line_reader.size() == 2) { break; }
-    } else {
-#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
-      // Blank line indicates end of headers.
-      if (line_reader.size() == 1) { break; }
-      line_terminator_len = 1;
-#else
-      continue; // Skip invalid line.
-#endif
+  bool start_with_case_ignore(const std::string &a, const char *b) const {
+    const auto b_len = strlen(b);
+    if (a.size() < b_len) { return false; }
+    for (size_t i = 0; i < b_len; i++) {
+      if (case_ignore::to_lower(a[i]) != case_ignore::to_lower(b[i])) {
+        return false;
+      }
     }
+    return true;
+  }
 
-    if (line_reader.size() > CPPHTTPLIB_HEADER_MAX_LENGTH) { return false; }
-
-    // Check header count limit
-    if (header_count >= CPPHTTPLIB_HEADER_MAX_COUNT) { return false; }
+  const std::string dash_ = "--";
+  const std::string crlf_ = "\r\n";
+  std::string boundary_;
+  std::string dash_boundary_crlf_;
+  std::string crlf_dash_boundary_;
 
-    // Exclude line terminator
-    auto end = line_reader.ptr() + line_reader.size() - line_terminator_len;
+  size_t state_ = 0;
+  bool is_valid_ = false;
+  FormData file_;
 
-    if (!parse_header(line_reader.ptr(), end,
-                      [&](const std::string &key, const std::string &val) {
-                        headers.emplace(key, val);
-                      })) {
-      return false;
+  // Buffer
+  bool start_with(const std::string &a, size_t spos, size_t epos,
+                  const std::string &b) const {
+    if (epos - spos < b.size()) { return false; }
+    for (size_t i = 0; i < b.size(); i++) {
+      if (a[i + spos] != b[i]) { return false; }
     }
-
-    header_count++;
+    return true;
   }
 
-  return true;
-}
-
-inline bool read_content_with_length(Stream &strm, size_t len,
-                                     DownloadProgress progress,
-                                     ContentReceiverWithProgress out) {
-  char buf[CPPHTTPLIB_RECV_BUFSIZ];
+  size_t buf_size() const { return buf_epos_ - buf_spos_; }
 
-  size_t r = 0;
-  while (r < len) {
-    auto read_len = static_cast<size_t>(len - r);
-    auto n = strm.read(buf, (std::min)(read_len, CPPHTTPLIB_RECV_BUFSIZ));
-    if (n <= 0) { return false; }
+  const char *buf_data() const { return &buf_[buf_spos_]; }
 
-    if (!out(buf, static_cast<size_t>(n), r, len)) { return false; }
-    r += static_cast<size_t>(n);
+  std::string buf_head(size_t l) const { return buf_.substr(buf_spos_, l); }
 
-    if (progress) {
-      if (!progress(r, len)) { return false; }
-    }
+  bool buf_start_with(const std::string &s) const {
+    return start_with(buf_, buf_spos_, buf_epos_, s);
   }
 
-  return true;
-}
+  size_t buf_find(const std::string &s) const {
+    auto c = s.front();
 
-inline void skip_content_with_length(Stream &strm, size_t len) {
-  char buf[CPPHTTPLIB_RECV_BUFSIZ];
-  size_t r = 0;
-  while (r < len) {
-    auto read_len = static_cast<size_t>(len - r);
-    auto n = strm.read(buf, (std::min)(read_len, CPPHTTPLIB_RECV_BUFSIZ));
-    if (n <= 0) { return; }
-    r += static_cast<size_t>(n);
-  }
-}
+    size_t off = buf_spos_;
+    while (off < buf_epos_) {
+      auto pos = off;
+      while (true) {
+        if (pos == buf_epos_) { return buf_size(); }
+        if (buf_[pos] == c) { break; }
+        pos++;
+      }
 
-enum class ReadContentResult {
-  Success,         // Successfully read the content
-  PayloadTooLarge, // The content exceeds the specified payload limit
-  Error            // An error occurred while reading the content
-};
+      auto remaining_size = buf_epos_ - pos;
+      if (s.size() > remaining_size) { return buf_size(); }
 
-inline ReadContentResult
-read_content_without_length(Stream &strm, size_t payload_max_length,
-                            ContentReceiverWithProgress out) {
-  char buf[CPPHTTPLIB_RECV_BUFSIZ];
-  size_t r = 0;
-  for (;;) {
-    auto n = strm.read(buf, CPPHTTPLIB_RECV_BUFSIZ);
-    if (n == 0) { return ReadContentResult::Success; }
-    if (n < 0) { return ReadContentResult::Error; }
+      if (start_with(buf_, pos, buf_epos_, s)) { return pos - buf_spos_; }
 
-    // Check if adding this data would exceed the payload limit
-    if (r > payload_max_length ||
-        payload_max_length - r < static_cast<size_t>(n)) {
-      return ReadContentResult::PayloadTooLarge;
+      off = pos + 1;
     }
 
-    if (!out(buf, static_cast<size_t>(n), r, 0)) {
-      return ReadContentResult::Error;
-    }
-    r += static_cast<size_t>(n);
+    return buf_size();
   }
 
-  return ReadContentResult::Success;
-}
-
-template <typename T>
-inline ReadContentResult read_content_chunked(Stream &strm, T &x,
-                                              size_t payload_max_length,
-                                              ContentReceiverWithProgress out) {
-  const auto bufsiz = 16;
-  char buf[bufsiz];
-
-  stream_line_reader line_reader(strm, buf, bufsiz);
-
-  if (!line_reader.getline()) { return ReadContentResult::Error; }
-
-  unsigned long chunk_len;
-  size_t total_len = 0;
-  while (true) {
-    char *end_ptr;
-
-    chunk_len = std::strtoul(line_reader.ptr(), &end_ptr, 16);
-
-    if (end_ptr == line_reader.ptr()) { return ReadContentResult::Error; }
-    if (chunk_len == ULONG_MAX) { return ReadContentResult::Error; }
+  void buf_append(const char *data, size_t n) {
+    auto remaining_size = buf_size();
+    if (remaining_size > 0 && buf_spos_ > 0) {
+      for (size_t i = 0; i < remaining_size; i++) {
+        buf_[i] = buf_[buf_spos_ + i];
+      }
+    }
+    buf_spos_ = 0;
+    buf_epos_ = remaining_size;
 
-    if (chunk_len == 0) { break; }
+    if (remaining_size + n > buf_.size()) { buf_.resize(remaining_size + n); }
 
-    // Check if adding this chunk would exceed the payload limit
-    if (total_len > payload_max_length ||
-        payload_max_length - total_len < chunk_len) {
-      return ReadContentResult::PayloadTooLarge;
+    for (size_t i = 0; i < n; i++) {
+      buf_[buf_epos_ + i] = data[i];
     }
+    buf_epos_ += n;
+  }
 
-    total_len += chunk_len;
+  void buf_erase(size_t size) { buf_spos_ += size; }
 
-    if (!read_content_with_length(strm, chunk_len, nullptr, out)) {
-      return ReadContentResult::Error;
-    }
+  std::string buf_;
+  size_t buf_spos_ = 0;
+  size_t buf_epos_ = 0;
+};
 
-    if (!line_reader.getline()) { return ReadContentResult::Error; }
+inline std::string random_string(size_t length) {
+  constexpr const char data[] =
+      "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
 
-    if (strcmp(line_reader.ptr(), "\r\n") != 0) {
-      return ReadContentResult::Error;
-    }
+  thread_local auto engine([]() {
+    // std::random_device might actually be deterministic on some
+    // platforms, but due to lack of support in the c++ standard library,
+    // doing better requires either some ugly hacks or breaking portability.
+    std::random_device seed_gen;
+    // Request 128 bits of entropy for initialization
+    std::seed_seq seed_sequence{seed_gen(), seed_gen(), seed_gen(), seed_gen()};
+    return std::mt19937(seed_sequence);
+  }());
 
-    if (!line_reader.getline()) { return ReadContentResult::Error; }
+  std::string result;
+  for (size_t i = 0; i < length; i++) {
+    result += data[engine() % (sizeof(data) - 1)];
   }
+  return result;
+}
 
-  assert(chunk_len == 0);
-
-  // NOTE: In RFC 9112, '7.1 Chunked Transfer Coding' mentions "The chunked
-  // transfer coding is complete when a chunk with a chunk-size of zero is
-  // received, possibly followed by a trailer section, and finally terminated by
-  // an empty line". https://www.rfc-editor.org/rfc/rfc9112.html#section-7.1
-  //
-  // In '7.1.3. Decoding Chunked', however, the pseudo-code in the section
-  // does't care for the existence of the final CRLF. In other words, it seems
-  // to be ok whether the final CRLF exists or not in the chunked data.
-  // https://www.rfc-editor.org/rfc/rfc9112.html#section-7.1.3
-  //
-  // According to the reference code in RFC 9112, cpp-httplib now allows
-  // chunked transfer coding data without the final CRLF.
-  if (!line_reader.getline()) { return ReadContentResult::Success; }
+inline std::string make_multipart_data_boundary() {
+  return "--cpp-httplib-multipart-data-" + detail::random_string(16);
+}
 
-  // RFC 7230 Section 4.1.2 - Headers prohibited in trailers
-  thread_local case_ignore::unordered_set<std::string> prohibited_trailers = {
-      // Message framing
-      "transfer-encoding", "content-length",
+inline bool is_multipart_boundary_chars_valid(const std::string &boundary) {
+  auto valid = true;
+  for (size_t i = 0; i < boundary.size(); i++) {
+    auto c = boundary[i];
+    if (!std::isalnum(c) && c != '-' && c != '_') {
+      valid = false;
+      break;
+    }
+  }
+  return valid;
+}
 
-      // Routing
-      "host",
+template <typename T>
+inline std::string
+serialize_multipart_formdata_item_begin(const T &item,
+                                        const std::string &boundary) {
+  std::string body = "--" + boundary + "\r\n";
+  body += "Content-Disposition: form-data; name=\"" + item.name + "\"";
+  if (!item.filename.empty()) {
+    body += "; filename=\"" + item.filename + "\"";
+  }
+  body += "\r\n";
+  if (!item.content_type.empty()) {
+    body += "Content-Type: " + item.content_type + "\r\n";
+  }
+  body += "\r\n";
 
-      // Authentication
-      "authorization", "www-authenticate", "proxy-authenticate",
-      "proxy-authorization", "cookie", "set-cookie",
+  return body;
+}
 
-      // Request modifiers
-      "cache-control", "expect", "max-forwards", "pragma", "range", "te",
+inline std::string serialize_multipart_formdata_item_end() { return "\r\n"; }
 
-      // Response control
-      "age", "expires", "date", "location", "retry-after", "vary", "warning",
+inline std::string
+serialize_multipart_formdata_finish(const std::string &boundary) {
+  return "--" + boundary + "--\r\n";
+}
 
-      // Payload processing
-      "content-encoding", "content-type", "content-range", "trailer"};
+inline std::string
+serialize_multipart_formdata_get_content_type(const std::string &boundary) {
+  return "multipart/form-data; boundary=" + boundary;
+}
 
-  // Parse declared trailer headers once for performance
-  case_ignore::unordered_set<std::string> declared_trailers;
-  if (has_header(x.headers, "Trailer")) {
-    auto trailer_header = get_header_value(x.headers, "Trailer", "", 0);
-    auto len = std::strlen(trailer_header);
+inline std::string
+serialize_multipart_formdata(const UploadFormDataItems &items,
+                             const std::string &boundary, bool finish = true) {
+  std::string body;
 
-    split(trailer_header, trailer_header + len, ',',
-          [&](const char *b, const char *e) {
-            std::string key(b, e);
-            if (prohibited_trailers.find(key) == prohibited_trailers.end()) {
-              declared_trailers.insert(key);
-            }
-          });
+  for (const auto &item : items) {
+    body += serialize_multipart_formdata_item_begin(item, boundary);
+    body += item.content + serialize_multipart_formdata_item_end();
   }
 
-  size_t trailer_header_count = 0;
-  while (strcmp(line_reader.ptr(), "\r\n") != 0) {
-    if (line_reader.size() > CPPHTTPLIB_HEADER_MAX_LENGTH) {
-      return ReadContentResult::Error;
-    }
+  if (finish) { body += serialize_multipart_formdata_finish(boundary); }
 
-    // Check trailer header count limit
-    if (trailer_header_count >= CPPHTTPLIB_HEADER_MAX_COUNT) {
-      return ReadContentResult::Error;
-    }
+  return body;
+}
 
-    // Exclude line terminator
-    constexpr auto line_terminator_len = 2;
-    auto end = line_reader.ptr() + line_reader.size() - line_terminator_len;
+inline void coalesce_ranges(Ranges &ranges, size_t content_length) {
+  if (ranges.size() <= 1) return;
 
-    parse_header(line_reader.ptr(), end,
-                 [&](const std::string &key, const std::string &val) {
-                   if (declared_trailers.find(key) != declared_trailers.end()) {
-                     x.trailers.emplace(key, val);
-                     trailer_header_count++;
-                   }
-                 });
+  // Sort ranges by start position
+  std::sort(ranges.begin(), ranges.end(),
+            [](const Range &a, const Range &b) { return a.first < b.first; });
 
-    if (!line_reader.getline()) { return ReadContentResult::Error; }
-  }
+  Ranges coalesced;
+  coalesced.reserve(ranges.size());
 
-  return ReadContentResult::Success;
-}
+  for (auto &r : ranges) {
+    auto first_pos = r.first;
+    auto last_pos = r.second;
 
-inline bool is_chunked_transfer_encoding(const Headers &headers) {
-  return case_ignore::equal(
-      get_header_value(headers, "Transfer-Encoding", "", 0), "chunked");
-}
+    // Handle special cases like in range_error
+    if (first_pos == -1 && last_pos == -1) {
+      first_pos = 0;
+      last_pos = static_cast<ssize_t>(content_length);
+    }
 
-template <typename T, typename U>
-bool prepare_content_receiver(T &x, int &status,
-                              ContentReceiverWithProgress receiver,
-                              bool decompress, U callback) {
-  if (decompress) {
-    std::string encoding = x.get_header_value("Content-Encoding");
-    std::unique_ptr<decompressor> decompressor;
+    if (first_pos == -1) {
+      first_pos = static_cast<ssize_t>(content_length) - last_pos;
+      last_pos = static_cast<ssize_t>(content_length) - 1;
+    }
 
-    if (encoding == "gzip" || encoding == "deflate") {
-#ifdef CPPHTTPLIB_ZLIB_SUPPORT
-      decompressor = detail::make_unique<gzip_decompressor>();
-#else
-      status = StatusCode::UnsupportedMediaType_415;
-      return false;
-#endif
-    } else if (encoding.find("br") != std::string::npos) {
-#ifdef CPPHTTPLIB_BROTLI_SUPPORT
-      decompressor = detail::make_unique<brotli_decompressor>();
-#else
-      status = StatusCode::UnsupportedMediaType_415;
-      return false;
-#endif
-    } else if (encoding == "zstd") {
-#ifdef CPPHTTPLIB_ZSTD_SUPPORT
-      decompressor = detail::make_unique<zstd_decompressor>();
-#else
-      status = StatusCode::UnsupportedMediaType_415;
-      return false;
-#endif
+    if (last_pos == -1 || last_pos >= static_cast<ssize_t>(content_length)) {
+      last_pos = static_cast<ssize_t>(content_length) - 1;
     }
 
-    if (decompressor) {
-      if (decompressor->is_valid()) {
-        ContentReceiverWithProgress out = [&](const char *buf, size_t n,
-                                              size_t off, size_t len) {
-          return decompressor->decompress(buf, n,
-                                          [&](const char *buf2, size_t n2) {
-                                            return receiver(buf2, n2, off, len);
-                                          });
-        };
-        return callback(std::move(out));
-      } else {
-        status = StatusCode::InternalServerError_500;
-        return false;
+    // Skip invalid ranges
+    if (!(0 <= first_pos && first_pos <= last_pos &&
+          last_pos < static_cast<ssize_t>(content_length))) {
+      continue;
+    }
+
+    // Coalesce with previous range if overlapping or adjacent (but not
+    // identical)
+    if (!coalesced.empty()) {
+      auto &prev = coalesced.back();
+      // Check if current range overlaps or is adjacent to previous range
+      // but don't coalesce identical ranges (allow duplicates)
+      if (first_pos <= prev.second + 1 &&
+          !(first_pos == prev.first && last_pos == prev.second)) {
+        // Extend the previous range
+        prev.second = (std::max)(prev.second, last_pos);
+        continue;
       }
     }
+
+    // Add new range
+    coalesced.emplace_back(first_pos, last_pos);
   }
 
-  ContentReceiverWithProgress out = [&](const char *buf, size_t n, size_t off,
-                                        size_t len) {
-    return receiver(buf, n, off, len);
-  };
-  return callback(std::move(out));
+  ranges = std::move(coalesced);
 }
 
-template <typename T>
-bool read_content(Stream &strm, T &x, size_t payload_max_length, int &status,
-                  DownloadProgress progress,
-                  ContentReceiverWithProgress receiver, bool decompress) {
-  return prepare_content_receiver(
-      x, status, std::move(receiver), decompress,
-      [&](const ContentReceiverWithProgress &out) {
-        auto ret = true;
-        auto exceed_payload_max_length = false;
-
-        if (is_chunked_transfer_encoding(x.headers)) {
-          auto result = read_content_chunked(strm, x, payload_max_length, out);
-          if (result == ReadContentResult::Success) {
-            ret = true;
-          } else if (result == ReadContentResult::PayloadTooLarge) {
-            exceed_payload_max_length = true;
-            ret = false;
-          } else {
-            ret = false;
-          }
-        } else if (!has_header(x.headers, "Content-Length")) {
-          auto result =
-              read_content_without_length(strm, payload_max_length, out);
-          if (result == ReadContentResult::Success) {
-            ret = true;
-          } else if (result == ReadContentResult::PayloadTooLarge) {
-            exceed_payload_max_length = true;
-            ret = false;
-          } else {
-            ret = false;
-          }
-        } else {
-          auto is_invalid_value = false;
-          auto len = get_header_value_u64(x.headers, "Content-Length",
-                                          (std::numeric_limits<size_t>::max)(),
-                                          0, is_invalid_value);
-
-          if (is_invalid_value) {
-            ret = false;
-          } else if (len > payload_max_length) {
-            exceed_payload_max_length = true;
-            skip_content_with_length(strm, len);
-            ret = false;
-          } else if (len > 0) {
-            ret = read_content_with_length(strm, len, std::move(progress), out);
-          }
-        }
+inline bool range_error(Request &req, Response &res) {
+  if (!req.ranges.empty() && 200 <= res.status && res.status < 300) {
+    ssize_t content_len = static_cast<ssize_t>(
+        res.content_length_ ? res.content_length_ : res.body.size());
 
-        if (!ret) {
-          status = exceed_payload_max_length ? StatusCode::PayloadTooLarge_413
-                                             : StatusCode::BadRequest_400;
-        }
-        return ret;
-      });
-}
+    std::vector<std::pair<ssize_t, ssize_t>> processed_ranges;
+    size_t overwrapping_count = 0;
 
-inline ssize_t write_request_line(Stream &strm, const std::string &method,
-                                  const std::string &path) {
-  std::string s = method;
-  s += " ";
-  s += path;
-  s += " HTTP/1.1\r\n";
-  return strm.write(s.data(), s.size());
-}
+    // NOTE: The following Range check is based on '14.2. Range' in RFC 9110
+    // 'HTTP Semantics' to avoid potential denial-of-service attacks.
+    // https://www.rfc-editor.org/rfc/rfc9110#section-14.2
 
-inline ssize_t write_response_line(Stream &strm, int status) {
-  std::string s = "HTTP/1.1 ";
-  s += std::to_string(status);
-  s += " ";
-  s += httplib::status_message(status);
-  s += "\r\n";
-  return strm.write(s.data(), s.size());
-}
+    // Too many ranges
+    if (req.ranges.size() > CPPHTTPLIB_RANGE_MAX_COUNT) { return true; }
 
-inline ssize_t write_headers(Stream &strm, const Headers &headers) {
-  ssize_t write_len = 0;
-  for (const auto &x : headers) {
-    std::string s;
-    s = x.first;
-    s += ": ";
-    s += x.second;
-    s += "\r\n";
+    for (auto &r : req.ranges) {
+      auto &first_pos = r.first;
+      auto &last_pos = r.second;
 
-    auto len = strm.write(s.data(), s.size());
-    if (len < 0) { return len; }
-    write_len += len;
-  }
-  auto len = strm.write("\r\n");
-  if (len < 0) { return len; }
-  write_len += len;
-  return write_len;
-}
+      if (first_pos == -1 && last_pos == -1) {
+        first_pos = 0;
+        last_pos = content_len;
+      }
 
-inline bool write_data(Stream &strm, const char *d, size_t l) {
-  size_t offset = 0;
-  while (offset < l) {
-    auto length = strm.write(d + offset, l - offset);
-    if (length < 0) { return false; }
-    offset += static_cast<size_t>(length);
-  }
-  return true;
-}
+      if (first_pos == -1) {
+        first_pos = content_len - last_pos;
+        last_pos = content_len - 1;
+      }
 
-template <typename T>
-inline bool write_content_with_progress(Stream &strm,
-                                        const ContentProvider &content_provider,
-                                        size_t offset, size_t length,
-                                        T is_shutting_down,
-                                        const UploadProgress &upload_progress,
-                                        Error &error) {
-  size_t end_offset = offset + length;
-  size_t start_offset = offset;
-  auto ok = true;
-  DataSink data_sink;
+      // NOTE: RFC-9110 '14.1.2. Byte Ranges':
+      // A client can limit the number of bytes requested without knowing the
+      // size of the selected representation. If the last-pos value is absent,
+      // or if the value is greater than or equal to the current length of the
+      // representation data, the byte range is interpreted as the remainder of
+      // the representation (i.e., the server replaces the value of last-pos
+      // with a value that is one less than the current length of the selected
+      // representation).
+      // https://www.rfc-editor.org/rfc/rfc9110.html#section-14.1.2-6
+      if (last_pos == -1 || last_pos >= content_len) {
+        last_pos = content_len - 1;
+      }
 
-  data_sink.write = [&](const char *d, size_t l) -> bool {
-    if (ok) {
-      if (write_data(strm, d, l)) {
-        offset += l;
+      // Range must be within content length
+      if (!(0 <= first_pos && first_pos <= last_pos &&
+            last_pos <= content_len - 1)) {
+        return true;
+      }
 
-        if (upload_progress && length > 0) {
-          size_t current_written = offset - start_offset;
-          if (!upload_progress(current_written, length)) {
-            ok = false;
-            return false;
-          }
+      // Request must not have more than two overlapping ranges
+      for (const auto &processed_range : processed_ranges) {
+        if (!(last_pos < processed_range.first ||
+              first_pos > processed_range.second)) {
+          overwrapping_count++;
+          if (overwrapping_count > 2) { return true; }
+          break; // Only count once per range
         }
-      } else {
-        ok = false;
       }
-    }
-    return ok;
-  };
-
-  data_sink.is_writable = [&]() -> bool { return strm.wait_writable(); };
 
-  while (offset < end_offset && !is_shutting_down()) {
-    if (!strm.wait_writable()) {
-      error = Error::Write;
-      return false;
-    } else if (!content_provider(offset, end_offset - offset, data_sink)) {
-      error = Error::Canceled;
-      return false;
-    } else if (!ok) {
-      error = Error::Write;
-      return false;
+      processed_ranges.emplace_back(first_pos, last_pos);
     }
+
+    // After validation, coalesce overlapping ranges as per RFC 9110
+    coalesce_ranges(req.ranges, static_cast<size_t>(content_len));
   }
 
-  error = Error::Success;
-  return true;
+  return false;
 }
 
-template <typename T>
-inline bool write_content(Stream &strm, const ContentProvider &content_provider,
-                          size_t offset, size_t length, T is_shutting_down,
-                          Error &error) {
-  return write_content_with_progress<T>(strm, content_provider, offset, length,
-                                        is_shutting_down, nullptr, error);
+inline std::pair<size_t, size_t>
+get_range_offset_and_length(Range r, size_t content_length) {
+  assert(r.first != -1 && r.second != -1);
+  assert(0 <= r.first && r.first < static_cast<ssize_t>(content_length));
+  assert(r.first <= r.second &&
+         r.second < static_cast<ssize_t>(content_length));
+  (void)(content_length);
+  return std::make_pair(r.first, static_cast<size_t>(r.second - r.first) + 1);
 }
 
-template <typename T>
-inline bool write_content(Stream &strm, const ContentProvider &content_provider,
-                          size_t offset, size_t length,
-                          const T &is_shutting_down) {
-  auto error = Error::Success;
-  return write_content(strm, content_provider, offset, length, is_shutting_down,
-                       error);
-}
+inline std::string make_content_range_header_field(
+    const std::pair<size_t, size_t> &offset_and_length, size_t content_length) {
+  auto st = offset_and_length.first;
+  auto ed = st + offset_and_length.second - 1;
 
-template <typename T>
-inline bool
-write_content_without_length(Stream &strm,
-                             const ContentProvider &content_provider,
-                             const T &is_shutting_down) {
-  size_t offset = 0;
-  auto data_available = true;
-  auto ok = true;
-  DataSink data_sink;
+  std::string field = "bytes ";
+  field += std::to_string(st);
+  field += "-";
+  field += std::to_string(ed);
+  field += "/";
+  field += std::to_string(content_length);
+  return field;
+}
 
-  data_sink.write = [&](const char *d, size_t l) -> bool {
-    if (ok) {
-      offset += l;
-      if (!write_data(strm, d, l)) { ok = false; }
+template <typename SToken, typename CToken, typename Content>
+bool process_multipart_ranges_data(const Request &req,
+                                   const std::string &boundary,
+                                   const std::string &content_type,
+                                   size_t content_length, SToken stoken,
+                                   CToken ctoken, Content content) {
+  for (size_t i = 0; i < req.ranges.size(); i++) {
+    ctoken("--");
+    stoken(boundary);
+    ctoken("\r\n");
+    if (!content_type.empty()) {
+      ctoken("Content-Type: ");
+      stoken(content_type);
+      ctoken("\r\n");
     }
-    return ok;
-  };
 
-  data_sink.is_writable = [&]() -> bool { return strm.wait_writable(); };
+    auto offset_and_length =
+        get_range_offset_and_length(req.ranges[i], content_length);
 
-  data_sink.done = [&](void) { data_available = false; };
+    ctoken("Content-Range: ");
+    stoken(make_content_range_header_field(offset_and_length, content_length));
+    ctoken("\r\n");
+    ctoken("\r\n");
 
-  while (data_available && !is_shutting_down()) {
-    if (!strm.wait_writable()) {
-      return false;
-    } else if (!content_provider(offset, 0, data_sink)) {
-      return false;
-    } else if (!ok) {
+    if (!content(offset_and_length.first, offset_and_length.second)) {
       return false;
     }
+    ctoken("\r\n");
   }
+
+  ctoken("--");
+  stoken(boundary);
+  ctoken("--");
+
   return true;
 }
 
-template <typename T, typename U>
-inline bool
-write_content_chunked(Stream &strm, const ContentProvider &content_provider,
-                      const T &is_shutting_down, U &compressor, Error &error) {
-  size_t offset = 0;
-  auto data_available = true;
-  auto ok = true;
-  DataSink data_sink;
-
-  data_sink.write = [&](const char *d, size_t l) -> bool {
-    if (ok) {
-      data_available = l > 0;
-      offset += l;
+inline void make_multipart_ranges_data(const Request &req, Response &res,
+                                       const std::string &boundary,
+                                       const std::string &content_type,
+                                       size_t content_length,
+                                       std::string &data) {
+  process_multipart_ranges_data(
+      req, boundary, content_type, content_length,
+      [&](const std::string &token) { data += token; },
+      [&](const std::string &token) { data += token; },
+      [&](size_t offset, size_t length) {
+        assert(offset + length <= content_length);
+        data += res.body.substr(offset, length);
+        return true;
+      });
+}
 
-      std::string payload;
-      if (compressor.compress(d, l, false,
-                              [&](const char *data, size_t data_len) {
-                                payload.append(data, data_len);
-                                return true;
-                              })) {
-        if (!payload.empty()) {
-          // Emit chunked response header and footer for each chunk
-          auto chunk =
-              from_i_to_hex(payload.size()) + "\r\n" + payload + "\r\n";
-          if (!write_data(strm, chunk.data(), chunk.size())) { ok = false; }
-        }
-      } else {
-        ok = false;
-      }
-    }
-    return ok;
-  };
+inline size_t get_multipart_ranges_data_length(const Request &req,
+                                               const std::string &boundary,
+                                               const std::string &content_type,
+                                               size_t content_length) {
+  size_t data_length = 0;
 
-  data_sink.is_writable = [&]() -> bool { return strm.wait_writable(); };
+  process_multipart_ranges_data(
+      req, boundary, content_type, content_length,
+      [&](const std::string &token) { data_length += token.size(); },
+      [&](const std::string &token) { data_length += token.size(); },
+      [&](size_t /*offset*/, size_t length) {
+        data_length += length;
+        return true;
+      });
 
-  auto done_with_trailer = [&](const Headers *trailer) {
-    if (!ok) { return; }
+  return data_length;
+}
 
-    data_available = false;
+template <typename T>
+inline bool
+write_multipart_ranges_data(Stream &strm, const Request &req, Response &res,
+                            const std::string &boundary,
+                            const std::string &content_type,
+                            size_t content_length, const T &is_shutting_down) {
+  return process_multipart_ranges_data(
+      req, boundary, content_type, content_length,
+      [&](const std::string &token) { strm.write(token); },
+      [&](const std::string &token) { strm.write(token); },
+      [&](size_t offset, size_t length) {
+        return write_content(strm, res.content_provider_, offset, length,
+                             is_shutting_down);
+      });
+}
 
-    std::string payload;
-    if (!compressor.compress(nullptr, 0, true,
-                             [&](const char *data, size_t data_len) {
-                               payload.append(data, data_len);
-                               return true;
-                             })) {
-      ok = false;
-      return;
-    }
+inline bool expect_content(const Request &req) {
+  if (req.method == "POST" || req.method == "PUT" || req.method == "PATCH" ||
+      req.method == "DELETE") {
+    return true;
+  }
+  if (req.has_header("Content-Length") &&
+      req.get_header_value_u64("Content-Length") > 0) {
+    return true;
+  }
+  if (is_chunked_transfer_encoding(req)) { return true; }
+  return false;
+}
 
-    if (!payload.empty()) {
-      // Emit chunked response header and footer for each chunk
-      auto chunk = from_i_to_hex(payload.size()) + "\r\n" + payload + "\r\n";
-      if (!write_data(strm, chunk.data(), chunk.size())) {
-        ok = false;
-        return;
-      }
-    }
+inline bool has_crlf(const std::string &s) {
+  auto p = s.c_str();
+  while (*p) {
+    if (*p == '\r' || *p == '\n') { return true; }
+    p++;
+  }
+  return false;
+}
 
-    constexpr const char done_marker[] = "0\r\n";
-    if (!write_data(strm, done_marker, str_len(done_marker))) { ok = false; }
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+inline std::string message_digest(const std::string &s, const EVP_MD *algo) {
+  auto context = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>(
+      EVP_MD_CTX_new(), EVP_MD_CTX_free);
 
-    // Trailer
-    if (trailer) {
-      for (const auto &kv : *trailer) {
-        std::string field_line = kv.first + ": " + kv.second + "\r\n";
-        if (!write_data(strm, field_line.data(), field_line.size())) {
-          ok = false;
-        }
-      }
-    }
+  unsigned int hash_length = 0;
+  unsigned char hash[EVP_MAX_MD_SIZE];
 
-    constexpr const char crlf[] = "\r\n";
-    if (!write_data(strm, crlf, str_len(crlf))) { ok = false; }
-  };
+  EVP_DigestInit_ex(context.get(), algo, nullptr);
+  EVP_DigestUpdate(context.get(), s.c_str(), s.size());
+  EVP_DigestFinal_ex(context.get(), hash, &hash_length);
 
-  data_sink.done = [&](void) { done_with_trailer(nullptr); };
+  std::stringstream ss;
+  for (auto i = 0u; i < hash_length; ++i) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<unsigned int>(hash[i]);
+  }
 
-  data_sink.done_with_trailer = [&](const Headers &trailer) {
-    done_with_trailer(&trailer);
-  };
+  return ss.str();
+}
 
-  while (data_available && !is_shutting_down()) {
-    if (!strm.wait_writable()) {
-      error = Error::Write;
-      return false;
-    } else if (!content_provider(offset, 0, data_sink)) {
-      error = Error::Canceled;
-      return false;
-    } else if (!ok) {
-      error = Error::Write;
-      return false;
-    }
-  }
+inline std::string MD5(const std::string &s) {
+  return message_digest(s, EVP_md5());
+}
 
-  error = Error::Success;
-  return true;
+inline std::string SHA_256(const std::string &s) {
+  return message_digest(s, EVP_sha256());
 }
 
-template <typename T, typename U>
-inline bool write_content_chunked(Stream &strm,
-                                  const ContentProvider &content_provider,
-                                  const T &is_shutting_down, U &compressor) {
-  auto error = Error::Success;
-  return write_content_chunked(strm, content_provider, is_shutting_down,
-                               compressor, error);
+inline std::string SHA_512(const std::string &s) {
+  return message_digest(s, EVP_sha512());
 }
 
-template <typename T>
-inline bool redirect(T &cli, Request &req, Response &res,
-                     const std::string &path, const std::string &location,
-                     Error &error) {
-  Request new_req = req;
-  new_req.path = path;
-  new_req.redirect_count_ -= 1;
+inline std::pair<std::string, std::string> make_digest_authentication_header(
+    const Request &req, const std::map<std::string, std::string> &auth,
+    size_t cnonce_count, const std::string &cnonce, const std::string &username,
+    const std::string &password, bool is_proxy = false) {
+  std::string nc;
+  {
+    std::stringstream ss;
+    ss << std::setfill('0') << std::setw(8) << std::hex << cnonce_count;
+    nc = ss.str();
+  }
 
-  if (res.status == StatusCode::SeeOther_303 &&
-      (req.method != "GET" && req.method != "HEAD")) {
-    new_req.method = "GET";
-    new_req.body.clear();
-    new_req.headers.clear();
+  std::string qop;
+  if (auth.find("qop") != auth.end()) {
+    qop = auth.at("qop");
+    if (qop.find("auth-int") != std::string::npos) {
+      qop = "auth-int";
+    } else if (qop.find("auth") != std::string::npos) {
+      qop = "auth";
+    } else {
+      qop.clear();
+    }
   }
 
-  Response new_res;
+  std::string algo = "MD5";
+  if (auth.find("algorithm") != auth.end()) { algo = auth.at("algorithm"); }
 
-  auto ret = cli.send(new_req, new_res, error);
-  if (ret) {
-    req = new_req;
-    res = new_res;
+  std::string response;
+  {
+    auto H = algo == "SHA-256"   ? detail::SHA_256
+             : algo == "SHA-512" ? detail::SHA_512
+                                 : detail::MD5;
 
-    if (res.location.empty()) { res.location = location; }
-  }
-  return ret;
-}
+    auto A1 = username + ":" + auth.at("realm") + ":" + password;
 
-inline std::string params_to_query_str(const Params &params) {
-  std::string query;
+    auto A2 = req.method + ":" + req.path;
+    if (qop == "auth-int") { A2 += ":" + H(req.body); }
 
-  for (auto it = params.begin(); it != params.end(); ++it) {
-    if (it != params.begin()) { query += "&"; }
-    query += it->first;
-    query += "=";
-    query += httplib::encode_uri_component(it->second);
+    if (qop.empty()) {
+      response = H(H(A1) + ":" + auth.at("nonce") + ":" + H(A2));
+    } else {
+      response = H(H(A1) + ":" + auth.at("nonce") + ":" + nc + ":" + cnonce +
+                   ":" + qop + ":" + H(A2));
+    }
   }
-  return query;
-}
 
-inline void parse_query_text(const char *data, std::size_t size,
-                             Params &params) {
-  std::set<std::string> cache;
-  split(data, data + size, '&', [&](const char *b, const char *e) {
-    std::string kv(b, e);
-    if (cache.find(kv) != cache.end()) { return; }
-    cache.insert(std::move(kv));
+  auto opaque = (auth.find("opaque") != auth.end()) ? auth.at("opaque") : "";
 
-    std::string key;
-    std::string val;
-    divide(b, static_cast<std::size_t>(e - b), '=',
-           [&](const char *lhs_data, std::size_t lhs_size, const char *rhs_data,
-               std::size_t rhs_size) {
-             key.assign(lhs_data, lhs_size);
-             val.assign(rhs_data, rhs_size);
-           });
+  auto field = "Digest username=\"" + username + "\", realm=\"" +
+               auth.at("realm") + "\", nonce=\"" + auth.at("nonce") +
+               "\", uri=\"" + req.path + "\", algorithm=" + algo +
+               (qop.empty() ? ", response=\""
+                            : ", qop=" + qop + ", nc=" + nc + ", cnonce=\"" +
+                                  cnonce + "\", response=\"") +
+               response + "\"" +
+               (opaque.empty() ? "" : ", opaque=\"" + opaque + "\"");
 
-    if (!key.empty()) {
-      params.emplace(decode_path(key, true), decode_path(val, true));
-    }
-  });
+  auto key = is_proxy ? "Proxy-Authorization" : "Authorization";
+  return std::make_pair(key, field);
 }
 
-inline void parse_query_text(const std::string &s, Params &params) {
-  parse_query_text(s.data(), s.size(), params);
-}
+inline bool is_ssl_peer_could_be_closed(SSL *ssl, socket_t sock) {
+  detail::set_nonblocking(sock, true);
+  auto se = detail::scope_exit([&]() { detail::set_nonblocking(sock, false); });
 
-inline bool parse_multipart_boundary(const std::string &content_type,
-                                     std::string &boundary) {
-  auto boundary_keyword = "boundary=";
-  auto pos = content_type.find(boundary_keyword);
-  if (pos == std::string::npos) { return false; }
-  auto end = content_type.find(';', pos);
-  auto beg = pos + strlen(boundary_keyword);
-  boundary = trim_double_quotes_copy(content_type.substr(beg, end - beg));
-  return !boundary.empty();
+  char buf[1];
+  return !SSL_peek(ssl, buf, 1) &&
+         SSL_get_error(ssl, 0) == SSL_ERROR_ZERO_RETURN;
 }
 
-inline void parse_disposition_params(const std::string &s, Params &params) {
-  std::set<std::string> cache;
-  split(s.data(), s.data() + s.size(), ';', [&](const char *b, const char *e) {
-    std::string kv(b, e);
-    if (cache.find(kv) != cache.end()) { return; }
-    cache.insert(kv);
+#ifdef _WIN64
+// NOTE: This code came up with the following stackoverflow post:
+// https://stackoverflow.com/questions/9507184/can-openssl-on-windows-use-the-system-certificate-store
+inline bool load_system_certs_on_windows(X509_STORE *store) {
+  auto hStore = CertOpenSystemStoreW((HCRYPTPROV_LEGACY)NULL, L"ROOT");
+  if (!hStore) { return false; }
 
-    std::string key;
-    std::string val;
-    split(b, e, '=', [&](const char *b2, const char *e2) {
-      if (key.empty()) {
-        key.assign(b2, e2);
-      } else {
-        val.assign(b2, e2);
-      }
-    });
+  auto result = false;
+  PCCERT_CONTEXT pContext = NULL;
+  while ((pContext = CertEnumCertificatesInStore(hStore, pContext)) !=
+         nullptr) {
+    auto encoded_cert =
+        static_cast<const unsigned char *>(pContext->pbCertEncoded);
 
-    if (!key.empty()) {
-      params.emplace(trim_double_quotes_copy((key)),
-                     trim_double_quotes_copy((val)));
+    auto x509 = d2i_X509(NULL, &encoded_cert, pContext->cbCertEncoded);
+    if (x509) {
+      X509_STORE_add_cert(store, x509);
+      X509_free(x509);
+      result = true;
     }
-  });
-}
+  }
+
+  CertFreeCertificateContext(pContext);
+  CertCloseStore(hStore, 0);
 
-#ifdef CPPHTTPLIB_NO_EXCEPTIONS
-inline bool parse_range_header(const std::string &s, Ranges &ranges) {
-#else
-inline bool parse_range_header(const std::string &s, Ranges &ranges) try {
-#endif
-  auto is_valid = [](const std::string &str) {
-    return std::all_of(str.cbegin(), str.cend(),
-                       [](unsigned char c) { return std::isdigit(c); });
-  };
+  return result;
+}
+#elif defined(CPPHTTPLIB_USE_CERTS_FROM_MACOSX_KEYCHAIN) &&                    \
+    defined(TARGET_OS_OSX)
+template <typename T>
+using CFObjectPtr =
+    std::unique_ptr<typename std::remove_pointer<T>::type, void (*)(CFTypeRef)>;
 
-  if (s.size() > 7 && s.compare(0, 6, "bytes=") == 0) {
-    const auto pos = static_cast<size_t>(6);
-    const auto len = static_cast<size_t>(s.size() - 6);
-    auto all_valid_ranges = true;
-    split(&s[pos], &s[pos + len], ',', [&](const char *b, const char *e) {
-      if (!all_valid_ranges) { return; }
+inline void cf_object_ptr_deleter(CFTypeRef obj) {
+  if (obj) { CFRelease(obj); }
+}
 
-      const auto it = std::find(b, e, '-');
-      if (it == e) {
-        all_valid_ranges = false;
-        return;
-      }
+inline bool retrieve_certs_from_keychain(CFObjectPtr<CFArrayRef> &certs) {
+  CFStringRef keys[] = {kSecClass, kSecMatchLimit, kSecReturnRef};
+  CFTypeRef values[] = {kSecClassCertificate, kSecMatchLimitAll,
+                        kCFBooleanTrue};
 
-      const auto lhs = std::string(b, it);
-      const auto rhs = std::string(it + 1, e);
-      if (!is_valid(lhs) || !is_valid(rhs)) {
-        all_valid_ranges = false;
-        return;
-      }
+  CFObjectPtr<CFDictionaryRef> query(
+      CFDictionaryCreate(nullptr, reinterpret_cast<const void **>(keys), values,
+                         sizeof(keys) / sizeof(keys[0]),
+                         &kCFTypeDictionaryKeyCallBacks,
+                         &kCFTypeDictionaryValueCallBacks),
+      cf_object_ptr_deleter);
 
-      const auto first =
-          static_cast<ssize_t>(lhs.empty() ? -1 : std::stoll(lhs));
-      const auto last =
-          static_cast<ssize_t>(rhs.empty() ? -1 : std::stoll(rhs));
-      if ((first == -1 && last == -1) ||
-          (first != -1 && last != -1 && first > last)) {
-        all_valid_ranges = false;
-        return;
-      }
+  if (!query) { return false; }
 
-      ranges.emplace_back(first, last);
-    });
-    return all_valid_ranges && !ranges.empty();
+  CFTypeRef security_items = nullptr;
+  if (SecItemCopyMatching(query.get(), &security_items) != errSecSuccess ||
+      CFArrayGetTypeID() != CFGetTypeID(security_items)) {
+    return false;
   }
-  return false;
-#ifdef CPPHTTPLIB_NO_EXCEPTIONS
-}
-#else
-} catch (...) { return false; }
-#endif
-
-inline bool parse_accept_header(const std::string &s,
-                                std::vector<std::string> &content_types) {
-  content_types.clear();
 
-  // Empty string is considered valid (no preference)
-  if (s.empty()) { return true; }
+  certs.reset(reinterpret_cast<CFArrayRef>(security_items));
+  return true;
+}
 
-  // Check for invalid patterns: leading/trailing commas or consecutive commas
-  if (s.front() == ',' || s.back() == ',' ||
-      s.find(",,") != std::string::npos) {
+inline bool retrieve_root_certs_from_keychain(CFObjectPtr<CFArrayRef> &certs) {
+  CFArrayRef root_security_items = nullptr;
+  if (SecTrustCopyAnchorCertificates(&root_security_items) != errSecSuccess) {
     return false;
   }
 
-  struct AcceptEntry {
-    std::string media_type;
-    double quality;
-    int order; // Original order in header
-  };
+  certs.reset(root_security_items);
+  return true;
+}
 
-  std::vector<AcceptEntry> entries;
-  int order = 0;
-  bool has_invalid_entry = false;
+inline bool add_certs_to_x509_store(CFArrayRef certs, X509_STORE *store) {
+  auto result = false;
+  for (auto i = 0; i < CFArrayGetCount(certs); ++i) {
+    const auto cert = reinterpret_cast<const __SecCertificate *>(
+        CFArrayGetValueAtIndex(certs, i));
 
-  // Split by comma and parse each entry
-  split(s.data(), s.data() + s.size(), ',', [&](const char *b, const char *e) {
-    std::string entry(b, e);
-    entry = trim_copy(entry);
+    if (SecCertificateGetTypeID() != CFGetTypeID(cert)) { continue; }
 
-    if (entry.empty()) {
-      has_invalid_entry = true;
-      return;
+    CFDataRef cert_data = nullptr;
+    if (SecItemExport(cert, kSecFormatX509Cert, 0, nullptr, &cert_data) !=
+        errSecSuccess) {
+      continue;
     }
 
-    AcceptEntry accept_entry;
-    accept_entry.quality = 1.0; // Default quality
-    accept_entry.order = order++;
+    CFObjectPtr<CFDataRef> cert_data_ptr(cert_data, cf_object_ptr_deleter);
 
-    // Find q= parameter
-    auto q_pos = entry.find(";q=");
-    if (q_pos == std::string::npos) { q_pos = entry.find("; q="); }
+    auto encoded_cert = static_cast<const unsigned char *>(
+        CFDataGetBytePtr(cert_data_ptr.get()));
 
-    if (q_pos != std::string::npos) {
-      // Extract media type (before q parameter)
-      accept_entry.media_type = trim_copy(entry.substr(0, q_pos));
+    auto x509 =
+        d2i_X509(NULL, &encoded_cert, CFDataGetLength(cert_data_ptr.get()));
 
-      // Extract quality value
-      auto q_start = entry.find('=', q_pos) + 1;
-      auto q_end = entry.find(';', q_start);
-      if (q_end == std::string::npos) { q_end = entry.length(); }
+    if (x509) {
+      X509_STORE_add_cert(store, x509);
+      X509_free(x509);
+      result = true;
+    }
+  }
 
-      std::string quality_str =
-          trim_copy(entry.substr(q_start, q_end - q_start));
-      if (quality_str.empty()) {
-        has_invalid_entry = true;
-        return;
-      }
+  return result;
+}
 
-      try {
-        accept_entry.quality = std::stod(quality_str);
-        // Check if quality is in valid range [0.0, 1.0]
-        if (accept_entry.quality < 0.0 || accept_entry.quality > 1.0) {
-          has_invalid_entry = true;
-          return;
-        }
-      } catch (...) {
-        has_invalid_entry = true;
-        return;
-      }
-    } else {
-      // No quality parameter, use entire entry as media type
-      accept_entry.media_type = entry;
-    }
+inline bool load_system_certs_on_macos(X509_STORE *store) {
+  auto result = false;
+  CFObjectPtr<CFArrayRef> certs(nullptr, cf_object_ptr_deleter);
+  if (retrieve_certs_from_keychain(certs) && certs) {
+    result = add_certs_to_x509_store(certs.get(), store);
+  }
 
-    // Remove additional parameters from media type
-    auto param_pos = accept_entry.media_type.find(';');
-    if (param_pos != std::string::npos) {
-      accept_entry.media_type =
-          trim_copy(accept_entry.media_type.substr(0, param_pos));
-    }
+  if (retrieve_root_certs_from_keychain(certs) && certs) {
+    result = add_certs_to_x509_store(certs.get(), store) || result;
+  }
 
-    // Basic validation of media type format
-    if (accept_entry.media_type.empty()) {
-      has_invalid_entry = true;
-      return;
-    }
+  return result;
+}
+#endif // _WIN64
+#endif // CPPHTTPLIB_OPENSSL_SUPPORT
 
-    // Check for basic media type format (should contain '/' or be '*')
-    if (accept_entry.media_type != "*" &&
-        accept_entry.media_type.find('/') == std::string::npos) {
-      has_invalid_entry = true;
-      return;
-    }
+#ifdef _WIN64
+class WSInit {
+public:
+  WSInit() {
+    WSADATA wsaData;
+    if (WSAStartup(0x0002, &wsaData) == 0) is_valid_ = true;
+  }
 
-    entries.push_back(accept_entry);
-  });
+  ~WSInit() {
+    if (is_valid_) WSACleanup();
+  }
 
-  // Return false if any invalid entry was found
-  if (has_invalid_entry) { return false; }
+  bool is_valid_ = false;
+};
 
-  // Sort by quality (descending), then by original order (ascending)
-  std::sort(entries.begin(), entries.end(),
-            [](const AcceptEntry &a, const AcceptEntry &b) {
-              if (a.quality != b.quality) {
-                return a.quality > b.quality; // Higher quality first
-              }
-              return a.order < b.order; // Earlier order first for same quality
-            });
+static WSInit wsinit_;
+#endif
 
-  // Extract sorted media types
-  content_types.reserve(entries.size());
-  for (const auto &entry : entries) {
-    content_types.push_back(entry.media_type);
+inline bool parse_www_authenticate(const Response &res,
+                                   std::map<std::string, std::string> &auth,
+                                   bool is_proxy) {
+  auto auth_key = is_proxy ? "Proxy-Authenticate" : "WWW-Authenticate";
+  if (res.has_header(auth_key)) {
+    thread_local auto re =
+        std::regex(R"~((?:(?:,\s*)?(.+?)=(?:"(.*?)"|([^,]*))))~");
+    auto s = res.get_header_value(auth_key);
+    auto pos = s.find(' ');
+    if (pos != std::string::npos) {
+      auto type = s.substr(0, pos);
+      if (type == "Basic") {
+        return false;
+      } else if (type == "Digest") {
+        s = s.substr(pos + 1);
+        auto beg = std::sregex_iterator(s.begin(), s.end(), re);
+        for (auto i = beg; i != std::sregex_iterator(); ++i) {
+          const auto &m = *i;
+          auto key = s.substr(static_cast<size_t>(m.position(1)),
+                              static_cast<size_t>(m.length(1)));
+          auto val = m.length(2) > 0
+                         ? s.substr(static_cast<size_t>(m.position(2)),
+                                    static_cast<size_t>(m.length(2)))
+                         : s.substr(static_cast<size_t>(m.position(3)),
+                                    static_cast<size_t>(m.length(3)));
+          auth[key] = val;
+        }
+        return true;
+      }
+    }
   }
-
-  return true;
+  return false;
 }
 
-class FormDataParser {
+class ContentProviderAdapter {
 public:
-  FormDataParser() = default;
+  explicit ContentProviderAdapter(
+      ContentProviderWithoutLength &&content_provider)
+      : content_provider_(content_provider) {}
 
-  void set_boundary(std::string &&boundary) {
-    boundary_ = boundary;
-    dash_boundary_crlf_ = dash_ + boundary_ + crlf_;
-    crlf_dash_boundary_ = crlf_ + dash_ + boundary_;
+  bool operator()(size_t offset, size_t, DataSink &sink) {
+    return content_provider_(offset, sink);
   }
 
-  bool is_valid() const { return is_valid_; }
+private:
+  ContentProviderWithoutLength content_provider_;
+};
 
-  bool parse(const char *buf, size_t n, const FormDataHeader &header_callback,
-             const ContentReceiver &content_callback) {
+} // namespace detail
 
-    buf_append(buf, n);
+inline std::string hosted_at(const std::string &hostname) {
+  std::vector<std::string> addrs;
+  hosted_at(hostname, addrs);
+  if (addrs.empty()) { return std::string(); }
+  return addrs[0];
+}
 
-    while (buf_size() > 0) {
-      switch (state_) {
-      case 0: { // Initial boundary
-        auto pos = buf_find(dash_boundary_crlf_);
-        if (pos == buf_size()) { return true; }
-        buf_erase(pos + dash_boundary_crlf_.size());
-        state_ = 1;
-        break;
-      }
-      case 1: { // New entry
-        clear_file_info();
-        state_ = 2;
-        break;
-      }
-      case 2: { // Headers
-        auto pos = buf_find(crlf_);
-        if (pos > CPPHTTPLIB_HEADER_MAX_LENGTH) { return false; }
-        while (pos < buf_size()) {
-          // Empty line
-          if (pos == 0) {
-            if (!header_callback(file_)) {
-              is_valid_ = false;
-              return false;
-            }
-            buf_erase(crlf_.size());
-            state_ = 3;
-            break;
-          }
+inline void hosted_at(const std::string &hostname,
+                      std::vector<std::string> &addrs) {
+  struct addrinfo hints;
+  struct addrinfo *result;
 
-          const auto header = buf_head(pos);
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = 0;
 
-          if (!parse_header(header.data(), header.data() + header.size(),
-                            [&](const std::string &, const std::string &) {})) {
-            is_valid_ = false;
-            return false;
-          }
+  if (detail::getaddrinfo_with_timeout(hostname.c_str(), nullptr, &hints,
+                                       &result, 0)) {
+#if defined __linux__ && !defined __ANDROID__
+    res_init();
+#endif
+    return;
+  }
+  auto se = detail::scope_exit([&] { freeaddrinfo(result); });
 
-          // Parse and emplace space trimmed headers into a map
-          if (!parse_header(
-                  header.data(), header.data() + header.size(),
-                  [&](const std::string &key, const std::string &val) {
-                    file_.headers.emplace(key, val);
-                  })) {
-            is_valid_ = false;
-            return false;
-          }
+  for (auto rp = result; rp; rp = rp->ai_next) {
+    const auto &addr =
+        *reinterpret_cast<struct sockaddr_storage *>(rp->ai_addr);
+    std::string ip;
+    auto dummy = -1;
+    if (detail::get_ip_and_port(addr, sizeof(struct sockaddr_storage), ip,
+                                dummy)) {
+      addrs.push_back(ip);
+    }
+  }
+}
 
-          constexpr const char header_content_type[] = "Content-Type:";
+inline std::string encode_uri_component(const std::string &value) {
+  std::ostringstream escaped;
+  escaped.fill('0');
+  escaped << std::hex;
 
-          if (start_with_case_ignore(header, header_content_type)) {
-            file_.content_type =
-                trim_copy(header.substr(str_len(header_content_type)));
-          } else {
-            thread_local const std::regex re_content_disposition(
-                R"~(^Content-Disposition:\s*form-data;\s*(.*)$)~",
-                std::regex_constants::icase);
+  for (auto c : value) {
+    if (std::isalnum(static_cast<uint8_t>(c)) || c == '-' || c == '_' ||
+        c == '.' || c == '!' || c == '~' || c == '*' || c == '\'' || c == '(' ||
+        c == ')') {
+      escaped << c;
+    } else {
+      escaped << std::uppercase;
+      escaped << '%' << std::setw(2)
+              << static_cast<int>(static_cast<unsigned char>(c));
+      escaped << std::nouppercase;
+    }
+  }
 
-            std::smatch m;
-            if (std::regex_match(header, m, re_content_disposition)) {
-              Params params;
-              parse_disposition_params(m[1], params);
+  return escaped.str();
+}
 
-              auto it = params.find("name");
-              if (it != params.end()) {
-                file_.name = it->second;
-              } else {
-                is_valid_ = false;
-                return false;
-              }
+inline std::string encode_uri(const std::string &value) {
+  std::ostringstream escaped;
+  escaped.fill('0');
+  escaped << std::hex;
 
-              it = params.find("filename");
-              if (it != params.end()) { file_.filename = it->second; }
+  for (auto c : value) {
+    if (std::isalnum(static_cast<uint8_t>(c)) || c == '-' || c == '_' ||
+        c == '.' || c == '!' || c == '~' || c == '*' || c == '\'' || c == '(' ||
+        c == ')' || c == ';' || c == '/' || c == '?' || c == ':' || c == '@' ||
+        c == '&' || c == '=' || c == '+' || c == '$' || c == ',' || c == '#') {
+      escaped << c;
+    } else {
+      escaped << std::uppercase;
+      escaped << '%' << std::setw(2)
+              << static_cast<int>(static_cast<unsigned char>(c));
+      escaped << std::nouppercase;
+    }
+  }
 
-              it = params.find("filename*");
-              if (it != params.end()) {
-                // Only allow UTF-8 encoding...
-                thread_local const std::regex re_rfc5987_encoding(
-                    R"~(^UTF-8''(.+?)$)~", std::regex_constants::icase);
+  return escaped.str();
+}
 
-                std::smatch m2;
-                if (std::regex_match(it->second, m2, re_rfc5987_encoding)) {
-                  file_.filename = decode_path(m2[1], false); // override...
-                } else {
-                  is_valid_ = false;
-                  return false;
-                }
-              }
-            }
-          }
-          buf_erase(pos + crlf_.size());
-          pos = buf_find(crlf_);
-        }
-        if (state_ != 3) { return true; }
-        break;
-      }
-      case 3: { // Body
-        if (crlf_dash_boundary_.size() > buf_size()) { return true; }
-        auto pos = buf_find(crlf_dash_boundary_);
-        if (pos < buf_size()) {
-          if (!content_callback(buf_data(), pos)) {
-            is_valid_ = false;
-            return false;
-          }
-          buf_erase(pos + crlf_dash_boundary_.size());
-          state_ = 4;
-        } else {
-          auto len = buf_size() - crlf_dash_boundary_.size();
-          if (len > 0) {
-            if (!content_callback(buf_data(), len)) {
-              is_valid_ = false;
-              return false;
-            }
-            buf_erase(len);
-          }
-          return true;
-        }
-        break;
-      }
-      case 4: { // Boundary
-        if (crlf_.size() > buf_size()) { return true; }
-        if (buf_start_with(crlf_)) {
-          buf_erase(crlf_.size());
-          state_ = 1;
-        } else {
-          if (dash_.size() > buf_size()) { return true; }
-          if (buf_start_with(dash_)) {
-            buf_erase(dash_.size());
-            is_valid_ = true;
-            buf_erase(buf_size()); // Remove epilogue
-          } else {
-            return true;
-          }
-        }
-        break;
-      }
+inline std::string decode_uri_component(const std::string &value) {
+  std::string result;
+
+  for (size_t i = 0; i < value.size(); i++) {
+    if (value[i] == '%' && i + 2 < value.size()) {
+      auto val = 0;
+      if (detail::from_hex_to_i(value, i + 1, 2, val)) {
+        result += static_cast<char>(val);
+        i += 2;
+      } else {
+        result += value[i];
       }
+    } else {
+      result += value[i];
     }
-
-    return true;
   }
 
-private:
-  void clear_file_info() {
-    file_.name.clear();
-    file_.filename.clear();
-    file_.content_type.clear();
-    file_.headers.clear();
-  }
+  return result;
+}
 
-  bool start_with_case_ignore(const std::string &a, const char *b) const {
-    const auto b_len = strlen(b);
-    if (a.size() < b_len) { return false; }
-    for (size_t i = 0; i < b_len; i++) {
-      if (case_ignore::to_lower(a[i]) != case_ignore::to_lower(b[i])) {
-        return false;
+inline std::string decode_uri(const std::string &value) {
+  std::string result;
+
+  for (size_t i = 0; i < value.size(); i++) {
+    if (value[i] == '%' && i + 2 < value.size()) {
+      auto val = 0;
+      if (detail::from_hex_to_i(value, i + 1, 2, val)) {
+        result += static_cast<char>(val);
+        i += 2;
+      } else {
+        result += value[i];
       }
+    } else {
+      result += value[i];
     }
-    return true;
   }
 
-  const std::string dash_ = "--";
-  const std::string crlf_ = "\r\n";
-  std::string boundary_;
-  std::string dash_boundary_crlf_;
-  std::string crlf_dash_boundary_;
+  return result;
+}
 
-  size_t state_ = 0;
-  bool is_valid_ = false;
-  FormData file_;
+[[deprecated("Use encode_uri_component instead")]]
+inline std::string encode_query_param(const std::string &value) {
+  return encode_uri_component(value);
+}
 
-  // Buffer
-  bool start_with(const std::string &a, size_t spos, size_t epos,
-                  const std::string &b) const {
-    if (epos - spos < b.size()) { return false; }
-    for (size_t i = 0; i < b.size(); i++) {
-      if (a[i + spos] != b[i]) { return false; }
-    }
-    return true;
+inline std::string append_query_params(const std::string &path,
+                                       const Params &params) {
+  std::string path_with_query = path;
+  thread_local const std::regex re("[^?]+\\?.*");
+  auto delm = std::regex_match(path, re) ? '&' : '?';
+  path_with_query += delm + detail::params_to_query_str(params);
+  return path_with_query;
+}
+
+// Header utilities
+inline std::pair<std::string, std::string>
+make_range_header(const Ranges &ranges) {
+  std::string field = "bytes=";
+  auto i = 0;
+  for (const auto &r : ranges) {
+    if (i != 0) { field += ", "; }
+    if (r.first != -1) { field += std::to_string(r.first); }
+    field += '-';
+    if (r.second != -1) { field += std::to_string(r.second); }
+    i++;
   }
+  return std::make_pair("Range", std::move(field));
+}
 
-  size_t buf_size() const { return buf_epos_ - buf_spos_; }
+inline std::pair<std::string, std::string>
+make_basic_authentication_header(const std::string &username,
+                                 const std::string &password, bool is_proxy) {
+  auto field = "Basic " + detail::base64_encode(username + ":" + password);
+  auto key = is_proxy ? "Proxy-Authorization" : "Authorization";
+  return std::make_pair(key, std::move(field));
+}
 
-  const char *buf_data() const { return &buf_[buf_spos_]; }
+inline std::pair<std::string, std::string>
+make_bearer_token_authentication_header(const std::string &token,
+                                        bool is_proxy = false) {
+  auto field = "Bearer " + token;
+  auto key = is_proxy ? "Proxy-Authorization" : "Authorization";
+  return std::make_pair(key, std::move(field));
+}
 
-  std::string buf_head(size_t l) const { return buf_.substr(buf_spos_, l); }
+// Request implementation
+inline bool Request::has_header(const std::string &key) const {
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+  size_t id = 0;
+  if (find_header_field(key, id)) { return true; }
+#endif
+  return detail::has_header(headers, key);
+}
 
-  bool buf_start_with(const std::string &s) const {
-    return start_with(buf_, buf_spos_, buf_epos_, s);
+inline std::string Request::get_header_value(const std::string &key,
+                                             const char *def, size_t id) const {
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+  auto field = find_header_field(key, id);
+  if (field) {
+    return std::string(header_block_.data() + field->value_offset,
+                       field->value_length);
   }
+#endif
+  return detail::get_header_value(headers, key, def, id);
+}
 
-  size_t buf_find(const std::string &s) const {
-    auto c = s.front();
+inline size_t Request::get_header_value_count(const std::string &key) const {
+  auto r = headers.equal_range(key);
+  auto count = static_cast<size_t>(std::distance(r.first, r.second));
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+  auto hash = detail::case_ignore::token_hash(key.data(), key.size());
+  for (const auto &field : header_fields_) {
+    if (field.hash == hash &&
+        detail::case_ignore::equal(key.data(), key.size(),
+                                   header_block_.data() + field.name_offset,
+                                   field.name_length)) {
+      count++;
+    }
+  }
+#endif
+  return count;
+}
 
-    size_t off = buf_spos_;
-    while (off < buf_epos_) {
-      auto pos = off;
-      while (true) {
-        if (pos == buf_epos_) { return buf_size(); }
-        if (buf_[pos] == c) { break; }
-        pos++;
-      }
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+inline std::string_view Request::get_header_value_view(const std::string &key,
+                                                       size_t id) const {
+  auto field = find_header_field(key, id);
+  if (field) {
+    return std::string_view(header_block_.data() + field->value_offset,
+                            field->value_length);
+  }
+  auto val = detail::get_header_value(headers, key, nullptr, id);
+  return val ? std::string_view(val) : std::string_view();
+}
 
-      auto remaining_size = buf_epos_ - pos;
-      if (s.size() > remaining_size) { return buf_size(); }
+inline size_t Request::header_field_count() const {
+  return header_fields_.size();
+}
 
-      if (start_with(buf_, pos, buf_epos_, s)) { return pos - buf_spos_; }
+inline std::pair<std::string_view, std::string_view>
+Request::header_field(size_t index) const {
+  const auto &field = header_fields_[index];
+  return {std::string_view(header_block_.data() + field.name_offset,
+                           field.name_length),
+          std::string_view(header_block_.data() + field.value_offset,
+                           field.value_length)};
+}
 
-      off = pos + 1;
-    }
+// On a miss, `id` is reduced by the number of matching fields so that the
+// caller can continue the search in `headers`.
+inline const detail::HeaderField *
+Request::find_header_field(const std::string &key, size_t &id) const {
+  if (header_fields_.empty()) { return nullptr; }
 
-    return buf_size();
-  }
+  auto hash = detail::case_ignore::token_hash(key.data(), key.size());
 
-  void buf_append(const char *data, size_t n) {
-    auto remaining_size = buf_size();
-    if (remaining_size > 0 && buf_spos_ > 0) {
-      for (size_t i = 0; i < remaining_size; i++) {
-        buf_[i] = buf_[buf_spos_ + i];
+  if (id == 0) {
+    for (size_t i = 0; i < known_header_index_.size(); i++) {
+      if (hash == detail::known_header_hashes[i] &&
+          detail::case_ignore::equal(
+              key.data(), key.size(), detail::known_header_names[i],
+              std::strlen(detail::known_header_names[i]))) {
+        auto index = known_header_index_[i];
+        return index != SIZE_MAX ? &header_fields_[index] : nullptr;
       }
     }
-    buf_spos_ = 0;
-    buf_epos_ = remaining_size;
-
-    if (remaining_size + n > buf_.size()) { buf_.resize(remaining_size + n); }
+  }
 
-    for (size_t i = 0; i < n; i++) {
-      buf_[buf_epos_ + i] = data[i];
+  for (const auto &field : header_fields_) {
+    if (field.hash == hash &&
+        detail::case_ignore::equal(key.data(), key.size(),
+                                   header_block_.data() + field.name_offset,
+                                   field.name_length)) {
+      if (id == 0) { return &field; }
+      id--;
     }
-    buf_epos_ += n;
   }
+  return nullptr;
+}
+#endif
 
-  void buf_erase(size_t size) { buf_spos_ += size; }
+inline void Request::set_header(const std::string &key,
+                                const std::string &val) {
+  if (detail::fields::is_field_name(key) &&
+      detail::fields::is_field_value(val)) {
+    headers.emplace(key, val);
+  }
+}
 
-  std::string buf_;
-  size_t buf_spos_ = 0;
-  size_t buf_epos_ = 0;
-};
+inline bool Request::has_trailer(const std::string &key) const {
+  return trailers.find(key) != trailers.end();
+}
 
-inline std::string random_string(size_t length) {
-  constexpr const char data[] =
-      "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+inline std::string Request::get_trailer_value(const std::string &key,
+                                              size_t id) const {
+  auto rng = trailers.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) { return it->second; }
+  return std::string();
+}
 
-  thread_local auto engine([]() {
-    // std::random_device might actually be deterministic on some
-    // platforms, but due to lack of support in the c++ standard library,
-    // doing better requires either some ugly hacks or breaking portability.
-    std::random_device seed_gen;
-    // Request 128 bits of entropy for initialization
-    std::seed_seq seed_sequence{seed_gen(), seed_gen(), seed_gen(), seed_gen()};
-    return std::mt19937(seed_sequence);
-  }());
+inline size_t Request::get_trailer_value_count(const std::string &key) const {
+  auto r = trailers.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
+}
 
-  std::string result;
-  for (size_t i = 0; i < length; i++) {
-    result += data[engine() % (sizeof(data) - 1)];
-  }
-  return result;
+inline bool Request::has_param(const std::string &key) const {
+  return params.find(key) != params.end();
 }
 
-inline std::string make_multipart_data_boundary() {
-  return "--cpp-httplib-multipart-data-" + detail::random_string(16);
+inline std::string Request::get_param_value(const std::string &key,
+                                            size_t id) const {
+  auto rng = params.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) { return it->second; }
+  return std::string();
 }
 
-inline bool is_multipart_boundary_chars_valid(const std::string &boundary) {
-  auto valid = true;
-  for (size_t i = 0; i < boundary.size(); i++) {
-    auto c = boundary[i];
-    if (!std::isalnum(c) && c != '-' && c != '_') {
-      valid = false;
-      break;
-    }
-  }
-  return valid;
+inline size_t Request::get_param_value_count(const std::string &key) const {
+  auto r = params.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
 }
 
-template <typename T>
-inline std::string
-serialize_multipart_formdata_item_begin(const T &item,
-                                        const std::string &boundary) {
-  std::string body = "--" + boundary + "\r\n";
-  body += "Content-Disposition: form-data; name=\"" + item.name + "\"";
-  if (!item.filename.empty()) {
-    body += "; filename=\"" + item.filename + "\"";
+inline bool Request::is_multipart_form_data() const {
+  const auto &content_type = get_header_value("Content-Type");
+  return !content_type.rfind("multipart/form-data", 0);
+}
+
+// Multipart FormData implementation
+inline std::string MultipartFormData::get_field(const std::string &key,
+                                                size_t id) const {
+  auto rng = fields.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) { return it->second.content; }
+  return std::string();
+}
+
+inline std::vector<std::string>
+MultipartFormData::get_fields(const std::string &key) const {
+  std::vector<std::string> values;
+  auto rng = fields.equal_range(key);
+  for (auto it = rng.first; it != rng.second; it++) {
+    values.push_back(it->second.content);
   }
-  body += "\r\n";
-  if (!item.content_type.empty()) {
-    body += "Content-Type: " + item.content_type + "\r\n";
+  return values;
+}
+
+inline bool MultipartFormData::has_field(const std::string &key) const {
+  return fields.find(key) != fields.end();
+}
+
+inline size_t MultipartFormData::get_field_count(const std::string &key) const {
+  auto r = fields.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
+}
+
+inline FormData MultipartFormData::get_file(const std::string &key,
+                                            size_t id) const {
+  auto rng = files.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) { return it->second; }
+  return FormData();
+}
+
+inline std::vector<FormData>
+MultipartFormData::get_files(const std::string &key) const {
+  std::vector<FormData> values;
+  auto rng = files.equal_range(key);
+  for (auto it = rng.first; it != rng.second; it++) {
+    values.push_back(it->second);
   }
-  body += "\r\n";
+  return values;
+}
+
+inline bool MultipartFormData::has_file(const std::string &key) const {
+  return files.find(key) != files.end();
+}
+
+inline size_t MultipartFormData::get_file_count(const std::string &key) const {
+  auto r = files.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
+}
 
-  return body;
+// Response implementation
+inline bool Response::has_header(const std::string &key) const {
+  return headers.find(key) != headers.end();
 }
 
-inline std::string serialize_multipart_formdata_item_end() { return "\r\n"; }
+inline std::string Response::get_header_value(const std::string &key,
+                                              const char *def,
+                                              size_t id) const {
+  return detail::get_header_value(headers, key, def, id);
+}
 
-inline std::string
-serialize_multipart_formdata_finish(const std::string &boundary) {
-  return "--" + boundary + "--\r\n";
+inline size_t Response::get_header_value_count(const std::string &key) const {
+  auto r = headers.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
 }
 
-inline std::string
-serialize_multipart_formdata_get_content_type(const std::string &boundary) {
-  return "multipart/form-data; boundary=" + boundary;
+inline void Response::set_header(const std::string &key,
+                                 const std::string &val) {
+  if (detail::fields::is_field_name(key) &&
+      detail::fields::is_field_value(val)) {
+    headers.emplace(key, val);
+  }
+}
+inline bool Response::has_trailer(const std::string &key) const {
+  return trailers.find(key) != trailers.end();
 }
 
-inline std::string
-serialize_multipart_formdata(const UploadFormDataItems &items,
-                             const std::string &boundary, bool finish = true) {
-  std::string body;
+inline std::string Response::get_trailer_value(const std::string &key,
+                                               size_t id) const {
+  auto rng = trailers.equal_range(key);
+  auto it = rng.first;
+  std::advance(it, static_cast<ssize_t>(id));
+  if (it != rng.second) { return it->second; }
+  return std::string();
+}
 
-  for (const auto &item : items) {
-    body += serialize_multipart_formdata_item_begin(item, boundary);
-    body += item.content + serialize_multipart_formdata_item_end();
+inline size_t Response::get_trailer_value_count(const std::string &key) const {
+  auto r = trailers.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
+}
+
+inline void Response::set_redirect(const std::string &url, int stat) {
+  if (detail::fields::is_field_value(url)) {
+    set_header("Location", url);
+    if (300 <= stat && stat < 400) {
+      this->status = stat;
+    } else {
+      this->status = StatusCode::Found_302;
+    }
   }
+}
 
-  if (finish) { body += serialize_multipart_formdata_finish(boundary); }
+inline void Response::set_content(const char *s, size_t n,
+                                  const std::string &content_type) {
+  body.assign(s, n);
 
-  return body;
+  auto rng = headers.equal_range("Content-Type");
+  headers.erase(rng.first, rng.second);
+  set_header("Content-Type", content_type);
 }
 
-inline void coalesce_ranges(Ranges &ranges, size_t content_length) {
-  if (ranges.size() <= 1) return;
-
-  // Sort ranges by start position
-  std::sort(ranges.begin(), ranges.end(),
-            [](const Range &a, const Range &b) { return a.first < b.first; });
+inline void Response::set_content(const std::string &s,
+                                  const std::string &content_type) {
+  set_content(s.data(), s.size(), content_type);
+}
 
-  Ranges coalesced;
-  coalesced.reserve(ranges.size());
+inline void Response::set_content(std::string &&s,
+                                  const std::string &content_type) {
+  body = std::move(s);
 
-  for (auto &r : ranges) {
-    auto first_pos = r.first;
-    auto last_pos = r.second;
+  auto rng = headers.equal_range("Content-Type");
+  headers.erase(rng.first, rng.second);
+  set_header("Content-Type", content_type);
+}
 
-    // Handle special cases like in range_error
-    if (first_pos == -1 && last_pos == -1) {
-      first_pos = 0;
-      last_pos = static_cast<ssize_t>(content_length);
-    }
+inline void Response::set_content_provider(
+    size_t in_length, const std::string &content_type, ContentProvider provider,
+    ContentProviderResourceReleaser resource_releaser) {
+  set_header("Content-Type", content_type);
+  content_length_ = in_length;
+  if (in_length > 0) { content_provider_ = std::move(provider); }
+  content_provider_resource_releaser_ = std::move(resource_releaser);
+  is_chunked_content_provider_ = false;
+  content_fd_ = -1;
+}
 
-    if (first_pos == -1) {
-      first_pos = static_cast<ssize_t>(content_length) - last_pos;
-      last_pos = static_cast<ssize_t>(content_length) - 1;
-    }
+inline void Response::set_content_provider(
+    const std::string &content_type, ContentProviderWithoutLength provider,
+    ContentProviderResourceReleaser resource_releaser) {
+  set_header("Content-Type", content_type);
+  content_length_ = 0;
+  content_provider_ = detail::ContentProviderAdapter(std::move(provider));
+  content_provider_resource_releaser_ = std::move(resource_releaser);
+  is_chunked_content_provider_ = false;
+  content_fd_ = -1;
+}
 
-    if (last_pos == -1 || last_pos >= static_cast<ssize_t>(content_length)) {
-      last_pos = static_cast<ssize_t>(content_length) - 1;
-    }
+inline void Response::set_chunked_content_provider(
+    const std::string &content_type, ContentProviderWithoutLength provider,
+    ContentProviderResourceReleaser resource_releaser) {
+  set_header("Content-Type", content_type);
+  content_length_ = 0;
+  content_provider_ = detail::ContentProviderAdapter(std::move(provider));
+  content_provider_resource_releaser_ = std::move(resource_releaser);
+  is_chunked_content_provider_ = true;
+  content_fd_ = -1;
+}
 
-    // Skip invalid ranges
-    if (!(0 <= first_pos && first_pos <= last_pos &&
-          last_pos < static_cast<ssize_t>(content_length))) {
-      continue;
-    }
+inline void Response::set_file_content(const std::string &path,
+                                       const std::string &content_type) {
+  file_content_path_ = path;
+  file_content_content_type_ = content_type;
+}
 
-    // Coalesce with previous range if overlapping or adjacent (but not
-    // identical)
-    if (!coalesced.empty()) {
-      auto &prev = coalesced.back();
-      // Check if current range overlaps or is adjacent to previous range
-      // but don't coalesce identical ranges (allow duplicates)
-      if (first_pos <= prev.second + 1 &&
-          !(first_pos == prev.first && last_pos == prev.second)) {
-        // Extend the previous range
-        prev.second = (std::max)(prev.second, last_pos);
-        continue;
-      }
-    }
+inline void Response::set_file_content(const std::string &path) {
+  file_content_path_ = path;
+}
 
-    // Add new range
-    coalesced.emplace_back(first_pos, last_pos);
-  }
+// Result implementation
+inline bool Result::has_request_header(const std::string &key) const {
+  return request_headers_.find(key) != request_headers_.end();
+}
 
-  ranges = std::move(coalesced);
+inline std::string Result::get_request_header_value(const std::string &key,
+                                                    const char *def,
+                                                    size_t id) const {
+  return detail::get_header_value(request_headers_, key, def, id);
 }
 
-inline bool range_error(Request &req, Response &res) {
-  if (!req.ranges.empty() && 200 <= res.status && res.status < 300) {
-    ssize_t content_len = static_cast<ssize_t>(
-        res.content_length_ ? res.content_length_ : res.body.size());
+inline size_t
+Result::get_request_header_value_count(const std::string &key) const {
+  auto r = request_headers_.equal_range(key);
+  return static_cast<size_t>(std::distance(r.first, r.second));
+}
 
-    std::vector<std::pair<ssize_t, ssize_t>> processed_ranges;
-    size_t overwrapping_count = 0;
+// Stream implementation
+inline ssize_t Stream::write(const char *ptr) {
+  return write(ptr, strlen(ptr));
+}
 
-    // NOTE: The following Range check is based on '14.2. Range' in RFC 9110
-    // 'HTTP Semantics' to avoid potential denial-of-service attacks.
-    // https://www.rfc-editor.org/rfc/rfc9110#section-14.2
+inline ssize_t Stream::write(const std::string &s) {
+  return write(s.data(), s.size());
+}
 
-    // Too many ranges
-    if (req.ranges.size() > CPPHTTPLIB_RANGE_MAX_COUNT) { return true; }
+namespace detail {
 
-    for (auto &r : req.ranges) {
-      auto &first_pos = r.first;
-      auto &last_pos = r.second;
+inline void calc_actual_timeout(time_t max_timeout_msec, time_t duration_msec,
+                                time_t timeout_sec, time_t timeout_usec,
+                                time_t &actual_timeout_sec,
+                                time_t &actual_timeout_usec) {
+  auto timeout_msec = (timeout_sec * 1000) + (timeout_usec / 1000);
 
-      if (first_pos == -1 && last_pos == -1) {
-        first_pos = 0;
-        last_pos = content_len;
-      }
+  auto actual_timeout_msec =
+      (std::min)(max_timeout_msec - duration_msec, timeout_msec);
 
-      if (first_pos == -1) {
-        first_pos = content_len - last_pos;
-        last_pos = content_len - 1;
-      }
+  if (actual_timeout_msec < 0) { actual_timeout_msec = 0; }
 
-      // NOTE: RFC-9110 '14.1.2. Byte Ranges':
-      // A client can limit the number of bytes requested without knowing the
-      // size of the selected representation. If the last-pos value is absent,
-      // or if the value is greater than or equal to the current length of the
-      // representation data, the byte range is interpreted as the remainder of
-      // the representation (i.e., the server replaces the value of last-pos
-      // with a value that is one less than the current length of the selected
-      // representation).
-      // https://www.rfc-editor.org/rfc/rfc9110.html#section-14.1.2-6
-      if (last_pos == -1 || last_pos >= content_len) {
-        last_pos = content_len - 1;
-      }
+  actual_timeout_sec = actual_timeout_msec / 1000;
+  actual_timeout_usec = (actual_timeout_msec % 1000) * 1000;
+}
 
-      // Range must be within content length
-      if (!(0 <= first_pos && first_pos <= last_pos &&
-            last_pos <= content_len - 1)) {
-        return true;
-      }
+// Socket stream implementation
+inline SocketStream::SocketStream(
+    socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
+    time_t write_timeout_sec, time_t write_timeout_usec,
+    time_t max_timeout_msec,
+    std::chrono::time_point<std::chrono::steady_clock> start_time)
+    : sock_(sock), read_timeout_sec_(read_timeout_sec),
+      read_timeout_usec_(read_timeout_usec),
+      write_timeout_sec_(write_timeout_sec),
+      write_timeout_usec_(write_timeout_usec),
+      max_timeout_msec_(max_timeout_msec), start_time_(start_time),
+      read_buff_(read_buff_size_, 0,
+                 TaggedAllocator<char>(connection_buffers_tag())) {}
 
-      // Request must not have more than two overlapping ranges
-      for (const auto &processed_range : processed_ranges) {
-        if (!(last_pos < processed_range.first ||
-              first_pos > processed_range.second)) {
-          overwrapping_count++;
-          if (overwrapping_count > 2) { return true; }
-          break; // Only count once per range
-        }
-      }
+inline SocketStream::~SocketStream() = default;
 
-      processed_ranges.emplace_back(first_pos, last_pos);
-    }
+inline bool SocketStream::is_readable() const {
+  return read_buff_off_ < read_buff_content_size_;
+}
 
-    // After validation, coalesce overlapping ranges as per RFC 9110
-    coalesce_ranges(req.ranges, static_cast<size_t>(content_len));
+inline bool SocketStream::wait_readable() const {
+  if (max_timeout_msec_ <= 0) {
+    return select_read(sock_, read_timeout_sec_, read_timeout_usec_) > 0;
   }
 
-  return false;
-}
+  time_t read_timeout_sec;
+  time_t read_timeout_usec;
+  calc_actual_timeout(max_timeout_msec_, duration(), read_timeout_sec_,
+                      read_timeout_usec_, read_timeout_sec, read_timeout_usec);
 
-inline std::pair<size_t, size_t>
-get_range_offset_and_length(Range r, size_t content_length) {
-  assert(r.first != -1 && r.second != -1);
-  assert(0 <= r.first && r.first < static_cast<ssize_t>(content_length));
-  assert(r.first <= r.second &&
-         r.second < static_cast<ssize_t>(content_length));
-  (void)(content_length);
-  return std::make_pair(r.first, static_cast<size_t>(r.second - r.first) + 1);
+  return select_read(sock_, read_timeout_sec, read_timeout_usec) > 0;
 }
 
-inline std::string make_content_range_header_field(
-    const std::pair<size_t, size_t> &offset_and_length, size_t content_length) {
-  auto st = offset_and_length.first;
-  auto ed = st + offset_and_length.second - 1;
-
-  std::string field = "bytes ";
-  field += std::to_string(st);
-  field += "-";
-  field += std::to_string(ed);
-  field += "/";
-  field += std::to_string(content_length);
-  return field;
+inline bool SocketStream::wait_writable() const {
+  return select_write(sock_, write_timeout_sec_, write_timeout_usec_) > 0 &&
+         is_socket_alive(sock_);
 }
 
-template <typename SToken, typename CToken, typename Content>
-bool process_multipart_ranges_data(const Request &req,
-                                   const std::string &boundary,
-                                   const std::string &content_type,
-                                   size_t content_length, SToken stoken,
-                                   CToken ctoken, Content content) {
-  for (size_t i = 0; i < req.ranges.size(); i++) {
-    ctoken("--");
-    stoken(boundary);
-    ctoken("\r\n");
-    if (!content_type.empty()) {
-      ctoken("Content-Type: ");
-      stoken(content_type);
-      ctoken("\r\n");
+inline ssize_t SocketStream::read(char *ptr, size_t size) {
+#ifdef _WIN64
+  size =
+      (std::min)(size, static_cast<size_t>((std::numeric_limits<int>::max)()));
+#else
+  size = (std::min)(size,
+                    static_cast<size_t>((std::numeric_limits<ssize_t>::max)()));
+#endif
+
+  if (read_buff_off_ < read_buff_content_size_) {
+    auto remaining_size = read_buff_content_size_ - read_buff_off_;
+    if (size <= remaining_size) {
+      memcpy(ptr, read_buff_.data() + read_buff_off_, size);
+      read_buff_off_ += size;
+      return static_cast<ssize_t>(size);
+    } else {
+      memcpy(ptr, read_buff_.data() + read_buff_off_, remaining_size);
+      read_buff_off_ += remaining_size;
+      return static_cast<ssize_t>(remaining_size);
     }
+  }
 
-    auto offset_and_length =
-        get_range_offset_and_length(req.ranges[i], content_length);
+  // Nothing is buffered, so the peer may be waiting on pending responses
+  // before it sends more.
+  if (!flush()) { return -1; }
+  if (!wait_readable()) { return -1; }
 
-    ctoken("Content-Range: ");
-    stoken(make_content_range_header_field(offset_and_length, content_length));
-    ctoken("\r\n");
-    ctoken("\r\n");
+  read_buff_off_ = 0;
+  read_buff_content_size_ = 0;
 
-    if (!content(offset_and_length.first, offset_and_length.second)) {
-      return false;
+  if (size < read_buff_size_) {
+    auto n = read_socket(sock_, read_buff_.data(), read_buff_size_,
+                         CPPHTTPLIB_RECV_FLAGS);
+    if (n <= 0) {
+      return n;
+    } else if (n <= static_cast<ssize_t>(size)) {
+      memcpy(ptr, read_buff_.data(), static_cast<size_t>(n));
+      return n;
+    } else {
+      memcpy(ptr, read_buff_.data(), size);
+      read_buff_off_ = size;
+      read_buff_content_size_ = static_cast<size_t>(n);
+      return static_cast<ssize_t>(size);
     }
-    ctoken("\r\n");
+  } else {
+    return read_socket(sock_, ptr, size, CPPHTTPLIB_RECV_FLAGS);
   }
+}
 
-  ctoken("--");
-  stoken(boundary);
-  ctoken("--");
+inline ssize_t SocketStream::write(const char *ptr, size_t size) {
+  if (write_batching_ &&
+      write_buff_.size() + size <= CPPHTTPLIB_SEND_BUFSIZ) {
+    write_buff_.append(ptr, size);
+    return static_cast<ssize_t>(size);
+  }
 
-  return true;
+#ifndef _WIN64
+  if (!write_buff_.empty()) {
+    // Send the pending bytes and this write with a single call
+    if (!wait_writable()) { return -1; }
+
+    struct iovec iov[2];
+    iov[0].iov_base = &write_buff_[0];
+    iov[0].iov_len = write_buff_.size();
+    iov[1].iov_base = const_cast<char *>(ptr);
+    iov[1].iov_len = size;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    auto n = handle_EINTR(
+        [&]() { return sendmsg(sock_, &msg, CPPHTTPLIB_SEND_FLAGS); });
+    if (n < 0) { return n; }
+
+    auto sent = static_cast<size_t>(n);
+    if (sent < write_buff_.size()) {
+      write_buff_.erase(0, sent);
+      return 0;
+    }
+    sent -= write_buff_.size();
+    write_buff_.clear();
+    return static_cast<ssize_t>(sent);
+  }
+#else
+  if (!flush()) { return -1; }
+#endif
+
+  if (!wait_writable()) { return -1; }
+
+#if defined(_WIN64) && !defined(_WIN64)
+  size =
+      (std::min)(size, static_cast<size_t>((std::numeric_limits<int>::max)()));
+#endif
+
+  return send_socket(sock_, ptr, size, CPPHTTPLIB_SEND_FLAGS);
 }
 
-inline void make_multipart_ranges_data(const Request &req, Response &res,
-                                       const std::string &boundary,
-                                       const std::string &content_type,
-                                       size_t content_length,
-                                       std::string &data) {
-  process_multipart_ranges_data(
-      req, boundary, content_type, content_length,
-      [&](const std::string &token) { data += token; },
-      [&](const std::string &token) { data += token; },
-      [&](size_t offset, size_t length) {
-        assert(offset + length <= content_length);
-        data += res.body.substr(offset, length);
-        return true;
-      });
+inline void SocketStream::get_remote_ip_and_port(std::string &ip,
+                                                 int &port) const {
+  return detail::get_remote_ip_and_port(sock_, ip, port);
 }
 
-inline size_t get_multipart_ranges_data_length(const Request &req,
-                                               const std::string &boundary,
-                                               const std::string &content_type,
-                                               size_t content_length) {
-  size_t data_length = 0;
+inline void SocketStream::get_local_ip_and_port(std::string &ip,
+                                                int &port) const {
+  return detail::get_local_ip_and_port(sock_, ip, port);
+}
 
-  process_multipart_ranges_data(
-      req, boundary, content_type, content_length,
-      [&](const std::string &token) { data_length += token.size(); },
-      [&](const std::string &token) { data_length += token.size(); },
-      [&](size_t /*offset*/, size_t length) {
-        data_length += length;
-        return true;
-      });
+inline socket_t SocketStream::socket() const { return sock_; }
 
-  return data_length;
+inline time_t SocketStream::duration() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start_time_)
+      .count();
 }
 
-template <typename T>
-inline bool
-write_multipart_ranges_data(Stream &strm, const Request &req, Response &res,
-                            const std::string &boundary,
-                            const std::string &content_type,
-                            size_t content_length, const T &is_shutting_down) {
-  return process_multipart_ranges_data(
-      req, boundary, content_type, content_length,
-      [&](const std::string &token) { strm.write(token); },
-      [&](const std::string &token) { strm.write(token); },
-      [&](size_t offset, size_t length) {
-        return write_content(strm, res.content_provider_, offset, length,
-                             is_shutting_down);
-      });
+inline bool SocketStream::write_batching() const { return write_batching_; }
+
+inline bool SocketStream::set_write_batching(bool on) {
+  write_batching_ = on;
+  return on || flush();
 }
 
-inline bool expect_content(const Request &req) {
-  if (req.method == "POST" || req.method == "PUT" || req.method == "PATCH" ||
-      req.method == "DELETE") {
-    return true;
-  }
-  if (req.has_header("Content-Length") &&
-      req.get_header_value_u64("Content-Length") > 0) {
-    return true;
+inline bool SocketStream::flush() {
+  size_t off = 0;
+  while (off < write_buff_.size()) {
+    if (!wait_writable()) { break; }
+    auto n = send_socket(sock_, write_buff_.data() + off,
+                         write_buff_.size() - off, CPPHTTPLIB_SEND_FLAGS);
+    if (n <= 0) { break; }
+    off += static_cast<size_t>(n);
   }
-  if (is_chunked_transfer_encoding(req.headers)) { return true; }
-  return false;
+  auto ret = off == write_buff_.size();
+  write_buff_.clear();
+  return ret;
 }
 
-inline bool has_crlf(const std::string &s) {
-  auto p = s.c_str();
-  while (*p) {
-    if (*p == '\r' || *p == '\n') { return true; }
-    p++;
-  }
+inline bool SocketStream::can_send_file() const {
+#ifdef __linux__
+  return true;
+#else
   return false;
+#endif
 }
 
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-inline std::string message_digest(const std::string &s, const EVP_MD *algo) {
-  auto context = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>(
-      EVP_MD_CTX_new(), EVP_MD_CTX_free);
+inline ssize_t SocketStream::send_file(int fd, size_t offset, size_t size) {
+#ifdef __linux__
+  if (!flush()) { return -1; }
+  if (!wait_writable()) { return -1; }
 
-  unsigned int hash_length = 0;
-  unsigned char hash[EVP_MAX_MD_SIZE];
+  auto off = static_cast<off_t>(offset);
+  return handle_EINTR([&]() { return ::sendfile(sock_, fd, &off, size); });
+#else
+  (void)fd;
+  (void)offset;
+  (void)size;
+  return -1;
+#endif
+}
 
-  EVP_DigestInit_ex(context.get(), algo, nullptr);
-  EVP_DigestUpdate(context.get(), s.c_str(), s.size());
-  EVP_DigestFinal_ex(context.get(), hash, &hash_length);
+// Buffer stream implementation
+inline bool BufferStream::is_readable() const { return true; }
 
-  std::stringstream ss;
-  for (auto i = 0u; i < hash_length; ++i) {
-    ss << std::hex << std::setw(2) << std::setfill('0')
-       << static_cast<unsigned int>(hash[i]);
-  }
+inline bool BufferStream::wait_readable() const { return true; }
 
-  return ss.str();
-}
+inline bool BufferStream::wait_writable() const { return true; }
 
-inline std::string MD5(const std::string &s) {
-  return message_digest(s, EVP_md5());
+inline ssize_t BufferStream::read(char *ptr, size_t size) {
+#if defined(_MSC_VER) && _MSC_VER < 1910
+  auto len_read = buffer._Copy_s(ptr, size, size, position);
+#else
+  auto len_read = buffer.copy(ptr, size, position);
+#endif
+  position += static_cast<size_t>(len_read);
+  return static_cast<ssize_t>(len_read);
 }
 
-inline std::string SHA_256(const std::string &s) {
-  return message_digest(s, EVP_sha256());
+inline ssize_t BufferStream::write(const char *ptr, size_t size) {
+  buffer.append(ptr, size);
+  return static_cast<ssize_t>(size);
 }
 
-inline std::string SHA_512(const std::string &s) {
-  return message_digest(s, EVP_sha512());
-}
+inline void BufferStream::get_remote_ip_and_port(std::string & /*ip*/,
+                                                 int & /*port*/) const {}
 
-inline std::pair<std::string, std::string> make_digest_authentication_header(
-    const Request &req, const std::map<std::string, std::string> &auth,
-    size_t cnonce_count, const std::string &cnonce, const std::string &username,
-    const std::string &password, bool is_proxy = false) {
-  std::string nc;
-  {
-    std::stringstream ss;
-    ss << std::setfill('0') << std::setw(8) << std::hex << cnonce_count;
-    nc = ss.str();
-  }
+inline void BufferStream::get_local_ip_and_port(std::string & /*ip*/,
+                                                int & /*port*/) const {}
+
+inline socket_t BufferStream::socket() const { return 0; }
+
+inline time_t BufferStream::duration() const { return 0; }
+
+inline const std::string &BufferStream::get_buffer() const { return buffer; }
+
+inline PathParamsMatcher::PathParamsMatcher(const std::string &pattern)
+    : MatcherBase(pattern) {
+  constexpr const char marker[] = "/:";
 
-  std::string qop;
-  if (auth.find("qop") != auth.end()) {
-    qop = auth.at("qop");
-    if (qop.find("auth-int") != std::string::npos) {
-      qop = "auth-int";
-    } else if (qop.find("auth") != std::string::npos) {
-      qop = "auth";
-    } else {
-      qop.clear();
-    }
-  }
+  // One past the last ending position of a path param substring
+  std::size_t last_param_end = 0;
 
-  std::string algo = "MD5";
-  if (auth.find("algorithm") != auth.end()) { algo = auth.at("algorithm"); }
+#ifndef CPPHTTPLIB_NO_EXCEPTIONS
+  // Needed to ensure that parameter names are unique during matcher
+  // construction
+  // If exceptions are disabled, only last duplicate path
+  // parameter will be set
+  std::unordered_set<std::string> param_name_set;
+#endif
 
-  std::string response;
-  {
-    auto H = algo == "SHA-256"   ? detail::SHA_256
-             : algo == "SHA-512" ? detail::SHA_512
-                                 : detail::MD5;
+  while (true) {
+    const auto marker_pos = pattern.find(
+        marker, last_param_end == 0 ? last_param_end : last_param_end - 1);
+    if (marker_pos == std::string::npos) { break; }
 
-    auto A1 = username + ":" + auth.at("realm") + ":" + password;
+    static_fragments_.push_back(
+        pattern.substr(last_param_end, marker_pos - last_param_end + 1));
 
-    auto A2 = req.method + ":" + req.path;
-    if (qop == "auth-int") { A2 += ":" + H(req.body); }
+    const auto param_name_start = marker_pos + str_len(marker);
 
-    if (qop.empty()) {
-      response = H(H(A1) + ":" + auth.at("nonce") + ":" + H(A2));
-    } else {
-      response = H(H(A1) + ":" + auth.at("nonce") + ":" + nc + ":" + cnonce +
-                   ":" + qop + ":" + H(A2));
-    }
-  }
+    auto sep_pos = pattern.find(separator, param_name_start);
+    if (sep_pos == std::string::npos) { sep_pos = pattern.length(); }
 
-  auto opaque = (auth.find("opaque") != auth.end()) ? auth.at("opaque") : "";
+    auto param_name =
+        pattern.substr(param_name_start, sep_pos - param_name_start);
 
-  auto field = "Digest username=\"" + username + "\", realm=\"" +
-               auth.at("realm") + "\", nonce=\"" + auth.at("nonce") +
-               "\", uri=\"" + req.path + "\", algorithm=" + algo +
-               (qop.empty() ? ", response=\""
-                            : ", qop=" + qop + ", nc=" + nc + ", cnonce=\"" +
-                                  cnonce + "\", response=\"") +
-               response + "\"" +
-               (opaque.empty() ? "" : ", opaque=\"" + opaque + "\"");
+#ifndef CPPHTTPLIB_NO_EXCEPTIONS
+    if (param_name_set.find(param_name) != param_name_set.cend()) {
+      std::string msg = "Encountered path parameter '" + param_name +
+                        "' multiple times in route pattern '" + pattern + "'.";
+      throw std::invalid_argument(msg);
+    }
+#endif
 
-  auto key = is_proxy ? "Proxy-Authorization" : "Authorization";
-  return std::make_pair(key, field);
-}
+    param_names_.push_back(std::move(param_name));
 
-inline bool is_ssl_peer_could_be_closed(SSL *ssl, socket_t sock) {
-  detail::set_nonblocking(sock, true);
-  auto se = detail::scope_exit([&]() { detail::set_nonblocking(sock, false); });
+    last_param_end = sep_pos + 1;
+  }
 
-  char buf[1];
-  return !SSL_peek(ssl, buf, 1) &&
-         SSL_get_error(ssl, 0) == SSL_ERROR_ZERO_RETURN;
+  if (last_param_end < pattern.length()) {
+    static_fragments_.push_back(pattern.substr(last_param_end));
+  }
 }
 
-#ifdef _WIN64
-// NOTE: This code came up with the following stackoverflow post:
-// https://stackoverflow.com/questions/9507184/can-openssl-on-windows-use-the-system-certificate-store
-inline bool load_system_certs_on_windows(X509_STORE *store) {
-  auto hStore = CertOpenSystemStoreW((HCRYPTPROV_LEGACY)NULL, L"ROOT");
-  if (!hStore) { return false; }
+inline bool PathParamsMatcher::match(Request &request) const {
+  request.matches = std::smatch();
+  request.path_params.clear();
+  request.path_params.reserve(param_names_.size());
 
-  auto result = false;
-  PCCERT_CONTEXT pContext = NULL;
-  while ((pContext = CertEnumCertificatesInStore(hStore, pContext)) !=
-         nullptr) {
-    auto encoded_cert =
-        static_cast<const unsigned char *>(pContext->pbCertEncoded);
+  // One past the position at which the path matched the pattern last time
+  std::size_t starting_pos = 0;
+  for (size_t i = 0; i < static_fragments_.size(); ++i) {
+    const auto &fragment = static_fragments_[i];
 
-    auto x509 = d2i_X509(NULL, &encoded_cert, pContext->cbCertEncoded);
-    if (x509) {
-      X509_STORE_add_cert(store, x509);
-      X509_free(x509);
-      result = true;
+    if (starting_pos + fragment.length() > request.path.length()) {
+      return false;
     }
-  }
 
-  CertFreeCertificateContext(pContext);
-  CertCloseStore(hStore, 0);
+    // Avoid unnecessary allocation by using strncmp instead of substr +
+    // comparison
+    if (std::strncmp(request.path.c_str() + starting_pos, fragment.c_str(),
+                     fragment.length()) != 0) {
+      return false;
+    }
 
-  return result;
-}
-#elif defined(CPPHTTPLIB_USE_CERTS_FROM_MACOSX_KEYCHAIN) &&                    \
-    defined(TARGET_OS_OSX)
-template <typename T>
-using CFObjectPtr =
-    std::unique_ptr<typename std::remove_pointer<T>::type, void (*)(CFTypeRef)>;
+    starting_pos += fragment.length();
 
-inline void cf_object_ptr_deleter(CFTypeRef obj) {
-  if (obj) { CFRelease(obj); }
-}
+    // Should only happen when we have a static fragment after a param
+    // Example: '/users/:id/subscriptions'
+    // The 'subscriptions' fragment here does not have a corresponding param
+    if (i >= param_names_.size()) { continue; }
 
-inline bool retrieve_certs_from_keychain(CFObjectPtr<CFArrayRef> &certs) {
-  CFStringRef keys[] = {kSecClass, kSecMatchLimit, kSecReturnRef};
-  CFTypeRef values[] = {kSecClassCertificate, kSecMatchLimitAll,
-                        kCFBooleanTrue};
+    auto sep_pos = request.path.find(separator, starting_pos);
+    if (sep_pos == std::string::npos) { sep_pos = request.path.length(); }
 
-  CFObjectPtr<CFDictionaryRef> query(
-      CFDictionaryCreate(nullptr, reinterpret_cast<const void **>(keys), values,
-                         sizeof(keys) / sizeof(keys[0]),
-                         &kCFTypeDictionaryKeyCallBacks,
-                         &kCFTypeDictionaryValueCallBacks),
-      cf_object_ptr_deleter);
+    const auto &param_name = param_names_[i];
 
-  if (!query) { return false; }
+    request.path_params.emplace(
+        param_name, request.path.substr(starting_pos, sep_pos - starting_pos));
 
-  CFTypeRef security_items = nullptr;
-  if (SecItemCopyMatching(query.get(), &security_items) != errSecSuccess ||
-      CFArrayGetTypeID() != CFGetTypeID(security_items)) {
-    return false;
+    // Mark everything up to '/' as matched
+    starting_pos = sep_pos + 1;
   }
+  // Returns false if the path is longer than the pattern
+  return starting_pos >= request.path.length();
+}
 
-  certs.reset(reinterpret_cast<CFArrayRef>(security_items));
-  return true;
+inline bool RegexMatcher::match(Request &request) const {
+  request.path_params.clear();
+  return std::regex_match(request.path, request.matches, regex_);
 }
 
-inline bool retrieve_root_certs_from_keychain(CFObjectPtr<CFArrayRef> &certs) {
-  CFArrayRef root_security_items = nullptr;
-  if (SecTrustCopyAnchorCertificates(&root_security_items) != errSecSuccess) {
-    return false;
-  }
+} // namespace detail
 
-  certs.reset(root_security_items);
-  return true;
+// HTTP server implementation
+inline Server::Server()
+    : new_task_queue(
+          [] { return new ThreadPool(CPPHTTPLIB_THREAD_POOL_COUNT); }) {
+#ifndef _WIN64
+  signal(SIGPIPE, SIG_IGN);
+#endif
 }
 
-inline bool add_certs_to_x509_store(CFArrayRef certs, X509_STORE *store) {
-  auto result = false;
-  for (auto i = 0; i < CFArrayGetCount(certs); ++i) {
-    const auto cert = reinterpret_cast<const __SecCertificate *>(
-        CFArrayGetValueAtIndex(certs, i));
-
-    if (SecCertificateGetTypeID() != CFGetTypeID(cert)) { continue; }
+inline Server::~Server() = default;
 
-    CFDataRef cert_data = nullptr;
-    if (SecItemExport(cert, kSecFormatX509Cert, 0, nullptr, &cert_data) !=
-        errSecSuccess) {
-      continue;
-    }
+inline std::unique_ptr<detail::MatcherBase>
+Server::make_matcher(const std::string &pattern) {
+  if (pattern.find("/:") != std::string::npos) {
+    return detail::make_unique<detail::PathParamsMatcher>(pattern);
+  } else {
+    return detail::make_unique<detail::RegexMatcher>(pattern);
+  }
+}
 
-    CFObjectPtr<CFDataRef> cert_data_ptr(cert_data, cf_object_ptr_deleter);
+inline Server &Server::Get(const std::string &pattern, Handler handler) {
+  get_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
+  return *this;
+}
 
-    auto encoded_cert = static_cast<const unsigned char *>(
-        CFDataGetBytePtr(cert_data_ptr.get()));
+inline Server &Server::Post(const std::string &pattern, Handler handler) {
+  post_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
+  return *this;
+}
 
-    auto x509 =
-        d2i_X509(NULL, &encoded_cert, CFDataGetLength(cert_data_ptr.get()));
+inline Server &Server::Post(const std::string &pattern,
+                            HandlerWithContentReader handler) {
+  post_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
+                                                 std::move(handler));
+  return *this;
+}
 
-    if (x509) {
-      X509_STORE_add_cert(store, x509);
-      X509_free(x509);
-      result = true;
-    }
-  }
+inline Server &Server::Put(const std::string &pattern, Handler handler) {
+  put_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
+  return *this;
+}
 
-  return result;
+inline Server &Server::Put(const std::string &pattern,
+                           HandlerWithContentReader handler) {
+  put_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
+                                                std::move(handler));
+  return *this;
 }
 
-inline bool load_system_certs_on_macos(X509_STORE *store) {
-  auto result = false;
-  CFObjectPtr<CFArrayRef> certs(nullptr, cf_object_ptr_deleter);
-  if (retrieve_certs_from_keychain(certs) && certs) {
-    result = add_certs_to_x509_store(certs.get(), store);
-  }
+inline Server &Server::Patch(const std::string &pattern, Handler handler) {
+  patch_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
+  return *this;
+}
 
-  if (retrieve_root_certs_from_keychain(certs) && certs) {
-    result = add_certs_to_x509_store(certs.get(), store) || result;
-  }
+inline Server &Server::Patch(const std::string &pattern,
+                             HandlerWithContentReader handler) {
+  patch_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
+                                                  std::move(handler));
+  return *this;
+}
 
-  return result;
+inline Server &Server::Delete(const std::string &pattern, Handler handler) {
+  delete_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
+  return *this;
 }
-#endif // _WIN64
-#endif // CPPHTTPLIB_OPENSSL_SUPPORT
 
-#ifdef _WIN64
-class WSInit {
-public:
-  WSInit() {
-    WSADATA wsaData;
-    if (WSAStartup(0x0002, &wsaData) == 0) is_valid_ = true;
-  }
+inline Server &Server::Delete(const std::string &pattern,
+                              HandlerWithContentReader handler) {
+  delete_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
+                                                   std::move(handler));
+  return *this;
+}
 
-  ~WSInit() {
-    if (is_valid_) WSACleanup();
-  }
+inline Server &Server::Options(const std::string &pattern, Handler handler) {
+  options_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
+  return *this;
+}
 
-  bool is_valid_ = false;
-};
+inline bool Server::set_base_dir(const std::string &dir,
+                                 const std::string &mount_point) {
+  return set_mount_point(mount_point, dir);
+}
 
-static WSInit wsinit_;
-#endif
+inline bool Server::set_mount_point(const std::string &mount_point,
+                                    const std::string &dir, Headers headers) {
+  return set_mount_point(mount_point, dir, std::move(headers),
+                         MountPointOptions());
+}
 
-inline bool parse_www_authenticate(const Response &res,
-                                   std::map<std::string, std::string> &auth,
-                                   bool is_proxy) {
-  auto auth_key = is_proxy ? "Proxy-Authenticate" : "WWW-Authenticate";
-  if (res.has_header(auth_key)) {
-    thread_local auto re =
-        std::regex(R"~((?:(?:,\s*)?(.+?)=(?:"(.*?)"|([^,]*))))~");
-    auto s = res.get_header_value(auth_key);
-    auto pos = s.find(' ');
-    if (pos != std::string::npos) {
-      auto type = s.substr(0, pos);
-      if (type == "Basic") {
-        return false;
-      } else if (type == "Digest") {
-        s = s.substr(pos + 1);
-        auto beg = std::sregex_iterator(s.begin(), s.end(), re);
-        for (auto i = beg; i != std::sregex_iterator(); ++i) {
-          const auto &m = *i;
-          auto key = s.substr(static_cast<size_t>(m.position(1)),
-                              static_cast<size_t>(m.length(1)));
-          auto val = m.length(2) > 0
-                         ? s.substr(static_cast<size_t>(m.position(2)),
-                                    static_cast<size_t>(m.length(2)))
-                         : s.substr(static_cast<size_t>(m.position(3)),
-                                    static_cast<size_t>(m.length(3)));
-          auth[key] = val;
-        }
-        return true;
+inline bool Server::set_mount_point(const std::string &mount_point,
+                                    const std::string &dir, Headers headers,
+                                    const MountPointOptions &options) {
+  detail::FileStat stat(dir);
+  if (stat.is_dir()) {
+    std::string mnt = !mount_point.empty() ? mount_point : "/";
+    if (!mnt.empty() && mnt[0] == '/') {
+      std::shared_ptr<detail::AssetCache> cache;
+      if (options.cache_files || options.precompress) {
+        cache = std::make_shared<detail::AssetCache>(options.precompress);
       }
+      base_dirs_.push_back({mnt, dir, std::move(headers), std::move(cache)});
+      return true;
     }
   }
   return false;
 }
 
-class ContentProviderAdapter {
-public:
-  explicit ContentProviderAdapter(
-      ContentProviderWithoutLength &&content_provider)
-      : content_provider_(content_provider) {}
-
-  bool operator()(size_t offset, size_t, DataSink &sink) {
-    return content_provider_(offset, sink);
+inline bool Server::remove_mount_point(const std::string &mount_point) {
+  for (auto it = base_dirs_.begin(); it != base_dirs_.end(); ++it) {
+    if (it->mount_point == mount_point) {
+      base_dirs_.erase(it);
+      return true;
+    }
   }
+  return false;
+}
 
-private:
-  ContentProviderWithoutLength content_provider_;
-};
-
-} // namespace detail
-
-inline std::string hosted_at(const std::string &hostname) {
-  std::vector<std::string> addrs;
-  hosted_at(hostname, addrs);
-  if (addrs.empty()) { return std::string(); }
-  return addrs[0];
+inline Server &
+Server::set_file_extension_and_mimetype_mapping(const std::string &ext,
+                                                const std::string &mime) {
+  file_extension_and_mimetype_map_[ext] = mime;
+  return *this;
 }
 
-inline void hosted_at(const std::string &hostname,
-                      std::vector<std::string> &addrs) {
-  struct addrinfo hints;
-  struct addrinfo *result;
+inline Server &Server::set_default_file_mimetype(const std::string &mime) {
+  default_file_mimetype_ = mime;
+  return *this;
+}
 
-  memset(&hints, 0, sizeof(struct addrinfo));
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = 0;
+inline Server &Server::set_file_request_handler(Handler handler) {
+  file_request_handler_ = std::move(handler);
+  return *this;
+}
 
-  if (detail::getaddrinfo_with_timeout(hostname.c_str(), nullptr, &hints,
-                                       &result, 0)) {
-#if defined __linux__ && !defined __ANDROID__
-    res_init();
-#endif
-    return;
-  }
-  auto se = detail::scope_exit([&] { freeaddrinfo(result); });
+inline Server &Server::set_error_handler_core(HandlerWithResponse handler,
+                                              std::true_type) {
+  error_handler_ = std::move(handler);
+  return *this;
+}
 
-  for (auto rp = result; rp; rp = rp->ai_next) {
-    const auto &addr =
-        *reinterpret_cast<struct sockaddr_storage *>(rp->ai_addr);
-    std::string ip;
-    auto dummy = -1;
-    if (detail::get_ip_and_port(addr, sizeof(struct sockaddr_storage), ip,
-                                dummy)) {
-      addrs.push_back(ip);
-    }
-  }
+inline Server &Server::set_error_handler_core(Handler handler,
+                                              std::false_type) {
+  error_handler_ = [handler](const Request &req, Response &res) {
+    handler(req, res);
+    return HandlerResponse::Handled;
+  };
+  return *this;
 }
 
-inline std::string encode_uri_component(const std::string &value) {
-  std::ostringstream escaped;
-  escaped.fill('0');
-  escaped << std::hex;
+inline Server &Server::set_exception_handler(ExceptionHandler handler) {
+  exception_handler_ = std::move(handler);
+  return *this;
+}
 
-  for (auto c : value) {
-    if (std::isalnum(static_cast<uint8_t>(c)) || c == '-' || c == '_' ||
-        c == '.' || c == '!' || c == '~' || c == '*' || c == '\'' || c == '(' ||
-        c == ')') {
-      escaped << c;
-    } else {
-      escaped << std::uppercase;
-      escaped << '%' << std::setw(2)
-              << static_cast<int>(static_cast<unsigned char>(c));
-      escaped << std::nouppercase;
-    }
-  }
+inline Server &Server::set_pre_routing_handler(HandlerWithResponse handler) {
+  pre_routing_handler_ = std::move(handler);
+  return *this;
+}
 
-  return escaped.str();
+inline Server &Server::set_post_routing_handler(Handler handler) {
+  post_routing_handler_ = std::move(handler);
+  return *this;
 }
 
-inline std::string encode_uri(const std::string &value) {
-  std::ostringstream escaped;
-  escaped.fill('0');
-  escaped << std::hex;
+inline Server &Server::set_pre_request_handler(HandlerWithResponse handler) {
+  pre_request_handler_ = std::move(handler);
+  return *this;
+}
 
-  for (auto c : value) {
-    if (std::isalnum(static_cast<uint8_t>(c)) || c == '-' || c == '_' ||
-        c == '.' || c == '!' || c == '~' || c == '*' || c == '\'' || c == '(' ||
-        c == ')' || c == ';' || c == '/' || c == '?' || c == ':' || c == '@' ||
-        c == '&' || c == '=' || c == '+' || c == '$' || c == ',' || c == '#') {
-      escaped << c;
-    } else {
-      escaped << std::uppercase;
-      escaped << '%' << std::setw(2)
-              << static_cast<int>(static_cast<unsigned char>(c));
-      escaped << std::nouppercase;
-    }
-  }
+inline Server &Server::set_logger(Logger logger) {
+  logger_ = std::move(logger);
+  return *this;
+}
 
-  return escaped.str();
+inline Server &Server::set_pre_compression_logger(Logger logger) {
+  pre_compression_logger_ = std::move(logger);
+  return *this;
 }
 
-inline std::string decode_uri_component(const std::string &value) {
-  std::string result;
+inline Server &
+Server::set_expect_100_continue_handler(Expect100ContinueHandler handler) {
+  expect_100_continue_handler_ = std::move(handler);
+  return *this;
+}
 
-  for (size_t i = 0; i < value.size(); i++) {
-    if (value[i] == '%' && i + 2 < value.size()) {
-      auto val = 0;
-      if (detail::from_hex_to_i(value, i + 1, 2, val)) {
-        result += static_cast<char>(val);
-        i += 2;
-      } else {
-        result += value[i];
-      }
-    } else {
-      result += value[i];
-    }
-  }
+inline Server &Server::set_address_family(int family) {
+  address_family_ = family;
+  return *this;
+}
 
-  return result;
+inline Server &Server::set_tcp_nodelay(bool on) {
+  tcp_nodelay_ = on;
+  return *this;
 }
 
-inline std::string decode_uri(const std::string &value) {
-  std::string result;
+inline Server &Server::set_ipv6_v6only(bool on) {
+  ipv6_v6only_ = on;
+  return *this;
+}
 
-  for (size_t i = 0; i < value.size(); i++) {
-    if (value[i] == '%' && i + 2 < value.size()) {
-      auto val = 0;
-      if (detail::from_hex_to_i(value, i + 1, 2, val)) {
-        result += static_cast<char>(val);
-        i += 2;
-      } else {
-        result += value[i];
-      }
-    } else {
-      result += value[i];
-    }
-  }
+inline Server &Server::set_socket_options(SocketOptions socket_options) {
+  socket_options_ = std::move(socket_options);
+  return *this;
+}
 
-  return result;
+inline Server &Server::set_default_headers(Headers headers) {
+  default_headers_ = std::move(headers);
+  return *this;
 }
 
-[[deprecated("Use encode_uri_component instead")]]
-inline std::string encode_query_param(const std::string &value) {
-  return encode_uri_component(value);
+inline Server &Server::set_header_writer(
+    std::function<ssize_t(Stream &, Headers &)> const &writer) {
+  header_writer_ = writer;
+  return *this;
 }
 
-inline std::string append_query_params(const std::string &path,
-                                       const Params &params) {
-  std::string path_with_query = path;
-  thread_local const std::regex re("[^?]+\\?.*");
-  auto delm = std::regex_match(path, re) ? '&' : '?';
-  path_with_query += delm + detail::params_to_query_str(params);
-  return path_with_query;
+inline Server &Server::set_keep_alive_max_count(size_t count) {
+  keep_alive_max_count_ = count;
+  return *this;
 }
 
-// Header utilities
-inline std::pair<std::string, std::string>
-make_range_header(const Ranges &ranges) {
-  std::string field = "bytes=";
-  auto i = 0;
-  for (const auto &r : ranges) {
-    if (i != 0) { field += ", "; }
-    if (r.first != -1) { field += std::to_string(r.first); }
-    field += '-';
-    if (r.second != -1) { field += std::to_string(r.second); }
-    i++;
-  }
-  return std::make_pair("Range", std::move(field));
+inline Server &Server::set_keep_alive_timeout(time_t sec) {
+  keep_alive_timeout_sec_ = sec;
+  return *this;
 }
 
-inline std::pair<std::string, std::string>
-make_basic_authentication_header(const std::string &username,
-                                 const std::string &password, bool is_proxy) {
-  auto field = "Basic " + detail::base64_encode(username + ":" + password);
-  auto key = is_proxy ? "Proxy-Authorization" : "Authorization";
-  return std::make_pair(key, std::move(field));
+inline Server &Server::set_read_timeout(time_t sec, time_t usec) {
+  read_timeout_sec_ = sec;
+  read_timeout_usec_ = usec;
+  return *this;
 }
 
-inline std::pair<std::string, std::string>
-make_bearer_token_authentication_header(const std::string &token,
-                                        bool is_proxy = false) {
-  auto field = "Bearer " + token;
-  auto key = is_proxy ? "Proxy-Authorization" : "Authorization";
-  return std::make_pair(key, std::move(field));
+inline Server &Server::set_write_timeout(time_t sec, time_t usec) {
+  write_timeout_sec_ = sec;
+  write_timeout_usec_ = usec;
+  return *this;
 }
 
-// Request implementation
-inline bool Request::has_header(const std::string &key) const {
-  return detail::has_header(headers, key);
+inline Server &Server::set_idle_interval(time_t sec, time_t usec) {
+  idle_interval_sec_ = sec;
+  idle_interval_usec_ = usec;
+  return *this;
 }
 
-inline std::string Request::get_header_value(const std::string &key,
-                                             const char *def, size_t id) const {
-  return detail::get_header_value(headers, key, def, id);
+inline Server &Server::set_payload_max_length(size_t length) {
+  payload_max_length_ = length;
+  return *this;
 }
 
-inline size_t Request::get_header_value_count(const std::string &key) const {
-  auto r = headers.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline Server &Server::set_metrics_endpoint(const std::string &path) {
+  if (!metrics_) { metrics_ = detail::make_unique<detail::ServerMetrics>(); }
+  Get(path, [this](const Request &, Response &res) {
+    res.set_content(metrics_text(), "text/plain; version=0.0.4");
+  });
+  return *this;
 }
 
-inline void Request::set_header(const std::string &key,
-                                const std::string &val) {
-  if (detail::fields::is_field_name(key) &&
-      detail::fields::is_field_value(val)) {
-    headers.emplace(key, val);
+#ifdef CPPHTTPLIB_LOCK_PROFILING
+inline Mutex::Mutex(const char *name)
+    : stats_(detail::LockRegistry::instance().stats(name)) {}
+
+inline void Mutex::lock(const char *file, int line) {
+  if (!mutex_.try_lock()) {
+    auto start = std::chrono::steady_clock::now();
+    mutex_.lock();
+    stats_->record_wait(file, line, std::chrono::steady_clock::now() - start);
   }
+  stats_->acquisitions.fetch_add(1, std::memory_order_relaxed);
 }
 
-inline bool Request::has_trailer(const std::string &key) const {
-  return trailers.find(key) != trailers.end();
+inline bool Mutex::try_lock() {
+  if (!mutex_.try_lock()) { return false; }
+  stats_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+  return true;
 }
 
-inline std::string Request::get_trailer_value(const std::string &key,
-                                              size_t id) const {
-  auto rng = trailers.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) { return it->second; }
-  return std::string();
+inline std::string lock_profile() {
+  return detail::LockRegistry::instance().report();
 }
+#else
+inline std::string lock_profile() { return std::string(); }
+#endif
 
-inline size_t Request::get_trailer_value_count(const std::string &key) const {
-  auto r = trailers.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline MemoryTag &MemoryTag::get(const std::string &name) {
+  return detail::MemoryRegistry::instance().tag(name);
 }
 
-inline bool Request::has_param(const std::string &key) const {
-  return params.find(key) != params.end();
+inline std::string memory_profile(int64_t units) {
+  return detail::MemoryRegistry::instance().report(units);
 }
 
-inline std::string Request::get_param_value(const std::string &key,
-                                            size_t id) const {
-  auto rng = params.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) { return it->second; }
-  return std::string();
+inline TraceScope::TraceScope(const char *name)
+    : name_(name), active_(detail::trace_context().active()) {
+  if (active_) { start_ = std::chrono::steady_clock::now(); }
 }
 
-inline size_t Request::get_param_value_count(const std::string &key) const {
-  auto r = params.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline TraceScope::~TraceScope() {
+  if (active_) {
+    detail::trace_context().record(name_, start_,
+                                   std::chrono::steady_clock::now());
+  }
 }
 
-inline bool Request::is_multipart_form_data() const {
-  const auto &content_type = get_header_value("Content-Type");
-  return !content_type.rfind("multipart/form-data", 0);
+inline void annotate_request(const std::string &key, const std::string &value) {
+  auto stages = detail::trace_context().stages;
+  if (stages) { stages->fields.emplace_back(key, value); }
 }
 
-// Multipart FormData implementation
-inline std::string MultipartFormData::get_field(const std::string &key,
-                                                size_t id) const {
-  auto rng = fields.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) { return it->second.content; }
-  return std::string();
-}
+inline bool Server::set_slow_request_log(const std::string &path,
+                                         const SlowRequestLogOptions &options) {
+  slow_log_.reset();
+  if (path.empty()) { return true; }
 
-inline std::vector<std::string>
-MultipartFormData::get_fields(const std::string &key) const {
-  std::vector<std::string> values;
-  auto rng = fields.equal_range(key);
-  for (auto it = rng.first; it != rng.second; it++) {
-    values.push_back(it->second.content);
-  }
-  return values;
+  auto fp = std::fopen(path.c_str(), "ab");
+  if (!fp) { return false; }
+  slow_log_ = detail::make_unique<detail::SlowRequestLog>(fp, options);
+  return true;
 }
 
-inline bool MultipartFormData::has_field(const std::string &key) const {
-  return fields.find(key) != fields.end();
+inline bool Server::set_request_recording(const std::string &path) {
+  recorder_.reset();
+  if (path.empty()) { return true; }
+
+  auto fp = std::fopen(path.c_str(), "wb");
+  if (!fp) { return false; }
+  recorder_ = detail::make_unique<detail::RequestRecorder>(fp);
+  return true;
 }
 
-inline size_t MultipartFormData::get_field_count(const std::string &key) const {
-  auto r = fields.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline Server &Server::set_memory_endpoint(const std::string &path) {
+  Get(path, [](const Request &req, Response &res) {
+    // ?units=N, or the product of ?trains=&days=&seats= for a booking horizon
+    int64_t units = 0;
+    if (req.has_param("units")) {
+      units = std::atoll(req.get_param_value("units").c_str());
+    } else {
+      for (const auto &key : {"trains", "days", "seats"}) {
+        if (req.has_param(key)) {
+          units = (units ? units : 1) *
+                  std::atoll(req.get_param_value(key).c_str());
+        }
+      }
+    }
+    res.set_content(memory_profile(units), "text/plain");
+  });
+  return *this;
 }
 
-inline FormData MultipartFormData::get_file(const std::string &key,
-                                            size_t id) const {
-  auto rng = files.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) { return it->second; }
-  return FormData();
+inline Server &Server::set_lock_profile_endpoint(const std::string &path) {
+  Get(path, [](const Request &, Response &res) {
+#ifdef CPPHTTPLIB_LOCK_PROFILING
+    res.set_content(lock_profile(), "text/plain");
+#else
+    res.set_content("Lock profiling is off; build with "
+                    "CPPHTTPLIB_LOCK_PROFILING to enable it.\n",
+                    "text/plain");
+#endif
+  });
+  return *this;
 }
 
-inline std::vector<FormData>
-MultipartFormData::get_files(const std::string &key) const {
-  std::vector<FormData> values;
-  auto rng = files.equal_range(key);
-  for (auto it = rng.first; it != rng.second; it++) {
-    values.push_back(it->second);
+inline Server &Server::set_tracing(bool on, size_t events_per_thread) {
+  if (!tracer_) {
+    tracer_ = detail::make_unique<detail::StageTracer>(events_per_thread);
   }
-  return values;
+  tracer_->set_enabled(on);
+  return *this;
 }
 
-inline bool MultipartFormData::has_file(const std::string &key) const {
-  return files.find(key) != files.end();
+// `seconds=N` returns the last N seconds of the buffer when tracing is on.
+// When it is off, tracing is switched on for N seconds (at most
+// CPPHTTPLIB_TRACE_CAPTURE_MAX_SECOND, as the wait holds a worker) and that
+// window is returned. A capture requested while another runs gets 409.
+inline Server &Server::set_trace_endpoint(const std::string &path) {
+  if (!tracer_) { set_tracing(false); }
+  Get(path, [this](const Request &req, Response &res) {
+    time_t seconds = 5;
+    if (req.has_param("seconds")) {
+      seconds = static_cast<time_t>(
+          std::strtol(req.get_param_value("seconds").c_str(), nullptr, 10));
+    }
+    seconds = (std::max)(
+        static_cast<time_t>(1),
+        (std::min)(seconds,
+                   static_cast<time_t>(CPPHTTPLIB_TRACE_CAPTURE_MAX_SECOND)));
+
+    // Tracing is only on because of a running capture, if one is running
+    if (!tracer_->enabled() || trace_capturing_) {
+      if (trace_capturing_.exchange(true)) {
+        res.status = StatusCode::Conflict_409;
+        res.set_content("A trace capture is already running\n", "text/plain");
+        return;
+      }
+      tracer_->set_enabled(true);
+      std::this_thread::sleep_for(std::chrono::seconds(seconds));
+      tracer_->set_enabled(false);
+      trace_capturing_ = false;
+    }
+    res.set_content(trace_json(seconds), "application/json");
+  });
+  return *this;
 }
 
-inline size_t MultipartFormData::get_file_count(const std::string &key) const {
-  auto r = files.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline std::string Server::trace_json(time_t seconds) const {
+  if (!tracer_) { return "{\"traceEvents\":[]}"; }
+  return tracer_->to_json(std::chrono::steady_clock::now() -
+                          std::chrono::seconds(seconds));
 }
 
-// Response implementation
-inline bool Response::has_header(const std::string &key) const {
-  return headers.find(key) != headers.end();
+inline std::string Server::metrics_text() const {
+  if (!metrics_) { return std::string(); }
+
+  std::string extra;
+  auto line = [&](const std::string &name, const std::string &labels,
+                  uint64_t value) {
+    extra += name;
+    if (!labels.empty()) { extra += "{" + labels + "}"; }
+    extra += " " + std::to_string(value) + "\n";
+  };
+
+  auto cs = compression_stats();
+  extra += "# TYPE httplib_compression_responses_total counter\n";
+  line("httplib_compression_responses_total", "result=\"compressed\"",
+       cs.compressed);
+  line("httplib_compression_responses_total", "result=\"skipped\"",
+       cs.skipped);
+  extra += "# TYPE httplib_compression_saved_bytes_total counter\n";
+  line("httplib_compression_saved_bytes_total", "", cs.bytes_saved());
+  extra += "# TYPE httplib_compression_cpu_nanoseconds_total counter\n";
+  line("httplib_compression_cpu_nanoseconds_total", "", cs.cpu_ns);
+
+  auto as = admission_stats();
+  if (!as.empty()) {
+    extra += "# TYPE httplib_admission_requests_total counter\n";
+    for (const auto &c : as) {
+      auto cls = "class=\"" + c.name + "\"";
+      line("httplib_admission_requests_total", cls + ",result=\"admitted\"",
+           c.admitted);
+      line("httplib_admission_requests_total", cls + ",result=\"shed\"",
+           c.shed);
+    }
+    extra += "# TYPE httplib_admission_queued gauge\n";
+    for (const auto &c : as) {
+      line("httplib_admission_queued", "class=\"" + c.name + "\"", c.queued);
+    }
+  }
+
+  return metrics_->render(extra);
 }
 
-inline std::string Response::get_header_value(const std::string &key,
-                                              const char *def,
-                                              size_t id) const {
-  return detail::get_header_value(headers, key, def, id);
+inline Server &Server::set_admission_control(AdmissionControl config) {
+  admission_ = detail::make_unique<detail::AdmissionController>(
+      std::move(config));
+  return *this;
 }
 
-inline size_t Response::get_header_value_count(const std::string &key) const {
-  auto r = headers.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline std::vector<AdmissionClassStats> Server::admission_stats() const {
+  return admission_ ? admission_->stats() : std::vector<AdmissionClassStats>();
 }
 
-inline void Response::set_header(const std::string &key,
-                                 const std::string &val) {
-  if (detail::fields::is_field_name(key) &&
-      detail::fields::is_field_value(val)) {
-    headers.emplace(key, val);
-  }
+inline Server &Server::set_compression_policy(CompressionPolicy policy) {
+  default_compression_policy_ = std::move(policy);
+  return *this;
 }
-inline bool Response::has_trailer(const std::string &key) const {
-  return trailers.find(key) != trailers.end();
+
+inline Server &Server::set_compression_policy(const std::string &pattern,
+                                              CompressionPolicy policy) {
+  compression_policies_[pattern] = std::move(policy);
+  return *this;
 }
 
-inline std::string Response::get_trailer_value(const std::string &key,
-                                               size_t id) const {
-  auto rng = trailers.equal_range(key);
-  auto it = rng.first;
-  std::advance(it, static_cast<ssize_t>(id));
-  if (it != rng.second) { return it->second; }
-  return std::string();
+inline CompressionStats Server::compression_stats() const {
+  return compression_stats_.load();
 }
 
-inline size_t Response::get_trailer_value_count(const std::string &key) const {
-  auto r = trailers.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+inline CompressionStats
+Server::compression_stats(const std::string &pattern) const {
+  auto table = compression_routes_.load(std::memory_order_acquire);
+  if (!table) { return CompressionStats(); }
+  auto it = table->find(pattern);
+  return it != table->end() ? it->second->stats.load() : CompressionStats();
 }
 
-inline void Response::set_redirect(const std::string &url, int stat) {
-  if (detail::fields::is_field_value(url)) {
-    set_header("Location", url);
-    if (300 <= stat && stat < 400) {
-      this->status = stat;
-    } else {
-      this->status = StatusCode::Found_302;
-    }
-  }
+inline bool Server::bind_to_port(const std::string &host, int port,
+                                 int socket_flags) {
+  auto ret = bind_internal(host, port, socket_flags);
+  if (ret == -1) { is_decommissioned = true; }
+  return ret >= 0;
+}
+inline int Server::bind_to_any_port(const std::string &host, int socket_flags) {
+  auto ret = bind_internal(host, 0, socket_flags);
+  if (ret == -1) { is_decommissioned = true; }
+  return ret;
 }
 
-inline void Response::set_content(const char *s, size_t n,
-                                  const std::string &content_type) {
-  body.assign(s, n);
+inline bool Server::listen_after_bind() { return listen_internal(); }
 
-  auto rng = headers.equal_range("Content-Type");
-  headers.erase(rng.first, rng.second);
-  set_header("Content-Type", content_type);
+inline bool Server::listen(const std::string &host, int port,
+                           int socket_flags) {
+  return bind_to_port(host, port, socket_flags) && listen_internal();
+}
+
+inline bool Server::is_running() const { return is_running_; }
+
+inline void Server::wait_until_ready() const {
+  while (!is_running_ && !is_decommissioned) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+}
+
+inline void Server::stop() {
+  if (is_running_) {
+    assert(svr_sock_ != INVALID_SOCKET);
+    std::atomic<socket_t> sock(svr_sock_.exchange(INVALID_SOCKET));
+    detail::shutdown_socket(sock);
+    detail::close_socket(sock);
+  }
+  is_decommissioned = false;
 }
 
-inline void Response::set_content(const std::string &s,
-                                  const std::string &content_type) {
-  set_content(s.data(), s.size(), content_type);
-}
+inline void Server::decommission() { is_decommissioned = true; }
 
-inline void Response::set_content(std::string &&s,
-                                  const std::string &content_type) {
-  body = std::move(s);
+inline bool Server::parse_request_line(const char *s, Request &req) const {
+  auto len = strlen(s);
+  if (len < 2 || s[len - 2] != '\r' || s[len - 1] != '\n') { return false; }
+  len -= 2;
 
-  auto rng = headers.equal_range("Content-Type");
-  headers.erase(rng.first, rng.second);
-  set_header("Content-Type", content_type);
-}
+  {
+    size_t count = 0;
 
-inline void Response::set_content_provider(
-    size_t in_length, const std::string &content_type, ContentProvider provider,
-    ContentProviderResourceReleaser resource_releaser) {
-  set_header("Content-Type", content_type);
-  content_length_ = in_length;
-  if (in_length > 0) { content_provider_ = std::move(provider); }
-  content_provider_resource_releaser_ = std::move(resource_releaser);
-  is_chunked_content_provider_ = false;
-}
+    detail::split(s, s + len, ' ', [&](const char *b, const char *e) {
+      switch (count) {
+      case 0: req.method = std::string(b, e); break;
+      case 1: req.target = std::string(b, e); break;
+      case 2: req.version = std::string(b, e); break;
+      default: break;
+      }
+      count++;
+    });
 
-inline void Response::set_content_provider(
-    const std::string &content_type, ContentProviderWithoutLength provider,
-    ContentProviderResourceReleaser resource_releaser) {
-  set_header("Content-Type", content_type);
-  content_length_ = 0;
-  content_provider_ = detail::ContentProviderAdapter(std::move(provider));
-  content_provider_resource_releaser_ = std::move(resource_releaser);
-  is_chunked_content_provider_ = false;
-}
+    if (count != 3) { return false; }
+  }
 
-inline void Response::set_chunked_content_provider(
-    const std::string &content_type, ContentProviderWithoutLength provider,
-    ContentProviderResourceReleaser resource_releaser) {
-  set_header("Content-Type", content_type);
-  content_length_ = 0;
-  content_provider_ = detail::ContentProviderAdapter(std::move(provider));
-  content_provider_resource_releaser_ = std::move(resource_releaser);
-  is_chunked_content_provider_ = true;
-}
+  thread_local const std::set<std::string> methods{
+      "GET",     "HEAD",    "POST",  "PUT",   "DELETE",
+      "CONNECT", "OPTIONS", "TRACE", "PATCH", "PRI"};
 
-inline void Response::set_file_content(const std::string &path,
-                                       const std::string &content_type) {
-  file_content_path_ = path;
-  file_content_content_type_ = content_type;
-}
+  if (methods.find(req.method) == methods.end()) { return false; }
 
-inline void Response::set_file_content(const std::string &path) {
-  file_content_path_ = path;
-}
+  if (req.version != "HTTP/1.1" && req.version != "HTTP/1.0") { return false; }
 
-// Result implementation
-inline bool Result::has_request_header(const std::string &key) const {
-  return request_headers_.find(key) != request_headers_.end();
-}
+  {
+    // Skip URL fragment
+    for (size_t i = 0; i < req.target.size(); i++) {
+      if (req.target[i] == '#') {
+        req.target.erase(i);
+        break;
+      }
+    }
 
-inline std::string Result::get_request_header_value(const std::string &key,
-                                                    const char *def,
-                                                    size_t id) const {
-  return detail::get_header_value(request_headers_, key, def, id);
-}
+    detail::divide(req.target, '?',
+                   [&](const char *lhs_data, std::size_t lhs_size,
+                       const char *rhs_data, std::size_t rhs_size) {
+                     req.path = detail::decode_path(
+                         std::string(lhs_data, lhs_size), false);
+                     detail::parse_query_text(rhs_data, rhs_size, req.params);
+                   });
+  }
 
-inline size_t
-Result::get_request_header_value_count(const std::string &key) const {
-  auto r = request_headers_.equal_range(key);
-  return static_cast<size_t>(std::distance(r.first, r.second));
+  return true;
 }
 
-// Stream implementation
-inline ssize_t Stream::write(const char *ptr) {
-  return write(ptr, strlen(ptr));
+inline bool Server::write_response(Stream &strm, bool close_connection,
+                                   Request &req, Response &res) {
+  // NOTE: `req.ranges` should be empty, otherwise it will be applied
+  // incorrectly to the error content.
+  req.ranges.clear();
+  return write_response_core(strm, close_connection, req, res, false);
 }
 
-inline ssize_t Stream::write(const std::string &s) {
-  return write(s.data(), s.size());
+inline bool Server::write_response_with_content(Stream &strm,
+                                                bool close_connection,
+                                                const Request &req,
+                                                Response &res) {
+  return write_response_core(strm, close_connection, req, res, true);
 }
 
-namespace detail {
+inline bool Server::write_response_core(Stream &strm, bool close_connection,
+                                        const Request &req, Response &res,
+                                        bool need_apply_ranges) {
+  assert(res.status != -1);
 
-inline void calc_actual_timeout(time_t max_timeout_msec, time_t duration_msec,
-                                time_t timeout_sec, time_t timeout_usec,
-                                time_t &actual_timeout_sec,
-                                time_t &actual_timeout_usec) {
-  auto timeout_msec = (timeout_sec * 1000) + (timeout_usec / 1000);
+  if (400 <= res.status && error_handler_ &&
+      error_handler_(req, res) == HandlerResponse::Handled) {
+    need_apply_ranges = true;
+  }
 
-  auto actual_timeout_msec =
-      (std::min)(max_timeout_msec - duration_msec, timeout_msec);
+  std::string content_type;
+  std::string boundary;
+  if (need_apply_ranges) {
+    TraceScope trace("prepare_body");
+    apply_ranges(req, res, content_type, boundary);
+  }
 
-  if (actual_timeout_msec < 0) { actual_timeout_msec = 0; }
+  // Prepare additional headers
+  if (close_connection || req.get_header_value("Connection") == "close") {
+    res.set_header("Connection", "close");
+  } else {
+    std::string s = "timeout=";
+    s += std::to_string(keep_alive_timeout_sec_);
+    s += ", max=";
+    s += std::to_string(keep_alive_max_count_);
+    res.set_header("Keep-Alive", s);
+  }
 
-  actual_timeout_sec = actual_timeout_msec / 1000;
-  actual_timeout_usec = (actual_timeout_msec % 1000) * 1000;
-}
+  if ((!res.body.empty() || res.content_length_ > 0 || res.content_provider_) &&
+      !res.has_header("Content-Type")) {
+    res.set_header("Content-Type", "text/plain");
+  }
 
-// Socket stream implementation
-inline SocketStream::SocketStream(
-    socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
-    time_t write_timeout_sec, time_t write_timeout_usec,
-    time_t max_timeout_msec,
-    std::chrono::time_point<std::chrono::steady_clock> start_time)
-    : sock_(sock), read_timeout_sec_(read_timeout_sec),
-      read_timeout_usec_(read_timeout_usec),
-      write_timeout_sec_(write_timeout_sec),
-      write_timeout_usec_(write_timeout_usec),
-      max_timeout_msec_(max_timeout_msec), start_time_(start_time),
-      read_buff_(read_buff_size_, 0) {}
+  if (res.body.empty() && !res.content_length_ && !res.content_provider_ &&
+      !res.has_header("Content-Length")) {
+    res.set_header("Content-Length", "0");
+  }
 
-inline SocketStream::~SocketStream() = default;
+  if (req.method == "HEAD" && !res.has_header("Accept-Ranges")) {
+    res.set_header("Accept-Ranges", "bytes");
+  }
 
-inline bool SocketStream::is_readable() const {
-  return read_buff_off_ < read_buff_content_size_;
-}
+  if (post_routing_handler_) { post_routing_handler_(req, res); }
 
-inline bool SocketStream::wait_readable() const {
-  if (max_timeout_msec_ <= 0) {
-    return select_read(sock_, read_timeout_sec_, read_timeout_usec_) > 0;
+  TraceScope trace("write");
+
+  // Response line and headers
+  {
+    detail::BufferStream bstrm;
+    if (!detail::write_response_line(bstrm, res.status)) { return false; }
+    if (!header_writer_(bstrm, res.headers)) { return false; }
+
+    // Flush buffer
+    auto &data = bstrm.get_buffer();
+    detail::write_data(strm, data.data(), data.size());
   }
 
-  time_t read_timeout_sec;
-  time_t read_timeout_usec;
-  calc_actual_timeout(max_timeout_msec_, duration(), read_timeout_sec_,
-                      read_timeout_usec_, read_timeout_sec, read_timeout_usec);
+  // Body
+  auto ret = true;
+  if (req.method != "HEAD") {
+    if (!res.body.empty()) {
+      if (!detail::write_data(strm, res.body.data(), res.body.size())) {
+        ret = false;
+      }
+    } else if (res.content_provider_) {
+      // Content without a known length is streamed, so it goes out as it is
+      // produced
+      auto streamed = res.content_length_ == 0;
+      auto batching = streamed && strm.write_batching();
+      // The status line and headers may still be buffered; if they cannot be
+      // sent the body must not follow them
+      if (batching && !strm.set_write_batching(false)) { return false; }
+      if (write_content_with_provider(strm, req, res, boundary, content_type)) {
+        res.content_provider_success_ = true;
+      } else {
+        ret = false;
+      }
+      if (batching) { strm.set_write_batching(true); }
+    }
+  }
 
-  return select_read(sock_, read_timeout_sec, read_timeout_usec) > 0;
-}
+  // Log
+  if (logger_) { logger_(req, res); }
 
-inline bool SocketStream::wait_writable() const {
-  return select_write(sock_, write_timeout_sec_, write_timeout_usec_) > 0 &&
-         is_socket_alive(sock_);
+  if (metrics_) {
+    metrics_->record_request(
+        req, res.status,
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - req.start_time_)
+                .count()));
+  }
+
+  return ret;
 }
 
-inline ssize_t SocketStream::read(char *ptr, size_t size) {
-#ifdef _WIN64
-  size =
-      (std::min)(size, static_cast<size_t>((std::numeric_limits<int>::max)()));
-#else
-  size = (std::min)(size,
-                    static_cast<size_t>((std::numeric_limits<ssize_t>::max)()));
-#endif
+inline bool
+Server::write_content_with_provider(Stream &strm, const Request &req,
+                                    Response &res, const std::string &boundary,
+                                    const std::string &content_type) {
+  auto is_shutting_down = [this]() {
+    return this->svr_sock_ == INVALID_SOCKET;
+  };
 
-  if (read_buff_off_ < read_buff_content_size_) {
-    auto remaining_size = read_buff_content_size_ - read_buff_off_;
-    if (size <= remaining_size) {
-      memcpy(ptr, read_buff_.data() + read_buff_off_, size);
-      read_buff_off_ += size;
-      return static_cast<ssize_t>(size);
-    } else {
-      memcpy(ptr, read_buff_.data() + read_buff_off_, remaining_size);
-      read_buff_off_ += remaining_size;
-      return static_cast<ssize_t>(remaining_size);
+  if (res.content_length_ > 0) {
+    auto use_sendfile = res.content_fd_ != -1 && strm.can_send_file();
+
+    if (req.ranges.empty()) {
+      if (use_sendfile) {
+        return detail::write_file_content(strm, res.content_fd_, 0,
+                                          res.content_length_,
+                                          is_shutting_down);
+      }
+      return detail::write_content(strm, res.content_provider_, 0,
+                                   res.content_length_, is_shutting_down);
+    } else if (req.ranges.size() == 1) {
+      auto offset_and_length = detail::get_range_offset_and_length(
+          req.ranges[0], res.content_length_);
+
+      if (use_sendfile) {
+        return detail::write_file_content(
+            strm, res.content_fd_, offset_and_length.first,
+            offset_and_length.second, is_shutting_down);
+      }
+      return detail::write_content(strm, res.content_provider_,
+                                   offset_and_length.first,
+                                   offset_and_length.second, is_shutting_down);
+    } else {
+      return detail::write_multipart_ranges_data(
+          strm, req, res, boundary, content_type, res.content_length_,
+          is_shutting_down);
     }
-  }
-
-  if (!wait_readable()) { return -1; }
+  } else {
+    if (res.is_chunked_content_provider_) {
+      // The coding was chosen when the headers were prepared
+      auto type = detail::encoding_from_name(
+          res.get_header_value("Content-Encoding"));
+
+      if (type == detail::EncodingType::None) {
+        detail::nocompressor compressor;
+        return detail::write_content_chunked(strm, res.content_provider_,
+                                             is_shutting_down, compressor);
+      }
 
-  read_buff_off_ = 0;
-  read_buff_content_size_ = 0;
+      auto level = res.compression_level_;
+      auto compressor = detail::thread_local_compressor(type, level);
+      if (!compressor) { return false; }
 
-  if (size < read_buff_size_) {
-    auto n = read_socket(sock_, read_buff_.data(), read_buff_size_,
-                         CPPHTTPLIB_RECV_FLAGS);
-    if (n <= 0) {
-      return n;
-    } else if (n <= static_cast<ssize_t>(size)) {
-      memcpy(ptr, read_buff_.data(), static_cast<size_t>(n));
-      return n;
+      detail::measured_compressor measured(*compressor);
+      auto ret = detail::write_content_chunked(strm, res.content_provider_,
+                                               is_shutting_down, measured);
+      record_compression(req, type, level, measured.bytes_in,
+                         measured.bytes_out, measured.cpu_ns);
+      return ret;
     } else {
-      memcpy(ptr, read_buff_.data(), size);
-      read_buff_off_ = size;
-      read_buff_content_size_ = static_cast<size_t>(n);
-      return static_cast<ssize_t>(size);
+      return detail::write_content_without_length(strm, res.content_provider_,
+                                                  is_shutting_down);
     }
-  } else {
-    return read_socket(sock_, ptr, size, CPPHTTPLIB_RECV_FLAGS);
   }
 }
 
-inline ssize_t SocketStream::write(const char *ptr, size_t size) {
-  if (!wait_writable()) { return -1; }
-
-#if defined(_WIN64) && !defined(_WIN64)
-  size =
-      (std::min)(size, static_cast<size_t>((std::numeric_limits<int>::max)()));
-#endif
+inline detail::EncodingType
+Server::choose_encoding(const Request &req, const Response &res, bool streamed,
+                        size_t size, int &level) const {
+  if (!detail::can_compress_content_type(res.get_header_value("Content-Type"))) {
+    return detail::EncodingType::None;
+  }
 
-  return send_socket(sock_, ptr, size, CPPHTTPLIB_SEND_FLAGS);
-}
+  auto it = compression_policies_.find(req.matched_route);
+  const auto &policy = it != compression_policies_.end()
+                           ? it->second
+                           : default_compression_policy_;
+  const auto &accept_encoding = req.get_header_value("Accept-Encoding");
 
-inline void SocketStream::get_remote_ip_and_port(std::string &ip,
-                                                 int &port) const {
-  return detail::get_remote_ip_and_port(sock_, ip, port);
-}
+  auto &route = compression_route(req.matched_route);
 
-inline void SocketStream::get_local_ip_and_port(std::string &ip,
-                                                int &port) const {
-  return detail::get_local_ip_and_port(sock_, ip, port);
-}
+  auto skip = [&]() {
+    route.stats.skipped.fetch_add(1, std::memory_order_relaxed);
+    compression_stats_.skipped.fetch_add(1, std::memory_order_relaxed);
+    return detail::EncodingType::None;
+  };
 
-inline socket_t SocketStream::socket() const { return sock_; }
+  auto acceptable = [&](const std::string &name) {
+    return detail::encoding_from_name(name) != detail::EncodingType::None &&
+           detail::accepts_encoding(accept_encoding, name);
+  };
 
-inline time_t SocketStream::duration() const {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(
-             std::chrono::steady_clock::now() - start_time_)
-      .count();
-}
+  if (std::none_of(policy.codecs.begin(), policy.codecs.end(), acceptable)) {
+    return detail::EncodingType::None;
+  }
+  if (!streamed && size < policy.min_size) { return skip(); }
 
-// Buffer stream implementation
-inline bool BufferStream::is_readable() const { return true; }
+  for (const auto &name : policy.codecs) {
+    if (!acceptable(name)) { continue; }
 
-inline bool BufferStream::wait_readable() const { return true; }
+    auto type = detail::encoding_from_name(name);
+    auto &codec = route.codecs[static_cast<size_t>(type)];
 
-inline bool BufferStream::wait_writable() const { return true; }
+    // Over budget even at its lowest level; only probe it now and then
+    if (codec.disabled.load(std::memory_order_relaxed)) {
+      if (codec.since_probe.fetch_add(1, std::memory_order_relaxed) + 1 <
+          CPPHTTPLIB_COMPRESSION_PROBE_INTERVAL) {
+        continue;
+      }
+      codec.since_probe.store(0, std::memory_order_relaxed);
+    }
 
-inline ssize_t BufferStream::read(char *ptr, size_t size) {
-#if defined(_MSC_VER) && _MSC_VER < 1910
-  auto len_read = buffer._Copy_s(ptr, size, size, position);
-#else
-  auto len_read = buffer.copy(ptr, size, position);
-#endif
-  position += static_cast<size_t>(len_read);
-  return static_cast<ssize_t>(len_read);
-}
+    level = codec.level.load(std::memory_order_relaxed);
+    if (level == -1) {
+      auto start = policy.level >= 0 ? policy.level
+                                     : detail::default_compression_level(type);
+      // Another worker may have set it first; either way `level` is current
+      if (codec.level.compare_exchange_strong(level, start,
+                                              std::memory_order_relaxed)) {
+        level = start;
+      }
+    }
+    return type;
+  }
 
-inline ssize_t BufferStream::write(const char *ptr, size_t size) {
-  buffer.append(ptr, size);
-  return static_cast<ssize_t>(size);
+  return skip();
 }
 
-inline void BufferStream::get_remote_ip_and_port(std::string & /*ip*/,
-                                                 int & /*port*/) const {}
+inline Server::RouteCompression &
+Server::compression_route(const std::string &route) const {
+  auto find = [&](const CompressionRouteTable *table) -> RouteCompression * {
+    if (!table) { return nullptr; }
+    auto it = table->find(route);
+    return it != table->end() ? it->second : nullptr;
+  };
 
-inline void BufferStream::get_local_ip_and_port(std::string & /*ip*/,
-                                                int & /*port*/) const {}
+  auto entry = find(compression_routes_.load(std::memory_order_acquire));
+  if (entry) { return *entry; }
+
+  // First response on this route: publish a copy of the table with it added
+  MutexLock guard(compression_mutex_);
+  auto table = compression_routes_.load(std::memory_order_relaxed);
+  entry = find(table);
+  if (entry) { return *entry; }
+
+  compression_route_entries_.push_back(
+      detail::make_unique<RouteCompression>());
+  entry = compression_route_entries_.back().get();
+
+  auto next = table ? detail::make_unique<CompressionRouteTable>(*table)
+                    : detail::make_unique<CompressionRouteTable>();
+  next->emplace(route, entry);
+  compression_routes_.store(next.get(), std::memory_order_release);
+  compression_route_tables_.push_back(std::move(next));
+  return *entry;
+}
+
+inline void Server::record_compression(const Request &req,
+                                       detail::EncodingType type, int level,
+                                       size_t bytes_in, size_t bytes_out,
+                                       uint64_t cpu_ns) const {
+  auto it = compression_policies_.find(req.matched_route);
+  const auto &policy = it != compression_policies_.end()
+                           ? it->second
+                           : default_compression_policy_;
+
+  auto &route = compression_route(req.matched_route);
+  for (auto stats : {&route.stats, &compression_stats_}) {
+    stats->compressed.fetch_add(1, std::memory_order_relaxed);
+    stats->bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+    stats->bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+    stats->cpu_ns.fetch_add(cpu_ns, std::memory_order_relaxed);
+  }
+
+  auto budget = policy.max_cpu_ns_per_byte;
+  if (budget <= 0 || bytes_in == 0) { return; }
+
+  auto &codec = route.codecs[static_cast<size_t>(type)];
+  auto cost = static_cast<double>(cpu_ns) / static_cast<double>(bytes_in);
+
+  MutexLock guard(route.tuning);
+  if (codec.disabled.load(std::memory_order_relaxed)) {
+    // Probe result: bring the codec back if it now fits the budget
+    if (cost <= budget) {
+      codec.disabled.store(false, std::memory_order_relaxed);
+      codec.samples = 0;
+    }
+    return;
+  }
 
-inline socket_t BufferStream::socket() const { return 0; }
+  codec.cost_ns_per_byte =
+      codec.samples ? codec.cost_ns_per_byte * 0.8 + cost * 0.2 : cost;
+  if (++codec.samples < 8) { return; }
 
-inline time_t BufferStream::duration() const { return 0; }
+  auto start_level = policy.level >= 0
+                         ? policy.level
+                         : detail::default_compression_level(type);
 
-inline const std::string &BufferStream::get_buffer() const { return buffer; }
+  auto current = codec.level.load(std::memory_order_relaxed);
+  if (codec.cost_ns_per_byte > budget) {
+    if (level > detail::min_compression_level(type)) {
+      codec.level.store(level - 1, std::memory_order_relaxed);
+    } else {
+      codec.since_probe.store(0, std::memory_order_relaxed);
+      codec.disabled.store(true, std::memory_order_relaxed);
+    }
+    codec.samples = 0;
+  } else if (codec.cost_ns_per_byte < budget / 4 && current < start_level) {
+    codec.level.store(current + 1, std::memory_order_relaxed);
+    codec.samples = 0;
+  }
+}
 
-inline PathParamsMatcher::PathParamsMatcher(const std::string &pattern)
-    : MatcherBase(pattern) {
-  constexpr const char marker[] = "/:";
+inline bool Server::read_content(Stream &strm, Request &req, Response &res) {
+  FormFields::iterator cur_field;
+  FormFiles::iterator cur_file;
+  auto is_text_field = false;
+  size_t count = 0;
+  if (read_content_core(
+          strm, req, res,
+          // Regular
+          [&](const char *buf, size_t n) {
+            if (req.body.size() + n > req.body.max_size()) { return false; }
+            req.body.append(buf, n);
+            return true;
+          },
+          // Multipart FormData
+          [&](const FormData &file) {
+            if (count++ == CPPHTTPLIB_MULTIPART_FORM_DATA_FILE_MAX_COUNT) {
+              return false;
+            }
 
-  // One past the last ending position of a path param substring
-  std::size_t last_param_end = 0;
+            if (file.filename.empty()) {
+              cur_field = req.form.fields.emplace(
+                  file.name, FormField{file.name, file.content, file.headers});
+              is_text_field = true;
+            } else {
+              cur_file = req.form.files.emplace(file.name, file);
+              is_text_field = false;
+            }
+            return true;
+          },
+          [&](const char *buf, size_t n) {
+            if (is_text_field) {
+              auto &content = cur_field->second.content;
+              if (content.size() + n > content.max_size()) { return false; }
+              content.append(buf, n);
+            } else {
+              auto &content = cur_file->second.content;
+              if (content.size() + n > content.max_size()) { return false; }
+              content.append(buf, n);
+            }
+            return true;
+          })) {
+    const auto &content_type = req.get_header_value("Content-Type");
+    if (!content_type.find("application/x-www-form-urlencoded")) {
+      if (req.body.size() > CPPHTTPLIB_FORM_URL_ENCODED_PAYLOAD_MAX_LENGTH) {
+        res.status = StatusCode::PayloadTooLarge_413; // NOTE: should be 414?
+        return false;
+      }
+      detail::parse_query_text(req.body, req.params);
+    }
+    return true;
+  }
+  return false;
+}
 
-#ifndef CPPHTTPLIB_NO_EXCEPTIONS
-  // Needed to ensure that parameter names are unique during matcher
-  // construction
-  // If exceptions are disabled, only last duplicate path
-  // parameter will be set
-  std::unordered_set<std::string> param_name_set;
-#endif
+inline bool Server::read_content_with_content_receiver(
+    Stream &strm, Request &req, Response &res, ContentReceiver receiver,
+    FormDataHeader multipart_header, ContentReceiver multipart_receiver) {
+  return read_content_core(strm, req, res, std::move(receiver),
+                           std::move(multipart_header),
+                           std::move(multipart_receiver));
+}
 
-  while (true) {
-    const auto marker_pos = pattern.find(
-        marker, last_param_end == 0 ? last_param_end : last_param_end - 1);
-    if (marker_pos == std::string::npos) { break; }
+inline bool Server::read_content_core(
+    Stream &strm, Request &req, Response &res, ContentReceiver receiver,
+    FormDataHeader multipart_header, ContentReceiver multipart_receiver) const {
+  detail::FormDataParser multipart_form_data_parser;
+  ContentReceiverWithProgress out;
 
-    static_fragments_.push_back(
-        pattern.substr(last_param_end, marker_pos - last_param_end + 1));
+  if (req.is_multipart_form_data()) {
+    const auto &content_type = req.get_header_value("Content-Type");
+    std::string boundary;
+    if (!detail::parse_multipart_boundary(content_type, boundary)) {
+      res.status = StatusCode::BadRequest_400;
+      return false;
+    }
 
-    const auto param_name_start = marker_pos + str_len(marker);
+    multipart_form_data_parser.set_boundary(std::move(boundary));
+    out = [&](const char *buf, size_t n, size_t /*off*/, size_t /*len*/) {
+      return multipart_form_data_parser.parse(buf, n, multipart_header,
+                                              multipart_receiver);
+    };
+  } else {
+    out = [receiver](const char *buf, size_t n, size_t /*off*/,
+                     size_t /*len*/) { return receiver(buf, n); };
+  }
 
-    auto sep_pos = pattern.find(separator, param_name_start);
-    if (sep_pos == std::string::npos) { sep_pos = pattern.length(); }
+  if (req.method == "DELETE" && !req.has_header("Content-Length")) {
+    return true;
+  }
 
-    auto param_name =
-        pattern.substr(param_name_start, sep_pos - param_name_start);
+  if (!detail::read_content(strm, req, payload_max_length_, res.status, nullptr,
+                            out, true)) {
+    return false;
+  }
 
-#ifndef CPPHTTPLIB_NO_EXCEPTIONS
-    if (param_name_set.find(param_name) != param_name_set.cend()) {
-      std::string msg = "Encountered path parameter '" + param_name +
-                        "' multiple times in route pattern '" + pattern + "'.";
-      throw std::invalid_argument(msg);
+  if (req.is_multipart_form_data()) {
+    if (!multipart_form_data_parser.is_valid()) {
+      res.status = StatusCode::BadRequest_400;
+      return false;
     }
-#endif
-
-    param_names_.push_back(std::move(param_name));
-
-    last_param_end = sep_pos + 1;
   }
 
-  if (last_param_end < pattern.length()) {
-    static_fragments_.push_back(pattern.substr(last_param_end));
-  }
+  return true;
 }
 
-inline bool PathParamsMatcher::match(Request &request) const {
-  request.matches = std::smatch();
-  request.path_params.clear();
-  request.path_params.reserve(param_names_.size());
+inline bool Server::handle_file_request(const Request &req, Response &res) {
+  for (const auto &entry : base_dirs_) {
+    // Prefix match
+    if (!req.path.compare(0, entry.mount_point.size(), entry.mount_point)) {
+      std::string sub_path = "/" + req.path.substr(entry.mount_point.size());
+      if (detail::is_valid_path(sub_path)) {
+        auto path = entry.base_dir + sub_path;
+        if (path.back() == '/') { path += "index.html"; }
 
-  // One past the position at which the path matched the pattern last time
-  std::size_t starting_pos = 0;
-  for (size_t i = 0; i < static_fragments_.size(); ++i) {
-    const auto &fragment = static_fragments_[i];
+        // A cached file is answered without touching the disk
+        if (entry.cache) {
+          auto asset = entry.cache->find(path);
+          if (asset) {
+            serve_cached_asset(req, res, entry.headers, std::move(asset));
+            return true;
+          }
+        }
+
+        detail::FileStat stat(path);
+
+        if (stat.is_dir()) {
+          res.set_redirect(sub_path + "/", StatusCode::MovedPermanently_301);
+          return true;
+        }
+
+        if (stat.is_file()) {
+          auto content_type = detail::find_content_type(
+              path, file_extension_and_mimetype_map_, default_file_mimetype_);
+
+          if (entry.cache &&
+              stat.size() <= CPPHTTPLIB_MOUNT_CACHE_MAX_FILE_SIZE) {
+            auto asset = entry.cache->load(path, content_type);
+            if (!asset) { return false; }
+            serve_cached_asset(req, res, entry.headers, std::move(asset));
+            return true;
+          }
+
+          for (const auto &kv : entry.headers) {
+            res.set_header(kv.first, kv.second);
+          }
+
+          if (!set_file_content_provider(res, path, content_type)) {
+            return false;
+          }
 
-    if (starting_pos + fragment.length() > request.path.length()) {
-      return false;
-    }
+          if (req.method != "HEAD" && file_request_handler_) {
+            file_request_handler_(req, res);
+          }
 
-    // Avoid unnecessary allocation by using strncmp instead of substr +
-    // comparison
-    if (std::strncmp(request.path.c_str() + starting_pos, fragment.c_str(),
-                     fragment.length()) != 0) {
-      return false;
+          return true;
+        }
+      }
     }
+  }
+  return false;
+}
 
-    starting_pos += fragment.length();
+inline void
+Server::serve_cached_asset(const Request &req, Response &res,
+                           const Headers &headers,
+                           std::shared_ptr<const detail::CachedAsset> holder) {
+  const auto &asset = *holder;
+  for (const auto &kv : headers) {
+    res.set_header(kv.first, kv.second);
+  }
+
+  // Pick the smallest representation the client accepts
+  const std::string *data = &asset.data;
+  const std::string *etag = &asset.etag;
+  if (!asset.variants.empty()) {
+    res.set_header("Vary", "Accept-Encoding");
+
+    const auto &accept_encoding = req.get_header_value("Accept-Encoding");
+    for (const auto &v : asset.variants) {
+      if (detail::accepts_encoding(accept_encoding, v.content_encoding)) {
+        res.set_header("Content-Encoding", v.content_encoding);
+        data = &v.data;
+        etag = &v.etag;
+        break;
+      }
+    }
+  }
 
-    // Should only happen when we have a static fragment after a param
-    // Example: '/users/:id/subscriptions'
-    // The 'subscriptions' fragment here does not have a corresponding param
-    if (i >= param_names_.size()) { continue; }
+  res.set_header("ETag", *etag);
+  if (!asset.last_modified.empty()) {
+    res.set_header("Last-Modified", asset.last_modified);
+  }
 
-    auto sep_pos = request.path.find(separator, starting_pos);
-    if (sep_pos == std::string::npos) { sep_pos = request.path.length(); }
+  // NOTE: https://www.rfc-editor.org/rfc/rfc9110#section-13.2.2
+  auto not_modified =
+      req.has_header("If-None-Match")
+          ? detail::etag_matches(req.get_header_value("If-None-Match"), *etag)
+          : !asset.last_modified.empty() &&
+                req.get_header_value("If-Modified-Since") ==
+                    asset.last_modified;
 
-    const auto &param_name = param_names_[i];
+  if (not_modified) {
+    res.status = StatusCode::NotModified_304;
+    res.set_header("Content-Length", std::to_string(data->size()));
+    return;
+  }
 
-    request.path_params.emplace(
-        param_name, request.path.substr(starting_pos, sep_pos - starting_pos));
+  res.set_content_provider(
+      data->size(), asset.content_type,
+      [holder, data](size_t offset, size_t length, DataSink &sink) -> bool {
+        sink.write(data->data() + offset, length);
+        return true;
+      });
 
-    // Mark everything up to '/' as matched
-    starting_pos = sep_pos + 1;
+  if (req.method != "HEAD" && file_request_handler_) {
+    file_request_handler_(req, res);
   }
-  // Returns false if the path is longer than the pattern
-  return starting_pos >= request.path.length();
-}
-
-inline bool RegexMatcher::match(Request &request) const {
-  request.path_params.clear();
-  return std::regex_match(request.path, request.matches, regex_);
 }
 
-} // namespace detail
+inline bool
+Server::set_file_content_provider(Response &res, const std::string &path,
+                                  const std::string &content_type) const {
+  auto mm = std::make_shared<detail::mmap>(path.c_str());
+  if (!mm->is_open()) { return false; }
+
+  res.set_content_provider(
+      mm->size(), content_type,
+      [mm](size_t offset, size_t length, DataSink &sink) -> bool {
+        sink.write(mm->data() + offset, length);
+        return true;
+      });
 
-// HTTP server implementation
-inline Server::Server()
-    : new_task_queue(
-          [] { return new ThreadPool(CPPHTTPLIB_THREAD_POOL_COUNT); }) {
-#ifndef _WIN64
-  signal(SIGPIPE, SIG_IGN);
+#if !defined(_WIN64)
+  // Large files go to the socket with sendfile(2) when the stream allows it.
+  // The provider keeps `mm`, and with it the descriptor, alive.
+  if (mm->size() >= CPPHTTPLIB_SENDFILE_THRESHOLD) {
+    res.content_fd_ = mm->fd();
+  }
 #endif
+  return true;
 }
 
-inline Server::~Server() = default;
+namespace detail {
 
-inline std::unique_ptr<detail::MatcherBase>
-Server::make_matcher(const std::string &pattern) {
-  if (pattern.find("/:") != std::string::npos) {
-    return detail::make_unique<detail::PathParamsMatcher>(pattern);
-  } else {
-    return detail::make_unique<detail::RegexMatcher>(pattern);
+// `worker_count` as configured, 0 standing for the default thread pool
+inline size_t worker_count(size_t configured) {
+  return configured ? configured : size_t(CPPHTTPLIB_THREAD_POOL_COUNT);
+}
+
+inline AdmissionController::AdmissionController(AdmissionControl config)
+    : config_(std::move(config)),
+      max_concurrency_(
+          config_.max_concurrency
+              ? config_.max_concurrency
+              : (std::max)(size_t(1), worker_count(config_.worker_count) / 2)),
+      max_waiting_(worker_count(config_.worker_count) > max_concurrency_
+                       ? (worker_count(config_.worker_count) -
+                          max_concurrency_) / 2
+                       : 0),
+      classes_((std::max)(config_.classes.size(), size_t(1))) {}
+
+// Waiting requests, of any class, beyond which class `cls` is shed
+inline size_t AdmissionController::wait_limit(size_t cls) const {
+  auto n = classes_.size();
+  return max_waiting_ * (n - cls) / n;
+}
+
+// Sheds the oldest waiter of the lowest priority class below `cls`
+inline bool AdmissionController::evict_below(size_t cls) {
+  for (auto i = classes_.size(); i-- > cls + 1;) {
+    auto &c = classes_[i];
+    if (c.queue.empty()) { continue; }
+    auto w = c.queue.front();
+    c.queue.pop_front();
+    waiting_--;
+    c.shed++;
+    w->state = Waiter::State::Shed;
+    w->cv.notify_one();
+    return true;
   }
+  return false;
 }
 
-inline Server &Server::Get(const std::string &pattern, Handler handler) {
-  get_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
-  return *this;
-}
+inline size_t AdmissionController::classify(const Request &req) const {
+  if (config_.classes.empty()) { return 0; }
 
-inline Server &Server::Post(const std::string &pattern, Handler handler) {
-  post_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
-  return *this;
-}
+  auto last = config_.classes.size() - 1;
+  if (config_.classify) { return (std::min)(config_.classify(req), last); }
 
-inline Server &Server::Post(const std::string &pattern,
-                            HandlerWithContentReader handler) {
-  post_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
-                                                 std::move(handler));
-  return *this;
+  for (size_t i = 0; i < config_.classes.size(); i++) {
+    for (const auto &route : config_.classes[i].routes) {
+      auto pos = route.find(' ');
+      if (pos != std::string::npos && route.compare(0, pos, req.method)) {
+        continue;
+      }
+      auto prefix = pos == std::string::npos ? 0 : pos + 1;
+      if (!req.path.compare(0, route.size() - prefix, route, prefix,
+                            std::string::npos)) {
+        return i;
+      }
+    }
+  }
+  return last;
 }
 
-inline Server &Server::Put(const std::string &pattern, Handler handler) {
-  put_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
-  return *this;
-}
+inline bool AdmissionController::acquire(size_t cls, time_t &retry_after_sec) {
+  using namespace std::chrono;
 
-inline Server &Server::Put(const std::string &pattern,
-                           HandlerWithContentReader handler) {
-  put_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
-                                                std::move(handler));
-  return *this;
-}
+  MutexLock lock(mutex_);
+  auto &c = classes_[cls];
 
-inline Server &Server::Patch(const std::string &pattern, Handler handler) {
-  patch_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
-  return *this;
-}
+  if (running_ < max_concurrency_) {
+    running_++;
+    c.admitted++;
+    c.queue_delay_ms *= 0.9;
+    c.first_above_time = steady_clock::time_point{};
+    c.dropping = false;
+    return true;
+  }
 
-inline Server &Server::Patch(const std::string &pattern,
-                             HandlerWithContentReader handler) {
-  patch_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
-                                                  std::move(handler));
-  return *this;
-}
+  auto max_queue = config_.classes.empty() ? size_t(64)
+                                           : config_.classes[cls].max_queue;
+  auto sheddable = !config_.classes.empty() && config_.classes[cls].sheddable;
+  while (waiting_ >= wait_limit(cls) && evict_below(cls)) {}
+  if (c.queue.size() >= max_queue || waiting_ >= wait_limit(cls) ||
+      (sheddable && c.dropping && !c.queue.empty())) {
+    c.shed++;
+    retry_after_sec = retry_after(cls);
+    return false;
+  }
 
-inline Server &Server::Delete(const std::string &pattern, Handler handler) {
-  delete_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
-  return *this;
-}
+  Waiter w;
+  w.enqueued = steady_clock::now();
+  c.queue.push_back(&w);
+  waiting_++;
 
-inline Server &Server::Delete(const std::string &pattern,
-                              HandlerWithContentReader handler) {
-  delete_handlers_for_content_reader_.emplace_back(make_matcher(pattern),
-                                                   std::move(handler));
-  return *this;
-}
+  auto max_wait = config_.classes.empty() ? milliseconds(1000)
+                                          : config_.classes[cls].max_wait;
+  auto deadline = w.enqueued + max_wait;
+  while (w.state == Waiter::State::Waiting) {
+    if (w.cv.wait_until(lock, deadline) == std::cv_status::timeout &&
+        w.state == Waiter::State::Waiting) {
+      c.queue.remove(&w);
+      waiting_--;
+      c.shed++;
+      w.state = Waiter::State::Shed;
+    }
+  }
 
-inline Server &Server::Options(const std::string &pattern, Handler handler) {
-  options_handlers_.emplace_back(make_matcher(pattern), std::move(handler));
-  return *this;
+  if (w.state == Waiter::State::Shed) {
+    retry_after_sec = retry_after(cls);
+    return false;
+  }
+  return true;
 }
 
-inline bool Server::set_base_dir(const std::string &dir,
-                                 const std::string &mount_point) {
-  return set_mount_point(mount_point, dir);
+inline void AdmissionController::release() {
+  MutexLock guard(mutex_);
+  running_--;
+  grant();
 }
 
-inline bool Server::set_mount_point(const std::string &mount_point,
-                                    const std::string &dir, Headers headers) {
-  detail::FileStat stat(dir);
-  if (stat.is_dir()) {
-    std::string mnt = !mount_point.empty() ? mount_point : "/";
-    if (!mnt.empty() && mnt[0] == '/') {
-      base_dirs_.push_back({mnt, dir, std::move(headers)});
-      return true;
+// Hands free slots to waiting requests, picking the class by smooth weighted
+// round robin. Ties go to the higher priority class.
+inline void AdmissionController::grant() {
+  using namespace std::chrono;
+
+  while (running_ < max_concurrency_) {
+    ClassState *next = nullptr;
+    size_t next_index = 0;
+    int64_t total = 0;
+    for (size_t i = 0; i < classes_.size(); i++) {
+      auto &c = classes_[i];
+      if (c.queue.empty()) { continue; }
+      auto weight = static_cast<int64_t>(
+          config_.classes.empty() ? 1 : config_.classes[i].weight);
+      c.current_weight += weight;
+      total += weight;
+      if (!next || c.current_weight > next->current_weight) {
+        next = &c;
+        next_index = i;
+      }
     }
-  }
-  return false;
-}
+    if (!next) { break; }
+    next->current_weight -= total;
 
-inline bool Server::remove_mount_point(const std::string &mount_point) {
-  for (auto it = base_dirs_.begin(); it != base_dirs_.end(); ++it) {
-    if (it->mount_point == mount_point) {
-      base_dirs_.erase(it);
-      return true;
+    auto w = next->queue.front();
+    next->queue.pop_front();
+    waiting_--;
+
+    auto now = steady_clock::now();
+    auto sojourn = now - w->enqueued;
+    next->queue_delay_ms =
+        next->queue_delay_ms * 0.9 +
+        duration_cast<duration<double, std::milli>>(sojourn).count() * 0.1;
+
+    if (should_drop(next_index, sojourn, now)) {
+      next->shed++;
+      w->state = Waiter::State::Shed;
+    } else {
+      running_++;
+      next->admitted++;
+      w->state = Waiter::State::Admitted;
     }
+    w->cv.notify_one();
   }
-  return false;
 }
 
-inline Server &
-Server::set_file_extension_and_mimetype_mapping(const std::string &ext,
-                                                const std::string &mime) {
-  file_extension_and_mimetype_map_[ext] = mime;
-  return *this;
-}
+// NOTE: https://datatracker.ietf.org/doc/html/rfc8289
+inline bool
+AdmissionController::should_drop(size_t cls,
+                                 std::chrono::steady_clock::duration sojourn,
+                                 std::chrono::steady_clock::time_point now) {
+  if (config_.classes.empty()) { return false; }
+  const auto &config = config_.classes[cls];
+  auto &c = classes_[cls];
+
+  if (sojourn < config.target) {
+    c.first_above_time = std::chrono::steady_clock::time_point{};
+    c.dropping = false;
+    return false;
+  }
 
-inline Server &Server::set_default_file_mimetype(const std::string &mime) {
-  default_file_mimetype_ = mime;
-  return *this;
-}
+  if (c.first_above_time == std::chrono::steady_clock::time_point{}) {
+    c.first_above_time = now + config.interval;
+    return false;
+  }
 
-inline Server &Server::set_file_request_handler(Handler handler) {
-  file_request_handler_ = std::move(handler);
-  return *this;
+  if (now >= c.first_above_time) { c.dropping = true; }
+  return c.dropping && config.sheddable;
 }
 
-inline Server &Server::set_error_handler_core(HandlerWithResponse handler,
-                                              std::true_type) {
-  error_handler_ = std::move(handler);
-  return *this;
+// Ask clients to come back after about twice the current queueing delay
+inline time_t AdmissionController::retry_after(size_t cls) const {
+  auto sec = static_cast<time_t>(classes_[cls].queue_delay_ms * 2 / 1000);
+  return (std::max)(sec, time_t(1));
 }
 
-inline Server &Server::set_error_handler_core(Handler handler,
-                                              std::false_type) {
-  error_handler_ = [handler](const Request &req, Response &res) {
-    handler(req, res);
-    return HandlerResponse::Handled;
-  };
-  return *this;
+inline std::vector<AdmissionClassStats> AdmissionController::stats() const {
+  MutexLock guard(mutex_);
+  std::vector<AdmissionClassStats> ret;
+  for (size_t i = 0; i < classes_.size(); i++) {
+    const auto &c = classes_[i];
+    AdmissionClassStats st;
+    if (i < config_.classes.size()) { st.name = config_.classes[i].name; }
+    st.admitted = c.admitted;
+    st.shed = c.shed;
+    st.queued = c.queue.size();
+    st.queue_delay_ms = c.queue_delay_ms;
+    ret.push_back(std::move(st));
+  }
+  return ret;
 }
 
-inline Server &Server::set_exception_handler(ExceptionHandler handler) {
-  exception_handler_ = std::move(handler);
-  return *this;
-}
+inline size_t LatencyHistogram::bucket_index(uint64_t usec) {
+  if (usec < 16) { return static_cast<size_t>(usec); }
 
-inline Server &Server::set_pre_routing_handler(HandlerWithResponse handler) {
-  pre_routing_handler_ = std::move(handler);
-  return *this;
+  size_t msb = 0;
+  for (auto v = usec; v >>= 1;) {
+    msb++;
+  }
+  auto index = (msb - 3) * 8 + static_cast<size_t>(usec >> (msb - 3));
+  return (std::min)(index, bucket_count - 1);
 }
 
-inline Server &Server::set_post_routing_handler(Handler handler) {
-  post_routing_handler_ = std::move(handler);
-  return *this;
+// Values in bucket `index` are below this bound
+inline uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+  if (index < 8) { return index + 1; }
+  return static_cast<uint64_t>(index % 8 + 9) << (index / 8 - 1);
 }
 
-inline Server &Server::set_pre_request_handler(HandlerWithResponse handler) {
-  pre_request_handler_ = std::move(handler);
-  return *this;
+inline void LatencyHistogram::record(uint64_t usec) {
+  auto &bucket = buckets_[bucket_index(usec)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  count_.store(count_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  sum_usec_.store(sum_usec_.load(std::memory_order_relaxed) + usec,
+                  std::memory_order_relaxed);
 }
 
-inline Server &Server::set_logger(Logger logger) {
-  logger_ = std::move(logger);
-  return *this;
+inline void LatencyHistogram::merge_into(std::vector<uint64_t> &buckets,
+                                         uint64_t &count,
+                                         uint64_t &sum_usec) const {
+  buckets.resize(bucket_count);
+  for (size_t i = 0; i < bucket_count; i++) {
+    buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+  }
+  count += count_.load(std::memory_order_relaxed);
+  sum_usec += sum_usec_.load(std::memory_order_relaxed);
 }
 
-inline Server &Server::set_pre_compression_logger(Logger logger) {
-  pre_compression_logger_ = std::move(logger);
-  return *this;
-}
+// Counts the bytes going through a stream for ServerMetrics
+class CountingStream final : public Stream {
+public:
+  CountingStream(Stream &strm, ServerMetrics &metrics)
+      : strm_(strm), metrics_(metrics) {}
 
-inline Server &
-Server::set_expect_100_continue_handler(Expect100ContinueHandler handler) {
-  expect_100_continue_handler_ = std::move(handler);
-  return *this;
-}
+  bool is_readable() const override { return strm_.is_readable(); }
+  bool wait_readable() const override { return strm_.wait_readable(); }
+  bool wait_writable() const override { return strm_.wait_writable(); }
 
-inline Server &Server::set_address_family(int family) {
-  address_family_ = family;
-  return *this;
-}
+  ssize_t read(char *ptr, size_t size) override {
+    auto n = strm_.read(ptr, size);
+    if (n > 0) { metrics_.add_bytes_in(static_cast<size_t>(n)); }
+    return n;
+  }
 
-inline Server &Server::set_tcp_nodelay(bool on) {
-  tcp_nodelay_ = on;
-  return *this;
-}
+  ssize_t write(const char *ptr, size_t size) override {
+    auto n = strm_.write(ptr, size);
+    if (n > 0) { metrics_.add_bytes_out(static_cast<size_t>(n)); }
+    return n;
+  }
 
-inline Server &Server::set_ipv6_v6only(bool on) {
-  ipv6_v6only_ = on;
-  return *this;
-}
+  void get_remote_ip_and_port(std::string &ip, int &port) const override {
+    strm_.get_remote_ip_and_port(ip, port);
+  }
+  void get_local_ip_and_port(std::string &ip, int &port) const override {
+    strm_.get_local_ip_and_port(ip, port);
+  }
+  socket_t socket() const override { return strm_.socket(); }
+  time_t duration() const override { return strm_.duration(); }
 
-inline Server &Server::set_socket_options(SocketOptions socket_options) {
-  socket_options_ = std::move(socket_options);
-  return *this;
-}
+  bool write_batching() const override { return strm_.write_batching(); }
+  bool set_write_batching(bool on) override {
+    return strm_.set_write_batching(on);
+  }
+  bool flush() override { return strm_.flush(); }
 
-inline Server &Server::set_default_headers(Headers headers) {
-  default_headers_ = std::move(headers);
-  return *this;
-}
+  bool can_send_file() const override { return strm_.can_send_file(); }
+  ssize_t send_file(int fd, size_t offset, size_t size) override {
+    auto n = strm_.send_file(fd, offset, size);
+    if (n > 0) { metrics_.add_bytes_out(static_cast<size_t>(n)); }
+    return n;
+  }
 
-inline Server &Server::set_header_writer(
-    std::function<ssize_t(Stream &, Headers &)> const &writer) {
-  header_writer_ = writer;
-  return *this;
-}
+private:
+  Stream &strm_;
+  ServerMetrics &metrics_;
+};
 
-inline Server &Server::set_keep_alive_max_count(size_t count) {
-  keep_alive_max_count_ = count;
-  return *this;
+inline void ServerMetrics::record_request(const Request &req, int status,
+                                          uint64_t usec) {
+  auto &shard = local_shard();
+
+  thread_local std::string key;
+  key.assign(req.method);
+  key += ' ';
+  key += req.matched_route;
+  key += ' ';
+  key += std::to_string(status);
+
+  auto it = shard.series.find(key);
+  if (it == shard.series.end()) {
+    auto series = detail::make_unique<Series>();
+    series->method = req.method;
+    series->route = req.matched_route;
+    series->status = status;
+
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    it = shard.series.emplace(key, std::move(series)).first;
+  }
+  it->second->latency.record(usec);
 }
 
-inline Server &Server::set_keep_alive_timeout(time_t sec) {
-  keep_alive_timeout_sec_ = sec;
-  return *this;
+inline void ServerMetrics::record_queue_wait(uint64_t usec) {
+  local_shard().queue_wait.record(usec);
 }
 
-inline Server &Server::set_read_timeout(time_t sec, time_t usec) {
-  read_timeout_sec_ = sec;
-  read_timeout_usec_ = usec;
-  return *this;
+inline void ServerMetrics::add_bytes_in(size_t n) {
+  auto &v = local_shard().bytes_in;
+  v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
 }
 
-inline Server &Server::set_write_timeout(time_t sec, time_t usec) {
-  write_timeout_sec_ = sec;
-  write_timeout_usec_ = usec;
-  return *this;
+inline void ServerMetrics::add_bytes_out(size_t n) {
+  auto &v = local_shard().bytes_out;
+  v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
 }
 
-inline Server &Server::set_idle_interval(time_t sec, time_t usec) {
-  idle_interval_sec_ = sec;
-  idle_interval_usec_ = usec;
-  return *this;
+inline void ServerMetrics::connection_opened() {
+  auto &v = local_shard().live;
+  v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 }
 
-inline Server &Server::set_payload_max_length(size_t length) {
-  payload_max_length_ = length;
-  return *this;
+inline void ServerMetrics::connection_closed() {
+  auto &v = local_shard().live;
+  v.store(v.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
 }
 
-inline bool Server::bind_to_port(const std::string &host, int port,
-                                 int socket_flags) {
-  auto ret = bind_internal(host, port, socket_flags);
-  if (ret == -1) { is_decommissioned = true; }
-  return ret >= 0;
+template <typename T>
+inline bool ServerMetrics::measure(Stream &strm, T process) {
+  auto &active = local_shard().active;
+  active.store(active.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  auto done = scope_exit([&]() {
+    active.store(active.load(std::memory_order_relaxed) - 1,
+                 std::memory_order_relaxed);
+  });
+
+  CountingStream cstrm(strm, *this);
+  return process(cstrm);
 }
-inline int Server::bind_to_any_port(const std::string &host, int socket_flags) {
-  auto ret = bind_internal(host, 0, socket_flags);
-  if (ret == -1) { is_decommissioned = true; }
+
+inline std::string prometheus_label_value(const std::string &s) {
+  std::string ret;
+  for (auto c : s) {
+    switch (c) {
+    case '\\': ret += "\\\\"; break;
+    case '"': ret += "\\\""; break;
+    case '\n': ret += "\\n"; break;
+    default: ret += c; break;
+    }
+  }
   return ret;
 }
 
-inline bool Server::listen_after_bind() { return listen_internal(); }
+// NOTE: https://prometheus.io/docs/instrumenting/exposition_formats/
+inline std::string ServerMetrics::render(const std::string &extra) const {
+  static const uint64_t bounds_usec[] = {
+      100,    250,    500,     1000,    2500,    5000,    10000,
+      25000,  50000,  100000,  250000,  500000,  1000000, 2500000,
+      5000000, 10000000};
 
-inline bool Server::listen(const std::string &host, int port,
-                           int socket_flags) {
-  return bind_to_port(host, port, socket_flags) && listen_internal();
-}
+  struct Merged {
+    std::string labels;
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum_usec = 0;
+  };
 
-inline bool Server::is_running() const { return is_running_; }
+  std::map<std::string, Merged> requests;
+  Merged queue_wait;
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  int64_t live = 0;
+  int64_t active = 0;
 
-inline void Server::wait_until_ready() const {
-  while (!is_running_ && !is_decommissioned) {
-    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  shards_.for_each([&](const Shard &shard) {
+    {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      for (const auto &kv : shard.series) {
+        const auto &series = *kv.second;
+        auto &m = requests[kv.first];
+        if (m.labels.empty()) {
+          m.labels = "method=\"" + prometheus_label_value(series.method) +
+                     "\",route=\"" + prometheus_label_value(series.route) +
+                     "\",status=\"" + std::to_string(series.status) + "\"";
+        }
+        series.latency.merge_into(m.buckets, m.count, m.sum_usec);
+      }
+    }
+    shard.queue_wait.merge_into(queue_wait.buckets, queue_wait.count,
+                                queue_wait.sum_usec);
+    bytes_in += shard.bytes_in.load(std::memory_order_relaxed);
+    bytes_out += shard.bytes_out.load(std::memory_order_relaxed);
+    live += shard.live.load(std::memory_order_relaxed);
+    active += shard.active.load(std::memory_order_relaxed);
+  });
+
+  std::string out;
+  auto histogram = [&](const std::string &name, const Merged &m) {
+    auto prefix = m.labels.empty() ? std::string() : m.labels + ",";
+    uint64_t cumulative = 0;
+    size_t i = 0;
+    for (auto bound : bounds_usec) {
+      while (i < m.buckets.size() &&
+             LatencyHistogram::bucket_upper_bound(i) <= bound) {
+        cumulative += m.buckets[i++];
+      }
+      char le[32];
+      snprintf(le, sizeof(le), "%g", static_cast<double>(bound) / 1e6);
+      out += name + "_bucket{" + prefix + "le=\"" + le + "\"} " +
+             std::to_string(cumulative) + "\n";
+    }
+    out += name + "_bucket{" + prefix + "le=\"+Inf\"} " +
+           std::to_string(m.count) + "\n";
+
+    auto labels = m.labels.empty() ? std::string() : "{" + m.labels + "}";
+    char sum[32];
+    snprintf(sum, sizeof(sum), "%.6f", static_cast<double>(m.sum_usec) / 1e6);
+    out += name + "_sum" + labels + " " + sum + "\n";
+    out += name + "_count" + labels + " " + std::to_string(m.count) + "\n";
+  };
+
+  out += "# TYPE httplib_request_duration_seconds histogram\n";
+  for (const auto &kv : requests) {
+    histogram("httplib_request_duration_seconds", kv.second);
   }
+
+  out += "# TYPE httplib_task_queue_wait_seconds histogram\n";
+  histogram("httplib_task_queue_wait_seconds", queue_wait);
+
+  out += "# TYPE httplib_received_bytes_total counter\n";
+  out += "httplib_received_bytes_total " + std::to_string(bytes_in) + "\n";
+  out += "# TYPE httplib_sent_bytes_total counter\n";
+  out += "httplib_sent_bytes_total " + std::to_string(bytes_out) + "\n";
+
+  out += "# TYPE httplib_connections gauge\n";
+  out += "httplib_connections{state=\"active\"} " + std::to_string(active) +
+         "\n";
+  out += "httplib_connections{state=\"idle\"} " +
+         std::to_string(live - active) + "\n";
+
+  out += extra;
+  return out;
 }
 
-inline void Server::stop() {
-  if (is_running_) {
-    assert(svr_sock_ != INVALID_SOCKET);
-    std::atomic<socket_t> sock(svr_sock_.exchange(INVALID_SOCKET));
-    detail::shutdown_socket(sock);
-    detail::close_socket(sock);
+#ifdef CPPHTTPLIB_LOCK_PROFILING
+inline void LockStats::record_wait(const char *file, int line,
+                                   std::chrono::steady_clock::duration wait) {
+  auto ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count());
+
+  std::lock_guard<std::mutex> guard(mutex);
+  waits++;
+  wait_ns += ns;
+  wait_histogram.record(ns);
+
+  for (auto &site : sites) {
+    if (site.line == line && !strcmp(site.file, file)) {
+      site.waits++;
+      site.wait_ns += ns;
+      return;
+    }
   }
-  is_decommissioned = false;
+  sites.push_back({file, line, 1, ns});
 }
 
-inline void Server::decommission() { is_decommissioned = true; }
+inline LockRegistry &LockRegistry::instance() {
+  // Never destroyed, since mutexes in static objects may outlive it
+  static auto registry = new LockRegistry();
+  return *registry;
+}
 
-inline bool Server::parse_request_line(const char *s, Request &req) const {
-  auto len = strlen(s);
-  if (len < 2 || s[len - 2] != '\r' || s[len - 1] != '\n') { return false; }
-  len -= 2;
+inline std::shared_ptr<LockStats> LockRegistry::stats(const char *name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto &stats = stats_[name ? name : "mutex"];
+  if (!stats) { stats = std::make_shared<LockStats>(name ? name : "mutex"); }
+  return stats;
+}
+
+inline std::string LockRegistry::report() const {
+  struct Row {
+    std::string name;
+    uint64_t acquisitions;
+    uint64_t waits;
+    uint64_t wait_ns;
+    std::vector<uint64_t> buckets;
+    std::vector<LockStats::Site> sites;
+  };
 
+  std::vector<Row> rows;
   {
-    size_t count = 0;
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (const auto &kv : stats_) {
+      auto &stats = *kv.second;
+      Row row;
+      row.name = stats.name;
+      row.acquisitions = stats.acquisitions.load(std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> stats_guard(stats.mutex);
+      row.waits = stats.waits;
+      row.wait_ns = stats.wait_ns;
+      uint64_t count = 0;
+      uint64_t sum = 0;
+      stats.wait_histogram.merge_into(row.buckets, count, sum);
+      row.sites = stats.sites;
+      rows.push_back(std::move(row));
+    }
+  }
+
+  std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+    return a.wait_ns > b.wait_ns;
+  });
 
-    detail::split(s, s + len, ' ', [&](const char *b, const char *e) {
-      switch (count) {
-      case 0: req.method = std::string(b, e); break;
-      case 1: req.target = std::string(b, e); break;
-      case 2: req.version = std::string(b, e); break;
-      default: break;
+  auto percentile_us = [](const Row &row, double p) {
+    auto rank = (std::max)(
+        static_cast<uint64_t>(static_cast<double>(row.waits) * p),
+        static_cast<uint64_t>(1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < row.buckets.size(); i++) {
+      seen += row.buckets[i];
+      if (seen >= rank) {
+        return static_cast<double>(
+                   LatencyHistogram::bucket_upper_bound(i)) /
+               1000.0;
       }
-      count++;
-    });
+    }
+    return 0.0;
+  };
 
-    if (count != 3) { return false; }
+  std::string out;
+  char line[256];
+  snprintf(line, sizeof(line), "%-32s %12s %10s %8s %12s %10s %10s %10s\n",
+           "lock", "acquisitions", "waits", "waits%", "wait_ms", "p50_us",
+           "p99_us", "p999_us");
+  out += line;
+
+  for (auto &row : rows) {
+    snprintf(line, sizeof(line),
+             "%-32s %12llu %10llu %7.2f%% %12.3f %10.1f %10.1f %10.1f\n",
+             row.name.c_str(),
+             static_cast<unsigned long long>(row.acquisitions),
+             static_cast<unsigned long long>(row.waits),
+             row.acquisitions ? 100.0 * static_cast<double>(row.waits) /
+                                    static_cast<double>(row.acquisitions)
+                              : 0.0,
+             static_cast<double>(row.wait_ns) / 1e6,
+             percentile_us(row, 0.5), percentile_us(row, 0.99),
+             percentile_us(row, 0.999));
+    out += line;
+
+    // Top call sites by time spent waiting
+    std::sort(row.sites.begin(), row.sites.end(),
+              [](const LockStats::Site &a, const LockStats::Site &b) {
+                return a.wait_ns > b.wait_ns;
+              });
+    for (size_t i = 0; i < row.sites.size() && i < 5; i++) {
+      const auto &site = row.sites[i];
+      snprintf(line, sizeof(line), "    %s:%d  waits=%llu wait_ms=%.3f\n",
+               site.file, site.line,
+               static_cast<unsigned long long>(site.waits),
+               static_cast<double>(site.wait_ns) / 1e6);
+      out += line;
+    }
   }
+  return out;
+}
+#endif
 
-  thread_local const std::set<std::string> methods{
-      "GET",     "HEAD",    "POST",  "PUT",   "DELETE",
-      "CONNECT", "OPTIONS", "TRACE", "PATCH", "PRI"};
+inline MemoryRegistry &MemoryRegistry::instance() {
+  // Never destroyed, since tagged containers in static objects may outlive it
+  static auto registry = new MemoryRegistry();
+  return *registry;
+}
 
-  if (methods.find(req.method) == methods.end()) { return false; }
+inline MemoryTag &MemoryRegistry::tag(const std::string &name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto &tag = tags_[name];
+  if (!tag) { tag.reset(new MemoryTag(name)); }
+  return *tag;
+}
 
-  if (req.version != "HTTP/1.1" && req.version != "HTTP/1.0") { return false; }
+inline std::string MemoryRegistry::report(int64_t units) const {
+  std::string out;
+  char line[256];
+  snprintf(line, sizeof(line), "%-32s %14s %14s %12s %12s %12s", "tag",
+           "live_bytes", "peak_bytes", "allocations", "units", "bytes/unit");
+  out += line;
+  if (units > 0) {
+    snprintf(line, sizeof(line), " %16s", "projected_bytes");
+    out += line;
+  }
+  out += "\n";
+
+  size_t total_live = 0;
+  size_t total_peak = 0;
+  double total_projected = 0;
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (const auto &kv : tags_) {
+    const auto &tag = *kv.second;
+    auto live = tag.live();
+    auto peak = tag.peak();
+    auto tag_units = tag.units();
+    auto per_unit = tag_units > 0 ? static_cast<double>(live) /
+                                        static_cast<double>(tag_units)
+                                  : 0.0;
+    total_live += live;
+    total_peak += peak;
+
+    snprintf(line, sizeof(line), "%-32s %14zu %14zu %12llu %12lld %12.1f",
+             tag.name().c_str(), live, peak,
+             static_cast<unsigned long long>(tag.allocations()),
+             static_cast<long long>(tag_units), per_unit);
+    out += line;
+    if (units > 0) {
+      // Tags without units (connection buffers etc.) don't scale with data
+      auto projected = tag_units > 0 ? per_unit * static_cast<double>(units)
+                                     : static_cast<double>(peak);
+      total_projected += projected;
+      snprintf(line, sizeof(line), " %16.0f", projected);
+      out += line;
+    }
+    out += "\n";
+  }
+
+  snprintf(line, sizeof(line), "%-32s %14zu %14zu", "total", total_live,
+           total_peak);
+  out += line;
+  if (units > 0) {
+    snprintf(line, sizeof(line), " %12s %12lld %12s %16.0f", "",
+             static_cast<long long>(units), "", total_projected);
+    out += line;
+  }
+  out += "\n";
+  return out;
+}
 
-  {
-    // Skip URL fragment
-    for (size_t i = 0; i < req.target.size(); i++) {
-      if (req.target[i] == '#') {
-        req.target.erase(i);
-        break;
-      }
-    }
+inline void append_varint(std::string &out, uint64_t v) {
+  while (v >= 0x80) {
+    out += static_cast<char>((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out += static_cast<char>(v);
+}
 
-    detail::divide(req.target, '?',
-                   [&](const char *lhs_data, std::size_t lhs_size,
-                       const char *rhs_data, std::size_t rhs_size) {
-                     req.path = detail::decode_path(
-                         std::string(lhs_data, lhs_size), false);
-                     detail::parse_query_text(rhs_data, rhs_size, req.params);
-                   });
+inline void append_bytes(std::string &out, const std::string &s) {
+  append_varint(out, s.size());
+  out += s;
+}
+
+inline bool read_varint(const char *&p, const char *end, uint64_t &v) {
+  v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    auto c = static_cast<unsigned char>(*p++);
+    v |= static_cast<uint64_t>(c & 0x7f) << shift;
+    if (!(c & 0x80)) { return true; }
   }
+  return false;
+}
 
+inline bool read_bytes(const char *&p, const char *end, std::string &s) {
+  uint64_t len = 0;
+  if (!read_varint(p, end, len) || len > static_cast<uint64_t>(end - p)) {
+    return false;
+  }
+  s.assign(p, static_cast<size_t>(len));
+  p += len;
   return true;
 }
 
-inline bool Server::write_response(Stream &strm, bool close_connection,
-                                   Request &req, Response &res) {
-  // NOTE: `req.ranges` should be empty, otherwise it will be applied
-  // incorrectly to the error content.
-  req.ranges.clear();
-  return write_response_core(strm, close_connection, req, res, false);
+inline RequestRecorder::RequestRecorder(std::FILE *fp)
+    : fp_(fp), start_(std::chrono::steady_clock::now()) {
+  std::string header = "HLOG";
+  header += static_cast<char>(1);
+  append_varint(header,
+                static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count()));
+  std::fwrite(header.data(), 1, header.size(), fp_);
+
+  writer_ = std::thread([this]() { run(); });
 }
 
-inline bool Server::write_response_with_content(Stream &strm,
-                                                bool close_connection,
-                                                const Request &req,
-                                                Response &res) {
-  return write_response_core(strm, close_connection, req, res, true);
+inline RequestRecorder::~RequestRecorder() {
+  {
+    MutexLock lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  writer_.join();
+  std::fclose(fp_);
+}
+
+inline void RequestRecorder::record(
+    std::chrono::steady_clock::time_point arrival, uint64_t connection,
+    const Request &req) {
+  thread_local std::string payload;
+  thread_local std::string entry;
+
+  payload.clear();
+  auto time_us = arrival > start_
+                     ? std::chrono::duration_cast<std::chrono::microseconds>(
+                           arrival - start_)
+                           .count()
+                     : 0;
+  append_varint(payload, static_cast<uint64_t>(time_us));
+  append_varint(payload, connection);
+  append_bytes(payload, req.method);
+  append_bytes(payload, req.target);
+  append_bytes(payload, req.get_header_value("Content-Type"));
+  append_bytes(payload, req.body);
+
+  entry.clear();
+  append_varint(entry, payload.size());
+  entry += payload;
+
+  auto notify = false;
+  {
+    MutexLock lock(mutex_);
+    if (pending_.size() + entry.size() > CPPHTTPLIB_RECORDING_MAX_BACKLOG) {
+      return;
+    }
+    pending_ += entry;
+    notify = pending_.size() >= 64 * 1024;
+  }
+  if (notify) { cv_.notify_one(); }
 }
 
-inline bool Server::write_response_core(Stream &strm, bool close_connection,
-                                        const Request &req, Response &res,
-                                        bool need_apply_ranges) {
-  assert(res.status != -1);
+inline void RequestRecorder::run() {
+  std::string buf;
+  for (;;) {
+    auto stop = false;
+    {
+      MutexLock lock(mutex_);
+      cv_.wait_for(lock, std::chrono::milliseconds(100),
+                   [&]() { return stop_ || pending_.size() >= 64 * 1024; });
+      buf.swap(pending_);
+      stop = stop_;
+    }
 
-  if (400 <= res.status && error_handler_ &&
-      error_handler_(req, res) == HandlerResponse::Handled) {
-    need_apply_ranges = true;
+    if (!buf.empty()) {
+      std::fwrite(buf.data(), 1, buf.size(), fp_);
+      std::fflush(fp_);
+      buf.clear();
+    }
+    if (stop) { break; }
   }
+}
 
-  std::string content_type;
-  std::string boundary;
-  if (need_apply_ranges) { apply_ranges(req, res, content_type, boundary); }
-
-  // Prepare additional headers
-  if (close_connection || req.get_header_value("Connection") == "close") {
-    res.set_header("Connection", "close");
-  } else {
-    std::string s = "timeout=";
-    s += std::to_string(keep_alive_timeout_sec_);
-    s += ", max=";
-    s += std::to_string(keep_alive_max_count_);
-    res.set_header("Keep-Alive", s);
+inline std::string json_escape(const std::string &s) {
+  std::string ret;
+  for (auto ch : s) {
+    auto c = static_cast<unsigned char>(ch);
+    if (c == '"' || c == '\\') {
+      ret += '\\';
+      ret += static_cast<char>(c);
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      ret += buf;
+    } else {
+      ret += static_cast<char>(c);
+    }
   }
+  return ret;
+}
 
-  if ((!res.body.empty() || res.content_length_ > 0 || res.content_provider_) &&
-      !res.has_header("Content-Type")) {
-    res.set_header("Content-Type", "text/plain");
+inline AsyncLogWriter::AsyncLogWriter(std::FILE *fp, size_t capacity)
+    : fp_(fp), mask_([](size_t n) {
+        size_t size = 2;
+        while (size < n) { size <<= 1; }
+        return size - 1;
+      }(capacity)) {
+  cells_.reset(new Cell[mask_ + 1]);
+  for (size_t i = 0; i <= mask_; i++) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
   }
+  writer_ = std::thread([this]() { run(); });
+}
 
-  if (res.body.empty() && !res.content_length_ && !res.content_provider_ &&
-      !res.has_header("Content-Length")) {
-    res.set_header("Content-Length", "0");
+inline AsyncLogWriter::~AsyncLogWriter() {
+  stop_.store(true, std::memory_order_release);
+  writer_.join();
+  std::fclose(fp_);
+}
+
+// Vyukov's bounded queue: a cell is free for the producer at position `pos`
+// when its sequence equals `pos`, and ready for the consumer at `pos + 1`.
+inline bool AsyncLogWriter::push(std::string &&line) {
+  auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+  for (;;) {
+    auto &cell = cells_[pos & mask_];
+    auto sequence = cell.sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        cell.line = std::move(line);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
   }
+}
 
-  if (req.method == "HEAD" && !res.has_header("Accept-Ranges")) {
-    res.set_header("Accept-Ranges", "bytes");
+inline bool AsyncLogWriter::pop(std::string &line) {
+  auto &cell = cells_[dequeue_pos_ & mask_];
+  auto sequence = cell.sequence.load(std::memory_order_acquire);
+  if (sequence != dequeue_pos_ + 1) { return false; }
+  line.swap(cell.line);
+  cell.line.clear();
+  cell.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+  dequeue_pos_++;
+  return true;
+}
+
+inline void AsyncLogWriter::run() {
+  std::string line;
+  std::string batch;
+  for (;;) {
+    auto stopping = stop_.load(std::memory_order_acquire);
+    while (pop(line)) {
+      batch += line;
+      batch += '\n';
+    }
+    auto dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+      batch += "{\"dropped\":" + std::to_string(dropped) + "}\n";
+    }
+
+    if (!batch.empty()) {
+      std::fwrite(batch.data(), 1, batch.size(), fp_);
+      std::fflush(fp_);
+      batch.clear();
+    } else if (!stopping) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (stopping) { break; }
   }
+}
 
-  if (post_routing_handler_) { post_routing_handler_(req, res); }
+inline SlowRequestLog::SlowRequestLog(std::FILE *fp,
+                                      const SlowRequestLogOptions &options)
+    : options_(options), salt_(std::random_device()()),
+      writer_(fp, options.queue_capacity) {
+  salt_ = (salt_ << 32) ^ std::random_device()();
+}
 
-  // Response line and headers
-  {
-    detail::BufferStream bstrm;
-    if (!detail::write_response_line(bstrm, res.status)) { return false; }
-    if (!header_writer_(bstrm, res.headers)) { return false; }
+inline std::string SlowRequestLog::value(const std::string &key,
+                                         const std::string &value) const {
+  if (std::find(options_.hashed_params.begin(), options_.hashed_params.end(),
+                key) == options_.hashed_params.end()) {
+    return json_escape(value);
+  }
 
-    // Flush buffer
-    auto &data = bstrm.get_buffer();
-    detail::write_data(strm, data.data(), data.size());
+  // FNV-1a over the salt and the value
+  auto h = 14695981039346656037ull;
+  auto mix = [&](unsigned char c) {
+    h ^= c;
+    h *= 1099511628211ull;
+  };
+  for (int i = 0; i < 8; i++) {
+    mix(static_cast<unsigned char>(salt_ >> (i * 8)));
+  }
+  for (auto c : value) {
+    mix(static_cast<unsigned char>(c));
   }
+  char buf[24];
+  snprintf(buf, sizeof(buf), "h:%016llx", static_cast<unsigned long long>(h));
+  return buf;
+}
 
-  // Body
-  auto ret = true;
-  if (req.method != "HEAD") {
-    if (!res.body.empty()) {
-      if (!detail::write_data(strm, res.body.data(), res.body.size())) {
-        ret = false;
-      }
-    } else if (res.content_provider_) {
-      if (write_content_with_provider(strm, req, res, boundary, content_type)) {
-        res.content_provider_success_ = true;
-      } else {
-        ret = false;
+inline void SlowRequestLog::log(const Request &req, int status,
+                                std::chrono::steady_clock::time_point start,
+                                std::chrono::steady_clock::time_point end,
+                                const RequestStages &stages) {
+  const char *reason = nullptr;
+  if (end - start >= options_.threshold) {
+    reason = "slow";
+  } else if (options_.sample_one_in) {
+    thread_local std::minstd_rand rng(std::random_device{}());
+    if (rng() % options_.sample_one_in == 0) { reason = "sample"; }
+  }
+  if (!reason) { return; }
+
+  auto ms = [](std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+  char num[32];
+
+  std::string out = "{\"ts\":";
+  out += std::to_string(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  out += ",\"reason\":\"";
+  out += reason;
+  out += "\",\"method\":\"" + json_escape(req.method);
+  out += "\",\"route\":\"";
+  out += json_escape(req.matched_route.empty() ? req.path
+                                               : req.matched_route);
+  out += "\",\"status\":" + std::to_string(status);
+  snprintf(num, sizeof(num), "%.3f", ms(end - start));
+  out += ",\"duration_ms\":";
+  out += num;
+
+  out += ",\"params\":{";
+  auto first = true;
+  auto add_field = [&](const std::string &key, const std::string &val) {
+    if (!first) { out += ','; }
+    first = false;
+    out += "\"" + json_escape(key) + "\":\"" + value(key, val) + "\"";
+  };
+  for (const auto &kv : req.path_params) {
+    add_field(kv.first, kv.second);
+  }
+  for (const auto &kv : req.params) {
+    add_field(kv.first, kv.second);
+  }
+
+  out += "},\"stages\":[";
+  for (size_t i = 0; i < stages.count; i++) {
+    const auto &stage = stages.stages[i];
+    if (i) { out += ','; }
+    snprintf(num, sizeof(num), "%.3f", ms(stage.start - start));
+    out += "{\"name\":\"" + json_escape(stage.name) + "\",\"start_ms\":";
+    out += num;
+    snprintf(num, sizeof(num), "%.3f", ms(stage.duration));
+    out += ",\"ms\":";
+    out += num;
+    out += '}';
+  }
+
+  out += "],\"fields\":{";
+  first = true;
+  for (const auto &kv : stages.fields) {
+    add_field(kv.first, kv.second);
+  }
+  out += "}}";
+
+  writer_.push(std::move(out));
+}
+
+inline StageTracer::StageTracer(size_t events_per_thread)
+    : capacity_((std::max)(events_per_thread, static_cast<size_t>(1))),
+      epoch_(std::chrono::steady_clock::now()) {}
+
+inline void StageTracer::record(const char *name, uint64_t request_id,
+                                std::chrono::steady_clock::time_point start,
+                                std::chrono::steady_clock::time_point end,
+                                const std::string &detail) {
+  auto &ring = rings_.local();
+  auto slots = ring.slots.load(std::memory_order_relaxed);
+  if (!slots) {
+    ring.storage.reset(new Slot[capacity_]);
+    ring.tid = ++tid_;
+    slots = ring.storage.get();
+    ring.slots.store(slots, std::memory_order_release);
+  }
+
+  auto &slot = slots[ring.next++ % capacity_];
+  auto seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto &e = slot.event;
+  e.name = name;
+  e.request_id = request_id;
+  e.start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   start - epoch_)
+                   .count();
+  e.dur_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  auto len = (std::min)(detail.size(), sizeof(e.detail) - 1);
+  memcpy(e.detail, detail.data(), len);
+  e.detail[len] = '\0';
+
+  slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+// NOTE: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+inline std::string StageTracer::to_json(
+    std::chrono::steady_clock::time_point since) const {
+  auto since_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(since - epoch_)
+          .count();
+
+  auto escape = [](const char *p) { return json_escape(p); };
+
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  auto first = true;
+  auto separator = [&]() {
+    if (!first) { out += ",\n"; }
+    first = false;
+  };
+
+  rings_.for_each([&](const Ring &ring) {
+    auto slots = ring.slots.load(std::memory_order_acquire);
+    if (!slots) { return; }
+
+    auto tid = std::to_string(ring.tid);
+    separator();
+    out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid +
+           ",\"args\":{\"name\":\"worker " + tid + "\"}}";
+
+    for (size_t i = 0; i < capacity_; i++) {
+      const auto &slot = slots[i];
+      auto seq = slot.seq.load(std::memory_order_acquire);
+      if (!seq || (seq & 1)) { continue; }
+      TraceEvent e = slot.event;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq) { continue; }
+
+      if (!e.name || e.start_ns < since_ns) { continue; }
+
+      char times[64];
+      snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f",
+               static_cast<double>(e.start_ns) / 1000.0,
+               static_cast<double>(e.dur_ns) / 1000.0);
+
+      separator();
+      out += "{\"name\":\"";
+      out += escape(e.name);
+      out += "\",\"cat\":\"httplib\",\"ph\":\"X\",";
+      out += times;
+      out += ",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"request\":" +
+             std::to_string(e.request_id);
+      if (e.detail[0]) {
+        out += ",\"detail\":\"";
+        out += escape(e.detail);
+        out += "\"";
       }
+      out += "}}";
     }
-  }
+  });
 
-  // Log
-  if (logger_) { logger_(req, res); }
+  out += "]}";
+  return out;
+}
 
-  return ret;
+inline std::shared_ptr<const CachedAsset>
+AssetCache::find(const std::string &path) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = assets_.find(path);
+  return it != assets_.end() ? it->second : nullptr;
 }
 
-inline bool
-Server::write_content_with_provider(Stream &strm, const Request &req,
-                                    Response &res, const std::string &boundary,
-                                    const std::string &content_type) {
-  auto is_shutting_down = [this]() {
-    return this->svr_sock_ == INVALID_SOCKET;
-  };
+inline std::shared_ptr<const CachedAsset>
+AssetCache::load(const std::string &path, const std::string &content_type) {
+  FileStat stat(path);
+  mmap mm(path.c_str());
+  if (!mm.is_open()) { return nullptr; }
+
+  auto asset = std::make_shared<CachedAsset>();
+  asset->data.assign(mm.data(), mm.size());
+  asset->content_type = content_type;
+  asset->etag = make_etag(asset->data);
+  asset->last_modified = http_date(stat.mtime());
+  if (precompress_ && can_compress_content_type(content_type)) {
+    add_variants(path, *asset);
+  }
+
+  // Another thread may have loaded the same file meanwhile; keep the first
+  std::lock_guard<std::mutex> guard(mutex_);
+  return assets_.emplace(path, std::move(asset)).first->second;
+}
 
-  if (res.content_length_ > 0) {
-    if (req.ranges.empty()) {
-      return detail::write_content(strm, res.content_provider_, 0,
-                                   res.content_length_, is_shutting_down);
-    } else if (req.ranges.size() == 1) {
-      auto offset_and_length = detail::get_range_offset_and_length(
-          req.ranges[0], res.content_length_);
+inline void AssetCache::add_variants(const std::string &path,
+                                     CachedAsset &asset) const {
+  auto add = [&](const char *content_encoding, const char *ext,
+                 std::unique_ptr<compressor> comp) {
+    CachedAsset::Variant v;
+    v.content_encoding = content_encoding;
 
-      return detail::write_content(strm, res.content_provider_,
-                                   offset_and_length.first,
-                                   offset_and_length.second, is_shutting_down);
-    } else {
-      return detail::write_multipart_ranges_data(
-          strm, req, res, boundary, content_type, res.content_length_,
-          is_shutting_down);
+    mmap sibling((path + ext).c_str());
+    if (sibling.is_open()) {
+      v.data.assign(sibling.data(), sibling.size());
+    } else if (!comp ||
+               !comp->compress(asset.data.data(), asset.data.size(), true,
+                               [&](const char *data, size_t data_len) {
+                                 v.data.append(data, data_len);
+                                 return true;
+                               })) {
+      return;
     }
-  } else {
-    if (res.is_chunked_content_provider_) {
-      auto type = detail::encoding_type(req, res);
 
-      std::unique_ptr<detail::compressor> compressor;
-      if (type == detail::EncodingType::Gzip) {
+    // Not worth a round of content negotiation
+    if (v.data.size() >= asset.data.size()) { return; }
+
+    // A strong validator has to differ between representations
+    v.etag = asset.etag;
+    v.etag.insert(v.etag.size() - 1, std::string("-") + content_encoding);
+    asset.variants.push_back(std::move(v));
+  };
+
+  std::unique_ptr<compressor> gzip, brotli, zstd;
 #ifdef CPPHTTPLIB_ZLIB_SUPPORT
-        compressor = detail::make_unique<detail::gzip_compressor>();
+  gzip = detail::make_unique<gzip_compressor>();
 #endif
-      } else if (type == detail::EncodingType::Brotli) {
 #ifdef CPPHTTPLIB_BROTLI_SUPPORT
-        compressor = detail::make_unique<detail::brotli_compressor>();
+  brotli = detail::make_unique<brotli_compressor>();
 #endif
-      } else if (type == detail::EncodingType::Zstd) {
 #ifdef CPPHTTPLIB_ZSTD_SUPPORT
-        compressor = detail::make_unique<detail::zstd_compressor>();
+  zstd = detail::make_unique<zstd_compressor>();
 #endif
-      } else {
-        compressor = detail::make_unique<detail::nocompressor>();
-      }
-      assert(compressor != nullptr);
 
-      return detail::write_content_chunked(strm, res.content_provider_,
-                                           is_shutting_down, *compressor);
-    } else {
-      return detail::write_content_without_length(strm, res.content_provider_,
-                                                  is_shutting_down);
-    }
-  }
+  add("br", ".br", std::move(brotli));
+  add("zstd", ".zst", std::move(zstd));
+  add("gzip", ".gz", std::move(gzip));
+
+  std::sort(asset.variants.begin(), asset.variants.end(),
+            [](const CachedAsset::Variant &a, const CachedAsset::Variant &b) {
+              return a.data.size() < b.data.size();
+            });
 }
 
-inline bool Server::read_content(Stream &strm, Request &req, Response &res) {
-  FormFields::iterator cur_field;
-  FormFiles::iterator cur_file;
-  auto is_text_field = false;
-  size_t count = 0;
-  if (read_content_core(
-          strm, req, res,
-          // Regular
-          [&](const char *buf, size_t n) {
-            if (req.body.size() + n > req.body.max_size()) { return false; }
-            req.body.append(buf, n);
-            return true;
-          },
-          // Multipart FormData
-          [&](const FormData &file) {
-            if (count++ == CPPHTTPLIB_MULTIPART_FORM_DATA_FILE_MAX_COUNT) {
-              return false;
-            }
+} // namespace detail
 
-            if (file.filename.empty()) {
-              cur_field = req.form.fields.emplace(
-                  file.name, FormField{file.name, file.content, file.headers});
-              is_text_field = true;
-            } else {
-              cur_file = req.form.files.emplace(file.name, file);
-              is_text_field = false;
-            }
-            return true;
-          },
-          [&](const char *buf, size_t n) {
-            if (is_text_field) {
-              auto &content = cur_field->second.content;
-              if (content.size() + n > content.max_size()) { return false; }
-              content.append(buf, n);
-            } else {
-              auto &content = cur_file->second.content;
-              if (content.size() + n > content.max_size()) { return false; }
-              content.append(buf, n);
-            }
-            return true;
-          })) {
-    const auto &content_type = req.get_header_value("Content-Type");
-    if (!content_type.find("application/x-www-form-urlencoded")) {
-      if (req.body.size() > CPPHTTPLIB_FORM_URL_ENCODED_PAYLOAD_MAX_LENGTH) {
-        res.status = StatusCode::PayloadTooLarge_413; // NOTE: should be 414?
-        return false;
-      }
-      detail::parse_query_text(req.body, req.params);
+inline bool read_request_log(const std::string &path,
+                             std::vector<RecordedRequest> &requests,
+                             uint64_t *start_unix_us) {
+  auto fp = std::fopen(path.c_str(), "rb");
+  if (!fp) { return false; }
+
+  std::string data;
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0) {
+    data.append(buf, n);
+  }
+  std::fclose(fp);
+
+  if (data.size() < 5 || data.compare(0, 4, "HLOG") != 0 || data[4] != 1) {
+    return false;
+  }
+
+  const char *p = data.data() + 5;
+  const char *end = data.data() + data.size();
+  uint64_t start = 0;
+  if (!detail::read_varint(p, end, start)) { return false; }
+  if (start_unix_us) { *start_unix_us = start; }
+
+  while (p < end) {
+    uint64_t len = 0;
+    if (!detail::read_varint(p, end, len) ||
+        len > static_cast<uint64_t>(end - p)) {
+      break;
     }
-    return true;
+
+    auto record_end = p + len;
+    RecordedRequest r;
+    if (!detail::read_varint(p, record_end, r.time_us) ||
+        !detail::read_varint(p, record_end, r.connection) ||
+        !detail::read_bytes(p, record_end, r.method) ||
+        !detail::read_bytes(p, record_end, r.target) ||
+        !detail::read_bytes(p, record_end, r.content_type) ||
+        !detail::read_bytes(p, record_end, r.body)) {
+      return false;
+    }
+    requests.push_back(std::move(r));
+    p = record_end;
   }
-  return false;
+  return true;
 }
 
-inline bool Server::read_content_with_content_receiver(
-    Stream &strm, Request &req, Response &res, ContentReceiver receiver,
-    FormDataHeader multipart_header, ContentReceiver multipart_receiver) {
-  return read_content_core(strm, req, res, std::move(receiver),
-                           std::move(multipart_header),
-                           std::move(multipart_receiver));
-}
+inline EventHub::EventHub(const EventStreamOptions &options)
+    : options_(options),
+      max_streams_(
+          options_.max_streams
+              ? options_.max_streams
+              : (std::max)(size_t(1),
+                           detail::worker_count(options_.worker_count) / 4)) {}
 
-inline bool Server::read_content_core(
-    Stream &strm, Request &req, Response &res, ContentReceiver receiver,
-    FormDataHeader multipart_header, ContentReceiver multipart_receiver) const {
-  detail::FormDataParser multipart_form_data_parser;
-  ContentReceiverWithProgress out;
+inline EventHub::~EventHub() { close(); }
 
-  if (req.is_multipart_form_data()) {
-    const auto &content_type = req.get_header_value("Content-Type");
-    std::string boundary;
-    if (!detail::parse_multipart_boundary(content_type, boundary)) {
-      res.status = StatusCode::BadRequest_400;
+inline bool EventHub::publish(const std::string &topic,
+                              const std::string &event,
+                              const std::string &data) {
+  {
+    MutexLock lock(mutex_);
+    auto it = topics_.find(topic);
+    if (it == topics_.end()) { return false; }
+    it->second.event = event;
+    it->second.data = data;
+    it->second.version = ++version_;
+  }
+  cv_.notify_all();
+  return true;
+}
+
+inline bool EventHub::subscribe(Response &res,
+                                std::vector<std::string> topics) {
+  auto stream = std::make_shared<Stream>();
+  {
+    MutexLock lock(mutex_);
+    if (closed_ || streams_ >= max_streams_) {
+      res.status = StatusCode::ServiceUnavailable_503;
+      res.set_content("Too many event streams", "text/plain");
       return false;
     }
 
-    multipart_form_data_parser.set_boundary(std::move(boundary));
-    out = [&](const char *buf, size_t n, size_t /*off*/, size_t /*len*/) {
-      return multipart_form_data_parser.parse(buf, n, multipart_header,
-                                              multipart_receiver);
-    };
-  } else {
-    out = [receiver](const char *buf, size_t n, size_t /*off*/,
-                     size_t /*len*/) { return receiver(buf, n); };
-  }
+    std::sort(topics.begin(), topics.end());
+    topics.erase(std::unique(topics.begin(), topics.end()), topics.end());
+    for (const auto &topic : topics) {
+      topics_[topic].subscribers++;
+    }
+    streams_++;
 
-  if (req.method == "DELETE" && !req.has_header("Content-Length")) {
-    return true;
+    stream->topics = std::move(topics);
+    stream->sent.assign(stream->topics.size(), 0);
+    stream->last_write = std::chrono::steady_clock::now();
   }
 
-  if (!detail::read_content(strm, req, payload_max_length_, res.status, nullptr,
-                            out, true)) {
-    return false;
-  }
+  res.set_header("Cache-Control", "no-cache");
+  res.set_chunked_content_provider(
+      "text/event-stream",
+      [this, stream](size_t /*offset*/, DataSink &sink) {
+        std::string chunk;
+        if (!next_chunk(*stream, chunk)) {
+          sink.done();
+          return true;
+        }
+        return chunk.empty() || sink.write(chunk.data(), chunk.size());
+      },
+      [this, stream](bool /*success*/) { release(*stream); });
+  return true;
+}
 
-  if (req.is_multipart_form_data()) {
-    if (!multipart_form_data_parser.is_valid()) {
-      res.status = StatusCode::BadRequest_400;
-      return false;
+inline std::vector<std::string>
+EventHub::subscribed_topics(const std::string &prefix) const {
+  std::vector<std::string> ret;
+  MutexLock lock(mutex_);
+  for (const auto &kv : topics_) {
+    if (kv.first.compare(0, prefix.size(), prefix) == 0) {
+      ret.push_back(kv.first);
     }
   }
+  return ret;
+}
 
-  return true;
+inline size_t EventHub::stream_count() const {
+  MutexLock lock(mutex_);
+  return streams_;
 }
 
-inline bool Server::handle_file_request(const Request &req, Response &res) {
-  for (const auto &entry : base_dirs_) {
-    // Prefix match
-    if (!req.path.compare(0, entry.mount_point.size(), entry.mount_point)) {
-      std::string sub_path = "/" + req.path.substr(entry.mount_point.size());
-      if (detail::is_valid_path(sub_path)) {
-        auto path = entry.base_dir + sub_path;
-        if (path.back() == '/') { path += "index.html"; }
+inline void EventHub::close() {
+  {
+    MutexLock lock(mutex_);
+    closed_ = true;
+  }
+  cv_.notify_all();
+}
 
-        detail::FileStat stat(path);
+// Called with mutex_ held
+inline bool EventHub::has_update(Stream &stream) {
+  if (stream.checked == version_) { return false; }
+  for (size_t i = 0; i < stream.topics.size(); i++) {
+    auto it = topics_.find(stream.topics[i]);
+    if (it != topics_.end() && it->second.version > stream.sent[i]) {
+      return true;
+    }
+  }
+  stream.checked = version_; // Only other topics changed
+  return false;
+}
 
-        if (stat.is_dir()) {
-          res.set_redirect(sub_path + "/", StatusCode::MovedPermanently_301);
-          return true;
-        }
+// Returns false once the hub is closed. An empty chunk means nothing to
+// send yet; the provider returns so the server can check for shutdown.
+inline bool EventHub::next_chunk(Stream &stream, std::string &chunk) {
+  using clock = std::chrono::steady_clock;
 
-        if (stat.is_file()) {
-          for (const auto &kv : entry.headers) {
-            res.set_header(kv.first, kv.second);
-          }
+  MutexLock lock(mutex_);
+  auto now = clock::now();
+  auto deadline = (std::min)(stream.last_write + options_.keepalive_interval,
+                             now + std::chrono::seconds(1));
+  cv_.wait_until(lock, deadline,
+                 [&]() { return closed_ || has_update(stream); });
+  if (closed_) { return false; }
 
-          auto mm = std::make_shared<detail::mmap>(path.c_str());
-          if (!mm->is_open()) { return false; }
+  now = clock::now();
+  if (!has_update(stream)) {
+    if (now >= stream.last_write + options_.keepalive_interval) {
+      chunk = ": keepalive\n\n";
+      stream.last_write = now;
+    }
+    return true;
+  }
 
-          res.set_content_provider(
-              mm->size(),
-              detail::find_content_type(path, file_extension_and_mimetype_map_,
-                                        default_file_mimetype_),
-              [mm](size_t offset, size_t length, DataSink &sink) -> bool {
-                sink.write(mm->data() + offset, length);
-                return true;
-              });
+  // Hold the event back until a full interval since the last one, so
+  // updates arriving meanwhile go out together
+  auto flush_at = stream.last_flush + options_.coalesce_interval;
+  if (now < flush_at) {
+    cv_.wait_until(lock, flush_at, [&]() { return closed_; });
+    if (closed_) { return false; }
+    now = clock::now();
+  }
 
-          if (req.method != "HEAD" && file_request_handler_) {
-            file_request_handler_(req, res);
-          }
+  for (size_t i = 0; i < stream.topics.size(); i++) {
+    auto it = topics_.find(stream.topics[i]);
+    if (it == topics_.end() || it->second.version <= stream.sent[i]) {
+      continue;
+    }
+    const auto &topic = it->second;
+    if (!topic.event.empty()) { chunk += "event: " + topic.event + "\n"; }
+    // Every line of a multi-line payload needs its own data field
+    size_t pos = 0;
+    for (;;) {
+      auto nl = topic.data.find('\n', pos);
+      chunk += "data: ";
+      chunk.append(topic.data, pos,
+                   nl == std::string::npos ? std::string::npos : nl - pos);
+      chunk += "\n";
+      if (nl == std::string::npos) { break; }
+      pos = nl + 1;
+    }
+    chunk += "\n";
+    stream.sent[i] = topic.version;
+  }
+  stream.checked = version_;
+  stream.last_flush = now;
+  stream.last_write = now;
+  return true;
+}
 
-          return true;
-        }
-      }
+inline void EventHub::release(Stream &stream) {
+  MutexLock lock(mutex_);
+  for (const auto &topic : stream.topics) {
+    auto it = topics_.find(topic);
+    if (it != topics_.end() && --it->second.subscribers == 0) {
+      topics_.erase(it);
     }
   }
-  return false;
+  streams_--;
 }
 
 inline socket_t
@@ -7791,8 +11324,20 @@ inline bool Server::listen_internal() {
       detail::set_socket_opt_time(sock, SOL_SOCKET, SO_SNDTIMEO,
                                   write_timeout_sec_, write_timeout_usec_);
 
-      if (!task_queue->enqueue(
-              [this, sock]() { process_and_close_socket(sock); })) {
+      auto enqueued = std::chrono::steady_clock::now();
+      if (!task_queue->enqueue([this, sock, enqueued]() {
+            if (metrics_) {
+              metrics_->record_queue_wait(static_cast<uint64_t>(
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - enqueued)
+                      .count()));
+            }
+            if (tracer_ && tracer_->enabled()) {
+              tracer_->record("accept_queue", 0, enqueued,
+                              std::chrono::steady_clock::now());
+            }
+            process_and_close_socket(sock);
+          })) {
         detail::shutdown_socket(sock);
         detail::close_socket(sock);
       }
@@ -7812,11 +11357,14 @@ inline bool Server::routing(Request &req, Response &res, Stream &strm) {
   }
 
   // File handler
-  if ((req.method == "GET" || req.method == "HEAD") &&
-      handle_file_request(req, res)) {
-    return true;
+  if (req.method == "GET" || req.method == "HEAD") {
+    TraceScope trace("mount_point");
+    if (handle_file_request(req, res)) { return true; }
   }
 
+  // Held until the handler returns
+  MemoryCharge body_memory(detail::request_bodies_tag());
+
   if (detail::expect_content(req)) {
     // Content reader handler
     {
@@ -7859,7 +11407,9 @@ inline bool Server::routing(Request &req, Response &res, Stream &strm) {
     }
 
     // Read content into `req.body`
+    TraceScope trace("read_body");
     if (!read_content(strm, req, res)) { return false; }
+    body_memory.set(req.body.capacity());
   }
 
   // Regular handler
@@ -7883,14 +11433,22 @@ inline bool Server::routing(Request &req, Response &res, Stream &strm) {
 
 inline bool Server::dispatch_request(Request &req, Response &res,
                                      const Handlers &handlers) const {
+  auto &trace = detail::trace_context();
+  std::chrono::steady_clock::time_point start;
+  if (trace.active()) { start = std::chrono::steady_clock::now(); }
+
   for (const auto &x : handlers) {
     const auto &matcher = x.first;
     const auto &handler = x.second;
 
     if (matcher->match(req)) {
       req.matched_route = matcher->pattern();
+      if (trace.active()) {
+        trace.record("route", start, std::chrono::steady_clock::now());
+      }
       if (!pre_request_handler_ ||
           pre_request_handler_(req, res) != HandlerResponse::Handled) {
+        TraceScope scope("handler");
         handler(req, res);
       }
       return true;
@@ -7915,8 +11473,6 @@ inline void Server::apply_ranges(const Request &req, Response &res,
                    "multipart/byteranges; boundary=" + boundary);
   }
 
-  auto type = detail::encoding_type(req, res);
-
   if (res.body.empty()) {
     if (res.content_length_ > 0) {
       size_t length = 0;
@@ -7940,12 +11496,11 @@ inline void Server::apply_ranges(const Request &req, Response &res,
       if (res.content_provider_) {
         if (res.is_chunked_content_provider_) {
           res.set_header("Transfer-Encoding", "chunked");
-          if (type == detail::EncodingType::Gzip) {
-            res.set_header("Content-Encoding", "gzip");
-          } else if (type == detail::EncodingType::Brotli) {
-            res.set_header("Content-Encoding", "br");
-          } else if (type == detail::EncodingType::Zstd) {
-            res.set_header("Content-Encoding", "zstd");
+
+          auto type =
+              choose_encoding(req, res, true, 0, res.compression_level_);
+          if (type != detail::EncodingType::None) {
+            res.set_header("Content-Encoding", detail::encoding_name(type));
           }
         }
       }
@@ -7972,39 +11527,28 @@ inline void Server::apply_ranges(const Request &req, Response &res,
       res.body.swap(data);
     }
 
+    int level = -1;
+    auto type = choose_encoding(req, res, false, res.body.size(), level);
+
     if (type != detail::EncodingType::None) {
       if (pre_compression_logger_) { pre_compression_logger_(req, res); }
 
-      std::unique_ptr<detail::compressor> compressor;
-      std::string content_encoding;
-
-      if (type == detail::EncodingType::Gzip) {
-#ifdef CPPHTTPLIB_ZLIB_SUPPORT
-        compressor = detail::make_unique<detail::gzip_compressor>();
-        content_encoding = "gzip";
-#endif
-      } else if (type == detail::EncodingType::Brotli) {
-#ifdef CPPHTTPLIB_BROTLI_SUPPORT
-        compressor = detail::make_unique<detail::brotli_compressor>();
-        content_encoding = "br";
-#endif
-      } else if (type == detail::EncodingType::Zstd) {
-#ifdef CPPHTTPLIB_ZSTD_SUPPORT
-        compressor = detail::make_unique<detail::zstd_compressor>();
-        content_encoding = "zstd";
-#endif
-      }
-
+      auto compressor = detail::thread_local_compressor(type, level);
       if (compressor) {
+        TraceScope trace("compress");
+        detail::measured_compressor measured(*compressor);
         std::string compressed;
-        if (compressor->compress(res.body.data(), res.body.size(), true,
-                                 [&](const char *data, size_t data_len) {
-                                   compressed.append(data, data_len);
-                                   return true;
-                                 })) {
+        compressed.reserve(res.body.size() / 2);
+        if (measured.compress(res.body.data(), res.body.size(), true,
+                              [&](const char *data, size_t data_len) {
+                                compressed.append(data, data_len);
+                                return true;
+                              })) {
           res.body.swap(compressed);
-          res.set_header("Content-Encoding", content_encoding);
+          res.set_header("Content-Encoding", detail::encoding_name(type));
         }
+        record_compression(req, type, level, measured.bytes_in,
+                           measured.bytes_out, measured.cpu_ns);
       }
     }
 
@@ -8046,11 +11590,61 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
   if (!line_reader.getline()) { return false; }
 
   Request req;
+  if (metrics_) { req.start_time_ = std::chrono::steady_clock::now(); }
 
   Response res;
   res.version = "HTTP/1.1";
   res.headers = default_headers_;
 
+  // Recorded once the body has been read
+  std::chrono::steady_clock::time_point arrival;
+  if (recorder_) { arrival = std::chrono::steady_clock::now(); }
+  auto record = detail::scope_exit([&]() {
+    if (recorder_ && !req.method.empty()) {
+      recorder_->record(arrival, detail::recording_connection(), req);
+    }
+  });
+
+  // Stage tracing and the slow-request log. The whole request is recorded
+  // last, so that it carries the status.
+  auto tracer = tracer_ && tracer_->enabled() ? tracer_.get() : nullptr;
+  std::chrono::steady_clock::time_point trace_start;
+  std::chrono::steady_clock::time_point stage_start;
+  auto &trace = detail::trace_context();
+  auto end_stage = [&](const char *name) {
+    if (trace.active()) {
+      auto now = std::chrono::steady_clock::now();
+      trace.record(name, stage_start, now);
+      stage_start = now;
+    }
+  };
+  auto trace_request = detail::scope_exit([&]() {
+    if (!trace.active()) { return; }
+    auto now = std::chrono::steady_clock::now();
+    if (tracer) {
+      tracer->record("request", trace.request_id, trace_start, now,
+                     req.method + " " + req.path + " " +
+                         std::to_string(res.status));
+    }
+    if (trace.stages && !req.method.empty()) {
+      slow_log_->log(req, res.status, trace_start, now, *trace.stages);
+    }
+    trace = detail::TraceContext();
+  });
+  if (tracer) {
+    trace.tracer = tracer;
+    trace.request_id = tracer->next_request_id();
+  }
+  if (slow_log_) {
+    thread_local detail::RequestStages stages;
+    stages.clear();
+    trace.stages = &stages;
+  }
+  if (trace.active()) {
+    trace_start = std::chrono::steady_clock::now();
+    stage_start = trace_start;
+  }
+
 #ifdef __APPLE__
   // Socket file descriptor exceeded FD_SETSIZE...
   if (strm.socket() >= FD_SETSIZE) {
@@ -8063,7 +11657,11 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
 
   // Request line and headers
   if (!parse_request_line(line_reader.ptr(), req) ||
+#ifdef CPPHTTPLIB_ZERO_COPY_HEADERS
+      !detail::read_headers(strm, req)) {
+#else
       !detail::read_headers(strm, req.headers)) {
+#endif
     res.status = StatusCode::BadRequest_400;
     return write_response(strm, close_connection, req, res);
   }
@@ -8113,6 +11711,26 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
 
   if (setup_request) { setup_request(req); }
 
+  end_stage("parse_headers");
+
+  // Admission control, before any request body is read. The slot is held
+  // until the response has been written, except for event streams.
+  auto admitted = false;
+  auto admission_slot = detail::scope_exit([&]() {
+    if (admitted) { admission_->release(); }
+  });
+  if (admission_) {
+    time_t retry_after_sec = 0;
+    if (!admission_->acquire(admission_->classify(req), retry_after_sec)) {
+      res.status = StatusCode::ServiceUnavailable_503;
+      res.set_header("Retry-After", std::to_string(retry_after_sec));
+      connection_closed = true;
+      return write_response(strm, true, req, res);
+    }
+    admitted = true;
+    end_stage("admission");
+  }
+
   if (req.get_header_value("Expect") == "100-continue") {
     int status = StatusCode::Continue_100;
     if (expect_100_continue_handler_) {
@@ -8181,14 +11799,6 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
     // Serve file content by using a content provider
     if (!res.file_content_path_.empty()) {
       const auto &path = res.file_content_path_;
-      auto mm = std::make_shared<detail::mmap>(path.c_str());
-      if (!mm->is_open()) {
-        res.body.clear();
-        res.content_length_ = 0;
-        res.content_provider_ = nullptr;
-        res.status = StatusCode::NotFound_404;
-        return write_response(strm, close_connection, req, res);
-      }
 
       auto content_type = res.file_content_content_type_;
       if (content_type.empty()) {
@@ -8196,12 +11806,13 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
             path, file_extension_and_mimetype_map_, default_file_mimetype_);
       }
 
-      res.set_content_provider(
-          mm->size(), content_type,
-          [mm](size_t offset, size_t length, DataSink &sink) -> bool {
-            sink.write(mm->data() + offset, length);
-            return true;
-          });
+      if (!set_file_content_provider(res, path, content_type)) {
+        res.body.clear();
+        res.content_length_ = 0;
+        res.content_provider_ = nullptr;
+        res.status = StatusCode::NotFound_404;
+        return write_response(strm, close_connection, req, res);
+      }
     }
 
     if (detail::range_error(req, res)) {
@@ -8212,6 +11823,14 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
       return write_response(strm, close_connection, req, res);
     }
 
+    // An event stream writes for as long as its client stays, so it would
+    // pin a slot indefinitely; EventStreamOptions::max_streams bounds those
+    if (admitted && res.is_chunked_content_provider_ &&
+        res.get_header_value("Content-Type") == "text/event-stream") {
+      admitted = false;
+      admission_->release();
+    }
+
     return write_response_with_content(strm, close_connection, req, res);
   } else {
     if (res.status == -1) { res.status = StatusCode::NotFound_404; }
@@ -8231,16 +11850,26 @@ inline bool Server::process_and_close_socket(socket_t sock) {
   int local_port = 0;
   detail::get_local_ip_and_port(sock, local_addr, local_port);
 
+  if (metrics_) { metrics_->connection_opened(); }
+  if (recorder_) {
+    detail::recording_connection() = recorder_->next_connection_id();
+  }
+
   auto ret = detail::process_server_socket(
       svr_sock_, sock, keep_alive_max_count_, keep_alive_timeout_sec_,
       read_timeout_sec_, read_timeout_usec_, write_timeout_sec_,
       write_timeout_usec_,
       [&](Stream &strm, bool close_connection, bool &connection_closed) {
-        return process_request(strm, remote_addr, remote_port, local_addr,
-                               local_port, close_connection, connection_closed,
-                               nullptr);
+        auto process = [&](Stream &s) {
+          return process_request(s, remote_addr, remote_port, local_addr,
+                                 local_port, close_connection,
+                                 connection_closed, nullptr);
+        };
+        return metrics_ ? metrics_->measure(strm, process) : process(strm);
       });
 
+  if (metrics_) { metrics_->connection_closed(); }
+
   detail::shutdown_socket(sock);
   detail::close_socket(sock);
   return ret;
@@ -10190,11 +13819,11 @@ inline bool process_server_socket_ssl(
     size_t keep_alive_max_count, time_t keep_alive_timeout_sec,
     time_t read_timeout_sec, time_t read_timeout_usec, time_t write_timeout_sec,
     time_t write_timeout_usec, T callback) {
+  SSLSocketStream strm(sock, ssl, read_timeout_sec, read_timeout_usec,
+                       write_timeout_sec, write_timeout_usec);
   return process_server_socket_core(
-      svr_sock, sock, keep_alive_max_count, keep_alive_timeout_sec,
+      svr_sock, sock, keep_alive_max_count, keep_alive_timeout_sec, strm,
       [&](bool close_connection, bool &connection_closed) {
-        SSLSocketStream strm(sock, ssl, read_timeout_sec, read_timeout_usec,
-                             write_timeout_sec, write_timeout_usec);
         return callback(strm, close_connection, connection_closed);
       });
 }
@@ -10448,17 +14077,27 @@ inline bool SSLServer::process_and_close_socket(socket_t sock) {
     int local_port = 0;
     detail::get_local_ip_and_port(sock, local_addr, local_port);
 
+    if (metrics_) { metrics_->connection_opened(); }
+    if (recorder_) {
+      detail::recording_connection() = recorder_->next_connection_id();
+    }
+
     ret = detail::process_server_socket_ssl(
         svr_sock_, ssl, sock, keep_alive_max_count_, keep_alive_timeout_sec_,
         read_timeout_sec_, read_timeout_usec_, write_timeout_sec_,
         write_timeout_usec_,
         [&](Stream &strm, bool close_connection, bool &connection_closed) {
-          return process_request(strm, remote_addr, remote_port, local_addr,
-                                 local_port, close_connection,
-                                 connection_closed,
-                                 [&](Request &req) { req.ssl = ssl; });
+          auto process = [&](Stream &s) {
+            return process_request(s, remote_addr, remote_port, local_addr,
+                                   local_port, close_connection,
+                                   connection_closed,
+                                   [&](Request &req) { req.ssl = ssl; });
+          };
+          return metrics_ ? metrics_->measure(strm, process) : process(strm);
         });
 
+    if (metrics_) { metrics_->connection_closed(); }
+
     // Shutdown gracefully if the result seemed successful, non-gracefully if
     // the connection appeared to be closed.
     const bool shutdown_gracefully = ret;
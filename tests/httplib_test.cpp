@@ -0,0 +1,197 @@
+// cpp-httplib 扩展功能的回归测试
+//
+// 每个用例在本机端口上起一个 Server，用 Client 发请求检查行为。
+// 不依赖测试框架：失败时打印位置并以非零退出码结束，由 ctest 运行。
+
+#include <httplib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, \
+                         #cond);                                             \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+const char *HOST = "127.0.0.1";
+const int PORT = 18480;
+
+// 在后台线程监听，析构时停止
+class ServerThread {
+public:
+    explicit ServerThread(httplib::Server &svr) : svr_(svr) {
+        thread_ = std::thread([this] { svr_.listen(HOST, PORT); });
+        svr_.wait_until_ready();
+    }
+    ~ServerThread() {
+        svr_.stop();
+        thread_.join();
+    }
+
+private:
+    httplib::Server &svr_;
+    std::thread thread_;
+};
+
+void testIfNoneMatchList() {
+    namespace fs = std::filesystem;
+    auto dir = fs::temp_directory_path() / "httplib_test_www";
+    fs::create_directories(dir);
+    std::ofstream(dir / "index.html") << "<html>余票</html>";
+
+    httplib::Server svr;
+    httplib::MountPointOptions options;
+    options.cache_files = true;
+    svr.set_mount_point("/", dir.string(), {}, options);
+    ServerThread running(svr);
+
+    httplib::Client cli(HOST, PORT);
+    auto res = cli.Get("/index.html");
+    CHECK(res && res->status == 200);
+    auto etag = res ? res->get_header_value("ETag") : std::string();
+    CHECK(!etag.empty());
+
+    // 任意一个实体标签匹配即可，不只看第一个
+    res = cli.Get("/index.html", {{"If-None-Match", "\"a\", " + etag}});
+    CHECK(res && res->status == 304);
+    res = cli.Get("/index.html", {{"If-None-Match", "\"a\", W/" + etag}});
+    CHECK(res && res->status == 304);
+    res = cli.Get("/index.html", {{"If-None-Match", "\"a\", \"b\""}});
+    CHECK(res && res->status == 200);
+    res = cli.Get("/index.html", {{"If-None-Match", "*"}});
+    CHECK(res && res->status == 304);
+
+    fs::remove_all(dir);
+}
+
+void testAdmissionShedsWhenTopClassSaturated() {
+    using namespace std::chrono;
+
+    // 8 个工作线程、2 个槽位：最多 (8 - 2) / 2 = 3 个请求排队，其余线程留给读取和拒绝
+    std::promise<void> release;
+    auto released = release.get_future().share();
+
+    httplib::Server svr;
+    svr.new_task_queue = [] { return new httplib::ThreadPool(8); };
+    svr.Post("/book", [&](const httplib::Request &, httplib::Response &res) {
+        released.wait();
+        res.set_content("ok", "text/plain");
+    });
+    svr.Get("/search", [](const httplib::Request &, httplib::Response &res) {
+        res.set_content("ok", "text/plain");
+    });
+
+    httplib::AdmissionControl ac;
+    ac.worker_count = 8;
+    ac.max_concurrency = 2;
+    httplib::AdmissionClass booking;
+    booking.name = "booking";
+    booking.routes = {"POST /book"};
+    booking.sheddable = false;
+    booking.max_wait = seconds(10);
+    httplib::AdmissionClass search;
+    search.name = "search";
+    ac.classes = {booking, search};
+    svr.set_admission_control(ac);
+    ServerThread running(svr);
+
+    // 用预订请求占满槽位和全部排队名额
+    std::atomic<int> bookShed{0};
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 8; i++) {
+        clients.emplace_back([&] {
+            httplib::Client cli(HOST, PORT);
+            cli.set_read_timeout(10, 0);
+            auto res = cli.Post("/book", "{}", "application/json");
+            if (res && res->status == 503) { bookShed++; }
+        });
+        // 监听队列很短，同时发起的连接会被内核延迟到重传
+        std::this_thread::sleep_for(milliseconds(20));
+    }
+    std::this_thread::sleep_for(milliseconds(200));
+    CHECK(bookShed == 3);
+
+    // 仍有空闲线程读取新请求，立即拒绝而不是在线程池队列里等待
+    auto checkShedQuickly = [](std::function<httplib::Result(httplib::Client &)> send) {
+        httplib::Client cli(HOST, PORT);
+        auto start = steady_clock::now();
+        auto res = send(cli);
+        auto elapsed = steady_clock::now() - start;
+        CHECK(res && res->status == 503);
+        CHECK(res && res->has_header("Retry-After"));
+        CHECK(elapsed < milliseconds(200));
+    };
+    checkShedQuickly([](httplib::Client &cli) {
+        return cli.Post("/book", "{}", "application/json");
+    });
+    checkShedQuickly([](httplib::Client &cli) { return cli.Get("/search"); });
+
+    release.set_value();
+    for (auto &t : clients) { t.join(); }
+
+    // 槽位释放后恢复正常
+    httplib::Client cli(HOST, PORT);
+    auto res = cli.Get("/search");
+    CHECK(res && res->status == 200);
+}
+
+void testTraceCaptureRejectsOverlap() {
+    httplib::Server svr;
+    svr.set_trace_endpoint();
+    svr.Get("/ping", [](const httplib::Request &, httplib::Response &res) {
+        res.set_content("pong", "text/plain");
+    });
+    ServerThread running(svr);
+
+    httplib::Result first;
+    std::thread capture([&] {
+        httplib::Client cli(HOST, PORT);
+        first = cli.Get("/debug/trace?seconds=1");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    httplib::Client cli(HOST, PORT);
+    CHECK(cli.Get("/ping"));
+    auto second = cli.Get("/debug/trace?seconds=1");
+    CHECK(second && second->status == 409);
+
+    capture.join();
+    CHECK(first && first->status == 200);
+    // 捕获期间的 /ping 请求被记录
+    CHECK(first && first->body.find("parse_headers") != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    const std::vector<std::pair<const char *, std::function<void()>>> tests = {
+        {"IfNoneMatchList", testIfNoneMatchList},
+        {"AdmissionShedsWhenTopClassSaturated",
+         testAdmissionShedsWhenTopClassSaturated},
+        {"TraceCaptureRejectsOverlap", testTraceCaptureRejectsOverlap},
+    };
+
+    for (const auto &test : tests) {
+        auto before = failures;
+        test.second();
+        std::printf("%s %s\n", failures == before ? "[通过]" : "[失败]",
+                    test.first);
+    }
+    return failures ? 1 : 0;
+}
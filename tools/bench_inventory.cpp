@@ -0,0 +1,353 @@
+// 座位库存内核微基准
+//
+// 车型布局与 manage_database.js 一致（座位号由 generateSeatNumbers 生成），
+// 按不同上座率和碎片化模式预置已售座位后，测量：
+//   - 区间可用座位数统计
+//   - 首次适配查找 / 分配
+//   - 取消与恢复
+//   - 从快照（seat_allocations 行）加载
+// 带 _Scan 后缀的用例按 back-end.js 中 SQL 的思路逐条扫描分配记录，作为对照。
+//
+// 默认把结果以 JSON 写入 bench_inventory.json，便于不同构建之间对比，例如
+//   compare.py benchmarks before.json after.json
+
+#include "seat_inventory.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using inventory::Allocation;
+using inventory::AllocationList;
+using inventory::SeatInventory;
+using inventory::TrainLayout;
+
+const std::vector<TrainLayout> &layouts()
+{
+    static const std::vector<TrainLayout> data = {
+        // 种子数据中的 G101 与 K301
+        {"G101", 5,
+         {{"01", "二等座", 100}, {"02", "二等座", 100},
+          {"03", "一等座", 60}, {"04", "商务座", 24}}},
+        {"K301", 2, {{"01", "硬座", 118}, {"02", "硬卧", 60}, {"03", "软卧", 36}}},
+        // 16 节编组高铁，12 个经停站
+        {"G16", 12,
+         {{"01", "商务座", 24}, {"02", "一等座", 60}, {"03", "一等座", 60},
+          {"04", "二等座", 100}, {"05", "二等座", 100}, {"06", "二等座", 100},
+          {"07", "二等座", 100}, {"08", "二等座", 100}, {"09", "二等座", 100},
+          {"10", "二等座", 100}, {"11", "二等座", 100}, {"12", "二等座", 100},
+          {"13", "二等座", 100}, {"14", "一等座", 60}, {"15", "一等座", 60},
+          {"16", "商务座", 24}}},
+        // 18 节编组普速卧铺车，30 个经停站
+        {"K18", 30,
+         {{"01", "硬座", 118}, {"02", "硬座", 118}, {"03", "硬座", 118},
+          {"04", "硬座", 118}, {"05", "硬座", 118}, {"06", "硬座", 118},
+          {"07", "硬卧", 60}, {"08", "硬卧", 60}, {"09", "硬卧", 60},
+          {"10", "硬卧", 60}, {"11", "硬卧", 60}, {"12", "硬卧", 60},
+          {"13", "硬卧", 60}, {"14", "硬卧", 60}, {"15", "硬卧", 60},
+          {"16", "软卧", 36}, {"17", "软卧", 36}, {"18", "软卧", 36}}},
+    };
+    return data;
+}
+
+enum Pattern {
+    PATTERN_CONTIGUOUS,  // 全程票，按分配顺序从前往后售出
+    PATTERN_RANDOM,      // 随机座位、随机区间
+    PATTERN_SHORT_HOPS,  // 随机座位上的单段短途票，碎片最多
+};
+const char *const PATTERN_NAMES[] = {"contiguous", "random", "short_hops"};
+
+struct Query {
+    int type;
+    int fromOrder;
+    int toOrder;
+};
+
+// 预置到指定上座率（已占用的 座位×区间段 比例）的快照
+AllocationList preload(const TrainLayout &layout, int occupancyPct,
+                       Pattern pattern, unsigned seed = 42)
+{
+    SeatInventory inv(layout);
+    std::mt19937 rng(seed);
+    auto legs = layout.stationCount - 1;
+    auto totalLegs = static_cast<long>(inv.seatCount()) * legs;
+    auto target = totalLegs * occupancyPct / 100;
+    long occupied = 0;
+
+    if (pattern == PATTERN_CONTIGUOUS) {
+        for (int type = 0; type < static_cast<int>(inv.seatTypes().size()); type++) {
+            const auto &seats = inv.seatsOfType(type);
+            auto count = seats.size() * static_cast<size_t>(occupancyPct) / 100;
+            for (size_t i = 0; i < count; i++) {
+                inv.allocateSeat(seats[i], 1, layout.stationCount);
+            }
+        }
+        return inv.allocations();
+    }
+
+    std::uniform_int_distribution<int> seatDist(
+        0, static_cast<int>(inv.seatCount()) - 1);
+    std::uniform_int_distribution<int> legDist(1, legs);
+    for (long attempts = 0; occupied < target && attempts < totalLegs * 50;
+         attempts++) {
+        auto seatId = seatDist(rng);
+        int from = legDist(rng);
+        int to = from + 1;
+        if (pattern == PATTERN_RANDOM) {
+            std::uniform_int_distribution<int> toDist(from + 1, legs + 1);
+            to = toDist(rng);
+        }
+        if (inv.allocateSeat(seatId, from, to) >= 0) occupied += to - from;
+    }
+    return inv.allocations();
+}
+
+std::vector<Query> makeQueries(const SeatInventory &inv, size_t n,
+                               unsigned seed = 7)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> typeDist(
+        0, static_cast<int>(inv.seatTypes().size()) - 1);
+    std::uniform_int_distribution<int> stationDist(1, inv.stationCount());
+    std::vector<Query> queries;
+    while (queries.size() < n) {
+        auto a = stationDist(rng);
+        auto b = stationDist(rng);
+        if (a == b) continue;
+        queries.push_back({typeDist(rng), std::min(a, b), std::max(a, b)});
+    }
+    return queries;
+}
+
+// 每个基准共用的准备工作：布局、快照、查询序列
+struct Fixture {
+    explicit Fixture(const benchmark::State &state)
+        : layout(layouts()[static_cast<size_t>(state.range(0))]),
+          snapshot(preload(layout, static_cast<int>(state.range(1)),
+                           static_cast<Pattern>(state.range(2)))),
+          inv(layout), queries(makeQueries(inv, 4096))
+    {
+        inv.load(snapshot);
+    }
+
+    void label(benchmark::State &state) const
+    {
+        state.SetLabel(layout.name + "/" +
+                       std::to_string(state.range(1)) + "%/" +
+                       PATTERN_NAMES[state.range(2)]);
+        state.counters["seats"] = static_cast<double>(inv.seatCount());
+        state.counters["allocations"] = static_cast<double>(snapshot.size());
+    }
+
+    const TrainLayout &layout;
+    AllocationList snapshot;
+    SeatInventory inv;
+    std::vector<Query> queries;
+};
+
+// SQL 思路的对照：按座位聚合冲突的分配记录（COUNT DISTINCT seat_id）
+int countAvailableScan(const SeatInventory &inv, std::vector<char> &seen,
+                       const Query &q)
+{
+    const auto &seats = inv.seatsOfType(q.type);
+    std::fill(seen.begin(), seen.end(), 0);
+    int occupied = 0;
+    const auto &type = inv.seatTypes()[static_cast<size_t>(q.type)];
+    for (const auto &a : inv.allocations()) {
+        if (a.deleted || inv.seat(a.seatId).seatType != type) continue;
+        if (a.toOrder <= q.fromOrder || a.fromOrder >= q.toOrder) continue;
+        auto &s = seen[static_cast<size_t>(a.seatId)];
+        occupied += !s;
+        s = 1;
+    }
+    return static_cast<int>(seats.size()) - occupied;
+}
+
+// SQL 思路的对照：逐个座位查询该座位的分配记录是否冲突
+int findFirstFitScan(const SeatInventory &inv,
+                     const std::vector<std::vector<int>> &bySeat,
+                     const Query &q)
+{
+    const auto &allocations = inv.allocations();
+    for (auto seatId : inv.seatsOfType(q.type)) {
+        bool conflict = false;
+        for (auto index : bySeat[static_cast<size_t>(seatId)]) {
+            const auto &a = allocations[static_cast<size_t>(index)];
+            if (!a.deleted &&
+                !(a.toOrder <= q.fromOrder || a.fromOrder >= q.toOrder)) {
+                conflict = true;
+                break;
+            }
+        }
+        if (!conflict) return seatId;
+    }
+    return -1;
+}
+
+void BM_CountAvailable(benchmark::State &state)
+{
+    Fixture f(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto &q = f.queries[i++ % f.queries.size()];
+        benchmark::DoNotOptimize(f.inv.countAvailable(q.type, q.fromOrder, q.toOrder));
+    }
+    state.SetItemsProcessed(state.iterations());
+    f.label(state);
+}
+
+void BM_CountAvailable_Scan(benchmark::State &state)
+{
+    Fixture f(state);
+    std::vector<char> seen(f.inv.seatCount());
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto &q = f.queries[i++ % f.queries.size()];
+        benchmark::DoNotOptimize(countAvailableScan(f.inv, seen, q));
+    }
+    state.SetItemsProcessed(state.iterations());
+    f.label(state);
+}
+
+void BM_FindFirstFit(benchmark::State &state)
+{
+    Fixture f(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto &q = f.queries[i++ % f.queries.size()];
+        benchmark::DoNotOptimize(f.inv.findFirstFit(q.type, q.fromOrder, q.toOrder));
+    }
+    state.SetItemsProcessed(state.iterations());
+    f.label(state);
+}
+
+void BM_FindFirstFit_Scan(benchmark::State &state)
+{
+    Fixture f(state);
+    std::vector<std::vector<int>> bySeat(f.inv.seatCount());
+    for (size_t i = 0; i < f.snapshot.size(); i++) {
+        bySeat[static_cast<size_t>(f.snapshot[i].seatId)].push_back(
+            static_cast<int>(i));
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto &q = f.queries[i++ % f.queries.size()];
+        benchmark::DoNotOptimize(findFirstFitScan(f.inv, bySeat, q));
+    }
+    state.SetItemsProcessed(state.iterations());
+    f.label(state);
+}
+
+// 连续分配直到售完或满一批，然后从快照复原（复原不计时）
+void BM_Allocate(benchmark::State &state)
+{
+    Fixture f(state);
+    size_t i = 0;
+    size_t batch = 0;
+    for (auto _ : state) {
+        const auto &q = f.queries[i++ % f.queries.size()];
+        benchmark::DoNotOptimize(f.inv.allocate(q.type, q.fromOrder, q.toOrder));
+        if (++batch == 1024) {
+            state.PauseTiming();
+            f.inv.load(f.snapshot);
+            batch = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    f.label(state);
+}
+
+// 对已售座位取消后立即恢复，每次迭代包含一次取消和一次恢复
+void BM_CancelRestore(benchmark::State &state)
+{
+    Fixture f(state);
+    if (f.snapshot.empty()) {
+        state.SkipWithError("没有可取消的分配记录");
+        return;
+    }
+    std::mt19937 rng(11);
+    std::vector<int> ids(4096);
+    for (auto &id : ids) {
+        id = static_cast<int>(rng() % f.snapshot.size());
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        auto id = ids[i++ % ids.size()];
+        benchmark::DoNotOptimize(f.inv.cancel(id));
+        benchmark::DoNotOptimize(f.inv.restore(id));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    f.label(state);
+}
+
+void BM_SnapshotLoad(benchmark::State &state)
+{
+    Fixture f(state);
+    for (auto _ : state) {
+        f.inv.load(f.snapshot);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(f.snapshot.size()));
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<int64_t>(f.snapshot.size() * sizeof(Allocation)));
+    f.label(state);
+}
+
+// 参数：布局下标、上座率(%)、碎片化模式
+void fullMatrix(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"layout", "occupancy", "pattern"});
+    b->ArgsProduct({{0, 1, 2, 3}, {0, 50, 90, 99}, {0, 1, 2}});
+}
+
+void scanMatrix(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"layout", "occupancy", "pattern"});
+    b->ArgsProduct({{0, 3}, {50, 90}, {0, 2}});
+}
+
+void mutationMatrix(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"layout", "occupancy", "pattern"});
+    b->ArgsProduct({{0, 2, 3}, {50, 90, 99}, {0, 1, 2}});
+}
+
+BENCHMARK(BM_CountAvailable)->Apply(fullMatrix);
+BENCHMARK(BM_CountAvailable_Scan)->Apply(scanMatrix);
+BENCHMARK(BM_FindFirstFit)->Apply(fullMatrix);
+BENCHMARK(BM_FindFirstFit_Scan)->Apply(scanMatrix);
+BENCHMARK(BM_Allocate)->Apply(mutationMatrix);
+BENCHMARK(BM_CancelRestore)->Apply(mutationMatrix);
+BENCHMARK(BM_SnapshotLoad)->Apply(mutationMatrix);
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // 未指定 --benchmark_out 时默认输出 JSON 文件
+    std::vector<char *> args(argv, argv + argc);
+    std::string out = "--benchmark_out=bench_inventory.json";
+    std::string format = "--benchmark_out_format=json";
+    bool hasOut = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]).rfind("--benchmark_out=", 0) == 0) hasOut = true;
+    }
+    if (!hasOut) {
+        args.push_back(&out[0]);
+        args.push_back(&format[0]);
+    }
+    auto count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) return 1;
+    benchmark::AddCustomContext("seat_inventory", "bitmask-v1");
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,89 @@
+// 压测工具共用的延迟直方图（loadgen、replay）
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace loadtest {
+
+// 对数线性直方图（微秒），每个 2 的幂区间 32 个子桶，相对误差约 3%
+class Histogram {
+public:
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+
+    Histogram() : m_buckets(64 * SUB_COUNT, 0) {}
+
+    void record(uint64_t usec, uint64_t count = 1)
+    {
+        m_buckets[index(usec)] += count;
+        m_count += count;
+        m_max = (std::max)(m_max, usec);
+    }
+
+    // 闭环模式：按期望间隔补齐被阻塞期间缺失的样本
+    void recordCorrected(uint64_t usec, uint64_t expectedIntervalUsec)
+    {
+        record(usec);
+        if (expectedIntervalUsec == 0) return;
+        for (auto missing = usec; missing > expectedIntervalUsec;) {
+            missing -= expectedIntervalUsec;
+            record(missing);
+        }
+    }
+
+    void merge(const Histogram &other)
+    {
+        for (size_t i = 0; i < m_buckets.size(); i++) {
+            m_buckets[i] += other.m_buckets[i];
+        }
+        m_count += other.m_count;
+        m_max = (std::max)(m_max, other.m_max);
+    }
+
+    uint64_t count() const { return m_count; }
+    uint64_t max() const { return m_max; }
+
+    uint64_t percentile(double p) const
+    {
+        if (m_count == 0) return 0;
+        auto rank = static_cast<uint64_t>(std::ceil(p / 100.0 * m_count));
+        rank = (std::max<uint64_t>)(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < m_buckets.size(); i++) {
+            seen += m_buckets[i];
+            if (seen >= rank) return (std::min)(upperBound(i), m_max);
+        }
+        return m_max;
+    }
+
+private:
+    static size_t index(uint64_t v)
+    {
+        if (v < SUB_COUNT) return static_cast<size_t>(v);
+        int msb = 63;
+        while (!(v >> msb)) msb--;
+        auto shift = msb - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_COUNT +
+                                   ((v >> shift) - SUB_COUNT));
+    }
+
+    static uint64_t upperBound(size_t i)
+    {
+        if (i < SUB_COUNT) return i;
+        auto shift = i / SUB_COUNT - 1;
+        return ((i % SUB_COUNT + SUB_COUNT + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> m_buckets;
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+};
+
+} // namespace loadtest
+
+#endif // LATENCY_HISTOGRAM_H
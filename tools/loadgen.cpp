@@ -0,0 +1,912 @@
+// 订票接口压测工具
+//
+// 基于 httplib::Client，按可配置比例混合发送
+//   POST /search-bookable-trains、POST /book、GET /orders、DELETE /orders/:id
+// 支持开环（固定到达速率）与闭环两种模式，车次/区间按 Zipf 分布倾斜。
+// 抢票模式（--mode flash）模拟春运放票：N 个客户端在同一时刻同时对
+// 同一车次、同一座位类型发起预订，直到售罄，并检查公平性与是否超卖。
+//
+// 开环模式下每个请求都有“计划发出时间”，延迟从计划时间算起，
+// 因此服务端变慢导致的排队也会计入（消除 coordinated omission）。
+// 闭环模式下若指定了 --rate，则每个连接按 rate/connections 匀速发送，
+// 并按 HdrHistogram 的方式补齐被阻塞期间“本应发出”的样本。
+
+#include "latency_histogram.h"
+
+#include <httplib.h>
+#include <json/json.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using loadtest::Histogram;
+
+// 与客户端 MainWindow::STATION_LIST 一致
+const char *const STATION_LIST[] = {"北京", "天津", "济南", "南京", "上海",
+                                    "广州", "深圳", "西安", "成都"};
+
+// 与 manage_database.js 中的初始数据一致：车次经停站（按站序）与座位类型
+struct TrainInfo {
+    int id;
+    const char *name;
+    std::vector<int> stations;  // STATION_LIST 下标
+    std::vector<const char *> seatTypes;
+};
+
+const std::vector<TrainInfo> &trainCatalog()
+{
+    static const std::vector<TrainInfo> trains = {
+        {1, "G101", {0, 1, 2, 3, 4}, {"二等座", "一等座", "商务座"}},
+        {2, "G102", {4, 3, 2, 1, 0}, {"二等座", "一等座", "商务座"}},
+        {3, "D201", {5, 6}, {"二等座", "一等座"}},
+        {4, "K301", {7, 8}, {"硬座", "硬卧", "软卧"}},
+    };
+    return trains;
+}
+
+// 一个可预订的“车次 + 区间”
+struct Segment {
+    const TrainInfo *train;
+    int from;
+    int to;
+};
+
+enum Op { OP_SEARCH, OP_BOOK, OP_ORDERS, OP_CANCEL, OP_COUNT };
+const char *const OP_NAMES[OP_COUNT] = {"search", "book", "orders", "cancel"};
+
+struct Options {
+    std::string host = "localhost";
+    int port = 3000;
+    bool openLoop = true;
+    bool flashSale = false;
+    bool poisson = false;
+    double rate = 1000;          // 请求/秒；闭环模式下为 0 表示不限速
+    bool rateGiven = false;
+    int connections = 64;
+    double duration = 30;        // 秒
+    double warmup = 5;           // 秒，预热期间的样本不计入结果
+    double zipf = 1.0;           // Zipf 指数，0 为均匀分布
+    int days = 14;
+    std::string startDate = "2025-07-17";
+    int weights[OP_COUNT] = {70, 15, 10, 5};
+    time_t timeoutSec = 10;
+    unsigned seed = 42;
+
+    // 抢票模式
+    std::string train = "G101";
+    std::string seatType = "商务座";
+    std::string fromStation;     // 为空时取始发站/终点站
+    std::string toStation;
+    int ticketsPerClient = 1;
+    int retryMs = 50;            // 非售罄失败后的重试间隔
+};
+
+// 预先计算 CDF 的 Zipf 采样器，rank 0 最热
+class ZipfSampler {
+public:
+    ZipfSampler(size_t n, double s)
+    {
+        double sum = 0;
+        for (size_t k = 1; k <= n; k++) {
+            sum += 1.0 / std::pow(static_cast<double>(k), s);
+            m_cdf.push_back(sum);
+        }
+        for (auto &c : m_cdf) c /= sum;
+    }
+
+    template <typename Rng> size_t operator()(Rng &rng) const
+    {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), dist(rng));
+        return (std::min)(static_cast<size_t>(it - m_cdf.begin()),
+                          m_cdf.size() - 1);
+    }
+
+private:
+    std::vector<double> m_cdf;
+};
+
+struct OpStats {
+    Histogram latency;
+    uint64_t ok = 0;
+    uint64_t failed = 0;   // 非 2xx
+    uint64_t errors = 0;   // 连接/超时等传输错误
+    uint64_t dropped = 0;  // 开环模式下压测结束时仍积压、未发出的请求
+};
+
+struct WorkerStats {
+    OpStats ops[OP_COUNT];
+};
+
+// 开环模式的到达时间表：所有连接共享，按顺序领取计划发出时间
+class ArrivalSchedule {
+public:
+    ArrivalSchedule(Clock::time_point start, double rate, bool poisson,
+                    unsigned seed)
+        : m_start(start), m_rate(rate), m_poisson(poisson), m_rng(seed) {}
+
+    Clock::time_point next()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_poisson) {
+            std::exponential_distribution<double> dist(m_rate);
+            m_offset += dist(m_rng);
+        } else {
+            m_offset += 1.0 / m_rate;
+        }
+        return m_start + std::chrono::duration_cast<Clock::duration>(
+                             std::chrono::duration<double>(m_offset));
+    }
+
+private:
+    std::mutex m_mutex;
+    Clock::time_point m_start;
+    double m_rate;
+    bool m_poisson;
+    double m_offset = 0;
+    std::mt19937_64 m_rng;
+};
+
+std::string addDays(const std::string &date, int days)
+{
+    std::tm tm = {};
+    if (sscanf(date.c_str(), "%d-%d-%d", &tm.tm_year, &tm.tm_mon,
+               &tm.tm_mday) != 3) {
+        return date;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_mday += days;
+    tm.tm_hour = 12;
+    std::mktime(&tm);
+    char buf[16];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d", &tm);
+    return buf;
+}
+
+std::string jsonString(const Json::Value &v)
+{
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, v);
+}
+
+class Worker {
+public:
+    Worker(int id, const Options &opts, const std::vector<Segment> &segments,
+           const ZipfSampler &zipf, const std::vector<std::string> &dates)
+        : m_opts(opts), m_segments(segments), m_zipf(zipf),
+          m_dates(dates), m_client(opts.host, opts.port),
+          m_rng(opts.seed * 1000003u + static_cast<unsigned>(id))
+    {
+        m_client.set_keep_alive(true);
+        m_client.set_tcp_nodelay(true);
+        m_client.set_connection_timeout(m_opts.timeoutSec, 0);
+        m_client.set_read_timeout(m_opts.timeoutSec, 0);
+        m_client.set_write_timeout(m_opts.timeoutSec, 0);
+
+        m_passengerName = "压测乘客" + std::to_string(id);
+        char idCard[32];
+        snprintf(idCard, sizeof(idCard), "11010119900101%04d", id % 10000);
+        m_passengerId = idCard;
+    }
+
+    // 执行一次请求，返回是否为 2xx；transportError 表示未收到响应
+    bool execute(Op op, bool &transportError)
+    {
+        transportError = false;
+        httplib::Result res;
+
+        switch (op) {
+        case OP_SEARCH: {
+            const auto &seg = pickSegment();
+            Json::Value body;
+            body["fromStation"] = STATION_LIST[seg.from];
+            body["toStation"] = STATION_LIST[seg.to];
+            body["date"] = pickDate();
+            res = m_client.Post("/search-bookable-trains", jsonString(body),
+                                "application/json");
+            break;
+        }
+        case OP_BOOK: {
+            const auto &seg = pickSegment();
+            const auto &seatTypes = seg.train->seatTypes;
+            Json::Value body;
+            body["trainId"] = seg.train->id;
+            body["seatType"] = seatTypes[m_rng() % seatTypes.size()];
+            body["passengerName"] = m_passengerName;
+            body["passengerId"] = m_passengerId;
+            body["fromStation"] = STATION_LIST[seg.from];
+            body["toStation"] = STATION_LIST[seg.to];
+            body["date"] = pickDate();
+            res = m_client.Post("/book", jsonString(body), "application/json");
+            if (res && res->status == 200) rememberOrder(res->body);
+            break;
+        }
+        case OP_ORDERS: {
+            httplib::Params params = {{"passengerName", m_passengerName},
+                                      {"passengerId", m_passengerId}};
+            res = m_client.Get("/orders", params, httplib::Headers());
+            break;
+        }
+        case OP_CANCEL: {
+            // 没有可取消的订单时改为查询订单，保持请求量不变
+            if (m_orders.empty()) return execute(OP_ORDERS, transportError);
+            auto orderId = m_orders.back();
+            m_orders.pop_back();
+            res = m_client.Delete("/orders/" + std::to_string(orderId));
+            break;
+        }
+        default: break;
+        }
+
+        if (!res) {
+            transportError = true;
+            return false;
+        }
+        return res->status >= 200 && res->status < 300;
+    }
+
+    Op pickOp()
+    {
+        int total = 0;
+        for (auto w : m_opts.weights) total += w;
+        auto r = static_cast<int>(m_rng() % static_cast<unsigned>(total));
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (r < m_opts.weights[op]) return static_cast<Op>(op);
+            r -= m_opts.weights[op];
+        }
+        return OP_SEARCH;
+    }
+
+    WorkerStats &stats() { return m_stats; }
+
+private:
+    const Segment &pickSegment() { return m_segments[m_zipf(m_rng)]; }
+
+    const std::string &pickDate()
+    {
+        return m_dates[m_rng() % m_dates.size()];
+    }
+
+    void rememberOrder(const std::string &body)
+    {
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        Json::Value root;
+        if (reader->parse(body.data(), body.data() + body.size(), &root,
+                          nullptr) &&
+            root["data"].isObject() && root["data"]["orderId"].isIntegral()) {
+            m_orders.push_back(root["data"]["orderId"].asInt64());
+        }
+    }
+
+    const Options &m_opts;
+    const std::vector<Segment> &m_segments;
+    const ZipfSampler &m_zipf;
+    const std::vector<std::string> &m_dates;
+    httplib::Client m_client;
+    std::mt19937_64 m_rng;
+    std::string m_passengerName;
+    std::string m_passengerId;
+    std::vector<int64_t> m_orders;
+    WorkerStats m_stats;
+};
+
+uint64_t toUsec(Clock::duration d)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return us > 0 ? static_cast<uint64_t>(us) : 0;
+}
+
+void recordResult(OpStats &s, bool ok, bool transportError)
+{
+    if (ok) s.ok++;
+    else if (transportError) s.errors++;
+    else s.failed++;
+}
+
+void runOpenLoop(Worker &worker, ArrivalSchedule &schedule,
+                 Clock::time_point measureFrom, Clock::time_point end,
+                 Clock::duration drainTimeout)
+{
+    for (;;) {
+        auto intended = schedule.next();
+        if (intended >= end) break;
+        std::this_thread::sleep_until(intended);
+
+        auto op = worker.pickOp();
+
+        // 服务端跟不上时积压会越来越多；超过排空时限后不再发送，
+        // 但仍按已等待的时间记录（延迟的下限），避免低估尾延迟
+        auto now = Clock::now();
+        if (now > end + drainTimeout) {
+            if (intended < measureFrom) continue;
+            auto &s = worker.stats().ops[op];
+            s.latency.record(toUsec(now - intended));
+            s.dropped++;
+            continue;
+        }
+
+        bool transportError;
+        auto ok = worker.execute(op, transportError);
+        auto done = Clock::now();
+
+        if (intended < measureFrom) continue;
+        auto &s = worker.stats().ops[op];
+        s.latency.record(toUsec(done - intended));
+        recordResult(s, ok, transportError);
+    }
+}
+
+void runClosedLoop(Worker &worker, const Options &opts,
+                   Clock::time_point measureFrom, Clock::time_point end)
+{
+    // 指定了速率时每个连接匀速发送，否则尽力而为
+    auto interval = Clock::duration::zero();
+    if (opts.rateGiven && opts.rate > 0) {
+        interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(opts.connections / opts.rate));
+    }
+    auto expectedUsec = toUsec(interval);
+
+    auto next = Clock::now();
+    while (Clock::now() < end) {
+        if (interval != Clock::duration::zero()) {
+            std::this_thread::sleep_until(next);
+            next += interval;
+        }
+
+        auto op = worker.pickOp();
+        auto start = Clock::now();
+        bool transportError;
+        auto ok = worker.execute(op, transportError);
+        auto done = Clock::now();
+
+        // 落后于节拍时不追赶，从当前时间重新开始
+        if (interval != Clock::duration::zero() && next < done) next = done;
+
+        if (start < measureFrom) continue;
+        auto &s = worker.stats().ops[op];
+        s.latency.recordCorrected(toUsec(done - start), expectedUsec);
+        recordResult(s, ok, transportError);
+    }
+}
+
+// 所有客户端连接就绪后同时放行，等价于 C++20 的 std::latch
+class StartGate {
+public:
+    explicit StartGate(int parties) : m_waiting(parties) {}
+
+    // 返回统一的放行时刻
+    Clock::time_point arriveAndWait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (--m_waiting == 0) {
+            // 留出时间让所有线程从条件变量上醒来，再在同一时刻发出
+            m_release = Clock::now() + std::chrono::milliseconds(200);
+            m_open = true;
+            m_cond.notify_all();
+        }
+        m_cond.wait(lock, [&] { return m_open; });
+        return m_release;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    int m_waiting;
+    bool m_open = false;
+    Clock::time_point m_release;
+};
+
+// 一个抢票客户端的结果
+struct FlashClient {
+    int64_t arrival = -1;        // 首个请求发出的全局顺序
+    int booked = 0;
+    bool sawSoldOut = false;
+    uint64_t soldOutResponses = 0;
+    uint64_t failed = 0;         // 售罄以外的非 2xx，会重试
+    uint64_t errors = 0;         // 传输错误，会重试
+    Clock::time_point lastBooked;
+    Clock::time_point firstSoldOut;
+    std::vector<std::string> seats;  // "车厢-座位号"
+    Histogram latency;
+};
+
+bool parseJson(const std::string &body, Json::Value &root)
+{
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    return reader->parse(body.data(), body.data() + body.size(), &root, nullptr);
+}
+
+// 通过搜索接口查询余票，查询失败返回 -1
+int queryAvailable(const Options &opts, const TrainInfo &train)
+{
+    httplib::Client client(opts.host, opts.port);
+    client.set_connection_timeout(opts.timeoutSec, 0);
+    client.set_read_timeout(opts.timeoutSec, 0);
+
+    Json::Value body;
+    body["fromStation"] = opts.fromStation;
+    body["toStation"] = opts.toStation;
+    body["date"] = opts.startDate;
+    auto res = client.Post("/search-bookable-trains", jsonString(body),
+                           "application/json");
+    Json::Value root;
+    if (!res || res->status != 200 || !parseJson(res->body, root) ||
+        !root["data"].isArray()) {
+        return -1;
+    }
+
+    // 只返回有余票的座位类型，没列出即为 0
+    for (const auto &t : root["data"]) {
+        if (t["id"].asInt() != train.id) continue;
+        for (const auto &seat : t["seatTypes"]) {
+            if (seat["type"].asString() == opts.seatType) {
+                return seat["availableSeats"].asInt();
+            }
+        }
+    }
+    return 0;
+}
+
+void runFlashClient(int id, const Options &opts, const TrainInfo &train,
+                    StartGate &gate, std::atomic<int64_t> &arrivals,
+                    Clock::time_point deadline, FlashClient &out)
+{
+    httplib::Client client(opts.host, opts.port);
+    client.set_keep_alive(true);
+    client.set_tcp_nodelay(true);
+    client.set_connection_timeout(opts.timeoutSec, 0);
+    client.set_read_timeout(opts.timeoutSec, 0);
+    client.set_write_timeout(opts.timeoutSec, 0);
+
+    Json::Value body;
+    body["trainId"] = train.id;
+    body["seatType"] = opts.seatType;
+    body["passengerName"] = "抢票乘客" + std::to_string(id);
+    char idCard[32];
+    snprintf(idCard, sizeof(idCard), "11010120000101%04d", id % 10000);
+    body["passengerId"] = idCard;
+    body["fromStation"] = opts.fromStation;
+    body["toStation"] = opts.toStation;
+    body["date"] = opts.startDate;
+    auto payload = jsonString(body);
+
+    // 放票前先建立连接，避免放行瞬间的握手排队混入结果
+    client.Get("/");
+
+    std::this_thread::sleep_until(gate.arriveAndWait());
+
+    while (out.booked < opts.ticketsPerClient && !out.sawSoldOut &&
+           Clock::now() < deadline) {
+        if (out.arrival < 0) out.arrival = arrivals.fetch_add(1);
+
+        auto start = Clock::now();
+        auto res = client.Post("/book", payload, "application/json");
+        auto done = Clock::now();
+        out.latency.record(toUsec(done - start));
+
+        Json::Value root;
+        if (!res) {
+            out.errors++;
+        } else if (res->status == 200) {
+            out.booked++;
+            out.lastBooked = done;
+            if (parseJson(res->body, root)) {
+                out.seats.push_back(root["data"]["carriageNumber"].asString() +
+                                    "-" + root["data"]["seatNumber"].asString());
+            }
+            continue;
+        } else if (parseJson(res->body, root) &&
+                   root["message"].asString().find("售完") != std::string::npos) {
+            out.soldOutResponses++;
+            out.sawSoldOut = true;
+            out.firstSoldOut = done;
+            continue;
+        } else {
+            out.failed++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(opts.retryMs));
+    }
+}
+
+int runFlashSale(const Options &opts)
+{
+    auto &catalog = trainCatalog();
+    auto train = std::find_if(catalog.begin(), catalog.end(),
+                              [&](const TrainInfo &t) { return opts.train == t.name; });
+    if (train == catalog.end()) {
+        std::cerr << "未知车次: " << opts.train << "\n";
+        return 1;
+    }
+
+    // 区间默认取全程，并检查车站在线路上且顺序正确
+    Options flash = opts;
+    if (flash.fromStation.empty()) flash.fromStation = STATION_LIST[train->stations.front()];
+    if (flash.toStation.empty()) flash.toStation = STATION_LIST[train->stations.back()];
+    auto stationIndex = [&](const std::string &name) {
+        for (size_t i = 0; i < train->stations.size(); i++) {
+            if (name == STATION_LIST[train->stations[i]]) return static_cast<int>(i);
+        }
+        return -1;
+    };
+    auto fromIndex = stationIndex(flash.fromStation);
+    auto toIndex = stationIndex(flash.toStation);
+    if (fromIndex < 0 || toIndex <= fromIndex ||
+        std::find(train->seatTypes.begin(), train->seatTypes.end(),
+                  flash.seatType) == train->seatTypes.end()) {
+        std::cerr << "区间或座位类型不在车次 " << train->name << " 上\n";
+        return 1;
+    }
+
+    auto initial = queryAvailable(flash, *train);
+    printf("抢票 %s %s %s→%s %s，%d 个客户端，每人 %d 张，初始余票 %s\n",
+           train->name, flash.startDate.c_str(), flash.fromStation.c_str(),
+           flash.toStation.c_str(), flash.seatType.c_str(), flash.connections,
+           flash.ticketsPerClient,
+           initial < 0 ? "未知" : std::to_string(initial).c_str());
+
+    std::vector<FlashClient> clients(static_cast<size_t>(flash.connections));
+    StartGate gate(flash.connections + 1);
+    std::atomic<int64_t> arrivals{0};
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                       std::chrono::duration<double>(flash.duration));
+
+    std::vector<std::thread> threads;
+    threads.reserve(clients.size());
+    for (int i = 0; i < flash.connections; i++) {
+        threads.emplace_back([&, i] {
+            runFlashClient(i, flash, *train, gate, arrivals, deadline,
+                           clients[static_cast<size_t>(i)]);
+        });
+    }
+    auto release = gate.arriveAndWait();
+    for (auto &t : threads) t.join();
+
+    // 汇总
+    Histogram latency;
+    uint64_t booked = 0, soldOut = 0, failed = 0, errors = 0;
+    auto lastBooked = release;
+    auto firstSoldOut = Clock::time_point::max();
+    std::set<std::string> seats;
+    uint64_t duplicateSeats = 0;
+    for (const auto &c : clients) {
+        latency.merge(c.latency);
+        booked += static_cast<uint64_t>(c.booked);
+        soldOut += c.soldOutResponses;
+        failed += c.failed;
+        errors += c.errors;
+        if (c.booked) lastBooked = (std::max)(lastBooked, c.lastBooked);
+        if (c.sawSoldOut) firstSoldOut = (std::min)(firstSoldOut, c.firstSoldOut);
+        for (const auto &seat : c.seats) duplicateSeats += !seats.insert(seat).second;
+    }
+
+    auto sellSeconds = std::chrono::duration<double>(lastBooked - release).count();
+    auto requests = booked + soldOut + failed + errors;
+    printf("\n成交 %llu 张，请求 %llu 次（售罄响应 %llu，失败重试 %llu，传输错误重试 %llu）\n",
+           static_cast<unsigned long long>(booked),
+           static_cast<unsigned long long>(requests),
+           static_cast<unsigned long long>(soldOut),
+           static_cast<unsigned long long>(failed),
+           static_cast<unsigned long long>(errors));
+    if (firstSoldOut != Clock::time_point::max()) {
+        printf("售罄耗时: %.3fs（最后一张成交），首个售罄响应 %.3fs\n", sellSeconds,
+               std::chrono::duration<double>(firstSoldOut - release).count());
+    } else {
+        printf("未售罄：%.1fs 内共成交 %llu 张\n", sellSeconds,
+               static_cast<unsigned long long>(booked));
+    }
+    if (sellSeconds > 0) printf("成交吞吐: %.1f 张/s\n", booked / sellSeconds);
+    printf("预订延迟: p50 %.2fms, p99 %.2fms, p999 %.2fms, max %.2fms\n",
+           latency.percentile(50) / 1000.0, latency.percentile(99) / 1000.0,
+           latency.percentile(99.9) / 1000.0, latency.max() / 1000.0);
+
+    // 公平性：按首个请求的发出顺序分十组，看成交落在哪些到达者身上。
+    // 严格先到先得时，成交应全部集中在最先到达的那部分客户端
+    std::vector<const FlashClient *> byArrival;
+    for (const auto &c : clients) {
+        if (c.arrival >= 0) byArrival.push_back(&c);
+    }
+    std::sort(byArrival.begin(), byArrival.end(),
+              [](const FlashClient *a, const FlashClient *b) {
+                  return a->arrival < b->arrival;
+              });
+    if (!byArrival.empty()) {
+        printf("\n到达顺序       客户端     成交\n");
+        const size_t groups = 10;
+        for (size_t g = 0; g < groups; g++) {
+            auto begin = byArrival.size() * g / groups;
+            auto end = byArrival.size() * (g + 1) / groups;
+            if (begin == end) continue;
+            uint64_t won = 0;
+            for (auto i = begin; i < end; i++) {
+                won += static_cast<uint64_t>(byArrival[i]->booked);
+            }
+            printf("%3zu%%-%3zu%%  %8zu %8llu\n", g * 10, (g + 1) * 10,
+                   end - begin, static_cast<unsigned long long>(won));
+        }
+
+        // 能抢到票的客户端数，即严格先到先得时的“赢家”名额
+        auto perClient = static_cast<uint64_t>(flash.ticketsPerClient);
+        auto winners = (std::min)(byArrival.size(),
+                                  static_cast<size_t>((booked + perClient - 1) / perClient));
+        size_t fifo = 0, winningClients = 0;
+        for (size_t i = 0; i < byArrival.size(); i++) {
+            if (!byArrival[i]->booked) continue;
+            winningClients++;
+            fifo += i < winners;
+        }
+        if (winningClients) {
+            printf("先到先得比例: %.1f%%（抢到票的客户端中位于前 %zu 名到达者的比例）\n",
+                   100.0 * fifo / winningClients, winners);
+        }
+    }
+
+    // 超卖检查：座位不重复、成交数不超过初始余票、余票与成交数对得上
+    auto remaining = queryAvailable(flash, *train);
+    auto oversold = duplicateSeats > 0;
+    printf("\n超卖检查:\n");
+    printf("  重复售出的座位: %llu\n", static_cast<unsigned long long>(duplicateSeats));
+    if (initial >= 0) {
+        auto over = booked > static_cast<uint64_t>(initial);
+        oversold = oversold || over;
+        printf("  成交 %llu / 初始余票 %d%s\n", static_cast<unsigned long long>(booked),
+               initial, over ? "  超卖!" : "");
+    }
+    if (initial >= 0 && remaining >= 0) {
+        auto expected = initial - static_cast<int>(booked);
+        printf("  当前余票 %d，预期 %d%s\n", remaining, expected,
+               remaining != expected ? "  不一致（可能有其他流量）" : "");
+    }
+    printf("  结论: %s\n", oversold ? "发生超卖" : "未发现超卖");
+    return oversold ? 2 : 0;
+}
+
+bool parseMix(const std::string &spec, int weights[OP_COUNT])
+{
+    int parsed[OP_COUNT] = {0, 0, 0, 0};
+    bool ok = true;
+    httplib::detail::split(
+        spec.data(), spec.data() + spec.size(), ',',
+        [&](const char *b, const char *e) {
+            std::string item(b, e);
+            auto eq = item.find('=');
+            if (eq == std::string::npos) {
+                ok = false;
+                return;
+            }
+            auto name = item.substr(0, eq);
+            auto it = std::find_if(std::begin(OP_NAMES), std::end(OP_NAMES),
+                                   [&](const char *n) { return name == n; });
+            if (it == std::end(OP_NAMES)) {
+                ok = false;
+                return;
+            }
+            parsed[it - std::begin(OP_NAMES)] = std::atoi(item.c_str() + eq + 1);
+        });
+
+    int total = 0;
+    for (auto w : parsed) total += (std::max)(w, 0);
+    if (!ok || total == 0) return false;
+    for (int i = 0; i < OP_COUNT; i++) weights[i] = (std::max)(parsed[i], 0);
+    return true;
+}
+
+void printUsage(const char *prog)
+{
+    std::cerr
+        << "用法: " << prog << " [选项]\n"
+        << "  --host HOST            服务器地址 (默认 localhost)\n"
+        << "  --port PORT            端口 (默认 3000)\n"
+        << "  --mode open|closed|flash\n"
+        << "                         开环固定到达速率 / 闭环 / 抢票 (默认 open)\n"
+        << "  --rate N               目标请求数/秒 (默认 1000)\n"
+        << "  --poisson              开环模式下按泊松过程到达\n"
+        << "  --connections N        并发 keep-alive 连接数 (默认 64)\n"
+        << "  --duration SEC         压测时长 (默认 30)\n"
+        << "  --warmup SEC           预热时长，不计入结果 (默认 5)\n"
+        << "  --mix search=70,book=15,orders=10,cancel=5\n"
+        << "  --zipf S               车次/区间 Zipf 指数，0 为均匀 (默认 1.0)\n"
+        << "  --start-date DATE      起始日期 (默认 2025-07-17)\n"
+        << "  --days N               日期范围天数 (默认 14)\n"
+        << "  --timeout SEC          请求超时及开环排空时限 (默认 10)\n"
+        << "  --seed N               随机种子 (默认 42)\n"
+        << "抢票模式 (--mode flash，--connections 为客户端数，--duration 为时限):\n"
+        << "  --train NAME           车次 (默认 G101)\n"
+        << "  --seat-type TYPE       座位类型 (默认 商务座)\n"
+        << "  --from/--to STATION    区间 (默认全程)\n"
+        << "  --date DATE            乘车日期 (默认同 --start-date)\n"
+        << "  --tickets N            每个客户端要抢的张数 (默认 1)\n"
+        << "  --retry-ms MS          非售罄失败后的重试间隔 (默认 50)\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &opts)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            return i + 1 < argc ? argv[++i] : nullptr;
+        };
+
+        const char *v = nullptr;
+        if (arg == "--poisson") {
+            opts.poisson = true;
+            continue;
+        }
+        if (arg == "-h" || arg == "--help" || !(v = value())) return false;
+
+        if (arg == "--host") opts.host = v;
+        else if (arg == "--port") opts.port = std::atoi(v);
+        else if (arg == "--mode") {
+            if (std::strcmp(v, "open") == 0) opts.openLoop = true;
+            else if (std::strcmp(v, "closed") == 0) opts.openLoop = false;
+            else if (std::strcmp(v, "flash") == 0) opts.flashSale = true;
+            else return false;
+        } else if (arg == "--rate") {
+            opts.rate = std::atof(v);
+            opts.rateGiven = true;
+        } else if (arg == "--connections") opts.connections = std::atoi(v);
+        else if (arg == "--duration") opts.duration = std::atof(v);
+        else if (arg == "--warmup") opts.warmup = std::atof(v);
+        else if (arg == "--mix") {
+            if (!parseMix(v, opts.weights)) return false;
+        } else if (arg == "--zipf") opts.zipf = std::atof(v);
+        else if (arg == "--start-date" || arg == "--date") opts.startDate = v;
+        else if (arg == "--days") opts.days = std::atoi(v);
+        else if (arg == "--timeout") opts.timeoutSec = std::atoi(v);
+        else if (arg == "--seed") opts.seed = static_cast<unsigned>(std::atoi(v));
+        else if (arg == "--train") opts.train = v;
+        else if (arg == "--seat-type") opts.seatType = v;
+        else if (arg == "--from") opts.fromStation = v;
+        else if (arg == "--to") opts.toStation = v;
+        else if (arg == "--tickets") opts.ticketsPerClient = std::atoi(v);
+        else if (arg == "--retry-ms") opts.retryMs = std::atoi(v);
+        else return false;
+    }
+
+    if (opts.connections <= 0 || opts.duration <= 0 || opts.days <= 0) {
+        return false;
+    }
+    if (opts.flashSale) return opts.ticketsPerClient > 0 && opts.retryMs >= 0;
+    if (opts.openLoop && opts.rate <= 0) return false;
+    return true;
+}
+
+void printReport(const Options &opts, const std::vector<OpStats> &ops,
+                 double seconds)
+{
+    OpStats total;
+    for (const auto &s : ops) {
+        total.latency.merge(s.latency);
+        total.ok += s.ok;
+        total.failed += s.failed;
+        total.errors += s.errors;
+        total.dropped += s.dropped;
+    }
+
+    auto requests = total.ok + total.failed + total.errors;
+    printf("\n模式: %s, 连接数: %d, 统计时长: %.1fs\n",
+           opts.openLoop ? "开环" : "闭环", opts.connections, seconds);
+    if (opts.openLoop) printf("目标速率: %.0f req/s\n", opts.rate);
+    printf("吞吐量: %.1f req/s (成功 %.1f req/s)\n", requests / seconds,
+           total.ok / seconds);
+    if (!opts.openLoop && !opts.rateGiven) {
+        printf("注意: 闭环模式未指定 --rate，延迟未做 coordinated omission 修正\n");
+    }
+
+    if (total.dropped) {
+        printf("注意: %llu 个请求在压测结束后 %lds 内仍未能发出，已按等待时间计入延迟\n",
+               static_cast<unsigned long long>(total.dropped),
+               static_cast<long>(opts.timeoutSec));
+    }
+
+    printf("\n%-8s %10s %8s %8s %8s %10s %10s %10s %10s\n", "op", "requests",
+           "non2xx", "errors", "dropped", "p50(ms)", "p99(ms)", "p999(ms)",
+           "max(ms)");
+    auto row = [](const char *name, const OpStats &s) {
+        printf("%-8s %10llu %8llu %8llu %8llu %10.2f %10.2f %10.2f %10.2f\n",
+               name,
+               static_cast<unsigned long long>(s.ok + s.failed + s.errors),
+               static_cast<unsigned long long>(s.failed),
+               static_cast<unsigned long long>(s.errors),
+               static_cast<unsigned long long>(s.dropped),
+               s.latency.percentile(50) / 1000.0,
+               s.latency.percentile(99) / 1000.0,
+               s.latency.percentile(99.9) / 1000.0,
+               s.latency.max() / 1000.0);
+    };
+    for (int op = 0; op < OP_COUNT; op++) row(OP_NAMES[op], ops[op]);
+    row("total", total);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (opts.flashSale) return runFlashSale(opts);
+
+    // 所有车次上“出发站在到达站之前”的区间
+    std::vector<Segment> segments;
+    for (const auto &train : trainCatalog()) {
+        for (size_t i = 0; i < train.stations.size(); i++) {
+            for (size_t j = i + 1; j < train.stations.size(); j++) {
+                segments.push_back({&train, train.stations[i], train.stations[j]});
+            }
+        }
+    }
+    // 打乱后再按 Zipf 取样，热门区间不固定集中在第一趟车上
+    std::shuffle(segments.begin(), segments.end(), std::mt19937(opts.seed));
+    ZipfSampler zipf(segments.size(), opts.zipf);
+
+    std::vector<std::string> dates;
+    for (int i = 0; i < opts.days; i++) dates.push_back(addDays(opts.startDate, i));
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < opts.connections; i++) {
+        workers.emplace_back(new Worker(i, opts, segments, zipf, dates));
+    }
+
+    auto start = Clock::now();
+    auto measureFrom = start + std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(opts.warmup));
+    auto end = measureFrom + std::chrono::duration_cast<Clock::duration>(
+                                 std::chrono::duration<double>(opts.duration));
+    ArrivalSchedule schedule(start, opts.rate, opts.poisson, opts.seed);
+
+    printf("压测 %s:%d，预热 %.0fs，持续 %.0fs ...\n", opts.host.c_str(),
+           opts.port, opts.warmup, opts.duration);
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers.size());
+    for (auto &w : workers) {
+        auto *worker = w.get();
+        threads.emplace_back([&, worker] {
+            if (opts.openLoop) {
+                runOpenLoop(*worker, schedule, measureFrom, end,
+                            std::chrono::seconds(opts.timeoutSec));
+            }
+            else runClosedLoop(*worker, opts, measureFrom, end);
+        });
+    }
+    for (auto &t : threads) t.join();
+
+    std::vector<OpStats> ops(OP_COUNT);
+    for (auto &w : workers) {
+        for (int op = 0; op < OP_COUNT; op++) {
+            const auto &s = w->stats().ops[op];
+            ops[op].latency.merge(s.latency);
+            ops[op].ok += s.ok;
+            ops[op].failed += s.failed;
+            ops[op].errors += s.errors;
+            ops[op].dropped += s.dropped;
+        }
+    }
+    printReport(opts, ops, opts.duration);
+    return 0;
+}
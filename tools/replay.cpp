@@ -0,0 +1,439 @@
+// 请求回放工具
+//
+// 读取 Server::set_request_recording 录制的请求日志，按原始时间间隔
+// （或 N 倍速、最快速度）重放到目标服务器。同一条原始连接上的请求
+// 在同一个 keep-alive 连接上按顺序发出。
+//
+// 指定 --baseline 时先后对两台服务器各回放一遍，对比延迟分布，
+// 并逐条比较状态码与响应体，用于评估两个服务端版本。
+// 两次回放之间可用 --reset-cmd 把数据库恢复到录制前的状态。
+//
+// 延迟从“计划发出时间”算起：若上一条请求的响应晚于本条的计划时间，
+// 则从上一条响应返回时算起（HTTP/1.1 不流水线化时客户端本就要等待）。
+
+#include "latency_histogram.h"
+
+#include <httplib.h>
+#include <json/json.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using loadtest::Histogram;
+
+struct Endpoint {
+    std::string host;
+    int port = 0;
+};
+
+struct Options {
+    std::string logPath;
+    Endpoint target;
+    Endpoint baseline;
+    bool hasBaseline = false;
+    double speed = 1;            // 0 表示不按时间间隔，尽快发送
+    int threads = 64;
+    std::string resetCmd;
+    bool bodyDiff = true;
+    std::vector<std::string> ignoreKeys;
+    int maxDiffs = 5;
+    time_t timeoutSec = 10;
+};
+
+// 一条请求的回放结果
+struct Outcome {
+    int status = 0;              // 0 表示未收到响应
+    uint64_t latencyUsec = 0;
+    uint64_t bodyHash = 0;
+    std::string bodyHead;        // 响应体开头，差异报告用
+};
+
+const size_t BODY_HEAD_SIZE = 160;
+
+uint64_t fnv1a(const std::string &s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void stripKeys(Json::Value &v, const std::vector<std::string> &keys)
+{
+    if (v.isObject()) {
+        for (const auto &key : keys) v.removeMember(key);
+        for (const auto &name : v.getMemberNames()) stripKeys(v[name], keys);
+    } else if (v.isArray()) {
+        for (auto &item : v) stripKeys(item, keys);
+    }
+}
+
+// JSON 响应体去掉 --ignore-keys 中的字段（如时间戳）并规范化后再比较
+uint64_t bodyHash(const std::string &body, const std::vector<std::string> &ignoreKeys)
+{
+    if (ignoreKeys.empty()) return fnv1a(body);
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(body.data(), body.data() + body.size(), &root, &errs)) {
+        return fnv1a(body);
+    }
+    stripKeys(root, ignoreKeys);
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return fnv1a(Json::writeString(writer, root));
+}
+
+// 路由名：去掉查询串，纯数字的路径段替换为 :id，便于按接口汇总
+std::string routeOf(const httplib::RecordedRequest &r)
+{
+    auto path = r.target.substr(0, r.target.find('?'));
+    std::string route;
+    size_t pos = 0;
+    while (pos < path.size()) {
+        auto next = path.find('/', pos + 1);
+        if (next == std::string::npos) next = path.size();
+        auto segment = path.substr(pos, next - pos);
+        if (segment.size() > 1 &&
+            segment.find_first_not_of("0123456789", 1) == std::string::npos) {
+            segment = "/:id";
+        }
+        route += segment;
+        pos = next;
+    }
+    return r.method + " " + route;
+}
+
+// 回放一遍日志，results 与 requests 下标一一对应。
+// firstUs 为最早到达的请求时间，回放从它开始计时，
+// 录制开始到首个请求之间的空闲不回放
+void replay(const Endpoint &endpoint, const Options &opts,
+            const std::vector<httplib::RecordedRequest> &requests,
+            const std::vector<std::vector<size_t>> &connections,
+            uint64_t firstUs, std::vector<Outcome> &results)
+{
+    results.assign(requests.size(), Outcome());
+    std::atomic<size_t> nextConnection{0};
+    auto start = Clock::now();
+
+    auto worker = [&]() {
+        for (;;) {
+            auto c = nextConnection.fetch_add(1);
+            if (c >= connections.size()) break;
+
+            httplib::Client client(endpoint.host, endpoint.port);
+            client.set_keep_alive(true);
+            client.set_tcp_nodelay(true);
+            client.set_path_encode(false);
+            client.set_connection_timeout(opts.timeoutSec, 0);
+            client.set_read_timeout(opts.timeoutSec, 0);
+            client.set_write_timeout(opts.timeoutSec, 0);
+
+            auto previousDone = start;
+            for (auto i : connections[c]) {
+                const auto &r = requests[i];
+                // 最快速度回放时没有计划时间，只统计服务耗时
+                auto intended = Clock::now();
+                if (opts.speed > 0) {
+                    intended = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double, std::micro>(
+                            static_cast<double>(r.time_us - firstUs) / opts.speed));
+                    std::this_thread::sleep_until(intended);
+                    intended = (std::max)(intended, previousDone);
+                }
+
+                httplib::Request req;
+                req.method = r.method;
+                req.path = r.target;
+                req.body = r.body;
+                if (!r.content_type.empty()) {
+                    req.set_header("Content-Type", r.content_type);
+                }
+                auto res = client.send(req);
+                previousDone = Clock::now();
+
+                auto &out = results[i];
+                out.latencyUsec = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        previousDone - intended).count());
+                if (res) {
+                    out.status = res->status;
+                    if (opts.bodyDiff) {
+                        out.bodyHash = bodyHash(res->body, opts.ignoreKeys);
+                        out.bodyHead = res->body.substr(0, BODY_HEAD_SIZE);
+                    }
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    auto count = (std::min)(static_cast<size_t>(opts.threads), connections.size());
+    for (size_t i = 0; i < count; i++) threads.emplace_back(worker);
+    for (auto &t : threads) t.join();
+}
+
+bool runResetCommand(const Options &opts)
+{
+    if (opts.resetCmd.empty()) return true;
+    printf("执行重置命令: %s\n", opts.resetCmd.c_str());
+    fflush(stdout);
+    return std::system(opts.resetCmd.c_str()) == 0;
+}
+
+struct RouteStats {
+    Histogram latency;
+    uint64_t errors = 0;         // 未收到响应
+};
+
+std::map<std::string, RouteStats>
+summarize(const std::vector<httplib::RecordedRequest> &requests,
+          const std::vector<Outcome> &results)
+{
+    std::map<std::string, RouteStats> routes;
+    for (size_t i = 0; i < requests.size(); i++) {
+        for (auto *s : {&routes[routeOf(requests[i])], &routes["total"]}) {
+            s->latency.record(results[i].latencyUsec);
+            if (results[i].status == 0) s->errors++;
+        }
+    }
+    return routes;
+}
+
+void printLatency(const std::map<std::string, RouteStats> &routes)
+{
+    printf("\n%-32s %8s %7s %9s %9s %9s %9s %9s\n", "route", "requests",
+           "errors", "p50(ms)", "p90(ms)", "p99(ms)", "p999(ms)", "max(ms)");
+    for (const auto &kv : routes) {
+        const auto &h = kv.second.latency;
+        printf("%-32s %8llu %7llu %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+               kv.first.c_str(), static_cast<unsigned long long>(h.count()),
+               static_cast<unsigned long long>(kv.second.errors),
+               h.percentile(50) / 1000.0, h.percentile(90) / 1000.0,
+               h.percentile(99) / 1000.0, h.percentile(99.9) / 1000.0,
+               h.max() / 1000.0);
+    }
+}
+
+// 每个百分位给出 baseline → target 及变化比例
+void printLatencyDiff(const std::map<std::string, RouteStats> &base,
+                      const std::map<std::string, RouteStats> &target)
+{
+    const double percentiles[] = {50, 90, 99, 99.9};
+    printf("\n%-32s %-7s %10s %10s %8s\n", "route", "pct", "baseline",
+           "target", "change");
+    for (const auto &kv : target) {
+        auto it = base.find(kv.first);
+        if (it == base.end()) continue;
+        for (auto p : percentiles) {
+            auto b = it->second.latency.percentile(p) / 1000.0;
+            auto t = kv.second.latency.percentile(p) / 1000.0;
+            char pct[16];
+            snprintf(pct, sizeof(pct), "p%g", p);
+            printf("%-32s %-7s %10.2f %10.2f %+7.1f%%\n", kv.first.c_str(), pct,
+                   b, t, b > 0 ? (t - b) / b * 100 : 0.0);
+        }
+    }
+}
+
+void printResponseDiff(const Options &opts,
+                       const std::vector<httplib::RecordedRequest> &requests,
+                       const std::vector<Outcome> &base,
+                       const std::vector<Outcome> &target)
+{
+    uint64_t statusDiffs = 0;
+    uint64_t bodyDiffs = 0;
+    int shown = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        auto statusDiffers = base[i].status != target[i].status;
+        auto bodyDiffers = opts.bodyDiff && !statusDiffers &&
+                           base[i].bodyHash != target[i].bodyHash;
+        statusDiffs += statusDiffers;
+        bodyDiffs += bodyDiffers;
+
+        if ((statusDiffers || bodyDiffers) && shown < opts.maxDiffs) {
+            shown++;
+            const auto &r = requests[i];
+            printf("\n#%zu %s %s (连接 %llu)\n", i, r.method.c_str(),
+                   r.target.c_str(), static_cast<unsigned long long>(r.connection));
+            printf("  baseline %d: %s\n", base[i].status, base[i].bodyHead.c_str());
+            printf("  target   %d: %s\n", target[i].status, target[i].bodyHead.c_str());
+        }
+    }
+    printf("\n状态码不一致: %llu，响应体不一致: %llu（共 %zu 条请求）\n",
+           static_cast<unsigned long long>(statusDiffs),
+           static_cast<unsigned long long>(bodyDiffs), requests.size());
+}
+
+bool parseEndpoint(const char *v, Endpoint &endpoint)
+{
+    std::string s = v;
+    auto colon = s.rfind(':');
+    if (colon == std::string::npos) return false;
+    endpoint.host = s.substr(0, colon);
+    endpoint.port = std::atoi(s.c_str() + colon + 1);
+    return !endpoint.host.empty() && endpoint.port > 0;
+}
+
+void printUsage(const char *prog)
+{
+    std::cerr
+        << "用法: " << prog << " --log FILE --target HOST:PORT [选项]\n"
+        << "  --log FILE             Server::set_request_recording 录制的日志\n"
+        << "  --target HOST:PORT     回放目标\n"
+        << "  --baseline HOST:PORT   对照服务器，先回放并与 target 对比\n"
+        << "  --speed N|max          回放倍速，max 为不等待 (默认 1)\n"
+        << "  --threads N            并发回放的连接数上限 (默认 64)\n"
+        << "  --reset-cmd CMD        每遍回放前执行的命令，如恢复数据库\n"
+        << "  --no-body-diff         只比较状态码\n"
+        << "  --ignore-keys A,B      比较 JSON 响应体时忽略的字段\n"
+        << "  --max-diffs N          最多列出的差异条数 (默认 5)\n"
+        << "  --timeout SEC          请求超时 (默认 10)\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &opts)
+{
+    auto hasTarget = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            return i + 1 < argc ? argv[++i] : nullptr;
+        };
+
+        const char *v = nullptr;
+        if (arg == "--no-body-diff") {
+            opts.bodyDiff = false;
+            continue;
+        }
+        if (arg == "-h" || arg == "--help" || !(v = value())) return false;
+
+        if (arg == "--log") opts.logPath = v;
+        else if (arg == "--target") {
+            if (!parseEndpoint(v, opts.target)) return false;
+            hasTarget = true;
+        } else if (arg == "--baseline") {
+            if (!parseEndpoint(v, opts.baseline)) return false;
+            opts.hasBaseline = true;
+        } else if (arg == "--speed") {
+            opts.speed = std::strcmp(v, "max") == 0 ? 0 : std::atof(v);
+            if (opts.speed <= 0 && std::strcmp(v, "max") != 0) return false;
+        } else if (arg == "--threads") opts.threads = std::atoi(v);
+        else if (arg == "--reset-cmd") opts.resetCmd = v;
+        else if (arg == "--ignore-keys") {
+            std::string keys = v;
+            size_t pos = 0;
+            while (pos <= keys.size()) {
+                auto comma = (std::min)(keys.find(',', pos), keys.size());
+                if (comma > pos) opts.ignoreKeys.push_back(keys.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+        } else if (arg == "--max-diffs") opts.maxDiffs = std::atoi(v);
+        else if (arg == "--timeout") opts.timeoutSec = std::atoi(v);
+        else return false;
+    }
+    return !opts.logPath.empty() && hasTarget && opts.threads > 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<httplib::RecordedRequest> requests;
+    if (!httplib::read_request_log(opts.logPath, requests)) {
+        std::cerr << "无法读取请求日志: " << opts.logPath << "\n";
+        return 1;
+    }
+
+    // 按原始连接分组，组内保持录制顺序；先开始的连接先分配线程
+    std::map<uint64_t, std::vector<size_t>> byConnection;
+    for (size_t i = 0; i < requests.size(); i++) {
+        byConnection[requests[i].connection].push_back(i);
+    }
+    std::vector<std::vector<size_t>> connections;
+    for (auto &kv : byConnection) connections.push_back(std::move(kv.second));
+    std::sort(connections.begin(), connections.end(),
+              [&](const std::vector<size_t> &a, const std::vector<size_t> &b) {
+                  return requests[a.front()].time_us < requests[b.front()].time_us;
+              });
+
+    // 日志按请求完成顺序写入，最后一条不一定最晚到达
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    if (!requests.empty()) {
+        auto range = std::minmax_element(
+            requests.begin(), requests.end(),
+            [](const httplib::RecordedRequest &a, const httplib::RecordedRequest &b) {
+                return a.time_us < b.time_us;
+            });
+        firstUs = range.first->time_us;
+        lastUs = range.second->time_us;
+    }
+    auto span = (lastUs - firstUs) / 1e6;
+    char speed[32] = "max";
+    if (opts.speed > 0) snprintf(speed, sizeof(speed), "%gx", opts.speed);
+    printf("日志 %s: %zu 条请求，%zu 个连接，录制时长 %.1fs，回放速度 %s\n",
+           opts.logPath.c_str(), requests.size(), connections.size(), span, speed);
+    if (connections.size() > static_cast<size_t>(opts.threads)) {
+        printf("注意: 连接数多于 --threads，部分连接会排队，排队时间计入延迟\n");
+    }
+
+    std::vector<Outcome> baseResults;
+    if (opts.hasBaseline) {
+        if (!runResetCommand(opts)) {
+            std::cerr << "重置命令执行失败\n";
+            return 1;
+        }
+        printf("回放到 baseline %s:%d ...\n", opts.baseline.host.c_str(),
+               opts.baseline.port);
+        fflush(stdout);
+        replay(opts.baseline, opts, requests, connections, firstUs, baseResults);
+    }
+
+    if (!runResetCommand(opts)) {
+        std::cerr << "重置命令执行失败\n";
+        return 1;
+    }
+    printf("回放到 target %s:%d ...\n", opts.target.host.c_str(), opts.target.port);
+    fflush(stdout);
+    std::vector<Outcome> targetResults;
+    replay(opts.target, opts, requests, connections, firstUs, targetResults);
+
+    auto target = summarize(requests, targetResults);
+    if (!opts.hasBaseline) {
+        printLatency(target);
+        return 0;
+    }
+
+    auto base = summarize(requests, baseResults);
+    printf("\n== baseline ==");
+    printLatency(base);
+    printf("\n== target ==");
+    printLatency(target);
+    printLatencyDiff(base, target);
+    printResponseDiff(opts, requests, baseResults, targetResults);
+    return 0;
+}
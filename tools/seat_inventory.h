@@ -0,0 +1,314 @@
+// 座位库存内核（内存版）
+//
+// 与 back-end.js 的语义保持一致：
+//   - 座位按 ORDER BY carriage_number, seat_number（字符串序）排列，首次适配分配
+//   - 两个区间冲突当且仅当 NOT (a.to <= b.from OR a.from >= b.to)
+//   - 可用座位数 = 该座位类型总数 - 区间内有冲突的不同座位数
+//   - 取消为软删除，恢复前检查原座位区间是否仍空闲
+// 每个座位用一个 64 位掩码记录被占用的区间段（第 i 位表示第 i 站到第 i+1 站），
+// 冲突判断变成一次按位与。station_order 与 train_stations 一致，从 1 开始。
+//
+// 各容器按类别经 TrackedAllocator 分配，安装 memoryHook() 后可统计
+// 座位掩码、座位表、索引和分配记录各占多少内存。
+
+#ifndef SEAT_INVENTORY_H
+#define SEAT_INVENTORY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace inventory {
+
+enum MemoryCategory {
+    MEMORY_SEAT_MASKS,
+    MEMORY_SEATS,
+    MEMORY_INDEXES,
+    MEMORY_ALLOCATIONS,
+    MEMORY_CATEGORY_COUNT
+};
+const char *const MEMORY_CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+    "inventory.seat_masks", "inventory.seats", "inventory.indexes",
+    "inventory.allocations"};
+
+// 默认不统计。服务端可把回调接到 httplib::MemoryTag 上（见 README）
+struct MemoryHook {
+    // 分配为正、释放为负
+    void (*onBytes)(MemoryCategory category, std::ptrdiff_t bytes) = nullptr;
+    // 库存覆盖的座位数变化，每个车次每天一份库存
+    void (*onSeats)(std::ptrdiff_t seats) = nullptr;
+};
+
+inline MemoryHook &memoryHook()
+{
+    static MemoryHook hook;
+    return hook;
+}
+
+template <typename T, MemoryCategory C> struct TrackedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind {
+        using other = TrackedAllocator<U, C>;
+    };
+
+    TrackedAllocator() = default;
+    template <typename U> TrackedAllocator(const TrackedAllocator<U, C> &) {}
+
+    T *allocate(size_t n)
+    {
+        auto p = std::allocator<T>().allocate(n);
+        if (auto onBytes = memoryHook().onBytes) {
+            onBytes(C, static_cast<std::ptrdiff_t>(n * sizeof(T)));
+        }
+        return p;
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (auto onBytes = memoryHook().onBytes) {
+            onBytes(C, -static_cast<std::ptrdiff_t>(n * sizeof(T)));
+        }
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U> bool operator==(const TrackedAllocator<U, C> &) const { return true; }
+    template <typename U> bool operator!=(const TrackedAllocator<U, C> &) const { return false; }
+};
+
+template <typename T, MemoryCategory C>
+using TrackedVector = std::vector<T, TrackedAllocator<T, C>>;
+
+// 与 manage_database.js 中的 generateSeatNumbers 一致
+inline std::vector<std::string> generateSeatNumbers(const std::string &seatType,
+                                                    int totalSeats)
+{
+    std::vector<const char *> letters;
+    if (seatType == "二等座") letters = {"A", "B", "C", "D", "F"};
+    else if (seatType == "一等座") letters = {"A", "C", "D", "F"};
+    else if (seatType == "商务座") letters = {"A", "C"};
+    else if (seatType == "硬卧") letters = {"上", "中", "下"};
+    else if (seatType == "软卧") letters = {"上", "下"};
+
+    std::vector<std::string> seatNumbers;
+    seatNumbers.reserve(static_cast<size_t>(std::max(totalSeats, 0)));
+    for (int i = 0; i < totalSeats; i++) {
+        if (letters.empty()) {
+            // 硬座：简单数字编号
+            seatNumbers.push_back(std::to_string(i + 1));
+        } else {
+            auto perRow = static_cast<int>(letters.size());
+            seatNumbers.push_back(std::to_string(i / perRow + 1) +
+                                  letters[static_cast<size_t>(i % perRow)]);
+        }
+    }
+    return seatNumbers;
+}
+
+struct CarriageSpec {
+    std::string number;
+    std::string seatType;
+    int totalSeats;
+};
+
+struct TrainLayout {
+    std::string name;
+    int stationCount;  // 经停站数，最多 65 站
+    std::vector<CarriageSpec> carriages;
+};
+
+struct Seat {
+    std::string carriageNumber;
+    std::string seatNumber;
+    std::string seatType;
+};
+
+// 对应 seat_allocations 表的一行
+struct Allocation {
+    int seatId;
+    int fromOrder;
+    int toOrder;
+    bool deleted;
+};
+
+using AllocationList = TrackedVector<Allocation, MEMORY_ALLOCATIONS>;
+
+// 随库存对象拷贝、销毁上报覆盖的座位数
+class SeatCount {
+public:
+    explicit SeatCount(size_t seats = 0) : m_seats(seats) { report(1); }
+    SeatCount(const SeatCount &other) : m_seats(other.m_seats) { report(1); }
+    SeatCount &operator=(const SeatCount &other)
+    {
+        report(-1);
+        m_seats = other.m_seats;
+        report(1);
+        return *this;
+    }
+    ~SeatCount() { report(-1); }
+
+private:
+    void report(int sign) const
+    {
+        if (auto onSeats = memoryHook().onSeats) {
+            onSeats(sign * static_cast<std::ptrdiff_t>(m_seats));
+        }
+    }
+
+    size_t m_seats;
+};
+
+class SeatInventory {
+public:
+    explicit SeatInventory(const TrainLayout &layout)
+        : m_stationCount(layout.stationCount)
+    {
+        for (const auto &carriage : layout.carriages) {
+            for (auto &number :
+                 generateSeatNumbers(carriage.seatType, carriage.totalSeats)) {
+                m_seats.push_back({carriage.number, std::move(number),
+                                   carriage.seatType});
+            }
+        }
+        m_occupied.assign(m_seats.size(), 0);
+        m_seatCount = SeatCount(m_seats.size());
+
+        // 按座位类型分组，组内按车厢号、座位号排序
+        for (int id = 0; id < static_cast<int>(m_seats.size()); id++) {
+            auto type = seatTypeIndex(m_seats[static_cast<size_t>(id)].seatType);
+            if (type < 0) {
+                m_seatTypes.push_back(m_seats[static_cast<size_t>(id)].seatType);
+                m_groups.emplace_back();
+                type = static_cast<int>(m_groups.size()) - 1;
+            }
+            m_groups[static_cast<size_t>(type)].push_back(id);
+        }
+        for (auto &group : m_groups) {
+            std::sort(group.begin(), group.end(), [&](int a, int b) {
+                const auto &sa = m_seats[static_cast<size_t>(a)];
+                const auto &sb = m_seats[static_cast<size_t>(b)];
+                if (sa.carriageNumber != sb.carriageNumber) {
+                    return sa.carriageNumber < sb.carriageNumber;
+                }
+                return sa.seatNumber < sb.seatNumber;
+            });
+        }
+    }
+
+    int stationCount() const { return m_stationCount; }
+    size_t seatCount() const { return m_seats.size(); }
+    const Seat &seat(int seatId) const { return m_seats[static_cast<size_t>(seatId)]; }
+    const std::vector<std::string> &seatTypes() const { return m_seatTypes; }
+    const AllocationList &allocations() const { return m_allocations; }
+
+    int seatTypeIndex(const std::string &seatType) const
+    {
+        for (size_t i = 0; i < m_seatTypes.size(); i++) {
+            if (m_seatTypes[i] == seatType) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // 该座位类型在分配顺序下的座位 ID
+    const TrackedVector<int, MEMORY_INDEXES> &seatsOfType(int type) const
+    {
+        return m_groups[static_cast<size_t>(type)];
+    }
+
+    // 区间 [fromOrder, toOrder) 经过的区间段掩码
+    uint64_t legMask(int fromOrder, int toOrder) const
+    {
+        auto bits = [](int n) -> uint64_t {
+            return n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+        };
+        return bits(toOrder - 1) & ~bits(fromOrder - 1);
+    }
+
+    // 从快照（seat_allocations 的所有行）重建占用状态
+    void load(const AllocationList &rows)
+    {
+        m_allocations = rows;
+        std::fill(m_occupied.begin(), m_occupied.end(), 0);
+        for (const auto &a : m_allocations) {
+            if (!a.deleted) {
+                m_occupied[static_cast<size_t>(a.seatId)] |=
+                    legMask(a.fromOrder, a.toOrder);
+            }
+        }
+    }
+
+    int countAvailable(int type, int fromOrder, int toOrder) const
+    {
+        auto mask = legMask(fromOrder, toOrder);
+        int available = 0;
+        for (auto id : m_groups[static_cast<size_t>(type)]) {
+            available += (m_occupied[static_cast<size_t>(id)] & mask) == 0;
+        }
+        return available;
+    }
+
+    // 首次适配：按分配顺序第一个区间内空闲的座位，没有时返回 -1
+    int findFirstFit(int type, int fromOrder, int toOrder) const
+    {
+        auto mask = legMask(fromOrder, toOrder);
+        for (auto id : m_groups[static_cast<size_t>(type)]) {
+            if ((m_occupied[static_cast<size_t>(id)] & mask) == 0) return id;
+        }
+        return -1;
+    }
+
+    // 返回分配 ID（即 allocations() 下标），无座位时返回 -1
+    int allocate(int type, int fromOrder, int toOrder)
+    {
+        auto id = findFirstFit(type, fromOrder, toOrder);
+        return id < 0 ? -1 : allocateSeat(id, fromOrder, toOrder);
+    }
+
+    // 指定座位分配，区间已被占用时返回 -1
+    int allocateSeat(int seatId, int fromOrder, int toOrder)
+    {
+        auto mask = legMask(fromOrder, toOrder);
+        auto &occupied = m_occupied[static_cast<size_t>(seatId)];
+        if ((occupied & mask) != 0) return -1;
+        occupied |= mask;
+        m_allocations.push_back({seatId, fromOrder, toOrder, false});
+        return static_cast<int>(m_allocations.size()) - 1;
+    }
+
+    bool cancel(int allocationId)
+    {
+        auto &a = m_allocations[static_cast<size_t>(allocationId)];
+        if (a.deleted) return false;
+        a.deleted = true;
+        m_occupied[static_cast<size_t>(a.seatId)] &=
+            ~legMask(a.fromOrder, a.toOrder);
+        return true;
+    }
+
+    // 原座位在该区间已被他人占用时恢复失败
+    bool restore(int allocationId)
+    {
+        auto &a = m_allocations[static_cast<size_t>(allocationId)];
+        auto mask = legMask(a.fromOrder, a.toOrder);
+        auto &occupied = m_occupied[static_cast<size_t>(a.seatId)];
+        if (!a.deleted || (occupied & mask) != 0) return false;
+        a.deleted = false;
+        occupied |= mask;
+        return true;
+    }
+
+private:
+    int m_stationCount;
+    TrackedVector<Seat, MEMORY_SEATS> m_seats;
+    TrackedVector<uint64_t, MEMORY_SEAT_MASKS> m_occupied;
+    std::vector<std::string> m_seatTypes;
+    TrackedVector<TrackedVector<int, MEMORY_INDEXES>, MEMORY_INDEXES> m_groups;
+    AllocationList m_allocations;
+    SeatCount m_seatCount;
+};
+
+} // namespace inventory
+
+#endif // SEAT_INVENTORY_H